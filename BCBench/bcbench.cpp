@@ -0,0 +1,444 @@
+//--------------------------------------------------------------------------------------
+// File: bcbench.cpp
+//
+// BC compression benchmark
+//
+// Compresses deterministic synthetic images with every BC format and the relevant
+// TEX_COMPRESS_* flags, serial and parallel, and writes throughput and quality as CSV.
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+//--------------------------------------------------------------------------------------
+
+#ifdef _WIN32
+#pragma warning(push)
+#pragma warning(disable : 4005)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NODRAWTEXT
+#define NOGDI
+#define NOMCX
+#define NOSERVICE
+#define NOHELP
+#pragma warning(pop)
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "DirectXTex.h"
+
+using namespace DirectX;
+
+namespace
+{
+    enum CORPUS_KIND : uint32_t
+    {
+        CORPUS_LDR = 0x1,       // 8-bit RGBA sources, used with BC1-BC5 and BC7
+        CORPUS_HDR = 0x2,       // Float sources, used with BC6H
+    };
+
+    struct Corpus
+    {
+        const char* name;
+        CORPUS_KIND kind;
+    };
+
+    const Corpus g_Corpora[] =
+    {
+        { "gradient",   CORPUS_LDR },
+        { "noise",      CORPUS_LDR },
+        { "normalmap",  CORPUS_LDR },
+        { "cutout",     CORPUS_LDR },
+        { "hdrramp",    CORPUS_HDR },
+    };
+
+    struct FlagSet
+    {
+        const char* name;
+        TEX_COMPRESS_FLAGS flags;
+    };
+
+    const FlagSet g_BC123Flags[] =
+    {
+        { "default",    TEX_COMPRESS_DEFAULT },
+        { "dither",     TEX_COMPRESS_DITHER },
+        { "uniform",    TEX_COMPRESS_UNIFORM },
+        { "multiblock", TEX_COMPRESS_MULTIBLOCK },
+        { "memoize",    TEX_COMPRESS_MEMOIZE },
+        { "rdo",        TEX_COMPRESS_RDO },
+    };
+
+    const FlagSet g_BC45Flags[] =
+    {
+        { "default",    TEX_COMPRESS_DEFAULT },
+        { "memoize",    TEX_COMPRESS_MEMOIZE },
+        { "rdo",        TEX_COMPRESS_RDO },
+    };
+
+    const FlagSet g_BC6HFlags[] =
+    {
+        { "default",    TEX_COMPRESS_DEFAULT },
+        { "bc6hfast",   TEX_COMPRESS_BC6H_FAST },
+        { "memoize",    TEX_COMPRESS_MEMOIZE },
+        { "rdo",        TEX_COMPRESS_RDO },
+    };
+
+    const FlagSet g_BC7Flags[] =
+    {
+        { "default",    TEX_COMPRESS_DEFAULT },
+        { "quick",      TEX_COMPRESS_BC7_QUICK },
+        { "3subsets",   TEX_COMPRESS_BC7_USE_3SUBSETS },
+        { "level0",     TEX_COMPRESS_BC7_LEVEL_0 },
+        { "level1",     TEX_COMPRESS_BC7_LEVEL_1 },
+        { "level2",     TEX_COMPRESS_BC7_LEVEL_2 },
+        { "level3",     TEX_COMPRESS_BC7_LEVEL_3 },
+        { "memoize",    TEX_COMPRESS_MEMOIZE },
+        { "rdo",        TEX_COMPRESS_RDO },
+    };
+
+    struct Format
+    {
+        const char* name;
+        DXGI_FORMAT format;
+        CORPUS_KIND kind;
+        const FlagSet* flags;
+        size_t flagCount;
+    };
+
+    #define DEFFMT(fmt, kind, flags) { #fmt, DXGI_FORMAT_ ## fmt, kind, flags, std::size(flags) }
+
+    const Format g_Formats[] =
+    {
+        DEFFMT(BC1_UNORM, CORPUS_LDR, g_BC123Flags),
+        DEFFMT(BC2_UNORM, CORPUS_LDR, g_BC123Flags),
+        DEFFMT(BC3_UNORM, CORPUS_LDR, g_BC123Flags),
+        DEFFMT(BC4_UNORM, CORPUS_LDR, g_BC45Flags),
+        DEFFMT(BC4_SNORM, CORPUS_LDR, g_BC45Flags),
+        DEFFMT(BC5_UNORM, CORPUS_LDR, g_BC45Flags),
+        DEFFMT(BC5_SNORM, CORPUS_LDR, g_BC45Flags),
+        DEFFMT(BC6H_UF16, CORPUS_HDR, g_BC6HFlags),
+        DEFFMT(BC6H_SF16, CORPUS_HDR, g_BC6HFlags),
+        DEFFMT(BC7_UNORM, CORPUS_LDR, g_BC7Flags),
+    };
+
+    #undef DEFFMT
+
+    //----------------------------------------------------------------------------------
+    // Fixed-seed xorshift, so every platform and standard library sees the same pixels
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) noexcept : m_state(seed ? seed : 0x9E3779B9u) {}
+
+        uint32_t Next() noexcept
+        {
+            m_state ^= m_state << 13;
+            m_state ^= m_state >> 17;
+            m_state ^= m_state << 5;
+            return m_state;
+        }
+
+        float NextFloat() noexcept { return float(Next() >> 8) * (1.f / 16777216.f); }
+
+    private:
+        uint32_t m_state;
+    };
+
+    uint8_t ToUNorm8(float v) noexcept
+    {
+        return static_cast<uint8_t>(std::min(std::max(v, 0.f), 1.f) * 255.f + 0.5f);
+    }
+
+    //----------------------------------------------------------------------------------
+    HRESULT GenerateCorpus(const char* name, size_t size, ScratchImage& image)
+    {
+        const bool hdr = (strcmp(name, "hdrramp") == 0);
+
+        HRESULT hr = image.Initialize2D(hdr ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1);
+        if (FAILED(hr))
+            return hr;
+
+        const Image& img = *image.GetImage(0, 0, 0);
+        const float scale = 1.f / float(size - 1);
+        Random rng(0x2545F491u);
+
+        for (size_t y = 0; y < size; ++y)
+        {
+            uint8_t* pRow = img.pixels + y * img.rowPitch;
+            const float fy = float(y) * scale;
+
+            for (size_t x = 0; x < size; ++x)
+            {
+                const float fx = float(x) * scale;
+
+                if (hdr)
+                {
+                    // Exponential ramp from 2^-8 to 2^8, with a smooth hue shift
+                    const float lum = std::exp2(fx * 16.f - 8.f);
+                    auto pOut = reinterpret_cast<float*>(pRow) + x * 4;
+                    pOut[0] = lum;
+                    pOut[1] = lum * (0.5f + 0.5f * fy);
+                    pOut[2] = lum * (1.f - 0.75f * fy);
+                    pOut[3] = 1.f;
+                    continue;
+                }
+
+                uint8_t* pOut = pRow + x * 4;
+                if (strcmp(name, "gradient") == 0)
+                {
+                    pOut[0] = ToUNorm8(fx);
+                    pOut[1] = ToUNorm8(fy);
+                    pOut[2] = ToUNorm8(1.f - (fx + fy) * 0.5f);
+                    pOut[3] = ToUNorm8(0.25f + 0.75f * fx);
+                }
+                else if (strcmp(name, "noise") == 0)
+                {
+                    const uint32_t bits = rng.Next();
+                    memcpy(pOut, &bits, sizeof(bits));
+                }
+                else if (strcmp(name, "normalmap") == 0)
+                {
+                    // Tangent-space normals of overlapping sine bumps plus a little jitter
+                    const float period = 6.2831853f * 8.f;
+                    float nx = 0.6f * std::cos(fx * period) * std::sin(fy * period * 0.5f) + (rng.NextFloat() - 0.5f) * 0.05f;
+                    float ny = 0.6f * std::sin(fx * period * 0.5f) * std::cos(fy * period) + (rng.NextFloat() - 0.5f) * 0.05f;
+                    const float len = std::sqrt(nx * nx + ny * ny + 1.f);
+                    nx /= len;
+                    ny /= len;
+                    const float nz = 1.f / len;
+                    pOut[0] = ToUNorm8(nx * 0.5f + 0.5f);
+                    pOut[1] = ToUNorm8(ny * 0.5f + 0.5f);
+                    pOut[2] = ToUNorm8(nz * 0.5f + 0.5f);
+                    pOut[3] = 255;
+                }
+                else
+                {
+                    // Foliage-like cutout: soft colors with binary alpha from a ring pattern
+                    const float dx = fx - 0.5f;
+                    const float dy = fy - 0.5f;
+                    const float ring = std::sin(std::sqrt(dx * dx + dy * dy) * 80.f + std::atan2(dy, dx) * 5.f);
+                    pOut[0] = ToUNorm8(0.2f + 0.3f * fx);
+                    pOut[1] = ToUNorm8(0.5f + 0.4f * fy);
+                    pOut[2] = ToUNorm8(0.1f + 0.1f * rng.NextFloat());
+                    pOut[3] = (ring > 0.f) ? 255 : 0;
+                }
+            }
+        }
+
+        return S_OK;
+    }
+
+    void PrintUsage()
+    {
+        fprintf(stderr,
+            "Usage: bcbench [-size <n>] [-repeat <n>] [-threads <n>] [-serial] [-parallel]\n"
+            "               [-format <name>] [-corpus <name>]\n\n"
+            "   -size <n>       image width and height (multiple of 4, default 256)\n"
+            "   -repeat <n>     compressions per case, fastest is reported (default 3)\n"
+            "   -threads <n>    threads for parallel runs (default hardware concurrency)\n"
+            "   -serial         run serial cases only\n"
+            "   -parallel       run parallel cases only\n"
+            "   -format <name>  only run the named format (e.g. BC7_UNORM)\n"
+            "   -corpus <name>  only run the named corpus\n\n"
+            "Writes CSV to stdout: corpus,format,flags,threads,width,height,seconds,mpix_per_s,rmse,psnr\n");
+    }
+
+    int RunBenchmark(int argc, char* argv[])
+    {
+        size_t size = 256;
+        size_t repeat = 3;
+        size_t threads = 0;
+        bool runSerial = true;
+        bool runParallel = true;
+        const char* onlyFormat = nullptr;
+        const char* onlyCorpus = nullptr;
+
+        for (int iArg = 1; iArg < argc; ++iArg)
+        {
+            const char* arg = argv[iArg];
+            const bool hasValue = (iArg + 1 < argc);
+
+            if (!strcmp(arg, "-size") && hasValue)
+            {
+                size = strtoul(argv[++iArg], nullptr, 10);
+            }
+            else if (!strcmp(arg, "-repeat") && hasValue)
+            {
+                repeat = strtoul(argv[++iArg], nullptr, 10);
+            }
+            else if (!strcmp(arg, "-threads") && hasValue)
+            {
+                threads = strtoul(argv[++iArg], nullptr, 10);
+            }
+            else if (!strcmp(arg, "-serial"))
+            {
+                runParallel = false;
+            }
+            else if (!strcmp(arg, "-parallel"))
+            {
+                runSerial = false;
+            }
+            else if (!strcmp(arg, "-format") && hasValue)
+            {
+                onlyFormat = argv[++iArg];
+            }
+            else if (!strcmp(arg, "-corpus") && hasValue)
+            {
+                onlyCorpus = argv[++iArg];
+            }
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+
+        if (size < 4 || (size & 3) || !repeat || (!runSerial && !runParallel))
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        if (FAILED(SetParallelThreadCount(threads)))
+        {
+            fprintf(stderr, "ERROR: Invalid thread count %zu\n", threads);
+            return 1;
+        }
+
+        const size_t parallelThreads = threads ? threads : std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        const double mpix = double(size) * double(size) / 1000000.0;
+
+        printf("corpus,format,flags,threads,width,height,seconds,mpix_per_s,rmse,psnr\n");
+
+        for (const auto& corpus : g_Corpora)
+        {
+            if (onlyCorpus && strcmp(onlyCorpus, corpus.name) != 0)
+                continue;
+
+            ScratchImage source;
+            HRESULT hr = GenerateCorpus(corpus.name, size, source);
+            if (FAILED(hr))
+            {
+                fprintf(stderr, "ERROR: Failed generating %s (%08X)\n", corpus.name, static_cast<unsigned int>(hr));
+                return 1;
+            }
+
+            const Image& srcImage = *source.GetImage(0, 0, 0);
+
+            for (const auto& fmt : g_Formats)
+            {
+                if (fmt.kind != corpus.kind)
+                    continue;
+
+                if (onlyFormat && strcmp(onlyFormat, fmt.name) != 0)
+                    continue;
+
+                for (size_t f = 0; f < fmt.flagCount; ++f)
+                {
+                    for (int pass = 0; pass < 2; ++pass)
+                    {
+                        const bool parallel = (pass != 0);
+                        if ((parallel && !runParallel) || (!parallel && !runSerial))
+                            continue;
+
+                        auto compress = fmt.flags[f].flags;
+                        if (parallel)
+                            compress |= TEX_COMPRESS_PARALLEL;
+
+                        double best = 0.0;
+                        ScratchImage result;
+                        for (size_t r = 0; r < repeat; ++r)
+                        {
+                            ScratchImage cImage;
+                            const auto start = std::chrono::steady_clock::now();
+                            hr = Compress(srcImage, fmt.format, compress, TEX_THRESHOLD_DEFAULT, cImage);
+                            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                            if (FAILED(hr))
+                                break;
+
+                            if (!r || elapsed.count() < best)
+                                best = elapsed.count();
+
+                            result = std::move(cImage);
+                        }
+
+                        if (FAILED(hr))
+                        {
+                            fprintf(stderr, "ERROR: Failed compressing %s to %s with %s (%08X)\n",
+                                corpus.name, fmt.name, fmt.flags[f].name, static_cast<unsigned int>(hr));
+                            return 1;
+                        }
+
+                        // ComputeMSE decompresses the BC image; PSNR assumes a peak of 1.0, which for HDR is relative only
+                        float mse = 0.f;
+                        hr = ComputeMSE(srcImage, *result.GetImage(0, 0, 0), mse, nullptr);
+                        if (FAILED(hr))
+                        {
+                            fprintf(stderr, "ERROR: Failed computing MSE for %s (%08X)\n", fmt.name, static_cast<unsigned int>(hr));
+                            return 1;
+                        }
+
+                        const double rmse = std::sqrt(double(mse));
+                        const double psnr = (mse > 0.f) ? 10.0 * std::log10(1.0 / double(mse)) : 999.0;
+
+                        printf("%s,%s,%s,%zu,%zu,%zu,%.6f,%.3f,%.6f,%.3f\n",
+                            corpus.name, fmt.name, fmt.flags[f].name, parallel ? parallelThreads : size_t(1),
+                            size, size, best, (best > 0.0) ? mpix / best : 0.0, rmse, psnr);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+
+        return 0;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+#ifdef _WIN32
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    // The options are all ASCII, so narrow them and share the parser with other platforms
+    std::vector<std::string> args;
+    args.reserve(static_cast<size_t>(argc));
+    for (int iArg = 0; iArg < argc; ++iArg)
+    {
+        std::string arg;
+        for (const wchar_t* pch = argv[iArg]; *pch; ++pch)
+        {
+            arg.push_back((*pch < 0x80) ? static_cast<char>(*pch) : '?');
+        }
+        args.emplace_back(std::move(arg));
+    }
+
+    std::vector<char*> argp;
+    argp.reserve(args.size());
+    for (auto& arg : args)
+    {
+        argp.push_back(arg.data());
+    }
+
+    return RunBenchmark(argc, argp.data());
+}
+#else
+int main(int argc, char* argv[])
+{
+    return RunBenchmark(argc, argv);
+}
+#endif
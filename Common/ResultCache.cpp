@@ -0,0 +1,635 @@
+//--------------------------------------------------------------------------------------
+// File: ResultCache.cpp
+//
+// On-disk cache of per-file results keyed by a hash of the source file contents and
+// of the options that affect the result
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+//--------------------------------------------------------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable : 4005)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NODRAWTEXT
+#define NOMCX
+#define NOSERVICE
+#define NOHELP
+#pragma warning(pop)
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <vector>
+
+#include "ResultCache.h"
+
+namespace
+{
+    struct handle_closer { void operator()(HANDLE h) noexcept { if (h) CloseHandle(h); } };
+
+    using ScopedHandle = std::unique_ptr<void, handle_closer>;
+
+    inline HANDLE safe_handle(HANDLE h) noexcept { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
+
+    constexpr uint32_t CACHE_MAGIC = 0x43525854; // "TXRC"
+    constexpr uint32_t CACHE_VERSION = 1;
+
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entrySize;
+        uint32_t reserved;
+        uint64_t sortedCount;   // Entries after the sorted ones were appended by later runs
+        uint64_t reserved2;
+    };
+
+    static_assert(sizeof(CacheHeader) == 32, "CacheHeader is part of the index file format");
+
+    // Byte range locked to serialize appends. It lies far past the end of the file so it
+    // doesn't block reads of the index itself.
+    constexpr DWORD APPEND_LOCK_OFFSET_HIGH = 0x7FFFFFFF;
+
+    bool IsValidHeader(const CacheHeader& header, uint64_t fileSize) noexcept
+    {
+        if (header.magic != CACHE_MAGIC
+            || header.version != CACHE_VERSION
+            || header.entrySize != sizeof(CacheEntry))
+            return false;
+
+        return header.sortedCount <= (fileSize - sizeof(CacheHeader)) / sizeof(CacheEntry);
+    }
+
+    inline bool KeyLess(const CacheEntry& a, const CacheEntry& b) noexcept
+    {
+        if (a.contentHash != b.contentHash)
+            return a.contentHash < b.contentHash;
+
+        return a.optionsHash < b.optionsHash;
+    }
+
+    inline bool KeyMatch(const CacheEntry& entry, uint64_t contentHash, uint64_t optionsHash, uint64_t sourceSize) noexcept
+    {
+        return entry.contentHash == contentHash
+            && entry.optionsHash == optionsHash
+            && entry.sourceSize == sourceSize;
+    }
+
+    //----------------------------------------------------------------------------------
+    // xxHash64
+    constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ull;
+
+    inline uint64_t Rotl64(uint64_t x, int r) noexcept
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    inline uint64_t Read64(const uint8_t* ptr) noexcept
+    {
+        uint64_t v;
+        memcpy(&v, ptr, sizeof(v));
+        return v;
+    }
+
+    inline uint32_t Read32(const uint8_t* ptr) noexcept
+    {
+        uint32_t v;
+        memcpy(&v, ptr, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t HashRound(uint64_t acc, uint64_t input) noexcept
+    {
+        acc += input * PRIME64_2;
+        acc = Rotl64(acc, 31);
+        return acc * PRIME64_1;
+    }
+
+    inline uint64_t HashMergeRound(uint64_t acc, uint64_t val) noexcept
+    {
+        acc ^= HashRound(0, val);
+        return acc * PRIME64_1 + PRIME64_4;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+ContentHasher::ContentHasher(uint64_t seed) noexcept :
+    m_acc{ seed + PRIME64_1 + PRIME64_2, seed + PRIME64_2, seed, seed - PRIME64_1 },
+    m_seed(seed),
+    m_total(0),
+    m_buffer{},
+    m_bufferSize(0)
+{
+}
+
+void ContentHasher::Update(const void* pData, size_t size) noexcept
+{
+    auto ptr = static_cast<const uint8_t*>(pData);
+    m_total += size;
+
+    if (m_bufferSize)
+    {
+        const size_t fill = std::min(size, sizeof(m_buffer) - m_bufferSize);
+        memcpy(m_buffer + m_bufferSize, ptr, fill);
+        m_bufferSize += fill;
+        ptr += fill;
+        size -= fill;
+
+        if (m_bufferSize < sizeof(m_buffer))
+            return;
+
+        for (size_t j = 0; j < 4; ++j)
+        {
+            m_acc[j] = HashRound(m_acc[j], Read64(m_buffer + j * 8));
+        }
+        m_bufferSize = 0;
+    }
+
+    for (; size >= 32; ptr += 32, size -= 32)
+    {
+        m_acc[0] = HashRound(m_acc[0], Read64(ptr));
+        m_acc[1] = HashRound(m_acc[1], Read64(ptr + 8));
+        m_acc[2] = HashRound(m_acc[2], Read64(ptr + 16));
+        m_acc[3] = HashRound(m_acc[3], Read64(ptr + 24));
+    }
+
+    if (size)
+    {
+        memcpy(m_buffer, ptr, size);
+        m_bufferSize = size;
+    }
+}
+
+uint64_t ContentHasher::Finalize() const noexcept
+{
+    uint64_t h;
+    if (m_total >= 32)
+    {
+        h = Rotl64(m_acc[0], 1) + Rotl64(m_acc[1], 7) + Rotl64(m_acc[2], 12) + Rotl64(m_acc[3], 18);
+        for (size_t j = 0; j < 4; ++j)
+        {
+            h = HashMergeRound(h, m_acc[j]);
+        }
+    }
+    else
+    {
+        h = m_seed + PRIME64_5;
+    }
+
+    h += m_total;
+
+    const uint8_t* ptr = m_buffer;
+    size_t size = m_bufferSize;
+
+    for (; size >= 8; ptr += 8, size -= 8)
+    {
+        h ^= HashRound(0, Read64(ptr));
+        h = Rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+
+    if (size >= 4)
+    {
+        h ^= uint64_t(Read32(ptr)) * PRIME64_1;
+        h = Rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        ptr += 4;
+        size -= 4;
+    }
+
+    for (; size > 0; ++ptr, --size)
+    {
+        h ^= uint64_t(*ptr) * PRIME64_5;
+        h = Rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT HashFileContents(const wchar_t* szFile, uint64_t& hash, uint64_t& fileSize) noexcept
+{
+    hash = fileSize = 0;
+
+    if (!szFile)
+        return E_INVALIDARG;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    CREATEFILE2_EXTENDED_PARAMETERS params = { sizeof(CREATEFILE2_EXTENDED_PARAMETERS), 0, 0, 0, {} };
+    params.dwFileFlags = FILE_FLAG_SEQUENTIAL_SCAN;
+    ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, &params)));
+#else
+    ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, nullptr)));
+#endif
+    if (!hFile)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    constexpr DWORD c_chunkSize = 1024 * 1024;
+    std::unique_ptr<uint8_t[]> buffer(new (std::nothrow) uint8_t[c_chunkSize]);
+    if (!buffer)
+        return E_OUTOFMEMORY;
+
+    ContentHasher hasher;
+    uint64_t total = 0;
+    for (;;)
+    {
+        DWORD bytesRead = 0;
+        if (!ReadFile(hFile.get(), buffer.get(), c_chunkSize, &bytesRead, nullptr))
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        if (!bytesRead)
+            break;
+
+        hasher.Update(buffer.get(), bytesRead);
+        total += bytesRead;
+    }
+
+    hash = hasher.Finalize();
+    fileSize = total;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+ResultCache::ResultCache() noexcept :
+    m_szFile{},
+    m_hMapping(nullptr),
+    m_pView(nullptr),
+    m_sortedCount(0),
+    m_count(0),
+    m_written(0)
+{
+}
+
+ResultCache::~ResultCache()
+{
+    Unmap();
+}
+
+_Use_decl_annotations_
+HRESULT ResultCache::Open(const wchar_t* szFile) noexcept
+{
+    Unmap();
+
+    if (!szFile || wcscpy_s(m_szFile, szFile))
+        return E_INVALIDARG;
+
+    ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)));
+    if (!hFile)
+    {
+        const DWORD err = GetLastError();
+        return (err == ERROR_FILE_NOT_FOUND) ? S_OK : HRESULT_FROM_WIN32(err);
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(hFile.get(), &fileSize))
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    if (fileSize.QuadPart < LONGLONG(sizeof(CacheHeader)))
+    {
+        // Empty index, or one being created by another run
+        return S_OK;
+    }
+
+    ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+    if (!hMapping)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    auto pView = static_cast<const uint8_t*>(MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0));
+    if (!pView)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    auto header = reinterpret_cast<const CacheHeader*>(pView);
+    if (!IsValidHeader(*header, uint64_t(fileSize.QuadPart)))
+    {
+        UnmapViewOfFile(pView);
+        return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+
+    m_hMapping = hMapping.release();
+    m_pView = pView;
+    m_sortedCount = static_cast<size_t>(header->sortedCount);
+    m_count = static_cast<size_t>((uint64_t(fileSize.QuadPart) - sizeof(CacheHeader)) / sizeof(CacheEntry));
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+bool ResultCache::Find(uint64_t contentHash, uint64_t optionsHash, uint64_t sourceSize, CacheEntry& entry) const
+{
+    // Entries inserted by this run are the newest
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        for (auto it = m_pending.crbegin(); it != m_pending.crend(); ++it)
+        {
+            if (KeyMatch(*it, contentHash, optionsHash, sourceSize))
+            {
+                entry = *it;
+                return true;
+            }
+        }
+    }
+
+    if (m_pView)
+    {
+        auto entries = reinterpret_cast<const CacheEntry*>(m_pView + sizeof(CacheHeader));
+
+        // Appended entries are newer than the sorted ones
+        for (size_t j = m_count; j > m_sortedCount; --j)
+        {
+            if (KeyMatch(entries[j - 1], contentHash, optionsHash, sourceSize))
+            {
+                entry = entries[j - 1];
+                return true;
+            }
+        }
+
+        CacheEntry key = {};
+        key.contentHash = contentHash;
+        key.optionsHash = optionsHash;
+
+        auto it = std::lower_bound(entries, entries + m_sortedCount, key, KeyLess);
+        if (it != entries + m_sortedCount && KeyMatch(*it, contentHash, optionsHash, sourceSize))
+        {
+            entry = *it;
+            return true;
+        }
+    }
+
+    entry = {};
+    return false;
+}
+
+void ResultCache::Insert(const CacheEntry& entry)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_pending.push_back(entry);
+}
+
+HRESULT ResultCache::Flush()
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    if (!*m_szFile)
+        return E_UNEXPECTED;
+
+    if (m_written >= m_pending.size())
+        return S_OK;
+
+    ScopedHandle hFile(safe_handle(CreateFileW(m_szFile, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr)));
+    if (!hFile)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    OVERLAPPED lockRange = {};
+    lockRange.OffsetHigh = APPEND_LOCK_OFFSET_HIGH;
+    if (!LockFileEx(hFile.get(), LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &lockRange))
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    auto unlock = [&]()
+    {
+        OVERLAPPED range = {};
+        range.OffsetHigh = APPEND_LOCK_OFFSET_HIGH;
+        UnlockFileEx(hFile.get(), 0, 1, 0, &range);
+    };
+
+    HRESULT hr = S_OK;
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(hFile.get(), &fileSize))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+    else if (fileSize.QuadPart < LONGLONG(sizeof(CacheHeader)))
+    {
+        // New index
+        CacheHeader header = {};
+        header.magic = CACHE_MAGIC;
+        header.version = CACHE_VERSION;
+        header.entrySize = sizeof(CacheEntry);
+
+        DWORD bytesWritten;
+        if (!WriteFile(hFile.get(), &header, sizeof(header), &bytesWritten, nullptr))
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+        }
+        else if (bytesWritten != sizeof(header))
+        {
+            hr = E_FAIL;
+        }
+
+        fileSize.QuadPart = sizeof(CacheHeader);
+    }
+    else
+    {
+        CacheHeader header = {};
+        DWORD bytesRead = 0;
+        if (!ReadFile(hFile.get(), &header, sizeof(header), &bytesRead, nullptr))
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+        }
+        else if (bytesRead != sizeof(header) || !IsValidHeader(header, uint64_t(fileSize.QuadPart)))
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        // Append after the last complete entry, dropping any partial write from an earlier run
+        const uint64_t count = (uint64_t(fileSize.QuadPart) - sizeof(CacheHeader)) / sizeof(CacheEntry);
+
+        LARGE_INTEGER offset;
+        offset.QuadPart = LONGLONG(sizeof(CacheHeader) + count * sizeof(CacheEntry));
+
+        const auto bytesToWrite = static_cast<DWORD>((m_pending.size() - m_written) * sizeof(CacheEntry));
+
+        DWORD bytesWritten;
+        if (!SetFilePointerEx(hFile.get(), offset, nullptr, FILE_BEGIN)
+            || !WriteFile(hFile.get(), &m_pending[m_written], bytesToWrite, &bytesWritten, nullptr))
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+        }
+        else if (bytesWritten != bytesToWrite)
+        {
+            hr = E_FAIL;
+        }
+        else
+        {
+            m_written = m_pending.size();
+        }
+    }
+
+    unlock();
+
+    return hr;
+}
+
+void ResultCache::Close()
+{
+    if (!*m_szFile)
+        return;
+
+    std::ignore = Flush();
+
+    Unmap();
+
+    std::ignore = Compact();
+
+    std::lock_guard<std::mutex> guard(m_lock);
+    m_pending.clear();
+    m_written = 0;
+    *m_szFile = 0;
+}
+
+void ResultCache::Unmap() noexcept
+{
+    if (m_pView)
+    {
+        UnmapViewOfFile(m_pView);
+        m_pView = nullptr;
+    }
+
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+
+    m_sortedCount = m_count = 0;
+}
+
+// Sorts the appended entries into the rest of the index, keeping the newest entry for
+// each key. The compacted index is written to a temporary file that then replaces the
+// index, so a crash leaves either the old or the new index. The replacement fails while
+// another run has the index open or mapped, which leaves it for a later run to compact.
+// An entry another run appends between reading the index and replacing it is dropped,
+// which only costs a cache miss.
+HRESULT ResultCache::Compact() noexcept
+{
+    std::vector<CacheEntry> entries;
+    CacheHeader header = {};
+    {
+        ScopedHandle hFile(safe_handle(CreateFileW(m_szFile, GENERIC_READ, 0, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)));
+        if (!hFile)
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        LARGE_INTEGER fileSize = {};
+        if (!GetFileSizeEx(hFile.get(), &fileSize))
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        if (fileSize.QuadPart < LONGLONG(sizeof(CacheHeader)) || fileSize.HighPart > 0)
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        DWORD bytesRead = 0;
+        if (!ReadFile(hFile.get(), &header, sizeof(header), &bytesRead, nullptr))
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        if (bytesRead != sizeof(header) || !IsValidHeader(header, uint64_t(fileSize.QuadPart)))
+            return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+
+        const size_t count = (size_t(fileSize.LowPart) - sizeof(CacheHeader)) / sizeof(CacheEntry);
+        if (count == header.sortedCount)
+            return S_FALSE;
+
+        try
+        {
+            entries.resize(count);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        const auto bytesToRead = static_cast<DWORD>(count * sizeof(CacheEntry));
+        if (!ReadFile(hFile.get(), entries.data(), bytesToRead, &bytesRead, nullptr))
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        if (bytesRead != bytesToRead)
+            return E_FAIL;
+    }
+
+    // Stable sort keeps later entries after earlier ones with the same key
+    std::stable_sort(entries.begin(), entries.end(), KeyLess);
+
+    size_t unique = 0;
+    for (size_t j = 0; j < entries.size(); ++j)
+    {
+        if (unique > 0
+            && entries[unique - 1].contentHash == entries[j].contentHash
+            && entries[unique - 1].optionsHash == entries[j].optionsHash)
+        {
+            entries[unique - 1] = entries[j];
+        }
+        else
+        {
+            entries[unique++] = entries[j];
+        }
+    }
+
+    header.sortedCount = unique;
+
+    wchar_t szTemp[MAX_PATH] = {};
+    if (swprintf_s(szTemp, L"%ls.%lu.tmp", m_szFile, GetCurrentProcessId()) < 0)
+        return E_INVALIDARG;
+
+    HRESULT hr = S_OK;
+    {
+        ScopedHandle hTemp(safe_handle(CreateFileW(szTemp, GENERIC_WRITE, 0, nullptr,
+            CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr)));
+        if (!hTemp)
+            return HRESULT_FROM_WIN32(GetLastError());
+
+        const auto bytesToWrite = static_cast<DWORD>(unique * sizeof(CacheEntry));
+
+        DWORD bytesWritten;
+        if (!WriteFile(hTemp.get(), &header, sizeof(header), &bytesWritten, nullptr)
+            || !WriteFile(hTemp.get(), entries.data(), bytesToWrite, &bytesWritten, nullptr)
+            || !FlushFileBuffers(hTemp.get()))
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+        }
+        else if (bytesWritten != bytesToWrite)
+        {
+            hr = E_FAIL;
+        }
+    }
+
+    if (SUCCEEDED(hr) && !MoveFileExW(szTemp, m_szFile, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    if (FAILED(hr))
+    {
+        DeleteFileW(szTemp);
+    }
+
+    return hr;
+}
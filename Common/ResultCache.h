@@ -0,0 +1,98 @@
+//--------------------------------------------------------------------------------------
+// File: ResultCache.h
+//
+// On-disk cache of per-file results keyed by a hash of the source file contents and
+// of the options that affect the result
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+//--------------------------------------------------------------------------------------
+// Streaming 64-bit hash (xxHash64)
+class ContentHasher
+{
+public:
+    explicit ContentHasher(uint64_t seed = 0) noexcept;
+
+    void Update(const void* pData, size_t size) noexcept;
+    uint64_t Finalize() const noexcept;
+
+    template<typename T>
+    void UpdateValue(const T& value) noexcept { Update(&value, sizeof(T)); }
+
+private:
+    uint64_t m_acc[4];
+    uint64_t m_seed;
+    uint64_t m_total;
+    uint8_t  m_buffer[32];
+    size_t   m_bufferSize;
+};
+
+HRESULT HashFileContents(_In_z_ const wchar_t* szFile, _Out_ uint64_t& hash, _Out_ uint64_t& fileSize) noexcept;
+
+//--------------------------------------------------------------------------------------
+// Index entries are fixed size and position-independent, so the index file is used in
+// place through a read-only file mapping.
+struct CacheEntry
+{
+    uint64_t contentHash;   // Hash of the source file contents
+    uint64_t optionsHash;   // Hash of the options that affect the result
+    uint64_t sourceSize;    // Size of the source file in bytes
+    uint64_t value[17];     // Tool-specific result
+};
+
+static_assert(sizeof(CacheEntry) == 160, "CacheEntry is part of the index file format");
+
+//--------------------------------------------------------------------------------------
+// The index file is a header, entries sorted by key, and then entries appended by later
+// runs. Appending never changes existing bytes, so parallel runs can append while others
+// still have the index mapped. Close writes a re-sorted copy of the whole index and swaps
+// it in when no other run has it open.
+class ResultCache
+{
+public:
+    ResultCache() noexcept;
+    ~ResultCache();
+
+    ResultCache(ResultCache&&) = delete;
+    ResultCache& operator= (ResultCache&&) = delete;
+
+    ResultCache(ResultCache const&) = delete;
+    ResultCache& operator= (ResultCache const&) = delete;
+
+    // A missing index file is not an error; it is created by Flush
+    HRESULT Open(_In_z_ const wchar_t* szFile) noexcept;
+
+    // Find and Insert may be called from several threads at once
+    bool Find(uint64_t contentHash, uint64_t optionsHash, uint64_t sourceSize, _Out_ CacheEntry& entry) const;
+    void Insert(const CacheEntry& entry);
+
+    // Appends entries inserted since the last Flush to the index file
+    HRESULT Flush();
+
+    // Flushes, releases the mapping, and compacts the index if no other run has it open
+    void Close();
+
+private:
+    void Unmap() noexcept;
+    HRESULT Compact() noexcept;
+
+    wchar_t                 m_szFile[MAX_PATH];
+    HANDLE                  m_hMapping;
+    const uint8_t*          m_pView;
+    size_t                  m_sortedCount;
+    size_t                  m_count;
+    mutable std::mutex      m_lock;
+    std::vector<CacheEntry> m_pending;
+    size_t                  m_written;
+};
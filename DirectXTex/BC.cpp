@@ -60,6 +60,72 @@ namespace
         return w;
     }
 
+    //-------------------------------------------------------------------------------------
+    // Single-color tables: for every 8-bit channel value, the 5- or 6-bit endpoint pair
+    // whose 1/3 interpolant (four-color mode) or midpoint (three-color mode) decodes
+    // closest to it, with the remaining error in 8-bit units
+    //-------------------------------------------------------------------------------------
+    struct BC1SingleColor
+    {
+        uint8_t e0;
+        uint8_t e1;
+        float error;
+    };
+
+    struct BC1SingleColorTable
+    {
+        BC1SingleColor entry[256];
+    };
+
+    constexpr BC1SingleColorTable ComputeBC1SingleColorTable(int32_t iMax, bool bMidpoint) noexcept
+    {
+        BC1SingleColorTable table = {};
+
+        for (int32_t v = 0; v < 256; ++v)
+        {
+            // The best pairs have their first endpoint within a couple of codes of the value
+            const double t = double(v) * double(iMax) / 255.0;
+            const int32_t iCenter = int32_t(t + 0.5);
+
+            double fBest = 1e10;
+            for (int32_t e0 = std::max(0, iCenter - 2); e0 <= std::min(iMax, iCenter + 2); ++e0)
+            {
+                // Second endpoint that puts the interpolant closest to the value
+                double fe1 = bMidpoint ? (2.0 * t - double(e0)) : (3.0 * t - 2.0 * double(e0));
+                fe1 = (fe1 < 0.0) ? 0.0 : (fe1 > double(iMax)) ? double(iMax) : fe1;
+
+                for (int32_t e1 = int32_t(fe1); e1 <= std::min(iMax, int32_t(fe1) + 1); ++e1)
+                {
+                    const double fValue = bMidpoint
+                        ? (double(e0) + double(e1)) * 255.0 / (2.0 * double(iMax))
+                        : (2.0 * double(e0) + double(e1)) * 255.0 / (3.0 * double(iMax));
+                    const double fError = (fValue > double(v)) ? (fValue - double(v)) : (double(v) - fValue);
+
+                    if (fError < fBest)
+                    {
+                        fBest = fError;
+                        table.entry[v].e0 = static_cast<uint8_t>(e0);
+                        table.entry[v].e1 = static_cast<uint8_t>(e1);
+                        table.entry[v].error = static_cast<float>(fError);
+                    }
+                }
+            }
+        }
+
+        return table;
+    }
+
+    constexpr BC1SingleColorTable g_SingleColor5 = ComputeBC1SingleColorTable(31, false);
+    constexpr BC1SingleColorTable g_SingleColor6 = ComputeBC1SingleColorTable(63, false);
+    constexpr BC1SingleColorTable g_SingleColorMid5 = ComputeBC1SingleColorTable(31, true);
+    constexpr BC1SingleColorTable g_SingleColorMid6 = ComputeBC1SingleColorTable(63, true);
+
+    inline uint32_t QuantizeUNorm8(float f) noexcept
+    {
+        f = (f < 0.0f) ? 0.0f : (f > 1.0f) ? 1.0f : f;
+        return static_cast<uint32_t>(f * 255.0f + 0.5f);
+    }
+
 
     //-------------------------------------------------------------------------------------
     void OptimizeRGB(
@@ -315,12 +381,12 @@ namespace
 
 
     //-------------------------------------------------------------------------------------
-    inline void DecodeBC1(
-        _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor,
+    inline void DecodeBC1Palette(
+        _Out_writes_(4) XMVECTOR *pPalette,
         _In_ const D3DX_BC1 *pBC,
         bool isbc1) noexcept
     {
-        assert(pColor && pBC);
+        assert(pPalette && pBC);
         static_assert(sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes");
 
         static XMVECTORF32 s_Scale = { { { 1.f / 31.f, 1.f / 63.f, 1.f / 31.f, 1.f } } };
@@ -337,163 +403,74 @@ namespace
         clr0 = XMVectorSelect(g_XMIdentityR3, clr0, g_XMSelect1110);
         clr1 = XMVectorSelect(g_XMIdentityR3, clr1, g_XMSelect1110);
 
-        XMVECTOR clr2, clr3;
+        pPalette[0] = clr0;
+        pPalette[1] = clr1;
+
         if (isbc1 && (pBC->rgb[0] <= pBC->rgb[1]))
         {
-            clr2 = XMVectorLerp(clr0, clr1, 0.5f);
-            clr3 = XMVectorZero();  // Alpha of 0
+            pPalette[2] = XMVectorLerp(clr0, clr1, 0.5f);
+            pPalette[3] = XMVectorZero();  // Alpha of 0
         }
         else
         {
-            clr2 = XMVectorLerp(clr0, clr1, 1.f / 3.f);
-            clr3 = XMVectorLerp(clr0, clr1, 2.f / 3.f);
+            pPalette[2] = XMVectorLerp(clr0, clr1, 1.f / 3.f);
+            pPalette[3] = XMVectorLerp(clr0, clr1, 2.f / 3.f);
         }
+    }
+
+    inline void DecodeBC1(
+        _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor,
+        _In_ const D3DX_BC1 *pBC,
+        bool isbc1) noexcept
+    {
+        assert(pColor && pBC);
+
+        XMVECTOR palette[4];
+        DecodeBC1Palette(palette, pBC, isbc1);
 
         uint32_t dw = pBC->bitmap;
 
         for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
         {
-            switch (dw & 3)
-            {
-            case 0: pColor[i] = clr0; break;
-            case 1: pColor[i] = clr1; break;
-            case 2: pColor[i] = clr2; break;
-
-            case 3:
-            default: pColor[i] = clr3; break;
-            }
+            pColor[i] = palette[dw & 3];
         }
     }
 
-
-    //-------------------------------------------------------------------------------------
-    void EncodeBC1(
-        _Out_ D3DX_BC1 *pBC,
-        _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor,
-        bool bColorKey,
-        float threshold,
-        uint32_t flags) noexcept
+    inline void DecodeBC3AlphaPalette(_Out_writes_(8) float *pAlpha, _In_ const D3DX_BC3 *pBC) noexcept
     {
-        assert(pBC && pColor);
-        static_assert(sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes");
+        pAlpha[0] = static_cast<float>(pBC->alpha[0]) * (1.0f / 255.0f);
+        pAlpha[1] = static_cast<float>(pBC->alpha[1]) * (1.0f / 255.0f);
 
-        // Determine if we need to colorkey this block
-        uint32_t uSteps;
-
-        if (bColorKey)
+        if (pBC->alpha[0] > pBC->alpha[1])
         {
-            size_t uColorKey = 0;
-
-            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
-            {
-                if (pColor[i].a < threshold)
-                    uColorKey++;
-            }
-
-            if (NUM_PIXELS_PER_BLOCK == uColorKey)
-            {
-                pBC->rgb[0] = 0x0000;
-                pBC->rgb[1] = 0xffff;
-                pBC->bitmap = 0xffffffff;
-                return;
-            }
-
-            uSteps = (uColorKey > 0) ? 3u : 4u;
+            for (size_t i = 1; i < 7; ++i)
+                pAlpha[i + 1] = (pAlpha[0] * float(7u - i) + pAlpha[1] * float(i)) * (1.0f / 7.0f);
         }
         else
         {
-            uSteps = 4u;
-        }
-
-        // Quantize block to R56B5, using Floyd Stienberg error diffusion.  This
-        // increases the chance that colors will map directly to the quantized
-        // axis endpoints.
-        HDRColorA Color[NUM_PIXELS_PER_BLOCK];
-        HDRColorA Error[NUM_PIXELS_PER_BLOCK];
-
-        if (flags & BC_FLAGS_DITHER_RGB)
-            memset(Error, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(HDRColorA));
-
-        size_t i;
-        for (i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
-        {
-            HDRColorA Clr;
-            Clr.r = pColor[i].r;
-            Clr.g = pColor[i].g;
-            Clr.b = pColor[i].b;
-            Clr.a = 1.0f;
-
-            if (flags & BC_FLAGS_DITHER_RGB)
-            {
-                Clr.r += Error[i].r;
-                Clr.g += Error[i].g;
-                Clr.b += Error[i].b;
-            }
-
-            Color[i].r = static_cast<float>(static_cast<int32_t>(Clr.r * 31.0f + 0.5f)) * (1.0f / 31.0f);
-            Color[i].g = static_cast<float>(static_cast<int32_t>(Clr.g * 63.0f + 0.5f)) * (1.0f / 63.0f);
-            Color[i].b = static_cast<float>(static_cast<int32_t>(Clr.b * 31.0f + 0.5f)) * (1.0f / 31.0f);
-
-        #ifdef COLOR_WEIGHTS
-            Color[i].a = pColor[i].a;
-        #else
-            Color[i].a = 1.0f;
-        #endif // COLOR_WEIGHTS
-
-            if (flags & BC_FLAGS_DITHER_RGB)
-            {
-                HDRColorA Diff;
-                Diff.r = Color[i].a * (Clr.r - Color[i].r);
-                Diff.g = Color[i].a * (Clr.g - Color[i].g);
-                Diff.b = Color[i].a * (Clr.b - Color[i].b);
-                Diff.a = 0.0f;
-
-                if (3 != (i & 3))
-                {
-                    assert(i < 15);
-                    _Analysis_assume_(i < 15);
-                    Error[i + 1].r += Diff.r * (7.0f / 16.0f);
-                    Error[i + 1].g += Diff.g * (7.0f / 16.0f);
-                    Error[i + 1].b += Diff.b * (7.0f / 16.0f);
-                }
-
-                if (i < 12)
-                {
-                    if (i & 3)
-                    {
-                        Error[i + 3].r += Diff.r * (3.0f / 16.0f);
-                        Error[i + 3].g += Diff.g * (3.0f / 16.0f);
-                        Error[i + 3].b += Diff.b * (3.0f / 16.0f);
-                    }
-
-                    Error[i + 4].r += Diff.r * (5.0f / 16.0f);
-                    Error[i + 4].g += Diff.g * (5.0f / 16.0f);
-                    Error[i + 4].b += Diff.b * (5.0f / 16.0f);
-
-                    if (3 != (i & 3))
-                    {
-                        assert(i < 11);
-                        _Analysis_assume_(i < 11);
-                        Error[i + 5].r += Diff.r * (1.0f / 16.0f);
-                        Error[i + 5].g += Diff.g * (1.0f / 16.0f);
-                        Error[i + 5].b += Diff.b * (1.0f / 16.0f);
-                    }
-                }
-            }
+            for (size_t i = 1; i < 5; ++i)
+                pAlpha[i + 1] = (pAlpha[0] * float(5u - i) + pAlpha[1] * float(i)) * (1.0f / 5.0f);
 
-            if (!(flags & BC_FLAGS_UNIFORM))
-            {
-                Color[i].r *= g_Luminance.r;
-                Color[i].g *= g_Luminance.g;
-                Color[i].b *= g_Luminance.b;
-            }
+            pAlpha[6] = 0.0f;
+            pAlpha[7] = 1.0f;
         }
+    }
 
-        // Perform 6D root finding function to find two endpoints of color axis.
-        // Then quantize and sort the endpoints depending on mode.
-        HDRColorA ColorA, ColorB, ColorC, ColorD;
 
-        OptimizeRGB(&ColorA, &ColorB, Color, uSteps, flags);
+    //-------------------------------------------------------------------------------------
+    // Quantizes the endpoints found by OptimizeRGB, orders them for the block mode, and
+    // selects the index of each pixel
+    //-------------------------------------------------------------------------------------
+    void EncodeBC1Endpoints(
+        _Out_ D3DX_BC1 *pBC,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor,
+        HDRColorA ColorA,
+        HDRColorA ColorB,
+        uint32_t uSteps,
+        float threshold,
+        uint32_t flags) noexcept
+    {
+        HDRColorA ColorC, ColorD;
 
         if (flags & BC_FLAGS_UNIFORM)
         {
@@ -597,10 +574,11 @@ namespace
 
         // Encode colors
         uint32_t dw = 0;
+        HDRColorA Error[NUM_PIXELS_PER_BLOCK];
         if (flags & BC_FLAGS_DITHER_RGB)
             memset(Error, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(HDRColorA));
 
-        for (i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
         {
             if ((3 == uSteps) && (pColor[i].a < threshold))
             {
@@ -644,10 +622,16 @@ namespace
 
                 if (flags & BC_FLAGS_DITHER_RGB)
                 {
+                #ifdef COLOR_WEIGHTS
+                    const float fWeight = pColor[i].a;
+                #else
+                    const float fWeight = 1.0f;
+                #endif // COLOR_WEIGHTS
+
                     HDRColorA Diff;
-                    Diff.r = Color[i].a * (Clr.r - Step[iStep].r);
-                    Diff.g = Color[i].a * (Clr.g - Step[iStep].g);
-                    Diff.b = Color[i].a * (Clr.b - Step[iStep].b);
+                    Diff.r = fWeight * (Clr.r - Step[iStep].r);
+                    Diff.g = fWeight * (Clr.g - Step[iStep].g);
+                    Diff.b = fWeight * (Clr.b - Step[iStep].b);
                     Diff.a = 0.0f;
 
                     if (3 != (i & 3))
@@ -684,116 +668,1025 @@ namespace
         pBC->bitmap = dw;
     }
 
+
     //-------------------------------------------------------------------------------------
-#ifdef COLOR_WEIGHTS
-    void EncodeSolidBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor)
+    // Encodes a block whose pixels all share one color from the single-color tables,
+    // using the three-color midpoint when it is closer and the block allows it. Returns
+    // false, leaving pBC untouched, if the block is not a single color.
+    //-------------------------------------------------------------------------------------
+    bool EncodeUniformBC1(
+        _Out_ D3DX_BC1 *pBC,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor,
+        bool bColorKey,
+        uint32_t flags) noexcept
     {
-    #ifdef COLOR_AVG_0WEIGHTS
-        // Compute avg color
-        HDRColorA Color;
-        Color.r = pColor[0].r;
-        Color.g = pColor[0].g;
-        Color.b = pColor[0].b;
-
         for (size_t i = 1; i < NUM_PIXELS_PER_BLOCK; ++i)
         {
-            Color.r += pColor[i].r;
-            Color.g += pColor[i].g;
-            Color.b += pColor[i].b;
+            if (pColor[i].r != pColor[0].r || pColor[i].g != pColor[0].g || pColor[i].b != pColor[0].b)
+                return false;
         }
 
-        Color.r *= 1.0f / 16.0f;
-        Color.g *= 1.0f / 16.0f;
-        Color.b *= 1.0f / 16.0f;
+        const uint32_t r = QuantizeUNorm8(pColor[0].r);
+        const uint32_t g = QuantizeUNorm8(pColor[0].g);
+        const uint32_t b = QuantizeUNorm8(pColor[0].b);
 
-        const uint16_t wColor = Encode565(&Color);
-    #else
-        const uint16_t wColor = 0x0000;
-    #endif // COLOR_AVG_0WEIGHTS
+        const HDRColorA weight = (flags & BC_FLAGS_UNIFORM) ? HDRColorA(1.0f, 1.0f, 1.0f, 1.0f) : g_Luminance;
+        const auto WeightedError = [&](const BC1SingleColorTable& t5, const BC1SingleColorTable& t6) noexcept
+        {
+            return weight.r * t5.entry[r].error * t5.entry[r].error
+                + weight.g * t6.entry[g].error * t6.entry[g].error
+                + weight.b * t5.entry[b].error * t5.entry[b].error;
+        };
 
-        // Encode solid block
-        pBC->rgb[0] = wColor;
-        pBC->rgb[1] = wColor;
-        pBC->bitmap = 0x00000000;
-    }
-#endif // COLOR_WEIGHTS
-}
+        // Three-color mode is only decoded for BC1 itself, not the color part of BC2/BC3
+        const bool bMidpoint = bColorKey
+            && (WeightedError(g_SingleColorMid5, g_SingleColorMid6) < WeightedError(g_SingleColor5, g_SingleColor6));
 
+        const BC1SingleColorTable& t5 = bMidpoint ? g_SingleColorMid5 : g_SingleColor5;
+        const BC1SingleColorTable& t6 = bMidpoint ? g_SingleColorMid6 : g_SingleColor6;
 
-//=====================================================================================
-// Entry points
-//=====================================================================================
+        const auto w0 = static_cast<uint16_t>((t5.entry[r].e0 << 11) | (t6.entry[g].e0 << 5) | t5.entry[b].e0);
+        const auto w1 = static_cast<uint16_t>((t5.entry[r].e1 << 11) | (t6.entry[g].e1 << 5) | t5.entry[b].e1);
 
-//-------------------------------------------------------------------------------------
-// BC1 Compression
-//-------------------------------------------------------------------------------------
-_Use_decl_annotations_
-void DirectX::D3DXDecodeBC1(XMVECTOR *pColor, const uint8_t *pBC) noexcept
-{
-    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
-    DecodeBC1(pColor, pBC1, true);
-}
+        if (w0 == w1)
+        {
+            pBC->rgb[0] = w0;
+            pBC->rgb[1] = w1;
+            pBC->bitmap = 0x00000000;
+        }
+        else if (bMidpoint)
+        {
+            // Index 2 is the midpoint when rgb[0] <= rgb[1]
+            pBC->rgb[0] = std::min(w0, w1);
+            pBC->rgb[1] = std::max(w0, w1);
+            pBC->bitmap = 0xaaaaaaaa;
+        }
+        else if (w0 > w1)
+        {
+            // Index 2 is 2/3 rgb[0] + 1/3 rgb[1]
+            pBC->rgb[0] = w0;
+            pBC->rgb[1] = w1;
+            pBC->bitmap = 0xaaaaaaaa;
+        }
+        else
+        {
+            // Swapped endpoints, so index 3 selects the same interpolant
+            pBC->rgb[0] = w1;
+            pBC->rgb[1] = w0;
+            pBC->bitmap = 0xffffffff;
+        }
 
-_Use_decl_annotations_
-void DirectX::D3DXEncodeBC1(uint8_t *pBC, const XMVECTOR *pColor, float threshold, uint32_t flags) noexcept
-{
-    assert(pBC && pColor);
+        return true;
+    }
 
-    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
 
-    if (flags & BC_FLAGS_DITHER_A)
+    //-------------------------------------------------------------------------------------
+    void EncodeBC1(
+        _Out_ D3DX_BC1 *pBC,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor,
+        bool bColorKey,
+        float threshold,
+        uint32_t flags) noexcept
     {
-        float fError[NUM_PIXELS_PER_BLOCK] = {};
-
-        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
-        {
-            HDRColorA clr;
-            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&clr), pColor[i]);
-
-            const float fAlph = clr.a + fError[i];
+        assert(pBC && pColor);
+        static_assert(sizeof(D3DX_BC1) == 8, "D3DX_BC1 should be 8 bytes");
 
-            Color[i].r = clr.r;
-            Color[i].g = clr.g;
-            Color[i].b = clr.b;
-            Color[i].a = static_cast<float>(static_cast<int32_t>(clr.a + fError[i] + 0.5f));
+        // Determine if we need to colorkey this block
+        uint32_t uSteps;
 
-            const float fDiff = fAlph - Color[i].a;
+        if (bColorKey)
+        {
+            size_t uColorKey = 0;
 
-            if (3 != (i & 3))
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
             {
-                assert(i < 15);
-                _Analysis_assume_(i < 15);
-                fError[i + 1] += fDiff * (7.0f / 16.0f);
+                if (pColor[i].a < threshold)
+                    uColorKey++;
             }
 
-            if (i < 12)
+            if (NUM_PIXELS_PER_BLOCK == uColorKey)
             {
-                if (i & 3)
-                    fError[i + 3] += fDiff * (3.0f / 16.0f);
+                pBC->rgb[0] = 0x0000;
+                pBC->rgb[1] = 0xffff;
+                pBC->bitmap = 0xffffffff;
+                return;
+            }
+
+            uSteps = (uColorKey > 0) ? 3u : 4u;
+        }
+        else
+        {
+            uSteps = 4u;
+        }
+
+        if ((4 == uSteps) && EncodeUniformBC1(pBC, pColor, bColorKey, flags))
+            return;
+
+        // Quantize block to R56B5, using Floyd Stienberg error diffusion.  This
+        // increases the chance that colors will map directly to the quantized
+        // axis endpoints.
+        HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+        HDRColorA Error[NUM_PIXELS_PER_BLOCK];
+
+        if (flags & BC_FLAGS_DITHER_RGB)
+            memset(Error, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(HDRColorA));
+
+        size_t i;
+        for (i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            HDRColorA Clr;
+            Clr.r = pColor[i].r;
+            Clr.g = pColor[i].g;
+            Clr.b = pColor[i].b;
+            Clr.a = 1.0f;
+
+            if (flags & BC_FLAGS_DITHER_RGB)
+            {
+                Clr.r += Error[i].r;
+                Clr.g += Error[i].g;
+                Clr.b += Error[i].b;
+            }
+
+            Color[i].r = static_cast<float>(static_cast<int32_t>(Clr.r * 31.0f + 0.5f)) * (1.0f / 31.0f);
+            Color[i].g = static_cast<float>(static_cast<int32_t>(Clr.g * 63.0f + 0.5f)) * (1.0f / 63.0f);
+            Color[i].b = static_cast<float>(static_cast<int32_t>(Clr.b * 31.0f + 0.5f)) * (1.0f / 31.0f);
+
+        #ifdef COLOR_WEIGHTS
+            Color[i].a = pColor[i].a;
+        #else
+            Color[i].a = 1.0f;
+        #endif // COLOR_WEIGHTS
+
+            if (flags & BC_FLAGS_DITHER_RGB)
+            {
+                HDRColorA Diff;
+                Diff.r = Color[i].a * (Clr.r - Color[i].r);
+                Diff.g = Color[i].a * (Clr.g - Color[i].g);
+                Diff.b = Color[i].a * (Clr.b - Color[i].b);
+                Diff.a = 0.0f;
+
+                if (3 != (i & 3))
+                {
+                    assert(i < 15);
+                    _Analysis_assume_(i < 15);
+                    Error[i + 1].r += Diff.r * (7.0f / 16.0f);
+                    Error[i + 1].g += Diff.g * (7.0f / 16.0f);
+                    Error[i + 1].b += Diff.b * (7.0f / 16.0f);
+                }
+
+                if (i < 12)
+                {
+                    if (i & 3)
+                    {
+                        Error[i + 3].r += Diff.r * (3.0f / 16.0f);
+                        Error[i + 3].g += Diff.g * (3.0f / 16.0f);
+                        Error[i + 3].b += Diff.b * (3.0f / 16.0f);
+                    }
+
+                    Error[i + 4].r += Diff.r * (5.0f / 16.0f);
+                    Error[i + 4].g += Diff.g * (5.0f / 16.0f);
+                    Error[i + 4].b += Diff.b * (5.0f / 16.0f);
+
+                    if (3 != (i & 3))
+                    {
+                        assert(i < 11);
+                        _Analysis_assume_(i < 11);
+                        Error[i + 5].r += Diff.r * (1.0f / 16.0f);
+                        Error[i + 5].g += Diff.g * (1.0f / 16.0f);
+                        Error[i + 5].b += Diff.b * (1.0f / 16.0f);
+                    }
+                }
+            }
+
+            if (!(flags & BC_FLAGS_UNIFORM))
+            {
+                Color[i].r *= g_Luminance.r;
+                Color[i].g *= g_Luminance.g;
+                Color[i].b *= g_Luminance.b;
+            }
+        }
+
+        // Perform 6D root finding function to find two endpoints of color axis.
+        // Then quantize and sort the endpoints depending on mode.
+        HDRColorA ColorA, ColorB;
+
+        OptimizeRGB(&ColorA, &ColorB, Color, uSteps, flags);
+
+        EncodeBC1Endpoints(pBC, pColor, ColorA, ColorB, uSteps, threshold, flags);
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Four-block BC1 color encoder. Lane j of every vector belongs to block j, so each step
+    // of OptimizeRGB runs on four blocks at once. The steps perform the same floating-point
+    // operations in the same order as the scalar code, without fused multiply-add.
+    //-------------------------------------------------------------------------------------
+    struct ColorBlock4
+    {
+        XMVECTOR r[NUM_PIXELS_PER_BLOCK];
+        XMVECTOR g[NUM_PIXELS_PER_BLOCK];
+        XMVECTOR b[NUM_PIXELS_PER_BLOCK];
+    };
+
+    // Returns v0, v1, v2, or v3 per lane, as chosen by the step index in that lane
+    inline XMVECTOR XM_CALLCONV SelectStep(
+        FXMVECTOR index,
+        FXMVECTOR v0,
+        FXMVECTOR v1,
+        GXMVECTOR v2,
+        HXMVECTOR v3) noexcept
+    {
+        XMVECTOR v = XMVectorSelect(v0, v1, XMVectorEqual(index, g_XMOne));
+        v = XMVectorSelect(v, v2, XMVectorEqual(index, XMVectorReplicate(2.0f)));
+        return XMVectorSelect(v, v3, XMVectorEqual(index, XMVectorReplicate(3.0f)));
+    }
+
+    inline bool XM_CALLCONV AllLanesClear(FXMVECTOR mask) noexcept
+    {
+        return XMVector4EqualInt(mask, XMVectorZero());
+    }
+
+    // OptimizeRGB for four blocks; steps3 selects the lanes using 3 color steps
+    void OptimizeRGB4(
+        _Out_writes_(3) XMVECTOR *pX,
+        _Out_writes_(3) XMVECTOR *pY,
+        const ColorBlock4& points,
+        FXMVECTOR steps3,
+        uint32_t flags) noexcept
+    {
+        const XMVECTOR fEpsilon = XMVectorReplicate((0.25f / 64.0f) * (0.25f / 64.0f));
+
+        const XMVECTOR pC[4] =
+        {
+            XMVectorSelect(XMVectorReplicate(3.0f / 3.0f), XMVectorReplicate(2.0f / 2.0f), steps3),
+            XMVectorSelect(XMVectorReplicate(2.0f / 3.0f), XMVectorReplicate(1.0f / 2.0f), steps3),
+            XMVectorSelect(XMVectorReplicate(1.0f / 3.0f), XMVectorReplicate(0.0f / 2.0f), steps3),
+            XMVectorSelect(XMVectorReplicate(0.0f / 3.0f), XMVectorZero(), steps3),
+        };
+        const XMVECTOR pD[4] =
+        {
+            XMVectorSelect(XMVectorReplicate(0.0f / 3.0f), XMVectorReplicate(0.0f / 2.0f), steps3),
+            XMVectorSelect(XMVectorReplicate(1.0f / 3.0f), XMVectorReplicate(1.0f / 2.0f), steps3),
+            XMVectorSelect(XMVectorReplicate(2.0f / 3.0f), XMVectorReplicate(2.0f / 2.0f), steps3),
+            XMVectorSelect(XMVectorReplicate(3.0f / 3.0f), XMVectorZero(), steps3),
+        };
+
+        // Find Min and Max points, as starting point
+        XMVECTOR X[3], Y[3];
+        if (flags & BC_FLAGS_UNIFORM)
+        {
+            X[0] = X[1] = X[2] = g_XMOne;
+        }
+        else
+        {
+            X[0] = XMVectorReplicate(g_Luminance.r);
+            X[1] = XMVectorReplicate(g_Luminance.g);
+            X[2] = XMVectorReplicate(g_Luminance.b);
+        }
+        Y[0] = Y[1] = Y[2] = XMVectorZero();
+
+        for (size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+        {
+            X[0] = XMVectorMin(X[0], points.r[iPoint]);
+            X[1] = XMVectorMin(X[1], points.g[iPoint]);
+            X[2] = XMVectorMin(X[2], points.b[iPoint]);
+
+            Y[0] = XMVectorMax(Y[0], points.r[iPoint]);
+            Y[1] = XMVectorMax(Y[1], points.g[iPoint]);
+            Y[2] = XMVectorMax(Y[2], points.b[iPoint]);
+        }
+
+        // Diagonal axis
+        const XMVECTOR ABr = XMVectorSubtract(Y[0], X[0]);
+        const XMVECTOR ABg = XMVectorSubtract(Y[1], X[1]);
+        const XMVECTOR ABb = XMVectorSubtract(Y[2], X[2]);
+
+        const XMVECTOR fAB = XMVectorAdd(XMVectorAdd(XMVectorMultiply(ABr, ABr), XMVectorMultiply(ABg, ABg)), XMVectorMultiply(ABb, ABb));
+
+        // Single color lanes keep the min and max points
+        XMVECTOR active = XMVectorGreaterOrEqual(fAB, XMVectorReplicate(FLT_MIN));
+
+        if (!AllLanesClear(active))
+        {
+            // Try all four axis directions, to determine which diagonal best fits data
+            const XMVECTOR fABInv = XMVectorDivide(g_XMOne, fAB);
+
+            const XMVECTOR Dirr = XMVectorMultiply(ABr, fABInv);
+            const XMVECTOR Dirg = XMVectorMultiply(ABg, fABInv);
+            const XMVECTOR Dirb = XMVectorMultiply(ABb, fABInv);
+
+            const XMVECTOR Midr = XMVectorMultiply(XMVectorAdd(X[0], Y[0]), g_XMOneHalf);
+            const XMVECTOR Midg = XMVectorMultiply(XMVectorAdd(X[1], Y[1]), g_XMOneHalf);
+            const XMVECTOR Midb = XMVectorMultiply(XMVectorAdd(X[2], Y[2]), g_XMOneHalf);
+
+            XMVECTOR fDir[4] = { XMVectorZero(), XMVectorZero(), XMVectorZero(), XMVectorZero() };
+
+            for (size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+            {
+                const XMVECTOR Ptr = XMVectorMultiply(XMVectorSubtract(points.r[iPoint], Midr), Dirr);
+                const XMVECTOR Ptg = XMVectorMultiply(XMVectorSubtract(points.g[iPoint], Midg), Dirg);
+                const XMVECTOR Ptb = XMVectorMultiply(XMVectorSubtract(points.b[iPoint], Midb), Dirb);
+
+                XMVECTOR f = XMVectorAdd(XMVectorAdd(Ptr, Ptg), Ptb);
+                fDir[0] = XMVectorAdd(fDir[0], XMVectorMultiply(f, f));
+
+                f = XMVectorSubtract(XMVectorAdd(Ptr, Ptg), Ptb);
+                fDir[1] = XMVectorAdd(fDir[1], XMVectorMultiply(f, f));
+
+                f = XMVectorAdd(XMVectorSubtract(Ptr, Ptg), Ptb);
+                fDir[2] = XMVectorAdd(fDir[2], XMVectorMultiply(f, f));
+
+                f = XMVectorSubtract(XMVectorSubtract(Ptr, Ptg), Ptb);
+                fDir[3] = XMVectorAdd(fDir[3], XMVectorMultiply(f, f));
+            }
+
+            XMVECTOR fDirMax = fDir[0];
+            XMVECTOR iDirMax = XMVectorZero();
+
+            for (size_t iDir = 1; iDir < 4; iDir++)
+            {
+                const XMVECTOR greater = XMVectorGreater(fDir[iDir], fDirMax);
+                fDirMax = XMVectorSelect(fDirMax, fDir[iDir], greater);
+                iDirMax = XMVectorSelect(iDirMax, XMVectorReplicate(float(iDir)), greater);
+            }
+
+            // iDirMax & 2 swaps green, iDirMax & 1 swaps blue
+            const XMVECTOR swapG = XMVectorAndInt(active, XMVectorGreaterOrEqual(iDirMax, XMVectorReplicate(2.0f)));
+            const XMVECTOR swapB = XMVectorAndInt(active,
+                XMVectorOrInt(XMVectorEqual(iDirMax, g_XMOne), XMVectorEqual(iDirMax, XMVectorReplicate(3.0f))));
+
+            const XMVECTOR Xg = X[1];
+            X[1] = XMVectorSelect(X[1], Y[1], swapG);
+            Y[1] = XMVectorSelect(Y[1], Xg, swapG);
+
+            const XMVECTOR Xb = X[2];
+            X[2] = XMVectorSelect(X[2], Y[2], swapB);
+            Y[2] = XMVectorSelect(Y[2], Xb, swapB);
+
+            // Two color lanes keep the swapped points
+            active = XMVectorAndCInt(active, XMVectorLess(fAB, XMVectorReplicate(1.0f / 4096.0f)));
+        }
+
+        // Use Newton's Method to find local minima of sum-of-squares error.
+        const XMVECTOR fSteps = XMVectorSelect(XMVectorReplicate(3.0f), XMVectorReplicate(2.0f), steps3);
+        const XMVECTOR fEighth = XMVectorReplicate(1.0f / 8.0f);
+
+        for (size_t iIteration = 0; iIteration < 8 && !AllLanesClear(active); iIteration++)
+        {
+            // Calculate new steps
+            XMVECTOR pSteps[4][3];
+
+            for (size_t iStep = 0; iStep < 4; iStep++)
+            {
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    pSteps[iStep][c] = XMVectorAdd(XMVectorMultiply(X[c], pC[iStep]), XMVectorMultiply(Y[c], pD[iStep]));
+                }
+            }
+
+            // Calculate color direction
+            XMVECTOR Dir[3];
+            Dir[0] = XMVectorSubtract(Y[0], X[0]);
+            Dir[1] = XMVectorSubtract(Y[1], X[1]);
+            Dir[2] = XMVectorSubtract(Y[2], X[2]);
+
+            const XMVECTOR fLen = XMVectorAdd(XMVectorAdd(XMVectorMultiply(Dir[0], Dir[0]), XMVectorMultiply(Dir[1], Dir[1])), XMVectorMultiply(Dir[2], Dir[2]));
+
+            active = XMVectorAndCInt(active, XMVectorLess(fLen, XMVectorReplicate(1.0f / 4096.0f)));
+            if (AllLanesClear(active))
+                break;
+
+            const XMVECTOR fScale = XMVectorDivide(fSteps, fLen);
+
+            Dir[0] = XMVectorMultiply(Dir[0], fScale);
+            Dir[1] = XMVectorMultiply(Dir[1], fScale);
+            Dir[2] = XMVectorMultiply(Dir[2], fScale);
+
+            // Evaluate function, and derivatives
+            XMVECTOR d2X = XMVectorZero();
+            XMVECTOR d2Y = XMVectorZero();
+            XMVECTOR dX[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+            XMVECTOR dY[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+
+            for (size_t iPoint = 0; iPoint < NUM_PIXELS_PER_BLOCK; iPoint++)
+            {
+                const XMVECTOR Pt[3] = { points.r[iPoint], points.g[iPoint], points.b[iPoint] };
+
+                const XMVECTOR fDot = XMVectorAdd(XMVectorAdd(
+                    XMVectorMultiply(XMVectorSubtract(Pt[0], X[0]), Dir[0]),
+                    XMVectorMultiply(XMVectorSubtract(Pt[1], X[1]), Dir[1])),
+                    XMVectorMultiply(XMVectorSubtract(Pt[2], X[2]), Dir[2]));
+
+                XMVECTOR iStep = XMVectorTruncate(XMVectorAdd(fDot, g_XMOneHalf));
+                iStep = XMVectorSelect(iStep, fSteps, XMVectorGreaterOrEqual(fDot, fSteps));
+                iStep = XMVectorSelect(iStep, XMVectorZero(), XMVectorLessOrEqual(fDot, XMVectorZero()));
+
+                const XMVECTOR fCStep = SelectStep(iStep, pC[0], pC[1], pC[2], pC[3]);
+                const XMVECTOR fDStep = SelectStep(iStep, pD[0], pD[1], pD[2], pD[3]);
+
+                const XMVECTOR fC = XMVectorMultiply(fCStep, fEighth);
+                const XMVECTOR fD = XMVectorMultiply(fDStep, fEighth);
+
+                d2X = XMVectorAdd(d2X, XMVectorMultiply(fC, fCStep));
+                d2Y = XMVectorAdd(d2Y, XMVectorMultiply(fD, fDStep));
+
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    const XMVECTOR Diff = XMVectorSubtract(
+                        SelectStep(iStep, pSteps[0][c], pSteps[1][c], pSteps[2][c], pSteps[3][c]), Pt[c]);
+
+                    dX[c] = XMVectorAdd(dX[c], XMVectorMultiply(fC, Diff));
+                    dY[c] = XMVectorAdd(dY[c], XMVectorMultiply(fD, Diff));
+                }
+            }
+
+            // Move endpoints
+            const XMVECTOR moveX = XMVectorAndInt(active, XMVectorGreater(d2X, XMVectorZero()));
+            const XMVECTOR moveY = XMVectorAndInt(active, XMVectorGreater(d2Y, XMVectorZero()));
+
+            const XMVECTOR fX = XMVectorDivide(g_XMNegativeOne, d2X);
+            const XMVECTOR fY = XMVectorDivide(g_XMNegativeOne, d2Y);
+
+            XMVECTOR converged = active;
+
+            for (size_t c = 0; c < 3; ++c)
+            {
+                X[c] = XMVectorSelect(X[c], XMVectorAdd(X[c], XMVectorMultiply(dX[c], fX)), moveX);
+                Y[c] = XMVectorSelect(Y[c], XMVectorAdd(Y[c], XMVectorMultiply(dY[c], fY)), moveY);
+
+                converged = XMVectorAndInt(converged, XMVectorLess(XMVectorMultiply(dX[c], dX[c]), fEpsilon));
+                converged = XMVectorAndInt(converged, XMVectorLess(XMVectorMultiply(dY[c], dY[c]), fEpsilon));
+            }
+
+            active = XMVectorAndCInt(active, converged);
+        }
+
+        for (size_t c = 0; c < 3; ++c)
+        {
+            pX[c] = X[c];
+            pY[c] = Y[c];
+        }
+    }
+
+    // EncodeBC1 for four blocks, without RGB dithering
+    void EncodeBC1x4(
+        _In_reads_(4) D3DX_BC1 *const *ppBC,
+        _In_reads_(4 * NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor,
+        bool bColorKey,
+        float threshold,
+        uint32_t flags) noexcept
+    {
+        assert(ppBC && pColor);
+        assert(!(flags & BC_FLAGS_DITHER_RGB));
+
+        // Transpose to one vector per channel and pixel
+        ColorBlock4 Color;
+        XMVECTOR Alpha[NUM_PIXELS_PER_BLOCK];
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            XMMATRIX M(
+                XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&pColor[i])),
+                XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&pColor[NUM_PIXELS_PER_BLOCK + i])),
+                XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&pColor[NUM_PIXELS_PER_BLOCK * 2 + i])),
+                XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&pColor[NUM_PIXELS_PER_BLOCK * 3 + i])));
+            M = XMMatrixTranspose(M);
+
+            Color.r[i] = M.r[0];
+            Color.g[i] = M.r[1];
+            Color.b[i] = M.r[2];
+            Alpha[i] = M.r[3];
+        }
 
-                fError[i + 4] += fDiff * (5.0f / 16.0f);
+        // Determine if we need to colorkey each block
+        uint32_t uSteps[4] = { 4u, 4u, 4u, 4u };
+        bool bDone[4] = {};
+
+        if (bColorKey)
+        {
+            const XMVECTOR vThreshold = XMVectorReplicate(threshold);
+
+            XMVECTOR vColorKey = XMVectorZero();
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                vColorKey = XMVectorAdd(vColorKey, XMVectorSelect(XMVectorZero(), g_XMOne, XMVectorLess(Alpha[i], vThreshold)));
+            }
+
+            float uColorKey[4];
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(uColorKey), vColorKey);
+
+            for (size_t j = 0; j < 4; ++j)
+            {
+                if (float(NUM_PIXELS_PER_BLOCK) == uColorKey[j])
+                {
+                    ppBC[j]->rgb[0] = 0x0000;
+                    ppBC[j]->rgb[1] = 0xffff;
+                    ppBC[j]->bitmap = 0xffffffff;
+                    bDone[j] = true;
+                }
+
+                uSteps[j] = (uColorKey[j] > 0.0f) ? 3u : 4u;
+            }
+        }
+
+        for (size_t j = 0; j < 4; ++j)
+        {
+            if (!bDone[j] && (4 == uSteps[j]))
+                bDone[j] = EncodeUniformBC1(ppBC[j], &pColor[j * NUM_PIXELS_PER_BLOCK], bColorKey, flags);
+        }
+
+        if (bDone[0] && bDone[1] && bDone[2] && bDone[3])
+            return;
+
+        // Quantize blocks to R56B5
+        const XMVECTOR vScale5 = XMVectorReplicate(31.0f);
+        const XMVECTOR vScale6 = XMVectorReplicate(63.0f);
+        const XMVECTOR vInv5 = XMVectorReplicate(1.0f / 31.0f);
+        const XMVECTOR vInv6 = XMVectorReplicate(1.0f / 63.0f);
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            Color.r[i] = XMVectorMultiply(XMVectorTruncate(XMVectorAdd(XMVectorMultiply(Color.r[i], vScale5), g_XMOneHalf)), vInv5);
+            Color.g[i] = XMVectorMultiply(XMVectorTruncate(XMVectorAdd(XMVectorMultiply(Color.g[i], vScale6), g_XMOneHalf)), vInv6);
+            Color.b[i] = XMVectorMultiply(XMVectorTruncate(XMVectorAdd(XMVectorMultiply(Color.b[i], vScale5), g_XMOneHalf)), vInv5);
+
+            if (!(flags & BC_FLAGS_UNIFORM))
+            {
+                Color.r[i] = XMVectorMultiply(Color.r[i], XMVectorReplicate(g_Luminance.r));
+                Color.g[i] = XMVectorMultiply(Color.g[i], XMVectorReplicate(g_Luminance.g));
+                Color.b[i] = XMVectorMultiply(Color.b[i], XMVectorReplicate(g_Luminance.b));
+            }
+        }
+
+        // Perform 6D root finding function to find two endpoints of color axis.
+        const XMVECTOR steps3 = XMVectorSelectControl(
+            (3 == uSteps[0]) ? 1u : 0u,
+            (3 == uSteps[1]) ? 1u : 0u,
+            (3 == uSteps[2]) ? 1u : 0u,
+            (3 == uSteps[3]) ? 1u : 0u);
+
+        XMVECTOR X[3], Y[3];
+        OptimizeRGB4(X, Y, Color, steps3, flags);
+
+        float fX[3][4], fY[3][4];
+        for (size_t c = 0; c < 3; ++c)
+        {
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(fX[c]), X[c]);
+            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(fY[c]), Y[c]);
+        }
+
+        // Then quantize and sort the endpoints of each block depending on mode.
+        for (size_t j = 0; j < 4; ++j)
+        {
+            if (bDone[j])
+                continue;
+
+            const HDRColorA ColorA(fX[0][j], fX[1][j], fX[2][j], 1.0f);
+            const HDRColorA ColorB(fY[0][j], fY[1][j], fY[2][j], 1.0f);
+
+            EncodeBC1Endpoints(ppBC[j], &pColor[j * NUM_PIXELS_PER_BLOCK], ColorA, ColorB, uSteps[j], threshold, flags);
+        }
+    }
+
+    // The four-block encoder only covers the default BC1 color path
+    constexpr bool UseScalarBC1(uint32_t flags) noexcept
+    {
+    #ifdef COLOR_WEIGHTS
+        UNREFERENCED_PARAMETER(flags);
+        return true;
+    #else
+        return (flags & BC_FLAGS_DITHER_RGB) != 0;
+    #endif // COLOR_WEIGHTS
+    }
+
+    //-------------------------------------------------------------------------------------
+#ifdef COLOR_WEIGHTS
+    void EncodeSolidBC1(_Out_ D3DX_BC1 *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor)
+    {
+    #ifdef COLOR_AVG_0WEIGHTS
+        // Compute avg color
+        HDRColorA Color;
+        Color.r = pColor[0].r;
+        Color.g = pColor[0].g;
+        Color.b = pColor[0].b;
+
+        for (size_t i = 1; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            Color.r += pColor[i].r;
+            Color.g += pColor[i].g;
+            Color.b += pColor[i].b;
+        }
+
+        Color.r *= 1.0f / 16.0f;
+        Color.g *= 1.0f / 16.0f;
+        Color.b *= 1.0f / 16.0f;
+
+        const uint16_t wColor = Encode565(&Color);
+    #else
+        const uint16_t wColor = 0x0000;
+    #endif // COLOR_AVG_0WEIGHTS
+
+        // Encode solid block
+        pBC->rgb[0] = wColor;
+        pBC->rgb[1] = wColor;
+        pBC->bitmap = 0x00000000;
+    }
+#endif // COLOR_WEIGHTS
+
+    //-------------------------------------------------------------------------------------
+    // Selects the BC3 alpha endpoints for a block and writes them to pAlpha. Returns the
+    // number of interpolation steps (6 or 8) for the index bitmap, or 0 if the block is
+    // constant and all indices are zero.
+    //-------------------------------------------------------------------------------------
+    uint32_t EncodeBC3AlphaEndpoints(
+        _Out_writes_(2) uint8_t *pAlpha,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *pColor,
+        uint32_t flags) noexcept
+    {
+        // A constant block is stored exactly by equal endpoints with all indices zero. Only
+        // values the search below would also store that way take the shortcut: a block that
+        // quantizes to zero goes through the 6-step path, whose endpoint order is what the
+        // alpha block classification counts, and dithering may spread the quantization error.
+        bool bUniform = !(flags & BC_FLAGS_DITHER_A) && (pColor[0].a <= 1.0f);
+        for (size_t i = 1; bUniform && i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            if (pColor[i].a != pColor[0].a)
+                bUniform = false;
+        }
+
+        if (bUniform)
+        {
+            const auto bAlpha = static_cast<uint8_t>(QuantizeUNorm8(pColor[0].a));
+            if (bAlpha)
+            {
+                pAlpha[0] = pAlpha[1] = bAlpha;
+                return 0;
+            }
+        }
+
+        // Quantize block to A8, using Floyd Stienberg error diffusion.  This
+        // increases the chance that colors will map directly to the quantized
+        // axis endpoints.
+        float fAlpha[NUM_PIXELS_PER_BLOCK] = {};
+        float fError[NUM_PIXELS_PER_BLOCK] = {};
+
+        float fMinAlpha = pColor[0].a;
+        float fMaxAlpha = pColor[0].a;
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            float fAlph = pColor[i].a;
+            if (flags & BC_FLAGS_DITHER_A)
+                fAlph += fError[i];
+
+            fAlpha[i] = static_cast<float>(static_cast<int32_t>(fAlph * 255.0f + 0.5f)) * (1.0f / 255.0f);
+
+            if (fAlpha[i] < fMinAlpha)
+                fMinAlpha = fAlpha[i];
+            else if (fAlpha[i] > fMaxAlpha)
+                fMaxAlpha = fAlpha[i];
+
+            if (flags & BC_FLAGS_DITHER_A)
+            {
+                const float fDiff = fAlph - fAlpha[i];
+
+                if (3 != (i & 3))
+                {
+                    assert(i < 15);
+                    _Analysis_assume_(i < 15);
+                    fError[i + 1] += fDiff * (7.0f / 16.0f);
+                }
+
+                if (i < 12)
+                {
+                    if (i & 3)
+                        fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                    fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                    if (3 != (i & 3))
+                    {
+                        assert(i < 11);
+                        _Analysis_assume_(i < 11);
+                        fError[i + 5] += fDiff * (1.0f / 16.0f);
+                    }
+                }
+            }
+        }
+
+        if (1.0f == fMinAlpha)
+        {
+            pAlpha[0] = 0xff;
+            pAlpha[1] = 0xff;
+            return 0;
+        }
+
+        // Optimize and Quantize Min and Max values
+        const uint32_t uSteps = ((0.0f == fMinAlpha) || (1.0f == fMaxAlpha)) ? 6u : 8u;
+
+        float fAlphaA, fAlphaB;
+        OptimizeAlpha<false>(&fAlphaA, &fAlphaB, fAlpha, uSteps);
+
+        auto const bAlphaA = static_cast<uint8_t>(static_cast<int32_t>(fAlphaA * 255.0f + 0.5f));
+        auto const bAlphaB = static_cast<uint8_t>(static_cast<int32_t>(fAlphaB * 255.0f + 0.5f));
+
+        if ((8 == uSteps) && (bAlphaA == bAlphaB))
+        {
+            pAlpha[0] = bAlphaA;
+            pAlpha[1] = bAlphaB;
+            return 0;
+        }
+
+        // 6-step blocks are stored with alpha[0] <= alpha[1], 8-step blocks with alpha[0] > alpha[1]
+        if (6 == uSteps)
+        {
+            pAlpha[0] = bAlphaA;
+            pAlpha[1] = bAlphaB;
+        }
+        else
+        {
+            pAlpha[0] = bAlphaB;
+            pAlpha[1] = bAlphaA;
+        }
+
+        return uSteps;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Loads a BC1 block, quantizing alpha to 0 or 1 with error diffusion when dithering
+    //-------------------------------------------------------------------------------------
+    void LoadBC1Colors(
+        _Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA *Color,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor,
+        uint32_t flags) noexcept
+    {
+        if (flags & BC_FLAGS_DITHER_A)
+        {
+            float fError[NUM_PIXELS_PER_BLOCK] = {};
+
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                HDRColorA clr;
+                XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&clr), pColor[i]);
+
+                const float fAlph = clr.a + fError[i];
+
+                Color[i].r = clr.r;
+                Color[i].g = clr.g;
+                Color[i].b = clr.b;
+                Color[i].a = static_cast<float>(static_cast<int32_t>(clr.a + fError[i] + 0.5f));
+
+                const float fDiff = fAlph - Color[i].a;
+
+                if (3 != (i & 3))
+                {
+                    assert(i < 15);
+                    _Analysis_assume_(i < 15);
+                    fError[i + 1] += fDiff * (7.0f / 16.0f);
+                }
+
+                if (i < 12)
+                {
+                    if (i & 3)
+                        fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                    fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                    if (3 != (i & 3))
+                    {
+                        assert(i < 11);
+                        _Analysis_assume_(i < 11);
+                        fError[i + 5] += fDiff * (1.0f / 16.0f);
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+            {
+                XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&Color[i]), pColor[i]);
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Encodes the 4-bit alpha part of a BC2 block
+    //-------------------------------------------------------------------------------------
+    void EncodeBC2Alpha(
+        _Inout_ D3DX_BC2 *pBC2,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *Color,
+        uint32_t flags) noexcept
+    {
+        // 4-bit alpha part.  Dithered using Floyd Stienberg error diffusion.
+        pBC2->bitmap[0] = 0;
+        pBC2->bitmap[1] = 0;
+
+        float fError[NUM_PIXELS_PER_BLOCK] = {};
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            float fAlph = Color[i].a;
+            if (flags & BC_FLAGS_DITHER_A)
+                fAlph += fError[i];
+
+            const auto u = static_cast<uint32_t>(fAlph * 15.0f + 0.5f);
+
+            pBC2->bitmap[i >> 3] >>= 4;
+            pBC2->bitmap[i >> 3] |= (u << 28);
+
+            if (flags & BC_FLAGS_DITHER_A)
+            {
+                const float fDiff = fAlph - float(u) * (1.0f / 15.0f);
+
+                if (3 != (i & 3))
+                {
+                    assert(i < 15);
+                    _Analysis_assume_(i < 15);
+                    fError[i + 1] += fDiff * (7.0f / 16.0f);
+                }
 
-                if (3 != (i & 3))
+                if (i < 12)
                 {
-                    assert(i < 11);
-                    _Analysis_assume_(i < 11);
-                    fError[i + 5] += fDiff * (1.0f / 16.0f);
+                    if (i & 3)
+                        fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                    fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                    if (3 != (i & 3))
+                    {
+                        assert(i < 11);
+                        _Analysis_assume_(i < 11);
+                        fError[i + 5] += fDiff * (1.0f / 16.0f);
+                    }
                 }
             }
         }
     }
-    else
+
+    //-------------------------------------------------------------------------------------
+    // Encodes the adaptive 3-bit alpha part of a BC3 block
+    //-------------------------------------------------------------------------------------
+    void EncodeBC3Alpha(
+        _Inout_ D3DX_BC3 *pBC3,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA *Color,
+        uint32_t flags) noexcept
     {
-        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        const uint32_t uSteps = EncodeBC3AlphaEndpoints(pBC3->alpha, Color, flags);
+        if (!uSteps)
+        {
+            memset(pBC3->bitmap, 0x00, 6);
+            return;
+        }
+
+        static const size_t pSteps6[] = { 0, 2, 3, 4, 5, 1 };
+        static const size_t pSteps8[] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+
+        const size_t *pSteps;
+        float fStep[8] = {};
+
+        fStep[0] = static_cast<float>(pBC3->alpha[0]) * (1.0f / 255.0f);
+        fStep[1] = static_cast<float>(pBC3->alpha[1]) * (1.0f / 255.0f);
+
+        if (6 == uSteps)
+        {
+            for (size_t i = 1; i < 5; ++i)
+                fStep[i + 1] = (fStep[0] * float(5u - i) + fStep[1] * float(i)) * (1.0f / 5.0f);
+
+            fStep[6] = 0.0f;
+            fStep[7] = 1.0f;
+
+            pSteps = pSteps6;
+        }
+        else
+        {
+            for (size_t i = 1; i < 7; ++i)
+                fStep[i + 1] = (fStep[0] * float(7u - i) + fStep[1] * float(i)) * (1.0f / 7.0f);
+
+            pSteps = pSteps8;
+        }
+
+        // Encode alpha bitmap
+        auto const fSteps = static_cast<float>(uSteps - 1);
+        const float fScale = (fStep[0] != fStep[1]) ? (fSteps / (fStep[1] - fStep[0])) : 0.0f;
+
+        float fError[NUM_PIXELS_PER_BLOCK] = {};
+
+        for (size_t iSet = 0; iSet < 2; iSet++)
         {
-            XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&Color[i]), pColor[i]);
+            uint32_t dw = 0;
+
+            const size_t iMin = iSet * 8;
+            const size_t iLim = iMin + 8;
+
+            for (size_t i = iMin; i < iLim; ++i)
+            {
+                float fAlph = Color[i].a;
+                if (flags & BC_FLAGS_DITHER_A)
+                    fAlph += fError[i];
+                const float fDot = (fAlph - fStep[0]) * fScale;
+
+                uint32_t iStep;
+                if (fDot <= 0.0f)
+                    iStep = ((6 == uSteps) && (fAlph <= fStep[0] * 0.5f)) ? 6u : 0u;
+                else if (fDot >= fSteps)
+                    iStep = ((6 == uSteps) && (fAlph >= (fStep[1] + 1.0f) * 0.5f)) ? 7u : 1u;
+                else
+                    iStep = uint32_t(pSteps[uint32_t(fDot + 0.5f)]);
+
+                dw = (iStep << 21) | (dw >> 3);
+
+                if (flags & BC_FLAGS_DITHER_A)
+                {
+                    const float fDiff = (fAlph - fStep[iStep]);
+
+                    if (3 != (i & 3))
+                        fError[i + 1] += fDiff * (7.0f / 16.0f);
+
+                    if (i < 12)
+                    {
+                        if (i & 3)
+                            fError[i + 3] += fDiff * (3.0f / 16.0f);
+
+                        fError[i + 4] += fDiff * (5.0f / 16.0f);
+
+                        if (3 != (i & 3))
+                            fError[i + 5] += fDiff * (1.0f / 16.0f);
+                    }
+                }
+            }
+
+            pBC3->bitmap[0 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[0];
+            pBC3->bitmap[1 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[1];
+            pBC3->bitmap[2 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[2];
         }
     }
+}
+
+
+//=====================================================================================
+// Entry points
+//=====================================================================================
+
+//-------------------------------------------------------------------------------------
+// BC1 Compression
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC1(XMVECTOR *pColor, const uint8_t *pBC) noexcept
+{
+    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
+    DecodeBC1(pColor, pBC1, true);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC1Palette(XMVECTOR *pPalette, const uint8_t *pBC, bool isbc1) noexcept
+{
+    auto pBC1 = reinterpret_cast<const D3DX_BC1 *>(pBC);
+    DecodeBC1Palette(pPalette, pBC1, isbc1);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC3AlphaPalette(float *pAlpha, const uint8_t *pBC) noexcept
+{
+    auto pBC3 = reinterpret_cast<const D3DX_BC3 *>(pBC);
+    DecodeBC3AlphaPalette(pAlpha, pBC3);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC1(uint8_t *pBC, const XMVECTOR *pColor, float threshold, uint32_t flags) noexcept
+{
+    assert(pBC && pColor);
+
+    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+    LoadBC1Colors(Color, pColor, flags);
 
     auto pBC1 = reinterpret_cast<D3DX_BC1 *>(pBC);
     EncodeBC1(pBC1, Color, true, threshold, flags);
 }
 
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC1x4(uint8_t *pBC, const XMVECTOR *pColor, float threshold, uint32_t flags) noexcept
+{
+    assert(pBC && pColor);
+
+    if (UseScalarBC1(flags))
+    {
+        for (size_t j = 0; j < 4; ++j)
+        {
+            D3DXEncodeBC1(pBC + j * sizeof(D3DX_BC1), pColor + j * NUM_PIXELS_PER_BLOCK, threshold, flags);
+        }
+        return;
+    }
+
+    HDRColorA Color[4 * NUM_PIXELS_PER_BLOCK];
+    D3DX_BC1 *pBC1[4];
+    for (size_t j = 0; j < 4; ++j)
+    {
+        LoadBC1Colors(&Color[j * NUM_PIXELS_PER_BLOCK], &pColor[j * NUM_PIXELS_PER_BLOCK], flags);
+        pBC1[j] = reinterpret_cast<D3DX_BC1 *>(pBC + j * sizeof(D3DX_BC1));
+    }
+
+    EncodeBC1x4(pBC1, Color, true, threshold, flags);
+}
+
 
 //-------------------------------------------------------------------------------------
 // BC2 Compression
@@ -838,60 +1731,52 @@ void DirectX::D3DXEncodeBC2(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags
 
     auto pBC2 = reinterpret_cast<D3DX_BC2 *>(pBC);
 
-    // 4-bit alpha part.  Dithered using Floyd Stienberg error diffusion.
-    pBC2->bitmap[0] = 0;
-    pBC2->bitmap[1] = 0;
+    // 4-bit alpha part
+    EncodeBC2Alpha(pBC2, Color, flags);
 
-    float fError[NUM_PIXELS_PER_BLOCK] = {};
-    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    // RGB part
+#ifdef COLOR_WEIGHTS
+    if (!pBC2->bitmap[0] && !pBC2->bitmap[1])
     {
-        float fAlph = Color[i].a;
-        if (flags & BC_FLAGS_DITHER_A)
-            fAlph += fError[i];
+        EncodeSolidBC1(pBC2->dxt1, Color);
+        return;
+    }
+#endif // COLOR_WEIGHTS
 
-        const auto u = static_cast<uint32_t>(fAlph * 15.0f + 0.5f);
+    EncodeBC1(&pBC2->bc1, Color, false, 0.f, flags);
+}
 
-        pBC2->bitmap[i >> 3] >>= 4;
-        pBC2->bitmap[i >> 3] |= (u << 28);
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC2x4(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags) noexcept
+{
+    assert(pBC && pColor);
 
-        if (flags & BC_FLAGS_DITHER_A)
+    if (UseScalarBC1(flags))
+    {
+        for (size_t j = 0; j < 4; ++j)
         {
-            const float fDiff = fAlph - float(u) * (1.0f / 15.0f);
-
-            if (3 != (i & 3))
-            {
-                assert(i < 15);
-                _Analysis_assume_(i < 15);
-                fError[i + 1] += fDiff * (7.0f / 16.0f);
-            }
-
-            if (i < 12)
-            {
-                if (i & 3)
-                    fError[i + 3] += fDiff * (3.0f / 16.0f);
-
-                fError[i + 4] += fDiff * (5.0f / 16.0f);
-
-                if (3 != (i & 3))
-                {
-                    assert(i < 11);
-                    _Analysis_assume_(i < 11);
-                    fError[i + 5] += fDiff * (1.0f / 16.0f);
-                }
-            }
+            D3DXEncodeBC2(pBC + j * sizeof(D3DX_BC2), pColor + j * NUM_PIXELS_PER_BLOCK, flags);
         }
+        return;
     }
 
-    // RGB part
-#ifdef COLOR_WEIGHTS
-    if (!pBC2->bitmap[0] && !pBC2->bitmap[1])
+    HDRColorA Color[4 * NUM_PIXELS_PER_BLOCK];
+    for (size_t i = 0; i < 4 * NUM_PIXELS_PER_BLOCK; ++i)
     {
-        EncodeSolidBC1(pBC2->dxt1, Color);
-        return;
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&Color[i]), pColor[i]);
     }
-#endif // COLOR_WEIGHTS
 
-    EncodeBC1(&pBC2->bc1, Color, false, 0.f, flags);
+    // 4-bit alpha part
+    D3DX_BC1 *pBC1[4];
+    for (size_t j = 0; j < 4; ++j)
+    {
+        auto pBC2 = reinterpret_cast<D3DX_BC2 *>(pBC + j * sizeof(D3DX_BC2));
+        EncodeBC2Alpha(pBC2, &Color[j * NUM_PIXELS_PER_BLOCK], flags);
+        pBC1[j] = &pBC2->bc1;
+    }
+
+    // RGB part
+    EncodeBC1x4(pBC1, Color, false, 0.f, flags);
 }
 
 
@@ -911,23 +1796,7 @@ void DirectX::D3DXDecodeBC3(XMVECTOR *pColor, const uint8_t *pBC) noexcept
 
     // Adaptive 3-bit alpha part
     float fAlpha[8];
-
-    fAlpha[0] = static_cast<float>(pBC3->alpha[0]) * (1.0f / 255.0f);
-    fAlpha[1] = static_cast<float>(pBC3->alpha[1]) * (1.0f / 255.0f);
-
-    if (pBC3->alpha[0] > pBC3->alpha[1])
-    {
-        for (size_t i = 1; i < 7; ++i)
-            fAlpha[i + 1] = (fAlpha[0] * float(7u - i) + fAlpha[1] * float(i)) * (1.0f / 7.0f);
-    }
-    else
-    {
-        for (size_t i = 1; i < 5; ++i)
-            fAlpha[i + 1] = (fAlpha[0] * float(5u - i) + fAlpha[1] * float(i)) * (1.0f / 5.0f);
-
-        fAlpha[6] = 0.0f;
-        fAlpha[7] = 1.0f;
-    }
+    DecodeBC3AlphaPalette(fAlpha, pBC3);
 
     uint32_t dw = uint32_t(pBC3->bitmap[0]) | uint32_t(pBC3->bitmap[1] << 8) | uint32_t(pBC3->bitmap[2] << 16);
 
@@ -954,188 +1823,91 @@ void DirectX::D3DXEncodeBC3(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags
 
     auto pBC3 = reinterpret_cast<D3DX_BC3 *>(pBC);
 
-    // Quantize block to A8, using Floyd Stienberg error diffusion.  This
-    // increases the chance that colors will map directly to the quantized
-    // axis endpoints.
-    float fAlpha[NUM_PIXELS_PER_BLOCK] = {};
-    float fError[NUM_PIXELS_PER_BLOCK] = {};
-
-    float fMinAlpha = Color[0].a;
-    float fMaxAlpha = Color[0].a;
-
-    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    // RGB part
+#ifdef COLOR_WEIGHTS
+    bool bTransparent = true;
+    for (size_t i = 0; bTransparent && i < NUM_PIXELS_PER_BLOCK; ++i)
     {
-        float fAlph = Color[i].a;
-        if (flags & BC_FLAGS_DITHER_A)
-            fAlph += fError[i];
-
-        fAlpha[i] = static_cast<float>(static_cast<int32_t>(fAlph * 255.0f + 0.5f)) * (1.0f / 255.0f);
-
-        if (fAlpha[i] < fMinAlpha)
-            fMinAlpha = fAlpha[i];
-        else if (fAlpha[i] > fMaxAlpha)
-            fMaxAlpha = fAlpha[i];
-
-        if (flags & BC_FLAGS_DITHER_A)
-        {
-            const float fDiff = fAlph - fAlpha[i];
-
-            if (3 != (i & 3))
-            {
-                assert(i < 15);
-                _Analysis_assume_(i < 15);
-                fError[i + 1] += fDiff * (7.0f / 16.0f);
-            }
-
-            if (i < 12)
-            {
-                if (i & 3)
-                    fError[i + 3] += fDiff * (3.0f / 16.0f);
-
-                fError[i + 4] += fDiff * (5.0f / 16.0f);
-
-                if (3 != (i & 3))
-                {
-                    assert(i < 11);
-                    _Analysis_assume_(i < 11);
-                    fError[i + 5] += fDiff * (1.0f / 16.0f);
-                }
-            }
-        }
+        if (QuantizeUNorm8(Color[i].a))
+            bTransparent = false;
     }
 
-#ifdef COLOR_WEIGHTS
-    if (0.0f == fMaxAlpha)
+    if (bTransparent)
     {
         EncodeSolidBC1(&pBC3->dxt1, Color);
-        pBC3->alpha[0] = 0x00;
-        pBC3->alpha[1] = 0x00;
-        memset(pBC3->bitmap, 0x00, 6);
+        EncodeBC3Alpha(pBC3, Color, flags);
+        return;
     }
-#endif
+#endif // COLOR_WEIGHTS
 
-    // RGB part
     EncodeBC1(&pBC3->bc1, Color, false, 0.f, flags);
 
     // Alpha part
-    if (1.0f == fMinAlpha)
-    {
-        pBC3->alpha[0] = 0xff;
-        pBC3->alpha[1] = 0xff;
-        memset(pBC3->bitmap, 0x00, 6);
-        return;
-    }
-
-    // Optimize and Quantize Min and Max values
-    const uint32_t uSteps = ((0.0f == fMinAlpha) || (1.0f == fMaxAlpha)) ? 6u : 8u;
-
-    float fAlphaA, fAlphaB;
-    OptimizeAlpha<false>(&fAlphaA, &fAlphaB, fAlpha, uSteps);
-
-    auto const bAlphaA = static_cast<uint8_t>(static_cast<int32_t>(fAlphaA * 255.0f + 0.5f));
-    auto const bAlphaB = static_cast<uint8_t>(static_cast<int32_t>(fAlphaB * 255.0f + 0.5f));
+    EncodeBC3Alpha(pBC3, Color, flags);
+}
 
-    fAlphaA = static_cast<float>(bAlphaA) * (1.0f / 255.0f);
-    fAlphaB = static_cast<float>(bAlphaB) * (1.0f / 255.0f);
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC3x4(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags) noexcept
+{
+    assert(pBC && pColor);
 
-    // Setup block
-    if ((8 == uSteps) && (bAlphaA == bAlphaB))
+    if (UseScalarBC1(flags))
     {
-        pBC3->alpha[0] = bAlphaA;
-        pBC3->alpha[1] = bAlphaB;
-        memset(pBC3->bitmap, 0x00, 6);
+        for (size_t j = 0; j < 4; ++j)
+        {
+            D3DXEncodeBC3(pBC + j * sizeof(D3DX_BC3), pColor + j * NUM_PIXELS_PER_BLOCK, flags);
+        }
         return;
     }
 
-    static const size_t pSteps6[] = { 0, 2, 3, 4, 5, 1 };
-    static const size_t pSteps8[] = { 0, 2, 3, 4, 5, 6, 7, 1 };
-
-    const size_t *pSteps;
-    float fStep[8] = {};
-
-    if (6 == uSteps)
+    HDRColorA Color[4 * NUM_PIXELS_PER_BLOCK];
+    for (size_t i = 0; i < 4 * NUM_PIXELS_PER_BLOCK; ++i)
     {
-        pBC3->alpha[0] = bAlphaA;
-        pBC3->alpha[1] = bAlphaB;
-
-        fStep[0] = fAlphaA;
-        fStep[1] = fAlphaB;
-
-        for (size_t i = 1; i < 5; ++i)
-            fStep[i + 1] = (fStep[0] * float(5u - i) + fStep[1] * float(i)) * (1.0f / 5.0f);
-
-        fStep[6] = 0.0f;
-        fStep[7] = 1.0f;
-
-        pSteps = pSteps6;
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&Color[i]), pColor[i]);
     }
-    else
-    {
-        pBC3->alpha[0] = bAlphaB;
-        pBC3->alpha[1] = bAlphaA;
-
-        fStep[0] = fAlphaB;
-        fStep[1] = fAlphaA;
 
-        for (size_t i = 1; i < 7; ++i)
-            fStep[i + 1] = (fStep[0] * float(7u - i) + fStep[1] * float(i)) * (1.0f / 7.0f);
-
-        pSteps = pSteps8;
+    // RGB part
+    D3DX_BC1 *pBC1[4];
+    for (size_t j = 0; j < 4; ++j)
+    {
+        pBC1[j] = &reinterpret_cast<D3DX_BC3 *>(pBC + j * sizeof(D3DX_BC3))->bc1;
     }
 
-    // Encode alpha bitmap
-    auto const fSteps = static_cast<float>(uSteps - 1);
-    const float fScale = (fStep[0] != fStep[1]) ? (fSteps / (fStep[1] - fStep[0])) : 0.0f;
-
-    if (flags & BC_FLAGS_DITHER_A)
-        memset(fError, 0x00, NUM_PIXELS_PER_BLOCK * sizeof(float));
+    EncodeBC1x4(pBC1, Color, false, 0.f, flags);
 
-    for (size_t iSet = 0; iSet < 2; iSet++)
+    // Alpha part
+    for (size_t j = 0; j < 4; ++j)
     {
-        uint32_t dw = 0;
-
-        const size_t iMin = iSet * 8;
-        const size_t iLim = iMin + 8;
-
-        for (size_t i = iMin; i < iLim; ++i)
-        {
-            float fAlph = Color[i].a;
-            if (flags & BC_FLAGS_DITHER_A)
-                fAlph += fError[i];
-            const float fDot = (fAlph - fStep[0]) * fScale;
-
-            uint32_t iStep;
-            if (fDot <= 0.0f)
-                iStep = ((6 == uSteps) && (fAlph <= fStep[0] * 0.5f)) ? 6u : 0u;
-            else if (fDot >= fSteps)
-                iStep = ((6 == uSteps) && (fAlph >= (fStep[1] + 1.0f) * 0.5f)) ? 7u : 1u;
-            else
-                iStep = uint32_t(pSteps[uint32_t(fDot + 0.5f)]);
-
-            dw = (iStep << 21) | (dw >> 3);
-
-            if (flags & BC_FLAGS_DITHER_A)
-            {
-                const float fDiff = (fAlph - fStep[iStep]);
+        EncodeBC3Alpha(reinterpret_cast<D3DX_BC3 *>(pBC + j * sizeof(D3DX_BC3)), &Color[j * NUM_PIXELS_PER_BLOCK], flags);
+    }
+}
 
-                if (3 != (i & 3))
-                    fError[i + 1] += fDiff * (7.0f / 16.0f);
+_Use_decl_annotations_
+uint32_t DirectX::D3DXEncodeBC3Alpha(uint8_t *pAlpha, const XMVECTOR *pColor, uint32_t flags) noexcept
+{
+    assert(pAlpha && pColor);
 
-                if (i < 12)
-                {
-                    if (i & 3)
-                        fError[i + 3] += fDiff * (3.0f / 16.0f);
+    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&Color[i]), pColor[i]);
+    }
 
-                    fError[i + 4] += fDiff * (5.0f / 16.0f);
+    return EncodeBC3AlphaEndpoints(pAlpha, Color, flags);
+}
 
-                    if (3 != (i & 3))
-                        fError[i + 5] += fDiff * (1.0f / 16.0f);
-                }
-            }
-        }
+_Use_decl_annotations_
+uint32_t DirectX::D3DXEncodeBC3AlphaA8(uint8_t *pAlpha, const uint8_t *pA8, uint32_t flags) noexcept
+{
+    assert(pAlpha && pA8);
 
-        pBC3->bitmap[0 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[0];
-        pBC3->bitmap[1 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[1];
-        pBC3->bitmap[2 + iSet * 3] = reinterpret_cast<uint8_t *>(&dw)[2];
+    // Only alpha is used, and 8-bit values quantize back to themselves
+    HDRColorA Color[NUM_PIXELS_PER_BLOCK];
+    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        Color[i].r = Color[i].g = Color[i].b = 0.f;
+        Color[i].a = static_cast<float>(pA8[i]) * (1.0f / 255.0f);
     }
+
+    return EncodeBC3AlphaEndpoints(pAlpha, Color, flags);
 }
@@ -31,6 +31,14 @@ namespace DirectX
     {
         BC_FLAGS_NONE = 0x0,
 
+        BC_FLAGS_BC7_LEVEL_0 = 0x1000,
+        BC_FLAGS_BC7_LEVEL_1 = 0x2000,
+        BC_FLAGS_BC7_LEVEL_2 = 0x3000,
+        BC_FLAGS_BC7_LEVEL_3 = 0x4000,
+        BC_FLAGS_BC7_LEVEL_4 = 0x5000,
+        BC_FLAGS_BC7_LEVEL_MASK = 0x7000,
+        // BC7 search level from 0 (fastest) to 4 (same as the default search); none selects the default search
+
         BC_FLAGS_DITHER_RGB = 0x10000,
         // Enables dithering for RGB colors for BC1-3
 
@@ -45,6 +53,9 @@ namespace DirectX
 
         BC_FLAGS_FORCE_BC7_MODE6 = 0x100000,
         // BC7 should only use mode 6; skip other modes
+
+        BC_FLAGS_BC6H_FAST = 0x800000,
+        // BC6H prunes modes from the block dynamic range, uses a cheaper endpoint search, and stops at an error target
     };
 
     //-------------------------------------------------------------------------------------
@@ -311,6 +322,7 @@ namespace DirectX
 
     typedef void (*BC_DECODE)(XMVECTOR *pColor, const uint8_t *pBC);
     typedef void (*BC_ENCODE)(uint8_t *pDXT, const XMVECTOR *pColor, uint32_t flags);
+    typedef void (*BC_ENCODE_STATS)(uint8_t *pDXT, const XMVECTOR *pColor, uint32_t flags, BCEncoderStatistics& stats);
 
     void D3DXDecodeBC1(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(8) const uint8_t *pBC) noexcept;
     void D3DXDecodeBC2(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(16) const uint8_t *pBC) noexcept;
@@ -323,11 +335,31 @@ namespace DirectX
     void D3DXDecodeBC6HS(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(16) const uint8_t *pBC) noexcept;
     void D3DXDecodeBC7(_Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR *pColor, _In_reads_(16) const uint8_t *pBC) noexcept;
 
+    void D3DXDecodeBC1Palette(_Out_writes_(4) XMVECTOR *pPalette, _In_reads_(8) const uint8_t *pBC, _In_ bool isbc1) noexcept;
+    void D3DXDecodeBC3AlphaPalette(_Out_writes_(8) float *pAlpha, _In_reads_(8) const uint8_t *pBC) noexcept;
+    void D3DXDecodeBC4UPalette(_Out_writes_(8) float *pPalette, _In_reads_(8) const uint8_t *pBC) noexcept;
+    void D3DXDecodeBC4SPalette(_Out_writes_(8) float *pPalette, _In_reads_(8) const uint8_t *pBC) noexcept;
+        // Return the colors a block's 2-bit (BC1) or 3-bit (BC3 alpha, BC4) indices select, exactly as the decoders above produce them
+    void D3DXDecodeBC7LDR(_Out_writes_(NUM_PIXELS_PER_BLOCK * 4) uint8_t *pRGBA, _In_reads_(16) const uint8_t *pBC) noexcept;
+        // Decodes a BC7 block straight to 8-bit RGBA; D3DXDecodeBC7 returns the same values scaled to [0,1]
+    void D3DXDecodeBC6HUHalf(_Out_writes_(NUM_PIXELS_PER_BLOCK * 4) uint16_t *pRGBA, _In_reads_(16) const uint8_t *pBC) noexcept;
+    void D3DXDecodeBC6HSHalf(_Out_writes_(NUM_PIXELS_PER_BLOCK * 4) uint16_t *pRGBA, _In_reads_(16) const uint8_t *pBC) noexcept;
+        // Decodes a BC6H block straight to half-precision RGBA; the float decoders return the same values widened
+
     void D3DXEncodeBC1(_Out_writes_(8) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ float threshold, _In_ uint32_t flags) noexcept;
         // BC1 requires one additional parameter, so it doesn't match signature of BC_ENCODE above
 
     void D3DXEncodeBC2(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
     void D3DXEncodeBC3(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC1x4(_Out_writes_(32) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK * 4) const XMVECTOR *pColor, _In_ float threshold, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC2x4(_Out_writes_(64) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK * 4) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
+    void D3DXEncodeBC3x4(_Out_writes_(64) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK * 4) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
+        // Encode four consecutive blocks at once. The colors are chosen by the same steps as the single-block encoders,
+        // vectorized across the blocks, so the output only differs where floating-point rounding does
+    uint32_t D3DXEncodeBC3Alpha(_Out_writes_(2) uint8_t *pAlpha, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
+        // Selects only the BC3 alpha endpoints that D3DXEncodeBC3 would write; returns the interpolation steps (6 or 8), or 0 for a constant block
+    uint32_t D3DXEncodeBC3AlphaA8(_Out_writes_(2) uint8_t *pAlpha, _In_reads_(NUM_PIXELS_PER_BLOCK) const uint8_t *pA8, _In_ uint32_t flags) noexcept;
+        // Same as D3DXEncodeBC3Alpha for a block of 8-bit alpha values
     void D3DXEncodeBC4U(_Out_writes_(8) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
     void D3DXEncodeBC4S(_Out_writes_(8) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
     void D3DXEncodeBC5U(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
@@ -336,4 +368,9 @@ namespace DirectX
     void D3DXEncodeBC6HS(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
     void D3DXEncodeBC7(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags) noexcept;
 
+    void D3DXEncodeBC6HUStats(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags, _Inout_ BCEncoderStatistics& stats) noexcept;
+    void D3DXEncodeBC6HSStats(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags, _Inout_ BCEncoderStatistics& stats) noexcept;
+    void D3DXEncodeBC7Stats(_Out_writes_(16) uint8_t *pBC, _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR *pColor, _In_ uint32_t flags, _Inout_ BCEncoderStatistics& stats) noexcept;
+        // Encode exactly as above, also adding the block's mode search to stats (TEX_COMPRESS_ENCODER_STATS)
+
 } // namespace
@@ -294,30 +294,53 @@ namespace
 
 
     //------------------------------------------------------------------------------
-    inline void FindEndPointsBC5U(
+    // A constant block is stored by equal endpoints with all indices zero, which decodes
+    // to the endpoint exactly; returns false if the block is not constant. Blocks at the
+    // range boundaries are left to the 4-interpolant path, so the endpoint order (and the
+    // 8/6 red block counts derived from it) is unchanged.
+    //------------------------------------------------------------------------------
+    inline bool IsUniform(
         _In_reads_(BLOCK_SIZE) const float theTexelsU[],
-        _In_reads_(BLOCK_SIZE) const float theTexelsV[],
-        _Out_ uint8_t &endpointU_0,
-        _Out_ uint8_t &endpointU_1,
-        _Out_ uint8_t &endpointV_0,
-        _Out_ uint8_t &endpointV_1) noexcept
+        float fMinNorm,
+        float fMaxNorm) noexcept
     {
-        //Encoding the U and V channel by BC4 codec separately.
-        FindEndPointsBC4U(theTexelsU, endpointU_0, endpointU_1);
-        FindEndPointsBC4U(theTexelsV, endpointV_0, endpointV_1);
+        if (theTexelsU[0] == fMinNorm || theTexelsU[0] == fMaxNorm)
+            return false;
+
+        for (size_t i = 1; i < BLOCK_SIZE; ++i)
+        {
+            if (theTexelsU[i] != theTexelsU[0])
+                return false;
+        }
+        return true;
     }
 
-    inline void FindEndPointsBC5S(
-        _In_reads_(BLOCK_SIZE) const float theTexelsU[],
-        _In_reads_(BLOCK_SIZE) const float theTexelsV[],
-        _Out_ int8_t &endpointU_0,
-        _Out_ int8_t &endpointU_1,
-        _Out_ int8_t &endpointV_0,
-        _Out_ int8_t &endpointV_1) noexcept
+    bool EncodeUniformBC4U(
+        _Out_ BC4_UNORM* pBC,
+        _In_reads_(BLOCK_SIZE) const float theTexelsU[]) noexcept
     {
-        //Encoding the U and V channel by BC4 codec separately.
-        FindEndPointsBC4S(theTexelsU, endpointU_0, endpointU_1);
-        FindEndPointsBC4S(theTexelsV, endpointV_0, endpointV_1);
+        if (!IsUniform(theTexelsU, 0.f, 1.f))
+            return false;
+
+        float fVal = theTexelsU[0];
+        fVal = (fVal < 0.f) ? 0.f : (fVal > 1.f) ? 1.f : fVal;
+
+        pBC->data = 0;
+        pBC->red_0 = pBC->red_1 = static_cast<uint8_t>(fVal * 255.0f + 0.5f);
+        return true;
+    }
+
+    bool EncodeUniformBC4S(
+        _Out_ BC4_SNORM* pBC,
+        _In_reads_(BLOCK_SIZE) const float theTexelsU[]) noexcept
+    {
+        if (!IsUniform(theTexelsU, -1.f, 1.f))
+            return false;
+
+        pBC->data = 0;
+        FloatToSNorm(theTexelsU[0], &pBC->red_0);
+        pBC->red_1 = pBC->red_0;
+        return true;
     }
 
 
@@ -415,6 +438,32 @@ void DirectX::D3DXDecodeBC4S(XMVECTOR *pColor, const uint8_t *pBC) noexcept
     }
 }
 
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC4UPalette(float *pPalette, const uint8_t *pBC) noexcept
+{
+    assert(pPalette && pBC);
+
+    auto pBC4 = reinterpret_cast<const BC4_UNORM*>(pBC);
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        pPalette[i] = pBC4->DecodeFromIndex(i);
+    }
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC4SPalette(float *pPalette, const uint8_t *pBC) noexcept
+{
+    assert(pPalette && pBC);
+
+    auto pBC4 = reinterpret_cast<const BC4_SNORM*>(pBC);
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        pPalette[i] = pBC4->DecodeFromIndex(i);
+    }
+}
+
 _Use_decl_annotations_
 void DirectX::D3DXEncodeBC4U(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags) noexcept
 {
@@ -432,6 +481,9 @@ void DirectX::D3DXEncodeBC4U(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flag
         theTexelsU[i] = XMVectorGetX(pColor[i]);
     }
 
+    if (EncodeUniformBC4U(pBC4, theTexelsU))
+        return;
+
     FindEndPointsBC4U(theTexelsU, pBC4->red_0, pBC4->red_1);
     FindClosestUNORM(pBC4, theTexelsU);
 }
@@ -453,6 +505,9 @@ void DirectX::D3DXEncodeBC4S(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flag
         theTexelsU[i] = XMVectorGetX(pColor[i]);
     }
 
+    if (EncodeUniformBC4S(pBC4, theTexelsU))
+        return;
+
     FindEndPointsBC4S(theTexelsU, pBC4->red_0, pBC4->red_1);
     FindClosestSNORM(pBC4, theTexelsU);
 }
@@ -515,16 +570,18 @@ void DirectX::D3DXEncodeBC5U(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flag
         theTexelsV[i] = clr.y;
     }
 
-    FindEndPointsBC5U(
-        theTexelsU,
-        theTexelsV,
-        pBCR->red_0,
-        pBCR->red_1,
-        pBCG->red_0,
-        pBCG->red_1);
+    // Each channel is a BC4 block, so a constant channel takes the exact path on its own
+    if (!EncodeUniformBC4U(pBCR, theTexelsU))
+    {
+        FindEndPointsBC4U(theTexelsU, pBCR->red_0, pBCR->red_1);
+        FindClosestUNORM(pBCR, theTexelsU);
+    }
 
-    FindClosestUNORM(pBCR, theTexelsU);
-    FindClosestUNORM(pBCG, theTexelsV);
+    if (!EncodeUniformBC4U(pBCG, theTexelsV))
+    {
+        FindEndPointsBC4U(theTexelsV, pBCG->red_0, pBCG->red_1);
+        FindClosestUNORM(pBCG, theTexelsV);
+    }
 }
 
 _Use_decl_annotations_
@@ -549,14 +606,16 @@ void DirectX::D3DXEncodeBC5S(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flag
         theTexelsV[i] = clr.y;
     }
 
-    FindEndPointsBC5S(
-        theTexelsU,
-        theTexelsV,
-        pBCR->red_0,
-        pBCR->red_1,
-        pBCG->red_0,
-        pBCG->red_1);
+    // Each channel is a BC4 block, so a constant channel takes the exact path on its own
+    if (!EncodeUniformBC4S(pBCR, theTexelsU))
+    {
+        FindEndPointsBC4S(theTexelsU, pBCR->red_0, pBCR->red_1);
+        FindClosestSNORM(pBCR, theTexelsU);
+    }
 
-    FindClosestSNORM(pBCR, theTexelsU);
-    FindClosestSNORM(pBCG, theTexelsV);
+    if (!EncodeUniformBC4S(pBCG, theTexelsV))
+    {
+        FindEndPointsBC4S(theTexelsV, pBCG->red_0, pBCG->red_1);
+        FindClosestSNORM(pBCG, theTexelsV);
+    }
 }
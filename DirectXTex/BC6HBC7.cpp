@@ -327,6 +327,39 @@ namespace
     const int g_aWeights2[] = { 0, 21, 43, 64 };
     const int g_aWeights3[] = { 0, 9, 18, 27, 37, 46, 55, 64 };
     const int g_aWeights4[] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // BC7 search settings for BC_FLAGS_BC7_LEVEL_0 through BC_FLAGS_BC7_LEVEL_4
+    struct BC7Level
+    {
+        uint8_t uModes;         // Modes searched, one bit per mode
+        uint8_t uShapeShift;    // Refines uShapes >> uShapeShift partitions (at least 1) per mode
+        bool bRotations;        // Searches the rotations and index modes of modes 4 and 5
+        uint8_t uLowRange;      // Blocks whose channels all span less than this only use the single subset modes
+        float fErrorTarget;     // Stops once the block error (sum of squared 8-bit differences) is at most this
+    };
+
+    constexpr BC7Level g_aBC7Levels[] =
+    {
+        { 0x62, 6, false, 24, 256.f },  // Modes 1, 5, 6; one partition; RMS error 2
+        { 0xFA, 6, false, 16, 144.f },  // Modes 1, 3-7; one partition; RMS error 1.5
+        { 0xFA, 4, true, 8, 64.f },     // Modes 1, 3-7; uShapes/16 partitions; RMS error 1
+        { 0xFF, 3, true, 4, 16.f },     // All modes; uShapes/8 partitions; RMS error 0.5
+        { 0xFF, 2, true, 0, 0.f },      // Same search as the default
+    };
+
+    // BC6H fast profile settings for BC_FLAGS_BC6H_FAST
+    constexpr uint32_t BC6H_FAST_MODES = 0x3E03;        // Modes 1, 2, 10 and the single region modes 11-14
+    constexpr uint32_t BC6H_FAST_FLAT_MODES = 0x3C00;   // Single region modes 11-14
+    constexpr int BC6H_FAST_FLAT_RANGE = 0x400;         // Blocks spanning less than one f16 exponent in every channel use a single region
+    constexpr float BC6H_FAST_ERROR_TARGET = 192.f;     // RMS error of 2 f16 steps per channel
+    constexpr int BC6H_FAST_MAX_STEP = 4;               // Endpoint perturbation only searches +/- 7 quantized steps
+
+    // Steady clock in nanoseconds for the phase timings of TEX_COMPRESS_ENCODER_STATS
+    inline uint64_t GetEncoderTime() noexcept
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
 }
 
 namespace DirectX
@@ -656,7 +689,9 @@ namespace
     {
     public:
         void Decode(_In_ bool bSigned, _Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const noexcept;
-        void Encode(_In_ bool bSigned, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn) noexcept;
+        bool DecodeHalf(_In_ bool bSigned, _Out_writes_(NUM_PIXELS_PER_BLOCK * 4) HALF* pOut) const noexcept;
+        void Encode(_In_ bool bSigned, _In_ uint32_t flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn,
+            _Inout_opt_ BCEncoderStatistics* pStats) noexcept;
 
     private:
     #pragma warning(push)
@@ -702,14 +737,15 @@ namespace
         {
             float fBestErr;
             const bool bSigned;
+            const bool bFast;
             uint8_t uMode;
             uint8_t uShape;
             const HDRColorA* const aHDRPixels;
             INTEndPntPair aUnqEndPts[BC6H_MAX_SHAPES][BC6H_MAX_REGIONS];
             INTColor aIPixels[NUM_PIXELS_PER_BLOCK];
 
-            EncodeParams(const HDRColorA* const aOriginal, bool bSignedFormat) noexcept :
-                fBestErr(FLT_MAX), bSigned(bSignedFormat), uMode(0), uShape(0), aHDRPixels(aOriginal), aUnqEndPts{}, aIPixels{}
+            EncodeParams(const HDRColorA* const aOriginal, bool bSignedFormat, bool bFastProfile) noexcept :
+                fBestErr(FLT_MAX), bSigned(bSignedFormat), bFast(bFastProfile), uMode(0), uShape(0), aHDRPixels(aOriginal), aUnqEndPts{}, aIPixels{}
             {
                 for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
                 {
@@ -763,7 +799,9 @@ namespace
     {
     public:
         void Decode(_Out_writes_(NUM_PIXELS_PER_BLOCK) HDRColorA* pOut) const noexcept;
-        void Encode(uint32_t flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn) noexcept;
+        bool DecodeLDR(_Out_writes_(NUM_PIXELS_PER_BLOCK) LDRColorA* pOut) const noexcept;
+        void Encode(uint32_t flags, _In_reads_(NUM_PIXELS_PER_BLOCK) const HDRColorA* const pIn,
+            _Inout_opt_ BCEncoderStatistics* pStats) noexcept;
 
     private:
         struct ModeInfo
@@ -1641,6 +1679,32 @@ namespace
         #endif
         }
     }
+
+    void FillWithErrorColors(_Out_writes_(NUM_PIXELS_PER_BLOCK) LDRColorA* pOut) noexcept
+    {
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+        #ifdef _DEBUG
+            pOut[i] = LDRColorA(255, 0, 255, 255);
+        #else
+            pOut[i] = LDRColorA(0, 0, 0, 255);
+        #endif
+        }
+    }
+
+    void FillWithErrorColors(_Out_writes_(NUM_PIXELS_PER_BLOCK * 4) HALF* pOut) noexcept
+    {
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, pOut += 4)
+        {
+        #ifdef _DEBUG
+            pOut[0] = pOut[2] = 0x3C00;
+        #else
+            pOut[0] = pOut[2] = 0;
+        #endif
+            pOut[1] = 0;
+            pOut[3] = 0x3C00; // 1.0
+        }
+    }
 }
 
 
@@ -1648,7 +1712,7 @@ namespace
 // BC6H Compression
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const noexcept
+bool D3DX_BC6H::DecodeHalf(bool bSigned, HALF* pOut) const noexcept
 {
     assert(pOut);
 
@@ -1699,8 +1763,7 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const noexcept
                     #if defined(_WIN32) && defined(_DEBUG)
                         OutputDebugStringA("BC6H: Invalid header bits encountered during decoding\n");
                     #endif
-                        FillWithErrorColors(pOut);
-                        return;
+                        return false;
                     }
                 }
             }
@@ -1735,6 +1798,7 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const noexcept
         }
 
         // Read indices
+        uint8_t aIndices[NUM_PIXELS_PER_BLOCK];
         for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
         {
             const size_t uNumBits = IsFixUpOffset(info.uPartitions, uShape, i) ? info.uIndexPrec - 1u : info.uIndexPrec;
@@ -1743,8 +1807,7 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC6H: Invalid block encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
             }
             const uint8_t uIndex = GetBits(uStartBit, uNumBits);
 
@@ -1753,34 +1816,45 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC6H: Invalid index encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
+            }
+
+            aIndices[i] = uIndex;
+        }
+
+        // Unquantize the end points and interpolate each region's palette once
+        const int* aWeights = info.uPartitions > 0 ? g_aWeights3 : g_aWeights4;
+        const size_t uNumIndices = info.uPartitions > 0 ? 8u : 16u;
+        HALF aPalette[BC6H_MAX_REGIONS][16][3];
+        for (size_t p = 0; p <= info.uPartitions; ++p)
+        {
+            const int r1 = Unquantize(aEndPts[p].A.r, info.RGBAPrec[0][0].r, bSigned);
+            const int g1 = Unquantize(aEndPts[p].A.g, info.RGBAPrec[0][0].g, bSigned);
+            const int b1 = Unquantize(aEndPts[p].A.b, info.RGBAPrec[0][0].b, bSigned);
+            const int r2 = Unquantize(aEndPts[p].B.r, info.RGBAPrec[0][0].r, bSigned);
+            const int g2 = Unquantize(aEndPts[p].B.g, info.RGBAPrec[0][0].g, bSigned);
+            const int b2 = Unquantize(aEndPts[p].B.b, info.RGBAPrec[0][0].b, bSigned);
+            for (size_t uIndex = 0; uIndex < uNumIndices; ++uIndex)
+            {
+                INTColor fc;
+                fc.r = FinishUnquantize((r1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + r2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
+                fc.g = FinishUnquantize((g1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + g2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
+                fc.b = FinishUnquantize((b1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + b2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
+                fc.ToF16(aPalette[p][uIndex], bSigned);
             }
+        }
 
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, pOut += 4)
+        {
             const size_t uRegion = g_aPartitionTable[info.uPartitions][uShape][i];
             assert(uRegion < BC6H_MAX_REGIONS);
             _Analysis_assume_(uRegion < BC6H_MAX_REGIONS);
 
-            // Unquantize endpoints and interpolate
-            const int r1 = Unquantize(aEndPts[uRegion].A.r, info.RGBAPrec[0][0].r, bSigned);
-            const int g1 = Unquantize(aEndPts[uRegion].A.g, info.RGBAPrec[0][0].g, bSigned);
-            const int b1 = Unquantize(aEndPts[uRegion].A.b, info.RGBAPrec[0][0].b, bSigned);
-            const int r2 = Unquantize(aEndPts[uRegion].B.r, info.RGBAPrec[0][0].r, bSigned);
-            const int g2 = Unquantize(aEndPts[uRegion].B.g, info.RGBAPrec[0][0].g, bSigned);
-            const int b2 = Unquantize(aEndPts[uRegion].B.b, info.RGBAPrec[0][0].b, bSigned);
-            const int* aWeights = info.uPartitions > 0 ? g_aWeights3 : g_aWeights4;
-            INTColor fc;
-            fc.r = FinishUnquantize((r1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + r2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
-            fc.g = FinishUnquantize((g1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + g2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
-            fc.b = FinishUnquantize((b1 * (BC67_WEIGHT_MAX - aWeights[uIndex]) + b2 * aWeights[uIndex] + BC67_WEIGHT_ROUND) >> BC67_WEIGHT_SHIFT, bSigned);
-
-            HALF rgb[3];
-            fc.ToF16(rgb, bSigned);
-
-            pOut[i].r = XMConvertHalfToFloat(rgb[0]);
-            pOut[i].g = XMConvertHalfToFloat(rgb[1]);
-            pOut[i].b = XMConvertHalfToFloat(rgb[2]);
-            pOut[i].a = 1.0f;
+            const HALF* rgb = aPalette[uRegion][aIndices[i]];
+            pOut[0] = rgb[0];
+            pOut[1] = rgb[1];
+            pOut[2] = rgb[2];
+            pOut[3] = 0x3C00; // 1.0
         }
     }
     else
@@ -1797,30 +1871,85 @@ void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const noexcept
         OutputDebugStringA(warnstr);
     #endif
         // Per the BC6H format spec, we must return opaque black
-        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, pOut += 4)
         {
-            pOut[i] = HDRColorA(0.0f, 0.0f, 0.0f, 1.0f);
+            pOut[0] = pOut[1] = pOut[2] = 0;
+            pOut[3] = 0x3C00; // 1.0
         }
     }
+
+    return true;
+}
+
+_Use_decl_annotations_
+void D3DX_BC6H::Decode(bool bSigned, HDRColorA* pOut) const noexcept
+{
+    assert(pOut);
+
+    HALF aHalf[NUM_PIXELS_PER_BLOCK * 4];
+    if (!DecodeHalf(bSigned, aHalf))
+    {
+        FillWithErrorColors(pOut);
+        return;
+    }
+
+    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        pOut[i].r = XMConvertHalfToFloat(aHalf[i * 4]);
+        pOut[i].g = XMConvertHalfToFloat(aHalf[i * 4 + 1]);
+        pOut[i].b = XMConvertHalfToFloat(aHalf[i * 4 + 2]);
+        pOut[i].a = 1.0f;
+    }
 }
 
 
 _Use_decl_annotations_
-void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn) noexcept
+void D3DX_BC6H::Encode(bool bSigned, uint32_t flags, const HDRColorA* const pIn, BCEncoderStatistics* pStats) noexcept
 {
     assert(pIn);
 
-    EncodeParams EP(pIn, bSigned);
+    const uint64_t tStart = pStats ? GetEncoderTime() : 0;
+
+    EncodeParams EP(pIn, bSigned, (flags & BC_FLAGS_BC6H_FAST) != 0);
+    uint8_t uBestMode = 0;
+    uint8_t uBestShape = 0;
 
-    for (EP.uMode = 0; EP.uMode < c_NumModes && EP.fBestErr > 0; ++EP.uMode)
+    // The fast profile prunes modes from the block's dynamic range, refines a single shape, and stops at an error target
+    uint32_t uModes = (1u << c_NumModes) - 1;
+    float fErrorTarget = 0.f;
+    if (EP.bFast)
     {
+        INTColor minPixel = EP.aIPixels[0];
+        INTColor maxPixel = EP.aIPixels[0];
+        for (size_t i = 1; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            minPixel.r = std::min(minPixel.r, EP.aIPixels[i].r);
+            minPixel.g = std::min(minPixel.g, EP.aIPixels[i].g);
+            minPixel.b = std::min(minPixel.b, EP.aIPixels[i].b);
+            maxPixel.r = std::max(maxPixel.r, EP.aIPixels[i].r);
+            maxPixel.g = std::max(maxPixel.g, EP.aIPixels[i].g);
+            maxPixel.b = std::max(maxPixel.b, EP.aIPixels[i].b);
+        }
+
+        const int range = std::max(maxPixel.r - minPixel.r, std::max(maxPixel.g - minPixel.g, maxPixel.b - minPixel.b));
+        uModes = (range < BC6H_FAST_FLAT_RANGE) ? BC6H_FAST_FLAT_MODES : BC6H_FAST_MODES;
+        fErrorTarget = BC6H_FAST_ERROR_TARGET;
+    }
+
+    for (EP.uMode = 0; EP.uMode < c_NumModes && EP.fBestErr > fErrorTarget; ++EP.uMode)
+    {
+        if (!(uModes & (1u << EP.uMode)))
+            continue;
+
         const uint8_t uShapes = ms_aInfo[EP.uMode].uPartitions ? 32u : 1u;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1u, size_t(uShapes >> 2));
+        const size_t uItems = EP.bFast ? 1u : std::max<size_t>(1u, size_t(uShapes >> 2));
         float afRoughMSE[BC6H_MAX_SHAPES];
         uint8_t auShape[BC6H_MAX_SHAPES];
 
+        const uint64_t tRough = pStats ? GetEncoderTime() : 0;
+
         // pick the best uItems shapes and refine these.
         for (EP.uShape = 0; EP.uShape < uShapes; ++EP.uShape)
         {
@@ -1842,11 +1971,48 @@ void D3DX_BC6H::Encode(bool bSigned, const HDRColorA* const pIn) noexcept
             }
         }
 
-        for (size_t i = 0; i < uItems && EP.fBestErr > 0; i++)
+        uint64_t tRefine = 0;
+        if (pStats)
+        {
+            tRefine = GetEncoderTime();
+            pStats->roughMSECalls += uShapes;
+            pStats->roughTime += tRefine - tRough;
+        }
+
+        for (size_t i = 0; i < uItems && EP.fBestErr > fErrorTarget; i++)
         {
             EP.uShape = auShape[i];
+
+            const float fPrevErr = EP.fBestErr;
             Refine(&EP);
+            if (EP.fBestErr < fPrevErr)
+            {
+                uBestMode = EP.uMode;
+                uBestShape = EP.uShape;
+            }
+
+            if (pStats)
+                ++pStats->refineCalls;
+        }
+
+        if (pStats)
+            pStats->refineTime += GetEncoderTime() - tRefine;
+    }
+
+    if (pStats)
+    {
+        bool bSolid = true;
+        for (size_t i = 1; i < NUM_PIXELS_PER_BLOCK && bSolid; ++i)
+        {
+            bSolid = EP.aIPixels[i].r == EP.aIPixels[0].r && EP.aIPixels[i].g == EP.aIPixels[0].g && EP.aIPixels[i].b == EP.aIPixels[0].b;
         }
+
+        ++pStats->blocks;
+        ++pStats->modes[uBestMode];
+        ++pStats->partitions[uBestMode][uBestShape];
+        if (bSolid)
+            ++pStats->solidBlocks;
+        pStats->totalTime += GetEncoderTime() - tStart;
     }
 }
 
@@ -2093,7 +2259,9 @@ float D3DX_BC6H::PerturbOne(const EncodeParams* pEP, const INTColor aColors[], s
     tmpEndPts = newEndPts = oldEndPts;
 
     // do a logarithmic search for the best error for this endpoint (which)
-    for (int step = 1 << (uPrec - 1); step; step >>= 1)
+    // the fast profile only searches near the rough endpoints
+    const int maxStep = pEP->bFast ? std::min(BC6H_FAST_MAX_STEP, 1 << (uPrec - 1)) : (1 << (uPrec - 1));
+    for (int step = maxStep; step; step >>= 1)
     {
         bool bImproved = false;
         for (int sign = -1; sign <= 1; sign += 2)
@@ -2169,6 +2337,10 @@ void D3DX_BC6H::OptimizeOne(const EncodeParams* pEP, const INTColor aColors[], s
             do_b = 0;		// do A next
         }
 
+        // the fast profile keeps the first improvement for each channel
+        if (pEP->bFast)
+            continue;
+
         // now alternate endpoints and keep trying until there is no improvement
         for (;;)
         {
@@ -2555,7 +2727,7 @@ float D3DX_BC6H::RoughMSE(EncodeParams* pEP) const noexcept
 // BC7 Compression
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
+bool D3DX_BC7::DecodeLDR(LDRColorA* pOut) const noexcept
 {
     assert(pOut);
 
@@ -2599,8 +2771,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC7: Invalid block encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
             }
 
             c[i].r = GetBits(uStartBit, RGBAPrec.r);
@@ -2614,8 +2785,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC7: Invalid block encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
             }
 
             c[i].g = GetBits(uStartBit, RGBAPrec.g);
@@ -2629,8 +2799,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC7: Invalid block encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
             }
 
             c[i].b = GetBits(uStartBit, RGBAPrec.b);
@@ -2644,8 +2813,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC7: Invalid block encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
             }
 
             c[i].a = RGBAPrec.a ? GetBits(uStartBit, RGBAPrec.a) : 255u;
@@ -2661,8 +2829,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC7: Invalid block encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
             }
 
             P[i] = GetBit(uStartBit);
@@ -2699,8 +2866,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
             #if defined(_WIN32) && defined(_DEBUG)
                 OutputDebugStringA("BC7: Invalid block encountered during decoding\n");
             #endif
-                FillWithErrorColors(pOut);
-                return;
+                return false;
             }
             w1[i] = GetBits(uStartBit, uNumBits);
         }
@@ -2716,8 +2882,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
                 #if defined(_WIN32) && defined(_DEBUG)
                     OutputDebugStringA("BC7: Invalid block encountered during decoding\n");
                 #endif
-                    FillWithErrorColors(pOut);
-                    return;
+                    return false;
                 }
                 w2[i] = GetBits(uStartBit, uNumBits);
             }
@@ -2750,7 +2915,7 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
             case 3: std::swap(outPixel.b, outPixel.a); break;
             }
 
-            pOut[i] = HDRColorA(outPixel);
+            pOut[i] = outPixel;
         }
     }
     else
@@ -2759,19 +2924,45 @@ void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
         OutputDebugStringA("BC7: Reserved mode 8 encountered during decoding\n");
     #endif
         // Per the BC7 format spec, we must return transparent black
-        memset(pOut, 0, sizeof(HDRColorA) * NUM_PIXELS_PER_BLOCK);
+        memset(pOut, 0, sizeof(LDRColorA) * NUM_PIXELS_PER_BLOCK);
+    }
+
+    return true;
+}
+
+_Use_decl_annotations_
+void D3DX_BC7::Decode(HDRColorA* pOut) const noexcept
+{
+    assert(pOut);
+
+    LDRColorA aLDR[NUM_PIXELS_PER_BLOCK];
+    if (!DecodeLDR(aLDR))
+    {
+        FillWithErrorColors(pOut);
+        return;
+    }
+
+    for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+    {
+        pOut[i] = HDRColorA(aLDR[i]);
     }
 }
 
 _Use_decl_annotations_
-void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn) noexcept
+void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn, BCEncoderStatistics* pStats) noexcept
 {
     assert(pIn);
 
+    const uint64_t tStart = pStats ? GetEncoderTime() : 0;
+
     D3DX_BC7 final = *this;
     EncodeParams EP(pIn);
     float fMSEBest = FLT_MAX;
+    size_t uBestMode = 0;
+    size_t uBestShape = 0;
     uint32_t alphaMask = 0xFF;
+    LDRColorA minPixel(255, 255, 255, 255);
+    LDRColorA maxPixel(0, 0, 0, 0);
 
     for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
     {
@@ -2780,12 +2971,55 @@ void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn) noexcept
         EP.aLDRPixels[i].b = uint8_t(std::max<float>(0.0f, std::min<float>(255.0f, pIn[i].b * 255.0f + 0.01f)));
         EP.aLDRPixels[i].a = uint8_t(std::max<float>(0.0f, std::min<float>(255.0f, pIn[i].a * 255.0f + 0.01f)));
         alphaMask &= EP.aLDRPixels[i].a;
+
+        for (size_t ch = 0; ch < BC7_NUM_CHANNELS; ++ch)
+        {
+            minPixel[ch] = std::min(minPixel[ch], EP.aLDRPixels[i][ch]);
+            maxPixel[ch] = std::max(maxPixel[ch], EP.aLDRPixels[i][ch]);
+        }
     }
 
     const bool bHasAlpha = (alphaMask != 0xFF);
 
-    for (EP.uMode = 0; EP.uMode < 8 && fMSEBest > 0; ++EP.uMode)
+    // Quality levels prune modes using the block statistics and stop early once the block is close enough
+    uint32_t uModes = 0xFF;
+    size_t uShapeShift = 2;
+    bool bRotations = true;
+    float fErrorTarget = 0.f;
+
+    const size_t uLevel = (flags & BC_FLAGS_BC7_LEVEL_MASK) / BC_FLAGS_BC7_LEVEL_0;
+    if (uLevel > 0 && uLevel <= std::size(g_aBC7Levels))
+    {
+        const BC7Level& level = g_aBC7Levels[uLevel - 1];
+        uModes = level.uModes;
+        uShapeShift = level.uShapeShift;
+        bRotations = level.bRotations;
+        fErrorTarget = level.fErrorTarget;
+
+        int range = 0;
+        for (size_t ch = 0; ch < BC7_NUM_CHANNELS; ++ch)
+        {
+            range = std::max(range, int(maxPixel[ch]) - int(minPixel[ch]));
+        }
+
+        if (range < level.uLowRange)
+        {
+            // Uniform and low-contrast blocks gain nothing from partitions
+            uModes &= 0x70;
+        }
+
+        if (!bHasAlpha && !bRotations)
+        {
+            // Without rotations, modes 4 and 5 only add a separate index set for constant alpha
+            uModes &= ~0x30u;
+        }
+    }
+
+    for (EP.uMode = 0; EP.uMode < 8 && fMSEBest > fErrorTarget; ++EP.uMode)
     {
+        if (!(uModes & (1u << EP.uMode)))
+            continue;
+
         if (!(flags & BC_FLAGS_USE_3SUBSETS) && (EP.uMode == 0 || EP.uMode == 2))
         {
             // 3 subset modes tend to be used rarely and add significant compression time
@@ -2808,15 +3042,15 @@ void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn) noexcept
         assert(uShapes <= BC7_MAX_SHAPES);
         _Analysis_assume_(uShapes <= BC7_MAX_SHAPES);
 
-        const size_t uNumRots = size_t(1) << ms_aInfo[EP.uMode].uRotationBits;
-        const size_t uNumIdxMode = size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits;
+        const size_t uNumRots = bRotations ? (size_t(1) << ms_aInfo[EP.uMode].uRotationBits) : 1;
+        const size_t uNumIdxMode = bRotations ? (size_t(1) << ms_aInfo[EP.uMode].uIndexModeBits) : 1;
         // Number of rough cases to look at. reasonable values of this are 1, uShapes/4, and uShapes
         // uShapes/4 gets nearly all the cases; you can increase that a bit (say by 3 or 4) if you really want to squeeze the last bit out
-        const size_t uItems = std::max<size_t>(1, uShapes >> 2);
+        const size_t uItems = std::max<size_t>(1, uShapes >> uShapeShift);
         float afRoughMSE[BC7_MAX_SHAPES];
         size_t auShape[BC7_MAX_SHAPES];
 
-        for (size_t r = 0; r < uNumRots && fMSEBest > 0; ++r)
+        for (size_t r = 0; r < uNumRots && fMSEBest > fErrorTarget; ++r)
         {
             switch (r)
             {
@@ -2825,8 +3059,10 @@ void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn) noexcept
             case 3: for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; i++) std::swap(EP.aLDRPixels[i].b, EP.aLDRPixels[i].a); break;
             }
 
-            for (size_t im = 0; im < uNumIdxMode && fMSEBest > 0; ++im)
+            for (size_t im = 0; im < uNumIdxMode && fMSEBest > fErrorTarget; ++im)
             {
+                const uint64_t tRough = pStats ? GetEncoderTime() : 0;
+
                 // pick the best uItems shapes and refine these.
                 for (size_t s = 0; s < uShapes; s++)
                 {
@@ -2847,15 +3083,31 @@ void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn) noexcept
                     }
                 }
 
-                for (size_t i = 0; i < uItems && fMSEBest > 0; i++)
+                uint64_t tRefine = 0;
+                if (pStats)
+                {
+                    tRefine = GetEncoderTime();
+                    pStats->roughMSECalls += uShapes;
+                    pStats->roughTime += tRefine - tRough;
+                }
+
+                for (size_t i = 0; i < uItems && fMSEBest > fErrorTarget; i++)
                 {
                     const float fMSE = Refine(&EP, auShape[i], r, im);
                     if (fMSE < fMSEBest)
                     {
                         final = *this;
                         fMSEBest = fMSE;
+                        uBestMode = EP.uMode;
+                        uBestShape = auShape[i];
                     }
+
+                    if (pStats)
+                        ++pStats->refineCalls;
                 }
+
+                if (pStats)
+                    pStats->refineTime += GetEncoderTime() - tRefine;
             }
 
             switch (r)
@@ -2868,6 +3120,24 @@ void D3DX_BC7::Encode(uint32_t flags, const HDRColorA* const pIn) noexcept
     }
 
     *this = final;
+
+    if (pStats)
+    {
+        bool bSolid = true;
+        for (size_t ch = 0; ch < BC7_NUM_CHANNELS; ++ch)
+        {
+            bSolid = bSolid && (minPixel[ch] == maxPixel[ch]);
+        }
+
+        ++pStats->blocks;
+        ++pStats->modes[uBestMode];
+        ++pStats->partitions[uBestMode][uBestShape];
+        if (bSolid)
+            ++pStats->solidBlocks;
+        if (!bHasAlpha)
+            ++pStats->opaqueBlocks;
+        pStats->totalTime += GetEncoderTime() - tStart;
+    }
 }
 
 
@@ -3595,22 +3865,58 @@ void DirectX::D3DXDecodeBC6HS(XMVECTOR *pColor, const uint8_t *pBC) noexcept
     reinterpret_cast<const D3DX_BC6H*>(pBC)->Decode(true, reinterpret_cast<HDRColorA*>(pColor));
 }
 
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC6HUHalf(uint16_t *pRGBA, const uint8_t *pBC) noexcept
+{
+    assert(pRGBA && pBC);
+    static_assert(sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes");
+    if (!reinterpret_cast<const D3DX_BC6H*>(pBC)->DecodeHalf(false, pRGBA))
+    {
+        FillWithErrorColors(pRGBA);
+    }
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC6HSHalf(uint16_t *pRGBA, const uint8_t *pBC) noexcept
+{
+    assert(pRGBA && pBC);
+    static_assert(sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes");
+    if (!reinterpret_cast<const D3DX_BC6H*>(pBC)->DecodeHalf(true, pRGBA))
+    {
+        FillWithErrorColors(pRGBA);
+    }
+}
+
 _Use_decl_annotations_
 void DirectX::D3DXEncodeBC6HU(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags) noexcept
 {
-    UNREFERENCED_PARAMETER(flags);
     assert(pBC && pColor);
     static_assert(sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes");
-    reinterpret_cast<D3DX_BC6H*>(pBC)->Encode(false, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast<D3DX_BC6H*>(pBC)->Encode(false, flags, reinterpret_cast<const HDRColorA*>(pColor), nullptr);
 }
 
 _Use_decl_annotations_
 void DirectX::D3DXEncodeBC6HS(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags) noexcept
 {
-    UNREFERENCED_PARAMETER(flags);
     assert(pBC && pColor);
     static_assert(sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes");
-    reinterpret_cast<D3DX_BC6H*>(pBC)->Encode(true, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast<D3DX_BC6H*>(pBC)->Encode(true, flags, reinterpret_cast<const HDRColorA*>(pColor), nullptr);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC6HUStats(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags, BCEncoderStatistics& stats) noexcept
+{
+    assert(pBC && pColor);
+    static_assert(sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes");
+    reinterpret_cast<D3DX_BC6H*>(pBC)->Encode(false, flags, reinterpret_cast<const HDRColorA*>(pColor), &stats);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC6HSStats(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags, BCEncoderStatistics& stats) noexcept
+{
+    assert(pBC && pColor);
+    static_assert(sizeof(D3DX_BC6H) == 16, "D3DX_BC6H should be 16 bytes");
+    reinterpret_cast<D3DX_BC6H*>(pBC)->Encode(true, flags, reinterpret_cast<const HDRColorA*>(pColor), &stats);
 }
 
 
@@ -3625,10 +3931,31 @@ void DirectX::D3DXDecodeBC7(XMVECTOR *pColor, const uint8_t *pBC) noexcept
     reinterpret_cast<const D3DX_BC7*>(pBC)->Decode(reinterpret_cast<HDRColorA*>(pColor));
 }
 
+_Use_decl_annotations_
+void DirectX::D3DXDecodeBC7LDR(uint8_t *pRGBA, const uint8_t *pBC) noexcept
+{
+    assert(pRGBA && pBC);
+    static_assert(sizeof(D3DX_BC7) == 16, "D3DX_BC7 should be 16 bytes");
+    static_assert(sizeof(LDRColorA) == 4, "LDRColorA should be 4 bytes");
+    auto pOut = reinterpret_cast<LDRColorA*>(pRGBA);
+    if (!reinterpret_cast<const D3DX_BC7*>(pBC)->DecodeLDR(pOut))
+    {
+        FillWithErrorColors(pOut);
+    }
+}
+
 _Use_decl_annotations_
 void DirectX::D3DXEncodeBC7(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags) noexcept
 {
     assert(pBC && pColor);
     static_assert(sizeof(D3DX_BC7) == 16, "D3DX_BC7 should be 16 bytes");
-    reinterpret_cast<D3DX_BC7*>(pBC)->Encode(flags, reinterpret_cast<const HDRColorA*>(pColor));
+    reinterpret_cast<D3DX_BC7*>(pBC)->Encode(flags, reinterpret_cast<const HDRColorA*>(pColor), nullptr);
+}
+
+_Use_decl_annotations_
+void DirectX::D3DXEncodeBC7Stats(uint8_t *pBC, const XMVECTOR *pColor, uint32_t flags, BCEncoderStatistics& stats) noexcept
+{
+    assert(pBC && pColor);
+    static_assert(sizeof(D3DX_BC7) == 16, "D3DX_BC7 should be 16 bytes");
+    reinterpret_cast<D3DX_BC7*>(pBC)->Encode(flags, reinterpret_cast<const HDRColorA*>(pColor), &stats);
 }
@@ -534,6 +534,9 @@ namespace DirectX
     //---------------------------------------------------------------------------------
     // Texture conversion, resizing, mipmap generation, and block compression
 
+    using ProgressCallback = std::function<bool __cdecl(size_t completed, size_t total)>;
+        // Return false to cancel, which fails the operation with E_ABORT; calls are serialized but may come from pool threads
+
     enum TEX_FR_FLAGS : unsigned long
     {
         TEX_FR_ROTATE0 = 0x0,
@@ -616,7 +619,12 @@ namespace DirectX
     HRESULT __cdecl Resize(
         _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
         _In_ size_t width, _In_ size_t height, _In_ TEX_FILTER_FLAGS filter, _Out_ ScratchImage& result) noexcept;
+    HRESULT __cdecl Resize(
+        _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+        _In_ size_t width, _In_ size_t height, _In_ TEX_FILTER_FLAGS filter,
+        _In_ const ProgressCallback& progress, _Out_ ScratchImage& result) noexcept;
         // Resize the image to width x height. Defaults to Fant filtering.
+        // progress is reported once per resized subresource
         // Note for a complex resize, the result will always have mipLevels == 1
 
     constexpr float TEX_THRESHOLD_DEFAULT = 0.5f;
@@ -628,7 +636,12 @@ namespace DirectX
     HRESULT __cdecl Convert(
         _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
         _In_ DXGI_FORMAT format, _In_ TEX_FILTER_FLAGS filter, _In_ float threshold, _Out_ ScratchImage& result) noexcept;
+    HRESULT __cdecl Convert(
+        _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+        _In_ DXGI_FORMAT format, _In_ TEX_FILTER_FLAGS filter, _In_ float threshold,
+        _In_ const ProgressCallback& progress, _Out_ ScratchImage& result) noexcept;
         // Convert the image to a new format
+        // progress is reported once per converted subresource
 
     HRESULT __cdecl ConvertToSinglePlane(_In_ const Image& srcImage, _Out_ ScratchImage& image) noexcept;
     HRESULT __cdecl ConvertToSinglePlane(
@@ -642,6 +655,14 @@ namespace DirectX
     HRESULT __cdecl GenerateMipMaps(
         _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
         _In_ TEX_FILTER_FLAGS filter, _In_ size_t levels, _Inout_ ScratchImage& mipChain);
+    HRESULT __cdecl GenerateMipMaps(
+        _In_ const Image& baseImage, _In_ TEX_FILTER_FLAGS filter, _In_ size_t levels,
+        _In_ const ProgressCallback& progress, _Inout_ ScratchImage& mipChain, _In_ bool allow1D = false) noexcept;
+    HRESULT __cdecl GenerateMipMaps(
+        _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+        _In_ TEX_FILTER_FLAGS filter, _In_ size_t levels, _In_ const ProgressCallback& progress,
+        _Inout_ ScratchImage& mipChain);
+        // progress is reported once per generated mip level of each item
         // levels of '0' indicates a full mipchain, otherwise is generates that number of total levels (including the source base image)
         // Defaults to Fant filtering which is equivalent to a box filter
 
@@ -704,6 +725,32 @@ namespace DirectX
         TEX_COMPRESS_BC7_QUICK = 0x100000,
         // Minimal modes (usually mode 6) for BC7 compression
 
+        TEX_COMPRESS_BC7_LEVEL_0 = 0x1000,
+        TEX_COMPRESS_BC7_LEVEL_1 = 0x2000,
+        TEX_COMPRESS_BC7_LEVEL_2 = 0x3000,
+        TEX_COMPRESS_BC7_LEVEL_3 = 0x4000,
+        TEX_COMPRESS_BC7_LEVEL_4 = 0x5000,
+        TEX_COMPRESS_BC7_LEVEL_MASK = 0x7000,
+        // BC7 search level: lower levels skip modes unlikely to help the block (partitions for low-contrast blocks,
+        // rotations), refine fewer partitions, and stop at a larger error; level 4 matches the default search.
+        // TEX_COMPRESS_BC7_QUICK takes precedence, and TEX_COMPRESS_BC7_USE_3SUBSETS still controls modes 0 & 2
+
+        TEX_COMPRESS_BC6H_FAST = 0x800000,
+        // Fast BC6H profile: low dynamic range blocks only use single region modes, other blocks try a reduced mode set with
+        // one partition each, endpoints are refined locally, and the search stops at an RMS error of about 2 f16 steps
+
+        TEX_COMPRESS_MULTIBLOCK = 0x400000,
+        // Encodes BC1-3 four blocks at a time with a vectorized encoder; the result matches the default encoder except where
+        // floating-point rounding differs, which can move an endpoint by one 5:6:5 step. RGB dithering uses the default encoder.
+
+        TEX_COMPRESS_MEMOIZE = 0x40000000,
+        // Reuses the encoding of source blocks identical to one already compressed (compared after format conversion)
+        // through a bounded cache shared by all threads; the result is identical to compressing every block
+
+        TEX_COMPRESS_RDO = 0x80000000,
+        // Rate-distortion pass: rewrites the trailing bytes of each block with bytes repeated from the preceding blocks of
+        // its row where that costs little error, so the output compresses better with LZ-based archivers (see CompressRDO)
+
         TEX_COMPRESS_SRGB_IN = 0x1000000,
         TEX_COMPRESS_SRGB_OUT = 0x2000000,
         TEX_COMPRESS_SRGB = (TEX_COMPRESS_SRGB_IN | TEX_COMPRESS_SRGB_OUT),
@@ -712,6 +759,10 @@ namespace DirectX
 
         TEX_COMPRESS_PARALLEL = 0x10000000,
         // Compress is free to use multithreading to improve performance (by default it does not use multithreading)
+
+        TEX_COMPRESS_ENCODER_STATS = 0x20000000,
+        // Collects the BC6H/BC7 mode search statistics and phase timings in CompressStatistics::encoder; the timing
+        // adds a little overhead to every block, so leave it off when not tuning
     };
 
     HRESULT __cdecl Compress(
@@ -722,6 +773,61 @@ namespace DirectX
         _In_ DXGI_FORMAT format, _In_ TEX_COMPRESS_FLAGS compress, _In_ float threshold, _Out_ ScratchImage& cImages) noexcept;
         // Note that threshold is only used by BC1. TEX_THRESHOLD_DEFAULT is a typical value to use
 
+    struct BCEncoderStatistics
+    {
+        // Only blocks that went through the mode search are counted. Blocks reused by TEX_COMPRESS_MEMOIZE
+        // or copied from CompressOptions::prevCImages are not, see CompressStatistics::memoHits and unchanged.
+        size_t blocks;              // Blocks encoded by the BC6H or BC7 mode search
+        size_t modes[14];           // Blocks that chose each mode: BC7 modes 0-7, or BC6H modes 1-14 as 0-13
+        size_t partitions[14][64];  // Blocks that chose each partition (BC7) or shape (BC6H) of each mode
+        size_t solidBlocks;         // Blocks of a single color
+        size_t opaqueBlocks;        // BC7 blocks without alpha below 255
+        size_t roughMSECalls;       // Shape error estimates made to pick the shapes to refine
+        size_t refineCalls;         // Endpoint refinements of a shape
+        uint64_t roughTime;         // Cumulative nanoseconds over all threads estimating shapes
+        uint64_t refineTime;        // ... refining endpoints of the chosen shapes
+        uint64_t totalTime;         // ... in the mode search, including block setup
+    };
+
+    struct CompressStatistics
+    {
+        size_t blocks;          // Number of blocks written
+        size_t memoLookups;     // Blocks looked up in the duplicate-block cache (TEX_COMPRESS_MEMOIZE)
+        size_t memoHits;        // Blocks whose encoding was copied from an identical block
+        size_t unchanged;       // Blocks copied from the previous compressed image (CompressOptions::prevCImages)
+        size_t rdoBlocks;       // Blocks rewritten by the rate-distortion pass (TEX_COMPRESS_RDO)
+        BCEncoderStatistics encoder;    // Filled in with TEX_COMPRESS_ENCODER_STATS
+    };
+
+    constexpr float TEX_RDO_LAMBDA_DEFAULT = 1.f;
+    constexpr float TEX_RDO_MAX_MSE_DEFAULT = 0.0002f;
+
+    struct CompressRDO
+    {
+        float lambda;           // Weight of estimated LZ-coded bits against the squared error per pixel on a 0-255 scale
+        float maxMSE;           // Error each block may add to its plain encoding, as ComputeMSE measures it
+    };
+
+    struct CompressOptions
+    {
+        // Used with TEX_COMPRESS_RDO; as no block gains more than rdo.maxMSE, neither does the image as a whole
+        CompressRDO rdo = { TEX_RDO_LAMBDA_DEFAULT, TEX_RDO_MAX_MSE_DEFAULT };
+        ProgressCallback progress;              // Counts block rows across all images; returning false cancels with E_ABORT
+        CompressStatistics* stats = nullptr;    // Filled in on success when not null
+        const Image* prevSrcImages = nullptr;   // Incremental compression: only the blocks whose source pixels differ from
+        const Image* prevCImages = nullptr;     // prevSrcImages are encoded, the rest are copied from prevCImages
+    };
+
+    HRESULT __cdecl Compress(
+        _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ TEX_COMPRESS_FLAGS compress, _In_ float threshold,
+        _In_ const CompressOptions& options, _Out_ ScratchImage& cImage) noexcept;
+    HRESULT __cdecl Compress(
+        _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+        _In_ DXGI_FORMAT format, _In_ TEX_COMPRESS_FLAGS compress, _In_ float threshold,
+        _In_ const CompressOptions& options, _Out_ ScratchImage& cImages) noexcept;
+        // The previous images, when given, are one per image (or just one for the single image form) and must match the
+        // source and compressed images in format and size, so blocks correspond one to one
+
 #if defined(__d3d11_h__) || defined(__d3d11_x_h__)
     HRESULT __cdecl Compress(
         _In_ ID3D11Device* pDevice, _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ TEX_COMPRESS_FLAGS compress,
@@ -732,10 +838,67 @@ namespace DirectX
         // DirectCompute-based compression (alphaWeight is only used by BC7. 1.0 is the typical value to use)
 #endif
 
+    enum TEX_DECOMPRESS_FLAGS : unsigned long
+    {
+        TEX_DECOMPRESS_DEFAULT = 0,
+
+        TEX_DECOMPRESS_PARALLEL = 0x10000000,
+        // Decompress is free to decode large images in bands of block rows on the parallel executor (by default it does not use multithreading)
+    };
+
     HRESULT __cdecl Decompress(_In_ const Image& cImage, _In_ DXGI_FORMAT format, _Out_ ScratchImage& image) noexcept;
     HRESULT __cdecl Decompress(
         _In_reads_(nimages) const Image* cImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
         _In_ DXGI_FORMAT format, _Out_ ScratchImage& images) noexcept;
+    HRESULT __cdecl Decompress(
+        _In_ const Image& cImage, _In_ DXGI_FORMAT format, _In_ TEX_DECOMPRESS_FLAGS flags,
+        _Out_ ScratchImage& image) noexcept;
+    HRESULT __cdecl Decompress(
+        _In_reads_(nimages) const Image* cImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+        _In_ DXGI_FORMAT format, _In_ TEX_DECOMPRESS_FLAGS flags, _Out_ ScratchImage& images) noexcept;
+
+    struct AlphaBlockCounts
+    {
+        size_t blocks;  // Number of 4x4 blocks in the image
+        size_t block8;  // Blocks using 8 interpolated alpha values (alpha0 > alpha1)
+        size_t block6;  // Blocks using 6 interpolated alpha values plus 0 and 255 (alpha0 <= alpha1)
+    };
+
+    enum TEX_CLASSIFY_FLAGS : unsigned long
+    {
+        TEX_CLASSIFY_DEFAULT = 0,
+
+        TEX_CLASSIFY_STOP_AT_VERDICT = 0x1,
+        // Stops once both alpha block types have been found, so the counts only cover the blocks examined
+    };
+
+    HRESULT __cdecl ClassifyAlphaBlocks(
+        _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ TEX_COMPRESS_FLAGS compress,
+        _Out_ AlphaBlockCounts& counts) noexcept;
+    HRESULT __cdecl ClassifyAlphaBlocks(
+        _In_ const Image& srcImage, _In_ DXGI_FORMAT format, _In_ TEX_COMPRESS_FLAGS compress,
+        _In_ TEX_CLASSIFY_FLAGS classify, _In_ size_t sampleBlocks, _Out_ AlphaBlockCounts& counts) noexcept;
+        // Counts the BC3 alpha block types Compress would produce for srcImage without encoding the color part
+        // (format must be BC3_UNORM or BC3_UNORM_SRGB; with TEX_CLASSIFY_STOP_AT_VERDICT, block8 + block6 can be less than blocks)
+        // A BC-compressed srcImage is classified from its blocks, giving the same counts as Decompress followed by Compress
+        // A non-zero sampleBlocks only classifies a fixed stratified sample of at most that many blocks, one from each cell of a grid over the image
+
+    struct BlockSampleOrder
+    {
+        size_t nbWidth;     // 4x4 blocks per row
+        size_t nbHeight;    // 4x4 block rows
+        size_t cellsX;      // Columns of the sample grid (nbWidth when every block is visited)
+        size_t cellsY;      // Rows of the sample grid (nbHeight when every block is visited)
+        size_t stride;      // Step between the cells visited (1 visits them in scanline order)
+    };
+
+    void __cdecl ComputeBlockSampleOrder(
+        _In_ size_t width, _In_ size_t height, _In_ size_t sampleBlocks, _In_ bool spread,
+        _Out_ BlockSampleOrder& order) noexcept;
+    size_t __cdecl GetSampleBlockIndex(_In_ const BlockSampleOrder& order, _In_ size_t n) noexcept;
+        // The blocks ClassifyAlphaBlocks visits in a width x height image: every block, or with a non-zero sampleBlocks one block
+        // from each cell of a grid of at most that many cells. spread visits the cells spread over the image rather than in scanline order.
+        // n runs from 0 to cellsX * cellsY - 1, and the result is the row-major index of the block
 
     //---------------------------------------------------------------------------------
     // Normal map operations
@@ -828,6 +991,22 @@ namespace DirectX
             _In_reads_(width) const XMVECTOR* inPixels, size_t width, size_t y)> pixelFunc,
         ScratchImage& result);
 
+    //---------------------------------------------------------------------------------
+    // Parallel execution (TEX_COMPRESS_PARALLEL)
+    using ParallelExecutor = std::function<void __cdecl(size_t count, const std::function<void __cdecl(size_t index)>& task)>;
+        // Must run task(0) ... task(count - 1), possibly concurrently, and return once all of them have completed
+
+    HRESULT __cdecl SetParallelThreadCount(_In_ size_t threads) noexcept;
+        // Threads used by the built-in pool, including the calling thread; 0 (the default) uses the hardware concurrency
+        // The pool runs one job at a time: a call that finds it busy with another thread's job runs serially on the calling
+        // thread, so concurrent callers don't scale beyond one pool's worth of threads (use SetParallelExecutor for that)
+
+    void __cdecl SetParallelExecutor(_In_ ParallelExecutor executor) noexcept;
+        // Runs parallel work on an application-owned executor instead of the built-in pool; an empty executor restores the pool
+
+    void __cdecl ShutdownParallelThreads() noexcept;
+        // Joins the built-in pool's threads; call before unloading a DLL build, as the pool is not torn down by static destructors
+
     //---------------------------------------------------------------------------------
     // WIC utility code
 #ifdef _WIN32
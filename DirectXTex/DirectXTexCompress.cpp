@@ -11,11 +11,6 @@
 
 #include "DirectXTexP.h"
 
-#ifdef _OPENMP
-#include <omp.h>
-#pragma warning(disable : 4616 6993)
-#endif
-
 #include "BC.h"
 
 using namespace DirectX;
@@ -31,7 +26,11 @@ namespace
         static_assert(static_cast<int>(TEX_COMPRESS_UNIFORM) == static_cast<int>(BC_FLAGS_UNIFORM), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
         static_assert(static_cast<int>(TEX_COMPRESS_BC7_USE_3SUBSETS) == static_cast<int>(BC_FLAGS_USE_3SUBSETS), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
         static_assert(static_cast<int>(TEX_COMPRESS_BC7_QUICK) == static_cast<int>(BC_FLAGS_FORCE_BC7_MODE6), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
-        return (compress & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A | BC_FLAGS_UNIFORM | BC_FLAGS_USE_3SUBSETS | BC_FLAGS_FORCE_BC7_MODE6));
+        static_assert(static_cast<int>(TEX_COMPRESS_BC7_LEVEL_0) == static_cast<int>(BC_FLAGS_BC7_LEVEL_0), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC7_LEVEL_4) == static_cast<int>(BC_FLAGS_BC7_LEVEL_4), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC7_LEVEL_MASK) == static_cast<int>(BC_FLAGS_BC7_LEVEL_MASK), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        static_assert(static_cast<int>(TEX_COMPRESS_BC6H_FAST) == static_cast<int>(BC_FLAGS_BC6H_FAST), "TEX_COMPRESS_* flags should match BC_FLAGS_*");
+        return (compress & (BC_FLAGS_DITHER_RGB | BC_FLAGS_DITHER_A | BC_FLAGS_UNIFORM | BC_FLAGS_USE_3SUBSETS | BC_FLAGS_FORCE_BC7_MODE6 | BC_FLAGS_BC7_LEVEL_MASK | BC_FLAGS_BC6H_FAST));
     }
 
     constexpr TEX_FILTER_FLAGS GetSRGBFlags(_In_ TEX_COMPRESS_FLAGS compress) noexcept
@@ -40,7 +39,9 @@ namespace
         static_assert(static_cast<int>(TEX_COMPRESS_SRGB_IN) == static_cast<int>(TEX_FILTER_SRGB_IN), "TEX_COMPRESS_SRGB* should match TEX_FILTER_SRGB*");
         static_assert(static_cast<int>(TEX_COMPRESS_SRGB_OUT) == static_cast<int>(TEX_FILTER_SRGB_OUT), "TEX_COMPRESS_SRGB* should match TEX_FILTER_SRGB*");
         static_assert(static_cast<int>(TEX_COMPRESS_SRGB) == static_cast<int>(TEX_FILTER_SRGB), "TEX_COMPRESS_SRGB* should match TEX_FILTER_SRGB*");
-        return static_cast<TEX_FILTER_FLAGS>(compress & TEX_FILTER_SRGB_MASK);
+        static_assert(((static_cast<unsigned long>(TEX_COMPRESS_BC7_LEVEL_MASK) | TEX_COMPRESS_BC6H_FAST | TEX_COMPRESS_MULTIBLOCK
+            | TEX_COMPRESS_MEMOIZE | TEX_COMPRESS_RDO | TEX_COMPRESS_ENCODER_STATS) & TEX_FILTER_SRGB_MASK) == 0, "TEX_COMPRESS_* flags overlap TEX_FILTER_SRGB_MASK");
+        return static_cast<TEX_FILTER_FLAGS>(compress & static_cast<unsigned long>(TEX_FILTER_SRGB));
     }
 
     inline bool DetermineEncoderSettings(_In_ DXGI_FORMAT format, _Out_ BC_ENCODE& pfEncode, _Out_ size_t& blocksize, _Out_ TEX_FILTER_FLAGS& cflags) noexcept
@@ -69,150 +70,419 @@ namespace
 
 
     //-------------------------------------------------------------------------------------
-    HRESULT CompressBC(
+    // Loads the 4x4 block at pixel (x,y), replicating pixels for partial blocks
+    //-------------------------------------------------------------------------------------
+    bool LoadBlock(
         const Image& image,
-        const Image& result,
-        uint32_t bcflags,
-        TEX_FILTER_FLAGS srgb,
-        float threshold) noexcept
+        size_t sbpp,
+        size_t x,
+        size_t y,
+        _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR* temp) noexcept
     {
-        if (!image.pixels || !result.pixels)
-            return E_POINTER;
+        assert((x < image.width) && (y < image.height));
 
-        assert(image.width == result.width);
-        assert(image.height == result.height);
+        const size_t rowPitch = image.rowPitch;
+        const uint8_t *pSrc = image.pixels + (y * rowPitch) + (x * sbpp);
+        const uint8_t *pEnd = image.pixels + image.slicePitch;
 
-        const DXGI_FORMAT format = image.format;
-        size_t sbpp = BitsPerPixel(format);
-        if (!sbpp)
-            return E_FAIL;
+        const size_t ph = std::min<size_t>(4, image.height - y);
+        const size_t pw = std::min<size_t>(4, image.width - x);
+        assert(pw > 0 && ph > 0);
 
-        if (sbpp < 8)
+        const ptrdiff_t bytesLeft = pEnd - pSrc;
+        assert(bytesLeft > 0);
+
+        for (size_t t = 0; t < ph; ++t)
         {
-            // We don't support compressing from monochrome (DXGI_FORMAT_R1_UNORM)
-            return HRESULT_E_NOT_SUPPORTED;
+            const size_t bytesToRead = std::min<size_t>(rowPitch, static_cast<size_t>(bytesLeft) - rowPitch * t);
+            if (!LoadScanline(&temp[t * 4], pw, pSrc + rowPitch * t, bytesToRead, image.format))
+                return false;
         }
 
-        // Round to bytes
-        sbpp = (sbpp + 7) / 8;
+        if (pw != 4 || ph != 4)
+        {
+            // Replicate pixels for partial block
+            static const size_t uSrc[] = { 0, 0, 0, 1 };
 
-        uint8_t *pDest = result.pixels;
+            if (pw < 4)
+            {
+                for (size_t t = 0; t < ph && t < 4; ++t)
+                {
+                    for (size_t s = pw; s < 4; ++s)
+                    {
+                        temp[(t << 2) | s] = temp[(t << 2) | uSrc[s]];
+                    }
+                }
+            }
 
-        // Determine BC format encoder
-        BC_ENCODE pfEncode;
-        size_t blocksize;
-        TEX_FILTER_FLAGS cflags;
-        if (!DetermineEncoderSettings(result.format, pfEncode, blocksize, cflags))
-            return HRESULT_E_NOT_SUPPORTED;
+            if (ph < 4)
+            {
+                for (size_t t = ph; t < 4; ++t)
+                {
+                    for (size_t s = 0; s < 4; ++s)
+                    {
+                        temp[(t << 2) | s] = temp[(uSrc[t] << 2) | s];
+                    }
+                }
+            }
+        }
 
-        XM_ALIGNED_DATA(16) XMVECTOR temp[16];
-        const uint8_t *pSrc = image.pixels;
-        const uint8_t *pEnd = image.pixels + image.slicePitch;
-        const size_t rowPitch = image.rowPitch;
-        for (size_t h = 0; h < image.height; h += 4)
+        return true;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // 8-bit RGBA/BGRA sources whose pixels ConvertScanline leaves unchanged for the target,
+    // so blocks can be loaded straight from the source rows without the float tile
+    //-------------------------------------------------------------------------------------
+    bool IsDirectLoad(DXGI_FORMAT srcFormat, DXGI_FORMAT format, TEX_FILTER_FLAGS cflags) noexcept
+    {
+        switch (srcFormat)
         {
-            const uint8_t *sptr = pSrc;
-            uint8_t* dptr = pDest;
-            const size_t ph = std::min<size_t>(4, image.height - h);
-            size_t w = 0;
-            for (size_t count = 0; (count < result.rowPitch) && (w < image.width); count += blocksize, w += 4)
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            break;
+
+        default:
+            return false;
+        }
+
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            break;
+
+        default:
+            // SNORM targets rescale the pixels
+            return false;
+        }
+
+        // sRGB in and out cancel, anything else is a gamma conversion
+        const bool srgbIn = (cflags & TEX_FILTER_SRGB_IN) || IsSRGB(srcFormat);
+        const bool srgbOut = (cflags & TEX_FILTER_SRGB_OUT) || IsSRGB(format);
+        return srgbIn == srgbOut;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Loads the 4x4 block at column x of the scanlines at pSrc from 8-bit RGBA or BGRA
+    // pixels exactly as LoadScanline does, replicating pixels for partial blocks
+    //-------------------------------------------------------------------------------------
+    void LoadBlockRGBA8(
+        _In_ const uint8_t* pSrc,
+        size_t rowPitch,
+        size_t x,
+        size_t width,
+        size_t ph,
+        bool bgra,
+        _Out_writes_(NUM_PIXELS_PER_BLOCK) XMVECTOR* temp) noexcept
+    {
+        static const size_t uSrc[] = { 0, 0, 0, 1 };
+
+        const size_t pw = std::min<size_t>(4, width - x);
+        assert(pw > 0 && ph > 0);
+
+        for (size_t t = 0; t < 4; ++t)
+        {
+            size_t row = t;
+            while (row >= ph)
+                row = uSrc[row];
+
+            auto sPtr = reinterpret_cast<const PackedVector::XMUBYTEN4*>(pSrc + rowPitch * row) + x;
+            for (size_t s = 0; s < 4; ++s)
             {
-                const size_t pw = std::min<size_t>(4, image.width - w);
-                assert(pw > 0 && ph > 0);
+                size_t col = s;
+                while (col >= pw)
+                    col = uSrc[col];
 
-                const ptrdiff_t bytesLeft = pEnd - sptr;
-                assert(bytesLeft > 0);
-                size_t bytesToRead = std::min<size_t>(rowPitch, static_cast<size_t>(bytesLeft));
-                if (!LoadScanline(&temp[0], pw, sptr, bytesToRead, format))
-                    return E_FAIL;
+                const XMVECTOR v = PackedVector::XMLoadUByteN4(sPtr + col);
+                temp[t * 4 + s] = bgra ? XMVectorSwizzle<2, 1, 0, 3>(v) : v;
+            }
+        }
+    }
 
-                if (ph > 1)
-                {
-                    bytesToRead = std::min<size_t>(rowPitch, static_cast<size_t>(bytesLeft) - rowPitch);
-                    if (!LoadScanline(&temp[4], pw, sptr + rowPitch, bytesToRead, format))
-                        return E_FAIL;
 
-                    if (ph > 2)
-                    {
-                        bytesToRead = std::min<size_t>(rowPitch, static_cast<size_t>(bytesLeft) - rowPitch * 2);
-                        if (!LoadScanline(&temp[8], pw, sptr + rowPitch * 2, bytesToRead, format))
-                            return E_FAIL;
+    //-------------------------------------------------------------------------------------
+    // Formats with a four-block encoder
+    //-------------------------------------------------------------------------------------
+    bool IsMultiBlockFormat(DXGI_FORMAT format) noexcept
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            return true;
 
-                        if (ph > 3)
-                        {
-                            bytesToRead = std::min<size_t>(rowPitch, static_cast<size_t>(bytesLeft) - rowPitch * 3);
-                            if (!LoadScanline(&temp[12], pw, sptr + rowPitch * 3, bytesToRead, format))
-                                return E_FAIL;
-                        }
-                    }
-                }
+        default:
+            return false;
+        }
+    }
 
-                if (pw != 4 || ph != 4)
-                {
-                    // Replicate pixels for partial block
-                    static const size_t uSrc[] = { 0, 0, 0, 1 };
+    //-------------------------------------------------------------------------------------
+    // Bounded cache of encoded blocks keyed by their converted source pixels, shared by all
+    // threads of one compression (TEX_COMPRESS_MEMOIZE). Slots are direct-mapped by hash and
+    // guarded by striped locks; a block landing on an occupied slot replaces its entry.
+    //-------------------------------------------------------------------------------------
+    class BlockCache
+    {
+    public:
+        BlockCache() noexcept : m_mask(0), m_lookups(0), m_hits(0) {}
 
-                    if (pw < 4)
-                    {
-                        for (size_t t = 0; t < ph && t < 4; ++t)
-                        {
-                            for (size_t s = pw; s < 4; ++s)
-                            {
-                            #pragma prefast(suppress: 26000, "PREFAST false positive")
-                                temp[(t << 2) | s] = temp[(t << 2) | uSrc[s]];
-                            }
-                        }
-                    }
+        BlockCache(const BlockCache&) = delete;
+        BlockCache& operator=(const BlockCache&) = delete;
 
-                    if (ph < 4)
-                    {
-                        for (size_t t = ph; t < 4; ++t)
-                        {
-                            for (size_t s = 0; s < 4; ++s)
-                            {
-                            #pragma prefast(suppress: 26000, "PREFAST false positive")
-                                temp[(t << 2) | s] = temp[(uSrc[t] << 2) | s];
-                            }
-                        }
-                    }
-                }
+        HRESULT Initialize(size_t nBlocks) noexcept
+        {
+            size_t nSlots = 1;
+            while (nSlots < nBlocks && nSlots < c_MaxSlots)
+                nSlots <<= 1;
 
-                ConvertScanline(temp, 16, result.format, format, cflags | srgb);
+            m_slots.reset(new (std::nothrow) Slot[nSlots]());
+            if (!m_slots)
+                return E_OUTOFMEMORY;
 
-                if (pfEncode)
-                    pfEncode(dptr, temp, bcflags);
-                else
-                    D3DXEncodeBC1(dptr, temp, threshold, bcflags);
+            m_mask = nSlots - 1;
+            return S_OK;
+        }
+
+        static uint64_t Hash(_In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR* pixels) noexcept
+        {
+            uint32_t words[NUM_PIXELS_PER_BLOCK * 4];
+            memcpy(words, pixels, sizeof(words));
+
+            uint64_t hash = 14695981039346656037ull;
+            for (const uint32_t w : words)
+            {
+                hash = (hash ^ w) * 1099511628211ull;
+            }
+            return hash ^ (hash >> 29);
+        }
 
-                sptr += sbpp * 4;
-                dptr += blocksize;
+        // Copies the encodings of all count blocks only if every one of them is cached
+        bool Lookup(
+            _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR* pixels,
+            _In_reads_(count) const uint64_t* hashes,
+            size_t count,
+            _Out_writes_bytes_(count * blocksize) uint8_t* pBC,
+            size_t blocksize) noexcept
+        {
+            m_lookups += count;
+
+            for (size_t j = 0; j < count; ++j)
+            {
+                const size_t index = static_cast<size_t>(hashes[j]) & m_mask;
+                std::lock_guard<std::mutex> lock(m_locks[index % c_LockStripes]);
+
+                const Slot& slot = m_slots[index];
+                if (!slot.valid
+                    || slot.hash != hashes[j]
+                    || memcmp(slot.pixels, &pixels[j * NUM_PIXELS_PER_BLOCK], sizeof(slot.pixels)) != 0)
+                    return false;
+
+                memcpy(pBC + j * blocksize, slot.block, blocksize);
             }
 
-            pSrc += rowPitch * 4;
-            pDest += result.rowPitch;
+            m_hits += count;
+            return true;
         }
 
-        return S_OK;
-    }
+        void Insert(
+            _In_reads_(count * NUM_PIXELS_PER_BLOCK) const XMVECTOR* pixels,
+            _In_reads_(count) const uint64_t* hashes,
+            size_t count,
+            _In_reads_bytes_(count * blocksize) const uint8_t* pBC,
+            size_t blocksize) noexcept
+        {
+            assert(blocksize <= sizeof(Slot::block));
 
+            for (size_t j = 0; j < count; ++j)
+            {
+                const size_t index = static_cast<size_t>(hashes[j]) & m_mask;
+                std::lock_guard<std::mutex> lock(m_locks[index % c_LockStripes]);
+
+                Slot& slot = m_slots[index];
+                memcpy(slot.pixels, &pixels[j * NUM_PIXELS_PER_BLOCK], sizeof(slot.pixels));
+                memcpy(slot.block, pBC + j * blocksize, blocksize);
+                slot.hash = hashes[j];
+                slot.valid = true;
+            }
+        }
+
+        size_t GetLookups() const noexcept { return m_lookups; }
+        size_t GetHits() const noexcept { return m_hits; }
+
+    private:
+        static constexpr size_t c_MaxSlots = 8192;
+        static constexpr size_t c_LockStripes = 64;
+
+        struct Slot
+        {
+            XMVECTOR pixels[NUM_PIXELS_PER_BLOCK];
+            uint64_t hash;
+            uint8_t block[16];
+            bool valid;
+        };
+
+        std::unique_ptr<Slot[]> m_slots;
+        size_t m_mask;
+        std::mutex m_locks[c_LockStripes];
+        std::atomic<size_t> m_lookups;
+        std::atomic<size_t> m_hits;
+    };
 
     //-------------------------------------------------------------------------------------
-#ifdef _OPENMP
-    HRESULT CompressBC_Parallel(
-        const Image& image,
-        const Image& result,
+    // BC6H/BC7 encoder statistics of one compression (TEX_COMPRESS_ENCODER_STATS). Each block
+    // row counts into its own copy and adds it here once, so threads only meet at the lock.
+    //-------------------------------------------------------------------------------------
+    class EncoderStatistics
+    {
+    public:
+        EncoderStatistics() noexcept : m_total{} {}
+
+        EncoderStatistics(const EncoderStatistics&) = delete;
+        EncoderStatistics& operator=(const EncoderStatistics&) = delete;
+
+        void Add(const BCEncoderStatistics& stats) noexcept
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            m_total.blocks += stats.blocks;
+            for (size_t mode = 0; mode < std::size(m_total.modes); ++mode)
+            {
+                m_total.modes[mode] += stats.modes[mode];
+                for (size_t partition = 0; partition < std::size(m_total.partitions[mode]); ++partition)
+                {
+                    m_total.partitions[mode][partition] += stats.partitions[mode][partition];
+                }
+            }
+            m_total.solidBlocks += stats.solidBlocks;
+            m_total.opaqueBlocks += stats.opaqueBlocks;
+            m_total.roughMSECalls += stats.roughMSECalls;
+            m_total.refineCalls += stats.refineCalls;
+            m_total.roughTime += stats.roughTime;
+            m_total.refineTime += stats.refineTime;
+            m_total.totalTime += stats.totalTime;
+        }
+
+        const BCEncoderStatistics& GetTotal() const noexcept { return m_total; }
+
+    private:
+        BCEncoderStatistics m_total;
+        std::mutex m_lock;
+    };
+
+
+    //-------------------------------------------------------------------------------------
+    // Encoder settings shared by every block row of a compression
+    //-------------------------------------------------------------------------------------
+    struct BlockRowEncoder
+    {
+        BC_ENCODE pfEncode;
+        BC_ENCODE pfEncode4;    // Four-block encoder, or nullptr for D3DXEncodeBC1x4
+        BC_ENCODE_STATS pfEncodeStats;      // BC6H/BC7 encoder that also counts its work, or nullptr
+        EncoderStatistics* encoderStats;
+        bool multiBlock;
+        size_t blocksize;
+        TEX_FILTER_FLAGS cflags;
+        uint32_t bcflags;
+        float threshold;
+        BlockCache* cache;      // Duplicate-block cache, or nullptr
+        const Image* prevImages;    // Previous source of each subresource for incremental compression, or nullptr
+        const Image* prevResults;   // Previous compressed image of each subresource
+        std::atomic<size_t>* unchanged;
+        BC_DECODE pfDecode;     // Decoder for the rate-distortion pass, or nullptr without it
+        size_t rdoUnit;         // Bytes in each independently coded part of a block (BC2, BC3, BC5 have two)
+        XMVECTOR rdoMask;       // Channels that count towards the error
+        float rdoLambda;
+        float rdoMaxMSE;
+        std::atomic<size_t>* rdoBlocks;
+        ProgressTracker* progress;  // Stepped once per block row, or nullptr
+    };
+
+    HRESULT GetBlockRowEncoder(
+        DXGI_FORMAT format,
         uint32_t bcflags,
         TEX_FILTER_FLAGS srgb,
-        float threshold) noexcept
+        float threshold,
+        bool multiBlock,
+        BlockRowEncoder& enc) noexcept
     {
-        if (!image.pixels || !result.pixels)
-            return E_POINTER;
+        enc = {};
+        if (!DetermineEncoderSettings(format, enc.pfEncode, enc.blocksize, enc.cflags))
+            return HRESULT_E_NOT_SUPPORTED;
 
-        assert(image.width == result.width);
-        assert(image.height == result.height);
+        enc.cflags |= srgb;
+        enc.bcflags = bcflags;
+        enc.threshold = threshold;
+        enc.multiBlock = multiBlock;
+
+        if (multiBlock)
+        {
+            switch (format)
+            {
+            case DXGI_FORMAT_BC1_UNORM:
+            case DXGI_FORMAT_BC1_UNORM_SRGB:    enc.pfEncode4 = nullptr;         break;
+            case DXGI_FORMAT_BC2_UNORM:
+            case DXGI_FORMAT_BC2_UNORM_SRGB:    enc.pfEncode4 = D3DXEncodeBC2x4; break;
+            case DXGI_FORMAT_BC3_UNORM:
+            case DXGI_FORMAT_BC3_UNORM_SRGB:    enc.pfEncode4 = D3DXEncodeBC3x4; break;
+            default:                            return HRESULT_E_NOT_SUPPORTED;
+            }
+        }
+
+        return S_OK;
+    }
+
+    HRESULT SetRDOEncoder(DXGI_FORMAT format, const CompressRDO& rdo, BlockRowEncoder& enc) noexcept
+    {
+        if (!(rdo.lambda >= 0.f) || !(rdo.maxMSE >= 0.f))
+            return E_INVALIDARG;
+
+        enc.rdoUnit = 8;
+        enc.rdoMask = g_XMOne;
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:    enc.pfDecode = D3DXDecodeBC1;   break;
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:    enc.pfDecode = D3DXDecodeBC2;   break;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:    enc.pfDecode = D3DXDecodeBC3;   break;
+        case DXGI_FORMAT_BC4_UNORM:         enc.pfDecode = D3DXDecodeBC4U;  enc.rdoMask = g_XMIdentityR0; break;
+        case DXGI_FORMAT_BC4_SNORM:         enc.pfDecode = D3DXDecodeBC4S;  enc.rdoMask = g_XMIdentityR0; break;
+        case DXGI_FORMAT_BC5_UNORM:         enc.pfDecode = D3DXDecodeBC5U;  enc.rdoMask = XMVectorAdd(g_XMIdentityR0, g_XMIdentityR1); break;
+        case DXGI_FORMAT_BC5_SNORM:         enc.pfDecode = D3DXDecodeBC5S;  enc.rdoMask = XMVectorAdd(g_XMIdentityR0, g_XMIdentityR1); break;
+        case DXGI_FORMAT_BC6H_UF16:         enc.pfDecode = D3DXDecodeBC6HU; enc.rdoUnit = 16; break;
+        case DXGI_FORMAT_BC6H_SF16:         enc.pfDecode = D3DXDecodeBC6HS; enc.rdoUnit = 16; break;
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:    enc.pfDecode = D3DXDecodeBC7;   enc.rdoUnit = 16; break;
+        default:                            return HRESULT_E_NOT_SUPPORTED;
+        }
+
+        enc.rdoLambda = rdo.lambda;
+        enc.rdoMaxMSE = rdo.maxMSE;
+        return S_OK;
+    }
 
-        const DXGI_FORMAT format = image.format;
-        size_t sbpp = BitsPerPixel(format);
+    HRESULT CheckSourceFormat(DXGI_FORMAT format) noexcept
+    {
+        const size_t sbpp = BitsPerPixel(format);
         if (!sbpp)
             return E_FAIL;
 
@@ -222,164 +492,1398 @@ namespace
             return HRESULT_E_NOT_SUPPORTED;
         }
 
-        // Round to bytes
-        sbpp = (sbpp + 7) / 8;
+        return S_OK;
+    }
 
-        const uint8_t *pEnd = image.pixels + image.slicePitch;
+    inline size_t GetBlockCount(const Image& image) noexcept
+    {
+        return std::max<size_t>(1, (image.width + 3) / 4) * std::max<size_t>(1, (image.height + 3) / 4);
+    }
 
-        // Determine BC format encoder
-        BC_ENCODE pfEncode;
-        size_t blocksize;
-        TEX_FILTER_FLAGS cflags;
-        if (!DetermineEncoderSettings(result.format, pfEncode, blocksize, cflags))
-            return HRESULT_E_NOT_SUPPORTED;
+    // Pixels per scanline of the block-row tile, which holds four such scanlines
+    inline size_t GetTileWidth(const Image& image) noexcept
+    {
+        return std::max<size_t>(1, (image.width + 3) / 4) * 4;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Rate-distortion pass (TEX_COMPRESS_RDO)
+    //-------------------------------------------------------------------------------------
+    constexpr size_t c_RDOWindow = 16;          // Preceding blocks of the row searched for repeated bytes
+    constexpr size_t c_RDOMinMatch = 3;         // Shortest run an LZ coder codes as a match
+    constexpr float c_RDOLiteralBits = 8.f;
+    constexpr float c_RDOMatchBits = 16.f;      // Rough cost of a match's length and offset
+
+    // Block error as ComputeMSE measures it, against the converted source pixels
+    float GetBlockError(
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR* pixels,
+        _In_ const uint8_t* pBC,
+        const BlockRowEncoder& enc) noexcept
+    {
+        XM_ALIGNED_DATA(16) XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+        enc.pfDecode(temp, pBC);
 
-        // Refactored version of loop to support parallel independance
-        const size_t nBlocks = std::max<size_t>(1, (image.width + 3) / 4) * std::max<size_t>(1, (image.height + 3) / 4);
+        XMVECTOR acc = g_XMZero;
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const XMVECTOR v = XMVectorMultiply(XMVectorSubtract(pixels[i], temp[i]), enc.rdoMask);
+            acc = XMVectorMultiplyAdd(v, v, acc);
+        }
 
-        bool fail = false;
+        return XMVectorGetX(XMVector4Dot(acc, g_XMOne)) / float(NUM_PIXELS_PER_BLOCK);
+    }
 
-    #pragma omp parallel for
-        for (int nb = 0; nb < static_cast<int>(nBlocks); ++nb)
+    // Estimated LZ-coded size of a block: in each part, the longest tail found at the same
+    // place in a window block is a match and the bytes before it are literals
+    float GetBlockBits(
+        _In_ const uint8_t* pBC,
+        _In_reads_bytes_(nWindow * enc.blocksize) const uint8_t* pWindow,
+        size_t nWindow,
+        const BlockRowEncoder& enc) noexcept
+    {
+        float bits = 0.f;
+        for (size_t u = 0; u < enc.blocksize; u += enc.rdoUnit)
         {
-            const int nbWidth = std::max<int>(1, int((image.width + 3) / 4));
+            const size_t end = u + enc.rdoUnit;
+
+            size_t longest = 0;
+            for (size_t w = 0; w < nWindow; ++w)
+            {
+                const uint8_t* pRef = pWindow + w * enc.blocksize;
 
-            int y = nb / nbWidth;
-            const int x = (nb - (y*nbWidth)) * 4;
-            y *= 4;
+                size_t len = 0;
+                while (len < enc.rdoUnit && pBC[end - len - 1] == pRef[end - len - 1])
+                    ++len;
 
-            assert((x >= 0) && (x < int(image.width)));
-            assert((y >= 0) && (y < int(image.height)));
+                longest = std::max(longest, len);
+            }
 
-            const size_t rowPitch = image.rowPitch;
-            const uint8_t *pSrc = image.pixels + (size_t(y)*rowPitch) + (size_t(x)*sbpp);
+            if (longest >= c_RDOMinMatch)
+                bits += float(enc.rdoUnit - longest) * c_RDOLiteralBits + c_RDOMatchBits;
+            else
+                bits += float(enc.rdoUnit) * c_RDOLiteralBits;
+        }
 
-            uint8_t *pDest = result.pixels + (size_t(nb)*blocksize);
+        return bits;
+    }
 
-            const size_t ph = std::min<size_t>(4, image.height - size_t(y));
-            const size_t pw = std::min<size_t>(4, image.width - size_t(x));
-            assert(pw > 0 && ph > 0);
+    //-------------------------------------------------------------------------------------
+    // Tries replacing the tail of each part of the block with the bytes at the same place in
+    // each of the nWindow blocks before it, which hold the indices in every BC format, and
+    // keeps the candidate with the lowest error + lambda * bits within the error budget
+    //-------------------------------------------------------------------------------------
+    bool OptimizeBlockRD(
+        _Inout_updates_bytes_(enc.blocksize) uint8_t* pBC,
+        _In_reads_(NUM_PIXELS_PER_BLOCK) const XMVECTOR* pixels,
+        size_t nWindow,
+        const BlockRowEncoder& enc) noexcept
+    {
+        if (!nWindow)
+            return false;
+
+        const size_t blocksize = enc.blocksize;
+        const uint8_t* pWindow = pBC - nWindow * blocksize;
+
+        // Error per pixel on a 0-255 scale, so useful lambdas are around 1
+        constexpr float scale = 255.f * 255.f;
+
+        const float maxError = GetBlockError(pixels, pBC, enc) + enc.rdoMaxMSE;
 
-            const ptrdiff_t bytesLeft = pEnd - pSrc;
-            assert(bytesLeft > 0);
-            size_t bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft));
+        uint8_t best[16];
+        memcpy(best, pBC, blocksize);
+        float bestCost = (maxError - enc.rdoMaxMSE) * scale + enc.rdoLambda * GetBlockBits(best, pWindow, nWindow, enc);
+        bool changed = false;
 
-            XM_ALIGNED_DATA(16) XMVECTOR temp[16];
-            if (!LoadScanline(&temp[0], pw, pSrc, bytesToRead, format))
-                fail = true;
+        // Parts are optimized in turn, each starting from the best block so far
+        for (size_t u = 0; u < blocksize; u += enc.rdoUnit)
+        {
+            uint8_t current[16];
+            memcpy(current, best, blocksize);
 
-            if (ph > 1)
+            for (size_t w = 0; w < nWindow; ++w)
             {
-                bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft) - rowPitch);
-                if (!LoadScanline(&temp[4], pw, pSrc + rowPitch, bytesToRead, format))
-                    fail = true;
+                const uint8_t* pRef = pWindow + w * blocksize;
 
-                if (ph > 2)
+                uint8_t candidate[16];
+                memcpy(candidate, current, blocksize);
+
+                // Copy one more byte from the end each step, skipping steps that change nothing
+                bool pending = false;
+                for (size_t len = 1; len <= enc.rdoUnit; ++len)
                 {
-                    bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft) - rowPitch * 2);
-                    if (!LoadScanline(&temp[8], pw, pSrc + rowPitch * 2, bytesToRead, format))
-                        fail = true;
+                    const size_t pos = u + enc.rdoUnit - len;
+                    if (candidate[pos] != pRef[pos])
+                    {
+                        candidate[pos] = pRef[pos];
+                        pending = true;
+                    }
+
+                    if (!pending || len < c_RDOMinMatch)
+                        continue;
+
+                    pending = false;
 
-                    if (ph > 3)
+                    const float error = GetBlockError(pixels, candidate, enc);
+                    if (error > maxError)
+                        continue;
+
+                    const float cost = error * scale + enc.rdoLambda * GetBlockBits(candidate, pWindow, nWindow, enc);
+                    if (cost < bestCost)
                     {
-                        bytesToRead = std::min<size_t>(rowPitch, size_t(bytesLeft) - rowPitch * 3);
-                        if (!LoadScanline(&temp[12], pw, pSrc + rowPitch * 3, bytesToRead, format))
-                            fail = true;
+                        bestCost = cost;
+                        memcpy(best, candidate, blocksize);
+                        changed = true;
                     }
                 }
             }
+        }
+
+        if (changed)
+            memcpy(pBC, best, blocksize);
+
+        return changed;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Encodes one row of blocks: its four scanlines are loaded whole into the tile, padded
+    // the way partial blocks are, and converted with a single ConvertScanline call before
+    // the blocks are gathered from it (four at a time with the multi-block encoder).
+    // 8-bit sources needing no conversion skip the tile and load each block directly.
+    //-------------------------------------------------------------------------------------
+    bool CompressBlockRow(
+        const Image& image,
+        const Image& result,
+        size_t index,
+        size_t by,
+        const BlockRowEncoder& enc,
+        _Out_writes_(4 * GetTileWidth(image)) XMVECTOR* tile) noexcept
+    {
+        const size_t tileWidth = GetTileWidth(image);
+        const size_t nbWidth = tileWidth / 4;
+        const size_t y = by * 4;
+        assert(y < image.height);
+
+        const size_t rowPitch = image.rowPitch;
+        const uint8_t *pSrc = image.pixels + y * rowPitch;
+        const uint8_t *pEnd = image.pixels + image.slicePitch;
+
+        const size_t ph = std::min<size_t>(4, image.height - y);
+
+        uint8_t* pDest = result.pixels + by * result.rowPitch;
+
+        // Incremental compression copies the blocks whose source pixels are unchanged
+        const Image* prevImage = enc.prevImages ? &enc.prevImages[index] : nullptr;
+        const uint8_t* pPrevSrc = nullptr;
+        const uint8_t* pPrevDest = nullptr;
+        size_t rowBytes = 0;
+        size_t bytesPerBlock = 0;
+        bool unchanged[4] = {};
+        if (prevImage)
+        {
+            pPrevSrc = prevImage->pixels + y * prevImage->rowPitch;
+            pPrevDest = enc.prevResults[index].pixels + by * enc.prevResults[index].rowPitch;
+
+            const size_t sbpp = BitsPerPixel(image.format);
+            rowBytes = (image.width * sbpp + 7) / 8;
+            bytesPerBlock = sbpp / 2;
+
+            bool same = true;
+            for (size_t t = 0; t < ph && same; ++t)
+            {
+                same = memcmp(pSrc + rowPitch * t, pPrevSrc + prevImage->rowPitch * t, rowBytes) == 0;
+            }
+
+            if (same)
+            {
+                memcpy(pDest, pPrevDest, nbWidth * enc.blocksize);
+                *enc.unchanged += nbWidth;
+                return true;
+            }
+        }
+
+        const bool direct = IsDirectLoad(image.format, result.format, enc.cflags);
+        const bool bgra = (image.format == DXGI_FORMAT_B8G8R8A8_UNORM || image.format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
+
+        if (!direct)
+        {
+            for (size_t t = 0; t < ph; ++t)
+            {
+                const uint8_t *sptr = pSrc + rowPitch * t;
+                const size_t bytesToRead = std::min<size_t>(rowPitch, static_cast<size_t>(pEnd - sptr));
+                if (!LoadScanline(&tile[t * tileWidth], image.width, sptr, bytesToRead, image.format))
+                    return false;
+            }
+
+            // Replicate pixels for the partial block at the end of each scanline and for missing scanlines
+            static const size_t uSrc[] = { 0, 0, 0, 1 };
+
+            const size_t lastX = tileWidth - 4;
+            const size_t pw = image.width - lastX;
+            for (size_t t = 0; t < ph; ++t)
+            {
+                XMVECTOR* row = &tile[t * tileWidth + lastX];
+                for (size_t s = pw; s < 4; ++s)
+                {
+                    row[s] = row[uSrc[s]];
+                }
+            }
+
+            for (size_t t = ph; t < 4; ++t)
+            {
+                memcpy(&tile[t * tileWidth], &tile[uSrc[t] * tileWidth], sizeof(XMVECTOR) * tileWidth);
+            }
+
+            ConvertScanline(tile, 4 * tileWidth, result.format, image.format, enc.cflags);
+        }
+
+        const size_t group = enc.multiBlock ? 4 : 1;
+
+        XM_ALIGNED_DATA(16) XMVECTOR temp[4 * NUM_PIXELS_PER_BLOCK];
+
+        std::unique_ptr<BCEncoderStatistics> rowStats;
+        if (enc.pfEncodeStats)
+        {
+            rowStats.reset(new (std::nothrow) BCEncoderStatistics());
+            if (!rowStats)
+                return false;
+        }
+
+        for (size_t bx = 0; bx < nbWidth; bx += group)
+        {
+            const size_t count = std::min<size_t>(group, nbWidth - bx);
+
+            for (size_t j = 0; j < count; ++j)
+            {
+                if (direct)
+                {
+                    LoadBlockRGBA8(pSrc, rowPitch, (bx + j) * 4, image.width, ph, bgra, &temp[j * NUM_PIXELS_PER_BLOCK]);
+                    continue;
+                }
+
+                for (size_t t = 0; t < 4; ++t)
+                {
+                    memcpy(&temp[j * NUM_PIXELS_PER_BLOCK + t * 4], &tile[t * tileWidth + (bx + j) * 4], sizeof(XMVECTOR) * 4);
+                }
+            }
+
+            uint8_t* pBlocks = pDest + bx * enc.blocksize;
+
+            if (prevImage)
+            {
+                size_t nUnchanged = 0;
+                for (size_t j = 0; j < count; ++j)
+                {
+                    // Bytes of the block's pixels in each scanline, the last block of a row being partial
+                    const size_t offset = (bx + j) * bytesPerBlock;
+                    const size_t bytes = std::min(bytesPerBlock, rowBytes - offset);
+
+                    unchanged[j] = true;
+                    for (size_t t = 0; t < ph && unchanged[j]; ++t)
+                    {
+                        unchanged[j] = memcmp(pSrc + rowPitch * t + offset, pPrevSrc + prevImage->rowPitch * t + offset, bytes) == 0;
+                    }
+
+                    if (unchanged[j])
+                        ++nUnchanged;
+                }
+
+                if (nUnchanged == count)
+                {
+                    memcpy(pBlocks, pPrevDest + bx * enc.blocksize, count * enc.blocksize);
+                    *enc.unchanged += count;
+                    continue;
+                }
+            }
+
+            // Cache slots hold single blocks, but a partial group goes through the scalar encoder,
+            // which can differ from a lane of the four-block encoder by one 5:6:5 step. Only full
+            // groups use the cache, so every cached block comes from the same encoder path.
+            const bool useCache = enc.cache && (count == group);
+
+            uint64_t hashes[4] = {};
+            bool cached = false;
+            if (useCache)
+            {
+                for (size_t j = 0; j < count; ++j)
+                {
+                    hashes[j] = BlockCache::Hash(&temp[j * NUM_PIXELS_PER_BLOCK]);
+                }
+
+                cached = enc.cache->Lookup(temp, hashes, count, pBlocks, enc.blocksize);
+            }
+
+            if (!cached)
+            {
+                if (count == 4)
+                {
+                    if (enc.pfEncode4)
+                        enc.pfEncode4(pBlocks, temp, enc.bcflags);
+                    else
+                        D3DXEncodeBC1x4(pBlocks, temp, enc.threshold, enc.bcflags);
+                }
+                else
+                {
+                    for (size_t j = 0; j < count; ++j)
+                    {
+                        if (rowStats)
+                            enc.pfEncodeStats(pBlocks + j * enc.blocksize, &temp[j * NUM_PIXELS_PER_BLOCK], enc.bcflags, *rowStats);
+                        else if (enc.pfEncode)
+                            enc.pfEncode(pBlocks + j * enc.blocksize, &temp[j * NUM_PIXELS_PER_BLOCK], enc.bcflags);
+                        else
+                            D3DXEncodeBC1(pBlocks + j * enc.blocksize, &temp[j * NUM_PIXELS_PER_BLOCK], enc.threshold, enc.bcflags);
+                    }
+                }
+
+                if (useCache)
+                {
+                    enc.cache->Insert(temp, hashes, count, pBlocks, enc.blocksize);
+                }
+            }
+
+            if (enc.pfDecode)
+            {
+                // The cache keeps the plain encodings, as the pass depends on the blocks before
+                for (size_t j = 0; j < count; ++j)
+                {
+                    if (prevImage && unchanged[j])
+                        continue;
+
+                    const size_t nWindow = std::min(c_RDOWindow, bx + j);
+                    if (OptimizeBlockRD(pBlocks + j * enc.blocksize, &temp[j * NUM_PIXELS_PER_BLOCK], nWindow, enc))
+                        *enc.rdoBlocks += 1;
+                }
+            }
+
+            if (prevImage)
+            {
+                // Groups are encoded together, so restore the previous encoding of their unchanged blocks
+                for (size_t j = 0; j < count; ++j)
+                {
+                    if (unchanged[j])
+                    {
+                        memcpy(pBlocks + j * enc.blocksize, pPrevDest + (bx + j) * enc.blocksize, enc.blocksize);
+                        *enc.unchanged += 1;
+                    }
+                }
+            }
+        }
+
+        if (rowStats)
+        {
+            enc.encoderStats->Add(*rowStats);
+        }
+
+        return true;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    HRESULT CompressBC(
+        const Image& image,
+        const Image& result,
+        size_t index,
+        const BlockRowEncoder& enc) noexcept
+    {
+        if (!image.pixels || !result.pixels)
+            return E_POINTER;
+
+        assert(image.width == result.width);
+        assert(image.height == result.height);
+
+        const HRESULT hr = CheckSourceFormat(image.format);
+        if (FAILED(hr))
+            return hr;
+
+        auto tile = make_AlignedArrayXMVECTOR(uint64_t(GetTileWidth(image)) * 4);
+        if (!tile)
+            return E_OUTOFMEMORY;
+
+        const size_t nbHeight = std::max<size_t>(1, (image.height + 3) / 4);
+        for (size_t by = 0; by < nbHeight; ++by)
+        {
+            if (!CompressBlockRow(image, result, index, by, enc, tile.get()))
+                return E_FAIL;
+
+            if (enc.progress && !enc.progress->Step())
+                return E_ABORT;
+        }
+
+        return S_OK;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Compresses every subresource from one pool of block-row tasks, so the small mips and
+    // slices of a texture don't each pay for a fork/join that leaves most threads idle
+    //-------------------------------------------------------------------------------------
+    struct CompressTask
+    {
+        size_t index;   // Subresource
+        size_t row;     // First block row
+        size_t rows;
+        size_t cost;    // Estimated cost in blocks
+    };
+
+    // Rows of small subresources are merged into tasks of about this many blocks
+    constexpr size_t c_TaskBlocks = 256;
+
+    HRESULT CompressBC_Scheduled(
+        const Image* srcImages,
+        const Image* destImages,
+        size_t nimages,
+        const BlockRowEncoder& enc) noexcept
+    {
+        assert(srcImages && destImages && nimages > 0);
+
+        std::vector<CompressTask> tasks;
+        try
+        {
+            for (size_t index = 0; index < nimages; ++index)
+            {
+                const Image& image = srcImages[index];
+                if (!image.pixels || !destImages[index].pixels)
+                    return E_POINTER;
+
+                const HRESULT hr = CheckSourceFormat(image.format);
+                if (FAILED(hr))
+                    return hr;
+
+                const size_t nbWidth = std::max<size_t>(1, (image.width + 3) / 4);
+                const size_t nbHeight = std::max<size_t>(1, (image.height + 3) / 4);
+                const size_t rowsPerTask = std::max<size_t>(1, c_TaskBlocks / nbWidth);
+
+                for (size_t row = 0; row < nbHeight; row += rowsPerTask)
+                {
+                    const size_t rows = std::min(rowsPerTask, nbHeight - row);
+                    tasks.push_back({ index, row, rows, rows * nbWidth });
+                }
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        // Largest tasks first, so the small ones fill in the gaps at the end
+        std::stable_sort(tasks.begin(), tasks.end(),
+            [](const CompressTask& a, const CompressTask& b) noexcept { return a.cost > b.cost; });
+
+        std::atomic<bool> fail(false);
+
+        ParallelFor(tasks.size(), [&](size_t nt)
+            {
+                if (fail || (enc.progress && enc.progress->IsCancelled()))
+                    return;
+
+                const CompressTask& task = tasks[nt];
+                const Image& image = srcImages[task.index];
+
+                auto tile = make_AlignedArrayXMVECTOR(uint64_t(GetTileWidth(image)) * 4);
+                if (!tile)
+                {
+                    fail = true;
+                    return;
+                }
+
+                for (size_t by = task.row; by < task.row + task.rows; ++by)
+                {
+                    if (!CompressBlockRow(image, destImages[task.index], task.index, by, enc, tile.get()))
+                    {
+                        fail = true;
+                        break;
+                    }
+
+                    if (enc.progress && !enc.progress->Step())
+                        break;
+                }
+            });
+
+        if (fail)
+            return E_FAIL;
+
+        return (enc.progress && enc.progress->IsCancelled()) ? E_ABORT : S_OK;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Checks the previous images for incremental compression, which must have the same
+    // layout as the images being compressed so blocks correspond one to one
+    //-------------------------------------------------------------------------------------
+    HRESULT ValidatePreviousImages(
+        const Image* srcImages,
+        size_t nimages,
+        DXGI_FORMAT format,
+        const CompressOptions& options) noexcept
+    {
+        if (!options.prevSrcImages && !options.prevCImages)
+            return S_OK;
+
+        if (!options.prevSrcImages || !options.prevCImages)
+            return E_INVALIDARG;
+
+        for (size_t index = 0; index < nimages; ++index)
+        {
+            const Image& src = srcImages[index];
+            const Image& prevSrc = options.prevSrcImages[index];
+            const Image& prevC = options.prevCImages[index];
+
+            if (!prevSrc.pixels || !prevC.pixels)
+                return E_POINTER;
+
+            if (prevSrc.format != src.format || prevC.format != format)
+                return E_INVALIDARG;
+
+            if (prevSrc.width != src.width || prevSrc.height != src.height
+                || prevC.width != src.width || prevC.height != src.height)
+                return E_INVALIDARG;
+        }
+
+        return S_OK;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Compresses srcImages into the initialized destImages, as one parallel task pool with
+    // TEX_COMPRESS_PARALLEL, and fills in the statistics. prevImages and prevResults are
+    // the previous sources and compressed images for incremental compression, or nullptr.
+    // progress is told of each finished block row and may cancel with E_ABORT.
+    //-------------------------------------------------------------------------------------
+    HRESULT CompressImages(
+        const Image* srcImages,
+        const Image* destImages,
+        size_t nimages,
+        TEX_COMPRESS_FLAGS compress,
+        float threshold,
+        const CompressRDO& rdo,
+        const Image* prevImages,
+        const Image* prevResults,
+        const ProgressCallback& progress,
+        CompressStatistics& stats) noexcept
+    {
+        assert(srcImages && destImages && nimages > 0);
+
+        const DXGI_FORMAT format = destImages[0].format;
+        const bool multiBlock = (compress & TEX_COMPRESS_MULTIBLOCK) && IsMultiBlockFormat(format);
+
+        BlockRowEncoder enc;
+        HRESULT hr = GetBlockRowEncoder(format, GetBCFlags(compress), GetSRGBFlags(compress), threshold, multiBlock, enc);
+        if (FAILED(hr))
+            return hr;
+
+        size_t nBlocks = 0;
+        size_t nRows = 0;
+        for (size_t index = 0; index < nimages; ++index)
+        {
+            nBlocks += GetBlockCount(destImages[index]);
+            nRows += std::max<size_t>(1, (destImages[index].height + 3) / 4);
+        }
+
+        ProgressTracker tracker(progress, nRows);
+        enc.progress = &tracker;
+
+        // One cache serves every subresource, so repeated blocks across mips and array slices are found too
+        BlockCache cache;
+        if (compress & TEX_COMPRESS_MEMOIZE)
+        {
+            hr = cache.Initialize(nBlocks);
+            if (FAILED(hr))
+                return hr;
+
+            enc.cache = &cache;
+        }
+
+        std::atomic<size_t> unchanged(0);
+        enc.prevImages = prevImages;
+        enc.prevResults = prevResults;
+        enc.unchanged = &unchanged;
+
+        EncoderStatistics encoderStats;
+        if (compress & TEX_COMPRESS_ENCODER_STATS)
+        {
+            switch (format)
+            {
+            case DXGI_FORMAT_BC6H_UF16:         enc.pfEncodeStats = D3DXEncodeBC6HUStats; break;
+            case DXGI_FORMAT_BC6H_SF16:         enc.pfEncodeStats = D3DXEncodeBC6HSStats; break;
+            case DXGI_FORMAT_BC7_UNORM:
+            case DXGI_FORMAT_BC7_UNORM_SRGB:    enc.pfEncodeStats = D3DXEncodeBC7Stats;   break;
+            default:                            break;
+            }
+
+            enc.encoderStats = &encoderStats;
+        }
+
+        std::atomic<size_t> rdoBlocks(0);
+        if (compress & TEX_COMPRESS_RDO)
+        {
+            hr = SetRDOEncoder(format, rdo, enc);
+            if (FAILED(hr))
+                return hr;
+
+            enc.rdoBlocks = &rdoBlocks;
+        }
+
+        if (compress & TEX_COMPRESS_PARALLEL)
+        {
+            // All block rows of all subresources are scheduled together
+            hr = CompressBC_Scheduled(srcImages, destImages, nimages, enc);
+        }
+        else
+        {
+            for (size_t index = 0; index < nimages && SUCCEEDED(hr); ++index)
+            {
+                hr = CompressBC(srcImages[index], destImages[index], index, enc);
+            }
+        }
+
+        if (FAILED(hr))
+            return hr;
+
+        stats.blocks = nBlocks;
+        stats.memoLookups = cache.GetLookups();
+        stats.memoHits = cache.GetHits();
+        stats.unchanged = unchanged;
+        stats.rdoBlocks = rdoBlocks;
+        stats.encoder = encoderStats.GetTotal();
+        return S_OK;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Returns a stride that visits every one of nBlocks blocks exactly once when stepping
+    // modulo nBlocks, spreading the first blocks visited over the whole image
+    //-------------------------------------------------------------------------------------
+    size_t GetBlockStride(size_t nBlocks) noexcept
+    {
+        if (nBlocks < 3)
+            return 1;
+
+        // Start near nBlocks / golden ratio and step to the next value coprime to nBlocks
+        size_t stride = std::max<size_t>(1, size_t((uint64_t(nBlocks) * 618) / 1000));
+        for (;;)
+        {
+            size_t a = nBlocks;
+            size_t b = stride;
+            while (b)
+            {
+                const size_t t = a % b;
+                a = b;
+                b = t;
+            }
+
+            if (a == 1)
+                return stride;
+
+            ++stride;
+        }
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Splits the block grid into cellsX x cellsY cells for a stratified sample of about
+    // sampleBlocks blocks. Without sampling, every cell is a single block.
+    //-------------------------------------------------------------------------------------
+    void GetSampleGrid(
+        size_t nbWidth,
+        size_t nbHeight,
+        size_t sampleBlocks,
+        size_t& cellsX,
+        size_t& cellsY) noexcept
+    {
+        cellsX = nbWidth;
+        cellsY = nbHeight;
+
+        if (!sampleBlocks || sampleBlocks >= nbWidth * nbHeight)
+            return;
+
+        // Roughly square cells, with at least one block per cell in each direction
+        const double aspect = double(nbWidth) / double(nbHeight);
+        cellsX = std::min(nbWidth, std::max<size_t>(1, size_t(sqrt(double(sampleBlocks) * aspect) + 0.5)));
+        cellsY = std::min(nbHeight, std::max<size_t>(1, sampleBlocks / cellsX));
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Returns the block picked from a cell of the sample grid. The position within the cell
+    // is hashed from the cell index, so the sample is the same on every run.
+    //-------------------------------------------------------------------------------------
+    size_t GetSampleBlock(
+        size_t cell,
+        size_t nbWidth,
+        size_t nbHeight,
+        size_t cellsX,
+        size_t cellsY) noexcept
+    {
+        const size_t cx = cell % cellsX;
+        const size_t cy = cell / cellsX;
+
+        const size_t x0 = (cx * nbWidth) / cellsX;
+        const size_t y0 = (cy * nbHeight) / cellsY;
+        const size_t w = ((cx + 1) * nbWidth) / cellsX - x0;
+        const size_t h = ((cy + 1) * nbHeight) / cellsY - y0;
+
+        // splitmix64 finalizer
+        uint64_t z = uint64_t(cell) + 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z ^= z >> 31;
+
+        const size_t x = x0 + size_t((z & 0xFFFFFFFF) % w);
+        const size_t y = y0 + size_t((z >> 32) % h);
+
+        return y * nbWidth + x;
+    }
+
+    // Blocks classified by each task of a parallel classification
+    constexpr size_t c_ClassifyChunk = 1024;
+
+    //-------------------------------------------------------------------------------------
+    // Runs only the BC3 alpha endpoint selection for each block of the image
+    //-------------------------------------------------------------------------------------
+    HRESULT ClassifyBC3Alpha(
+        const Image& image,
+        DXGI_FORMAT format,
+        uint32_t bcflags,
+        TEX_FILTER_FLAGS srgb,
+        bool parallel,
+        bool stopAtVerdict,
+        size_t sampleBlocks,
+        AlphaBlockCounts& counts) noexcept
+    {
+        if (!image.pixels)
+            return E_POINTER;
+
+        size_t sbpp = BitsPerPixel(image.format);
+        if (!sbpp)
+            return E_FAIL;
+
+        if (sbpp < 8)
+        {
+            // We don't support compressing from monochrome (DXGI_FORMAT_R1_UNORM)
+            return HRESULT_E_NOT_SUPPORTED;
+        }
+
+        // Round to bytes
+        sbpp = (sbpp + 7) / 8;
+
+        // When stopping at the verdict, visit the blocks spread over the image rather than
+        // in scanline order so textures with both block types stop early
+        BlockSampleOrder order;
+        ComputeBlockSampleOrder(image.width, image.height, sampleBlocks, stopAtVerdict, order);
+
+        const size_t nbWidth = order.nbWidth;
+        const size_t nBlocks = nbWidth * order.nbHeight;
+        const size_t nCells = order.cellsX * order.cellsY;
+
+        std::atomic<bool> fail(false);
+        std::atomic<bool> seen8(false);
+        std::atomic<bool> seen6(false);
+        std::atomic<size_t> block8(0);
+        std::atomic<size_t> block6(0);
+
+        // Blocks are classified in chunks, which run concurrently when parallel
+        const size_t nChunks = (nCells + c_ClassifyChunk - 1) / c_ClassifyChunk;
+        auto classify = [&](size_t chunk)
+            {
+                size_t count8 = 0;
+                size_t count6 = 0;
+
+                const size_t last = std::min(nCells, (chunk + 1) * c_ClassifyChunk);
+                for (size_t nb = chunk * c_ClassifyChunk; nb < last; ++nb)
+                {
+                    if (stopAtVerdict && seen8.load(std::memory_order_relaxed) && seen6.load(std::memory_order_relaxed))
+                        break;
+
+                    const size_t index = GetSampleBlockIndex(order, nb);
+                    const size_t x = (index % nbWidth) * 4;
+                    const size_t y = (index / nbWidth) * 4;
+
+                    XM_ALIGNED_DATA(16) XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+                    if (!LoadBlock(image, sbpp, x, y, temp))
+                    {
+                        fail = true;
+                        break;
+                    }
+
+                    ConvertScanline(temp, NUM_PIXELS_PER_BLOCK, format, image.format, srgb);
+
+                    uint8_t alpha[2];
+                    D3DXEncodeBC3Alpha(alpha, temp, bcflags);
+
+                    // Same test D3DXDecodeBC3 uses to select the interpolation mode
+                    if (alpha[0] > alpha[1])
+                    {
+                        ++count8;
+                        seen8.store(true, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        ++count6;
+                        seen6.store(true, std::memory_order_relaxed);
+                    }
+                }
+
+                block8 += count8;
+                block6 += count6;
+            };
+
+        if (parallel)
+        {
+            ParallelFor(nChunks, classify);
+        }
+        else
+        {
+            for (size_t chunk = 0; chunk < nChunks; ++chunk)
+                classify(chunk);
+        }
+
+        if (fail)
+            return E_FAIL;
+
+        counts.blocks = nBlocks;
+        counts.block8 = block8;
+        counts.block6 = block6;
+
+        return S_OK;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Decodes only the alpha channel of a block to the 8-bit values Decompress would
+    // produce for it
+    //-------------------------------------------------------------------------------------
+    void DecodeAlphaBC1(_Out_writes_(NUM_PIXELS_PER_BLOCK) uint8_t* pA8, _In_reads_(8) const uint8_t* pBC) noexcept
+    {
+        auto pBC1 = reinterpret_cast<const D3DX_BC1*>(pBC);
+
+        // Only 3-color blocks have transparent texels (index 3)
+        uint32_t dw = pBC1->bitmap;
+        const bool punchThrough = (pBC1->rgb[0] <= pBC1->rgb[1]);
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
+        {
+            pA8[i] = (punchThrough && (dw & 3) == 3) ? 0 : 255;
+        }
+    }
+
+    void DecodeAlphaBC2(_Out_writes_(NUM_PIXELS_PER_BLOCK) uint8_t* pA8, _In_reads_(16) const uint8_t* pBC) noexcept
+    {
+        auto pBC2 = reinterpret_cast<const D3DX_BC2*>(pBC);
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            const uint32_t a4 = (pBC2->bitmap[i >> 3] >> ((i & 7) * 4)) & 0xF;
+            pA8[i] = static_cast<uint8_t>(a4 * 17);
+        }
+    }
+
+    void DecodeAlphaBC3(_Out_writes_(NUM_PIXELS_PER_BLOCK) uint8_t* pA8, _In_reads_(16) const uint8_t* pBC) noexcept
+    {
+        auto pBC3 = reinterpret_cast<const D3DX_BC3*>(pBC);
+
+        // Rounded to nearest like the float decoder followed by the 8-bit store
+        const uint32_t a0 = pBC3->alpha[0];
+        const uint32_t a1 = pBC3->alpha[1];
+
+        uint8_t alpha[8];
+        alpha[0] = static_cast<uint8_t>(a0);
+        alpha[1] = static_cast<uint8_t>(a1);
+
+        if (a0 > a1)
+        {
+            for (uint32_t i = 1; i < 7; ++i)
+                alpha[i + 1] = static_cast<uint8_t>((a0 * (7u - i) + a1 * i + 3u) / 7u);
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; ++i)
+                alpha[i + 1] = static_cast<uint8_t>((a0 * (5u - i) + a1 * i + 2u) / 5u);
+
+            alpha[6] = 0;
+            alpha[7] = 255;
+        }
+
+        uint32_t dw = uint32_t(pBC3->bitmap[0]) | uint32_t(pBC3->bitmap[1] << 8) | uint32_t(pBC3->bitmap[2] << 16);
+
+        for (size_t i = 0; i < 8; ++i, dw >>= 3)
+            pA8[i] = alpha[dw & 0x7];
+
+        dw = uint32_t(pBC3->bitmap[3]) | uint32_t(pBC3->bitmap[4] << 8) | uint32_t(pBC3->bitmap[5] << 16);
+
+        for (size_t i = 8; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 3)
+            pA8[i] = alpha[dw & 0x7];
+    }
+
+    void DecodeAlphaBC7(_Out_writes_(NUM_PIXELS_PER_BLOCK) uint8_t* pA8, _In_reads_(16) const uint8_t* pBC) noexcept
+    {
+        // BC7 decodes to 8-bit values, so converting the alpha back is exact
+        XM_ALIGNED_DATA(16) XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+        D3DXDecodeBC7(temp, pBC);
+
+        for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+        {
+            pA8[i] = static_cast<uint8_t>(static_cast<int32_t>(XMVectorGetW(temp[i]) * 255.0f + 0.5f));
+        }
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Classifies the BC3 alpha blocks for an image that is already BC compressed, working
+    // on one block at a time instead of decompressing the image
+    //-------------------------------------------------------------------------------------
+    HRESULT ClassifyBC3AlphaFromBC(
+        const Image& image,
+        uint32_t bcflags,
+        bool parallel,
+        bool stopAtVerdict,
+        size_t sampleBlocks,
+        AlphaBlockCounts& counts) noexcept
+    {
+        if (!image.pixels)
+            return E_POINTER;
+
+        using DecodeAlpha = void(*)(uint8_t*, const uint8_t*);
+
+        DecodeAlpha pfDecode;
+        size_t sbpp;
+        switch (image.format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:    pfDecode = DecodeAlphaBC1;  sbpp = 8;   break;
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:    pfDecode = DecodeAlphaBC2;  sbpp = 16;  break;
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:    pfDecode = DecodeAlphaBC3;  sbpp = 16;  break;
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:    pfDecode = DecodeAlphaBC7;  sbpp = 16;  break;
+
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            // No alpha channel, so every block is opaque and encodes as a constant 6 alpha block
+            counts.blocks = counts.block6 = std::max<size_t>(1, (image.width + 3) / 4) * std::max<size_t>(1, (image.height + 3) / 4);
+            counts.block8 = 0;
+            return S_OK;
+
+        default:
+            return HRESULT_E_NOT_SUPPORTED;
+        }
+
+        BlockSampleOrder order;
+        ComputeBlockSampleOrder(image.width, image.height, sampleBlocks, stopAtVerdict, order);
+
+        const size_t nbWidth = order.nbWidth;
+        const size_t nBlocks = nbWidth * order.nbHeight;
+        const size_t nCells = order.cellsX * order.cellsY;
+
+        std::atomic<bool> seen8(false);
+        std::atomic<bool> seen6(false);
+        std::atomic<size_t> block8(0);
+        std::atomic<size_t> block6(0);
+
+        // Blocks are classified in chunks, which run concurrently when parallel
+        const size_t nChunks = (nCells + c_ClassifyChunk - 1) / c_ClassifyChunk;
+        auto classify = [&](size_t chunk)
+            {
+                size_t count8 = 0;
+                size_t count6 = 0;
+
+                const size_t last = std::min(nCells, (chunk + 1) * c_ClassifyChunk);
+                for (size_t nb = chunk * c_ClassifyChunk; nb < last; ++nb)
+                {
+                    if (stopAtVerdict && seen8.load(std::memory_order_relaxed) && seen6.load(std::memory_order_relaxed))
+                        break;
+
+                    const size_t index = GetSampleBlockIndex(order, nb);
+                    const uint8_t* pBC = image.pixels + (index / nbWidth) * image.rowPitch + (index % nbWidth) * sbpp;
+
+                    uint8_t a8[NUM_PIXELS_PER_BLOCK];
+                    pfDecode(a8, pBC);
+
+                    // Replicate pixels for partial block the same way LoadBlock does
+                    const size_t pw = std::min<size_t>(4, image.width - (index % nbWidth) * 4);
+                    const size_t ph = std::min<size_t>(4, image.height - (index / nbWidth) * 4);
+                    if (pw != 4 || ph != 4)
+                    {
+                        static const size_t uSrc[] = { 0, 0, 0, 1 };
+
+                        for (size_t t = 0; t < ph; ++t)
+                        {
+                            for (size_t s = pw; s < 4; ++s)
+                            {
+                                a8[(t << 2) | s] = a8[(t << 2) | uSrc[s]];
+                            }
+                        }
+
+                        for (size_t t = ph; t < 4; ++t)
+                        {
+                            for (size_t s = 0; s < 4; ++s)
+                            {
+                                a8[(t << 2) | s] = a8[(uSrc[t] << 2) | s];
+                            }
+                        }
+                    }
+
+                    uint8_t alpha[2];
+                    D3DXEncodeBC3AlphaA8(alpha, a8, bcflags);
+
+                    if (alpha[0] > alpha[1])
+                    {
+                        ++count8;
+                        seen8.store(true, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        ++count6;
+                        seen6.store(true, std::memory_order_relaxed);
+                    }
+                }
+
+                block8 += count8;
+                block6 += count6;
+            };
+
+        if (parallel)
+        {
+            ParallelFor(nChunks, classify);
+        }
+        else
+        {
+            for (size_t chunk = 0; chunk < nChunks; ++chunk)
+                classify(chunk);
+        }
+
+        counts.blocks = nBlocks;
+        counts.block8 = block8;
+        counts.block6 = block6;
+
+        return S_OK;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    DXGI_FORMAT DefaultDecompress(_In_ DXGI_FORMAT format) noexcept
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_TYPELESS:
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC2_TYPELESS:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC3_TYPELESS:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC7_TYPELESS:
+        case DXGI_FORMAT_BC7_UNORM:
+            return DXGI_FORMAT_R8G8B8A8_UNORM;
+
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
+        case DXGI_FORMAT_BC4_TYPELESS:
+        case DXGI_FORMAT_BC4_UNORM:
+            return DXGI_FORMAT_R8_UNORM;
+
+        case DXGI_FORMAT_BC4_SNORM:
+            return DXGI_FORMAT_R8_SNORM;
+
+        case DXGI_FORMAT_BC5_TYPELESS:
+        case DXGI_FORMAT_BC5_UNORM:
+            return DXGI_FORMAT_R8G8_UNORM;
+
+        case DXGI_FORMAT_BC5_SNORM:
+            return DXGI_FORMAT_R8G8_SNORM;
+
+        case DXGI_FORMAT_BC6H_TYPELESS:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            // We could use DXGI_FORMAT_R32G32B32_FLOAT here since BC6H is always Alpha 1.0,
+            // but this format is more supported by viewers
+            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+        default:
+            return DXGI_FORMAT_UNKNOWN;
+        }
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Decompression
+    //-------------------------------------------------------------------------------------
+    enum DECODE_PATH : uint32_t
+    {
+        DECODE_VECTOR = 0,  // Decode to XMVECTOR, then ConvertScanline and StoreScanline
+        DECODE_PALETTE,     // BC1-BC5 to 8-bit RGBA/BGRA, converting only the colors each block selects from
+        DECODE_BC7_RGBA8,   // BC7 straight to 8-bit RGBA/BGRA
+        DECODE_BC6H_HALF,   // BC6H straight to R16G16B16A16_FLOAT
+    };
+
+    struct BlockDecoder
+    {
+        BC_DECODE pfDecode;
+        size_t sbpp;        // Bytes per block
+        size_t dbpp;        // Bytes per destination pixel
+        DXGI_FORMAT cformat;
+        DXGI_FORMAT format;
+        DECODE_PATH path;
+        bool bgra;
+        uint32_t bc2Alpha[16];  // Stored BC2 alpha levels (DECODE_PALETTE only)
+    };
+
+    // Decoding is much cheaper than encoding, so bands are larger than c_TaskBlocks
+    constexpr size_t c_DecodeTaskBlocks = 4096;
+
+    inline uint32_t LoadBlock32(_In_reads_(4) const uint8_t* ptr) noexcept
+    {
+        uint32_t v;
+        memcpy(&v, ptr, sizeof(v));
+        return v;
+    }
+
+    inline uint64_t LoadBlockIndices48(_In_reads_(6) const uint8_t* ptr) noexcept
+    {
+        uint64_t v = 0;
+        memcpy(&v, ptr, 6);
+        return v;
+    }
+
+    // Runs palette entries through the same conversion and store as decoded pixels
+    inline bool StorePalette(
+        _Out_writes_(count) uint32_t* pEntries,
+        _Inout_updates_all_(count) XMVECTOR* pPalette,
+        size_t count,
+        const BlockDecoder& dec) noexcept
+    {
+        ConvertScanline(pPalette, count, dec.format, dec.cformat, TEX_FILTER_DEFAULT);
+        return StoreScanline(pEntries, sizeof(uint32_t) * count, dec.format, pPalette, count);
+    }
+
+    // ConvertScanline and StoreScanline work on each pixel on its own, and for these formats on color and
+    // alpha on their own, so looking texels up in the converted palette matches decoding them one by one
+    bool DecodePaletteBlock(
+        _Out_writes_(NUM_PIXELS_PER_BLOCK) uint32_t* pTexels,
+        _In_reads_(dec.sbpp) const uint8_t* pBC,
+        const BlockDecoder& dec) noexcept
+    {
+        XM_ALIGNED_DATA(16) XMVECTOR palette[8];
+        uint32_t entries[8];
+
+        switch (dec.cformat)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+            {
+                D3DXDecodeBC1Palette(palette, pBC, true);
+                if (!StorePalette(entries, palette, 4, dec))
+                    return false;
+
+                uint32_t dw = LoadBlock32(pBC + 4);
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2)
+                {
+                    pTexels[i] = entries[dw & 3];
+                }
+            }
+            break;
+
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+            {
+                D3DXDecodeBC1Palette(palette, pBC + 8, false);
+                if (!StorePalette(entries, palette, 4, dec))
+                    return false;
+
+                uint64_t alpha = uint64_t(LoadBlock32(pBC)) | (uint64_t(LoadBlock32(pBC + 4)) << 32);
+                uint32_t dw = LoadBlock32(pBC + 12);
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2, alpha >>= 4)
+                {
+                    pTexels[i] = (entries[dw & 3] & 0x00FFFFFF) | dec.bc2Alpha[alpha & 0xf];
+                }
+            }
+            break;
+
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+            {
+                // Entry i carries color i & 3 and alpha i
+                float fAlpha[8];
+                D3DXDecodeBC1Palette(palette, pBC + 8, false);
+                D3DXDecodeBC3AlphaPalette(fAlpha, pBC);
+                for (size_t i = 8; i-- > 0; )
+                {
+                    palette[i] = XMVectorSetW(palette[i & 3], fAlpha[i]);
+                }
+                if (!StorePalette(entries, palette, 8, dec))
+                    return false;
+
+                uint64_t alpha = LoadBlockIndices48(pBC + 2);
+                uint32_t dw = LoadBlock32(pBC + 12);
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, dw >>= 2, alpha >>= 3)
+                {
+                    pTexels[i] = (entries[dw & 3] & 0x00FFFFFF) | (entries[alpha & 7] & 0xFF000000);
+                }
+            }
+            break;
+
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            {
+                float fRed[8];
+                if (dec.cformat == DXGI_FORMAT_BC4_SNORM)
+                    D3DXDecodeBC4SPalette(fRed, pBC);
+                else
+                    D3DXDecodeBC4UPalette(fRed, pBC);
+
+                for (size_t i = 0; i < 8; ++i)
+                {
+                    palette[i] = XMVectorSet(fRed[i], 0, 0, 1.0f);
+                }
+                if (!StorePalette(entries, palette, 8, dec))
+                    return false;
+
+                uint64_t red = LoadBlockIndices48(pBC + 2);
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, red >>= 3)
+                {
+                    pTexels[i] = entries[red & 7];
+                }
+            }
+            break;
 
-            if (pw != 4 || ph != 4)
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
             {
-                // Replicate pixels for partial block
-                static const size_t uSrc[] = { 0, 0, 0, 1 };
+                // Entry i carries red i and green i
+                float fRed[8], fGreen[8];
+                if (dec.cformat == DXGI_FORMAT_BC5_SNORM)
+                {
+                    D3DXDecodeBC4SPalette(fRed, pBC);
+                    D3DXDecodeBC4SPalette(fGreen, pBC + 8);
+                }
+                else
+                {
+                    D3DXDecodeBC4UPalette(fRed, pBC);
+                    D3DXDecodeBC4UPalette(fGreen, pBC + 8);
+                }
 
-                if (pw < 4)
+                for (size_t i = 0; i < 8; ++i)
                 {
-                    for (size_t t = 0; t < ph && t < 4; ++t)
-                    {
-                        for (size_t s = pw; s < 4; ++s)
-                        {
-                            temp[(t << 2) | s] = temp[(t << 2) | uSrc[s]];
-                        }
-                    }
+                    palette[i] = XMVectorSet(fRed[i], fGreen[i], 0, 1.0f);
                 }
+                if (!StorePalette(entries, palette, 8, dec))
+                    return false;
 
-                if (ph < 4)
+                uint64_t red = LoadBlockIndices48(pBC + 2);
+                uint64_t green = LoadBlockIndices48(pBC + 10);
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i, red >>= 3, green >>= 3)
                 {
-                    for (size_t t = ph; t < 4; ++t)
-                    {
-                        for (size_t s = 0; s < 4; ++s)
-                        {
-                            temp[(t << 2) | s] = temp[(uSrc[t] << 2) | s];
-                        }
-                    }
+                    pTexels[i] = (entries[red & 7] & 0xFFFF00FF) | (entries[green & 7] & 0x0000FF00);
                 }
             }
+            break;
 
-            ConvertScanline(temp, 16, result.format, format, cflags | srgb);
-
-            if (pfEncode)
-                pfEncode(pDest, temp, bcflags);
-            else
-                D3DXEncodeBC1(pDest, temp, threshold, bcflags);
+        default:
+            return false;
         }
 
-        return (fail) ? E_FAIL : S_OK;
+        return true;
     }
-#endif // _OPENMP
-
 
-    //-------------------------------------------------------------------------------------
-    DXGI_FORMAT DefaultDecompress(_In_ DXGI_FORMAT format) noexcept
+    // Decodes one block into 4 rows of 4 destination pixels (direct paths only)
+    bool DecodeBlock(
+        _Out_writes_bytes_(NUM_PIXELS_PER_BLOCK * 8) uint8_t* pTexels,
+        _In_reads_(dec.sbpp) const uint8_t* pBC,
+        const BlockDecoder& dec) noexcept
     {
-        switch (format)
+        switch (dec.path)
         {
-        case DXGI_FORMAT_BC1_TYPELESS:
-        case DXGI_FORMAT_BC1_UNORM:
-        case DXGI_FORMAT_BC2_TYPELESS:
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC3_TYPELESS:
-        case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC7_TYPELESS:
-        case DXGI_FORMAT_BC7_UNORM:
-            return DXGI_FORMAT_R8G8B8A8_UNORM;
+        case DECODE_PALETTE:
+            return DecodePaletteBlock(reinterpret_cast<uint32_t*>(pTexels), pBC, dec);
 
-        case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-            return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+        case DECODE_BC7_RGBA8:
+            D3DXDecodeBC7LDR(pTexels, pBC);
+            if (dec.bgra)
+            {
+                auto ptr = reinterpret_cast<uint32_t*>(pTexels);
+                for (size_t i = 0; i < NUM_PIXELS_PER_BLOCK; ++i)
+                {
+                    const uint32_t t = ptr[i];
+                    ptr[i] = (t & 0xFF00FF00) | ((t >> 16) & 0xFF) | ((t & 0xFF) << 16);
+                }
+            }
+            return true;
 
-        case DXGI_FORMAT_BC4_TYPELESS:
-        case DXGI_FORMAT_BC4_UNORM:
-            return DXGI_FORMAT_R8_UNORM;
+        case DECODE_BC6H_HALF:
+            if (dec.cformat == DXGI_FORMAT_BC6H_SF16)
+                D3DXDecodeBC6HSHalf(reinterpret_cast<uint16_t*>(pTexels), pBC);
+            else
+                D3DXDecodeBC6HUHalf(reinterpret_cast<uint16_t*>(pTexels), pBC);
+            return true;
 
-        case DXGI_FORMAT_BC4_SNORM:
-            return DXGI_FORMAT_R8_SNORM;
+        case DECODE_VECTOR:
+        default:
+            return false;
+        }
+    }
 
-        case DXGI_FORMAT_BC5_TYPELESS:
-        case DXGI_FORMAT_BC5_UNORM:
-            return DXGI_FORMAT_R8G8_UNORM;
+    bool DecompressBlockRows(
+        const Image& cImage,
+        const Image& result,
+        size_t by,
+        size_t rows,
+        const BlockDecoder& dec) noexcept
+    {
+        XM_ALIGNED_DATA(16) XMVECTOR temp[16];
+        XM_ALIGNED_DATA(16) uint8_t texels[NUM_PIXELS_PER_BLOCK * 8];
 
-        case DXGI_FORMAT_BC5_SNORM:
-            return DXGI_FORMAT_R8G8_SNORM;
+        const size_t rowPitch = result.rowPitch;
+        const size_t blockPitch = dec.dbpp * 4;
+        const uint8_t *pSrc = cImage.pixels + by * cImage.rowPitch;
+        uint8_t *pDest = result.pixels + by * 4 * rowPitch;
+        for (size_t h = by * 4; (h < cImage.height) && (rows > 0); h += 4, --rows)
+        {
+            const uint8_t *sptr = pSrc;
+            uint8_t* dptr = pDest;
+            const size_t ph = std::min<size_t>(4, cImage.height - h);
+            size_t w = 0;
+            for (size_t count = 0; (count < cImage.rowPitch) && (w < cImage.width); count += dec.sbpp, w += 4)
+            {
+                const size_t pw = std::min<size_t>(4, cImage.width - w);
+                assert(pw > 0 && ph > 0);
 
-        case DXGI_FORMAT_BC6H_TYPELESS:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-            // We could use DXGI_FORMAT_R32G32B32_FLOAT here since BC6H is always Alpha 1.0,
-            // but this format is more supported by viewers
-            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+                if (dec.path != DECODE_VECTOR)
+                {
+                    if (!DecodeBlock(texels, sptr, dec))
+                        return false;
 
-        default:
-            return DXGI_FORMAT_UNKNOWN;
+                    for (size_t y = 0; y < ph; ++y)
+                    {
+                        memcpy(dptr + rowPitch * y, texels + blockPitch * y, pw * dec.dbpp);
+                    }
+                }
+                else
+                {
+                    dec.pfDecode(temp, sptr);
+                    ConvertScanline(temp, 16, dec.format, dec.cformat, TEX_FILTER_DEFAULT);
+
+                    for (size_t y = 0; y < ph; ++y)
+                    {
+                        if (!StoreScanline(dptr + rowPitch * y, rowPitch, dec.format, &temp[y * 4], pw))
+                            return false;
+                    }
+                }
+
+                sptr += dec.sbpp;
+                dptr += blockPitch;
+            }
+
+            pSrc += cImage.rowPitch;
+            pDest += rowPitch * 4;
         }
-    }
 
+        return true;
+    }
 
     //-------------------------------------------------------------------------------------
-    HRESULT DecompressBC(_In_ const Image& cImage, _In_ const Image& result) noexcept
+    HRESULT DecompressBC(_In_ const Image& cImage, _In_ const Image& result, bool parallel) noexcept
     {
         if (!cImage.pixels || !result.pixels)
             return E_POINTER;
@@ -401,10 +1905,6 @@ namespace
         // Round to bytes
         dbpp = (dbpp + 7) / 8;
 
-        uint8_t *pDest = result.pixels;
-        if (!pDest)
-            return E_POINTER;
-
         // Promote "typeless" BC formats
         DXGI_FORMAT cformat;
         switch (cImage.format)
@@ -420,75 +1920,112 @@ namespace
         }
 
         // Determine BC format decoder
-        BC_DECODE pfDecode;
-        size_t sbpp;
+        BlockDecoder dec = {};
         switch (cformat)
         {
         case DXGI_FORMAT_BC1_UNORM:
-        case DXGI_FORMAT_BC1_UNORM_SRGB:    pfDecode = D3DXDecodeBC1;   sbpp = 8;   break;
+        case DXGI_FORMAT_BC1_UNORM_SRGB:    dec.pfDecode = D3DXDecodeBC1;   dec.sbpp = 8;   break;
         case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:    pfDecode = D3DXDecodeBC2;   sbpp = 16;  break;
+        case DXGI_FORMAT_BC2_UNORM_SRGB:    dec.pfDecode = D3DXDecodeBC2;   dec.sbpp = 16;  break;
         case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:    pfDecode = D3DXDecodeBC3;   sbpp = 16;  break;
-        case DXGI_FORMAT_BC4_UNORM:         pfDecode = D3DXDecodeBC4U;  sbpp = 8;   break;
-        case DXGI_FORMAT_BC4_SNORM:         pfDecode = D3DXDecodeBC4S;  sbpp = 8;   break;
-        case DXGI_FORMAT_BC5_UNORM:         pfDecode = D3DXDecodeBC5U;  sbpp = 16;  break;
-        case DXGI_FORMAT_BC5_SNORM:         pfDecode = D3DXDecodeBC5S;  sbpp = 16;  break;
-        case DXGI_FORMAT_BC6H_UF16:         pfDecode = D3DXDecodeBC6HU; sbpp = 16;  break;
-        case DXGI_FORMAT_BC6H_SF16:         pfDecode = D3DXDecodeBC6HS; sbpp = 16;  break;
+        case DXGI_FORMAT_BC3_UNORM_SRGB:    dec.pfDecode = D3DXDecodeBC3;   dec.sbpp = 16;  break;
+        case DXGI_FORMAT_BC4_UNORM:         dec.pfDecode = D3DXDecodeBC4U;  dec.sbpp = 8;   break;
+        case DXGI_FORMAT_BC4_SNORM:         dec.pfDecode = D3DXDecodeBC4S;  dec.sbpp = 8;   break;
+        case DXGI_FORMAT_BC5_UNORM:         dec.pfDecode = D3DXDecodeBC5U;  dec.sbpp = 16;  break;
+        case DXGI_FORMAT_BC5_SNORM:         dec.pfDecode = D3DXDecodeBC5S;  dec.sbpp = 16;  break;
+        case DXGI_FORMAT_BC6H_UF16:         dec.pfDecode = D3DXDecodeBC6HU; dec.sbpp = 16;  break;
+        case DXGI_FORMAT_BC6H_SF16:         dec.pfDecode = D3DXDecodeBC6HS; dec.sbpp = 16;  break;
         case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:    pfDecode = D3DXDecodeBC7;   sbpp = 16;  break;
+        case DXGI_FORMAT_BC7_UNORM_SRGB:    dec.pfDecode = D3DXDecodeBC7;   dec.sbpp = 16;  break;
         default:
             return HRESULT_E_NOT_SUPPORTED;
         }
 
-        XM_ALIGNED_DATA(16) XMVECTOR temp[16];
-        const uint8_t *pSrc = cImage.pixels;
-        const size_t rowPitch = result.rowPitch;
-        for (size_t h = 0; h < cImage.height; h += 4)
+        dec.dbpp = dbpp;
+        dec.cformat = cformat;
+        dec.format = format;
+        dec.path = DECODE_VECTOR;
+
+        // Direct paths for the common destination formats
+        switch (format)
         {
-            const uint8_t *sptr = pSrc;
-            uint8_t* dptr = pDest;
-            const size_t ph = std::min<size_t>(4, cImage.height - h);
-            size_t w = 0;
-            for (size_t count = 0; (count < cImage.rowPitch) && (w < cImage.width); count += sbpp, w += 4)
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            dec.bgra = (format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB);
+            switch (cformat)
             {
-                pfDecode(temp, sptr);
-                ConvertScanline(temp, 16, format, cformat, TEX_FILTER_DEFAULT);
-
-                const size_t pw = std::min<size_t>(4, cImage.width - w);
-                assert(pw > 0 && ph > 0);
-
-                if (!StoreScanline(dptr, rowPitch, format, &temp[0], pw))
-                    return E_FAIL;
+            case DXGI_FORMAT_BC6H_UF16:
+            case DXGI_FORMAT_BC6H_SF16:
+                break;
+
+            case DXGI_FORMAT_BC7_UNORM:
+            case DXGI_FORMAT_BC7_UNORM_SRGB:
+                // Only without a gamma conversion
+                if ((cformat == DXGI_FORMAT_BC7_UNORM_SRGB) == IsSRGB(format))
+                {
+                    dec.path = DECODE_BC7_RGBA8;
+                }
+                break;
 
-                if (ph > 1)
+            case DXGI_FORMAT_BC2_UNORM:
+            case DXGI_FORMAT_BC2_UNORM_SRGB:
                 {
-                    if (!StoreScanline(dptr + rowPitch, rowPitch, format, &temp[4], pw))
+                    XM_ALIGNED_DATA(16) XMVECTOR levels[16];
+                    for (size_t i = 0; i < 16; ++i)
+                    {
+                        levels[i] = XMVectorSet(0, 0, 0, static_cast<float>(i) * (1.0f / 15.0f));
+                    }
+                    if (!StorePalette(dec.bc2Alpha, levels, 16, dec))
                         return E_FAIL;
 
-                    if (ph > 2)
+                    for (size_t i = 0; i < 16; ++i)
                     {
-                        if (!StoreScanline(dptr + rowPitch * 2, rowPitch, format, &temp[8], pw))
-                            return E_FAIL;
-
-                        if (ph > 3)
-                        {
-                            if (!StoreScanline(dptr + rowPitch * 3, rowPitch, format, &temp[12], pw))
-                                return E_FAIL;
-                        }
+                        dec.bc2Alpha[i] &= 0xFF000000;
                     }
                 }
+                dec.path = DECODE_PALETTE;
+                break;
 
-                sptr += sbpp;
-                dptr += dbpp * 4;
+            default:
+                dec.path = DECODE_PALETTE;
+                break;
             }
+            break;
 
-            pSrc += cImage.rowPitch;
-            pDest += rowPitch * 4;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            if (cformat == DXGI_FORMAT_BC6H_UF16 || cformat == DXGI_FORMAT_BC6H_SF16)
+            {
+                dec.path = DECODE_BC6H_HALF;
+            }
+            break;
+
+        default:
+            break;
         }
 
-        return S_OK;
+        const size_t nbWidth = std::max<size_t>(1, (cImage.width + 3) / 4);
+        const size_t nbHeight = std::max<size_t>(1, (cImage.height + 3) / 4);
+
+        if (!parallel)
+        {
+            return DecompressBlockRows(cImage, result, 0, nbHeight, dec) ? S_OK : E_FAIL;
+        }
+
+        // Large images are decoded in bands of block rows in parallel
+        const size_t rowsPerTask = std::max<size_t>(1, c_DecodeTaskBlocks / nbWidth);
+        const size_t nTasks = (nbHeight + rowsPerTask - 1) / rowsPerTask;
+
+        std::atomic<bool> fail(false);
+
+        ParallelFor(nTasks, [&](size_t nt)
+            {
+                if (!DecompressBlockRows(cImage, result, nt * rowsPerTask, rowsPerTask, dec))
+                    fail = true;
+            });
+
+        return fail ? E_FAIL : S_OK;
     }
 }
 
@@ -593,6 +2130,21 @@ HRESULT DirectX::Compress(
     float threshold,
     ScratchImage& image) noexcept
 {
+    return Compress(srcImage, format, compress, threshold, CompressOptions(), image);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::Compress(
+    const Image& srcImage,
+    DXGI_FORMAT format,
+    TEX_COMPRESS_FLAGS compress,
+    float threshold,
+    const CompressOptions& options,
+    ScratchImage& image) noexcept
+{
+    if (options.stats)
+        *options.stats = {};
+
     if (IsCompressed(srcImage.format) || !IsCompressed(format))
         return E_INVALIDARG;
 
@@ -600,8 +2152,12 @@ HRESULT DirectX::Compress(
         || IsTypeless(srcImage.format) || IsPlanar(srcImage.format) || IsPalettized(srcImage.format))
         return HRESULT_E_NOT_SUPPORTED;
 
+    HRESULT hr = ValidatePreviousImages(&srcImage, 1, format, options);
+    if (FAILED(hr))
+        return hr;
+
     // Create compressed image
-    HRESULT hr = image.Initialize2D(format, srcImage.width, srcImage.height, 1, 1);
+    hr = image.Initialize2D(format, srcImage.width, srcImage.height, 1, 1);
     if (FAILED(hr))
         return hr;
 
@@ -613,23 +2169,19 @@ HRESULT DirectX::Compress(
     }
 
     // Compress single image
-    if (compress & TEX_COMPRESS_PARALLEL)
-    {
-    #ifndef _OPENMP
-        return E_NOTIMPL;
-    #else
-        hr = CompressBC_Parallel(srcImage, *img, GetBCFlags(compress), GetSRGBFlags(compress), threshold);
-    #endif // _OPENMP
-    }
-    else
+    CompressStatistics stats = {};
+    hr = CompressImages(&srcImage, img, 1, compress, threshold, options.rdo,
+        options.prevSrcImages, options.prevCImages, options.progress, stats);
+    if (FAILED(hr))
     {
-        hr = CompressBC(srcImage, *img, GetBCFlags(compress), GetSRGBFlags(compress), threshold);
+        image.Release();
+        return hr;
     }
 
-    if (FAILED(hr))
-        image.Release();
+    if (options.stats)
+        *options.stats = stats;
 
-    return hr;
+    return S_OK;
 }
 
 _Use_decl_annotations_
@@ -642,6 +2194,23 @@ HRESULT DirectX::Compress(
     float threshold,
     ScratchImage& cImages) noexcept
 {
+    return Compress(srcImages, nimages, metadata, format, compress, threshold, CompressOptions(), cImages);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::Compress(
+    const Image* srcImages,
+    size_t nimages,
+    const TexMetadata& metadata,
+    DXGI_FORMAT format,
+    TEX_COMPRESS_FLAGS compress,
+    float threshold,
+    const CompressOptions& options,
+    ScratchImage& cImages) noexcept
+{
+    if (options.stats)
+        *options.stats = {};
+
     if (!srcImages || !nimages)
         return E_INVALIDARG;
 
@@ -652,11 +2221,15 @@ HRESULT DirectX::Compress(
         || IsTypeless(metadata.format) || IsPlanar(metadata.format) || IsPalettized(metadata.format))
         return HRESULT_E_NOT_SUPPORTED;
 
+    HRESULT hr = ValidatePreviousImages(srcImages, nimages, format, options);
+    if (FAILED(hr))
+        return hr;
+
     cImages.Release();
 
     TexMetadata mdata2 = metadata;
     mdata2.format = format;
-    HRESULT hr = cImages.Initialize(mdata2);
+    hr = cImages.Initialize(mdata2);
     if (FAILED(hr))
         return hr;
 
@@ -677,45 +2250,104 @@ HRESULT DirectX::Compress(
     {
         assert(dest[index].format == format);
 
-        const Image& src = srcImages[index];
-
-        if (src.width != dest[index].width || src.height != dest[index].height)
+        if (srcImages[index].width != dest[index].width || srcImages[index].height != dest[index].height)
         {
             cImages.Release();
             return E_FAIL;
         }
+    }
 
-        if ((compress & TEX_COMPRESS_PARALLEL))
-        {
-        #ifndef _OPENMP
-            return E_NOTIMPL;
-        #else
-            if (compress & TEX_COMPRESS_PARALLEL)
-            {
-                hr = CompressBC_Parallel(src, dest[index], GetBCFlags(compress), GetSRGBFlags(compress), threshold);
-                if (FAILED(hr))
-                {
-                    cImages.Release();
-                    return  hr;
-                }
-            }
-        #endif // _OPENMP
-        }
-        else
-        {
-            hr = CompressBC(src, dest[index], GetBCFlags(compress), GetSRGBFlags(compress), threshold);
-            if (FAILED(hr))
-            {
-                cImages.Release();
-                return hr;
-            }
-        }
+    CompressStatistics stats = {};
+    hr = CompressImages(srcImages, dest, nimages, compress, threshold, options.rdo,
+        options.prevSrcImages, options.prevCImages, options.progress, stats);
+    if (FAILED(hr))
+    {
+        cImages.Release();
+        return hr;
     }
 
+    if (options.stats)
+        *options.stats = stats;
+
     return S_OK;
 }
 
 
+//-------------------------------------------------------------------------------------
+// Alpha block classification
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::ClassifyAlphaBlocks(
+    const Image& srcImage,
+    DXGI_FORMAT format,
+    TEX_COMPRESS_FLAGS compress,
+    TEX_CLASSIFY_FLAGS classify,
+    size_t sampleBlocks,
+    AlphaBlockCounts& counts) noexcept
+{
+    counts = {};
+
+    if (format != DXGI_FORMAT_BC3_UNORM && format != DXGI_FORMAT_BC3_UNORM_SRGB)
+        return E_INVALIDARG;
+
+    if (IsTypeless(srcImage.format) || IsPlanar(srcImage.format) || IsPalettized(srcImage.format))
+        return HRESULT_E_NOT_SUPPORTED;
+
+    if (!srcImage.width || !srcImage.height)
+        return E_INVALIDARG;
+
+    const bool parallel = (compress & TEX_COMPRESS_PARALLEL) != 0;
+    const bool stopAtVerdict = (classify & TEX_CLASSIFY_STOP_AT_VERDICT) != 0;
+
+    if (IsCompressed(srcImage.format))
+    {
+        // Alpha isn't affected by sRGB conversion, so only the BC flags matter
+        return ClassifyBC3AlphaFromBC(srcImage, GetBCFlags(compress), parallel, stopAtVerdict, sampleBlocks, counts);
+    }
+
+    return ClassifyBC3Alpha(srcImage, format, GetBCFlags(compress), GetSRGBFlags(compress), parallel,
+        stopAtVerdict, sampleBlocks, counts);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::ClassifyAlphaBlocks(
+    const Image& srcImage,
+    DXGI_FORMAT format,
+    TEX_COMPRESS_FLAGS compress,
+    AlphaBlockCounts& counts) noexcept
+{
+    return ClassifyAlphaBlocks(srcImage, format, compress, TEX_CLASSIFY_DEFAULT, 0, counts);
+}
+
+_Use_decl_annotations_
+void DirectX::ComputeBlockSampleOrder(
+    size_t width,
+    size_t height,
+    size_t sampleBlocks,
+    bool spread,
+    BlockSampleOrder& order) noexcept
+{
+    order.nbWidth = std::max<size_t>(1, (width + 3) / 4);
+    order.nbHeight = std::max<size_t>(1, (height + 3) / 4);
+
+    GetSampleGrid(order.nbWidth, order.nbHeight, sampleBlocks, order.cellsX, order.cellsY);
+
+    order.stride = (spread) ? GetBlockStride(order.cellsX * order.cellsY) : 1;
+}
+
+_Use_decl_annotations_
+size_t DirectX::GetSampleBlockIndex(const BlockSampleOrder& order, size_t n) noexcept
+{
+    const size_t nCells = order.cellsX * order.cellsY;
+    const size_t cell = size_t((uint64_t(n) * order.stride) % nCells);
+
+    if (nCells == order.nbWidth * order.nbHeight)
+        return cell;
+
+    return GetSampleBlock(cell, order.nbWidth, order.nbHeight, order.cellsX, order.cellsY);
+}
+
+
 //-------------------------------------------------------------------------------------
 // Decompression
 //-------------------------------------------------------------------------------------
@@ -724,6 +2356,16 @@ HRESULT DirectX::Decompress(
     const Image& cImage,
     DXGI_FORMAT format,
     ScratchImage& image) noexcept
+{
+    return Decompress(cImage, format, TEX_DECOMPRESS_DEFAULT, image);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::Decompress(
+    const Image& cImage,
+    DXGI_FORMAT format,
+    TEX_DECOMPRESS_FLAGS flags,
+    ScratchImage& image) noexcept
 {
     if (!IsCompressed(cImage.format) || IsCompressed(format))
         return E_INVALIDARG;
@@ -760,7 +2402,7 @@ HRESULT DirectX::Decompress(
     }
 
     // Decompress single image
-    hr = DecompressBC(cImage, *img);
+    hr = DecompressBC(cImage, *img, (flags & TEX_DECOMPRESS_PARALLEL) != 0);
     if (FAILED(hr))
         image.Release();
 
@@ -774,6 +2416,18 @@ HRESULT DirectX::Decompress(
     const TexMetadata& metadata,
     DXGI_FORMAT format,
     ScratchImage& images) noexcept
+{
+    return Decompress(cImages, nimages, metadata, format, TEX_DECOMPRESS_DEFAULT, images);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::Decompress(
+    const Image* cImages,
+    size_t nimages,
+    const TexMetadata& metadata,
+    DXGI_FORMAT format,
+    TEX_DECOMPRESS_FLAGS flags,
+    ScratchImage& images) noexcept
 {
     if (!cImages || !nimages)
         return E_INVALIDARG;
@@ -838,7 +2492,7 @@ HRESULT DirectX::Decompress(
             return E_FAIL;
         }
 
-        hr = DecompressBC(src, dest[index]);
+        hr = DecompressBC(src, dest[index], (flags & TEX_DECOMPRESS_PARALLEL) != 0);
         if (FAILED(hr))
         {
             images.Release();
@@ -4950,6 +4950,20 @@ HRESULT DirectX::Convert(
     TEX_FILTER_FLAGS filter,
     float threshold,
     ScratchImage& result) noexcept
+{
+    return Convert(srcImages, nimages, metadata, format, filter, threshold, nullptr, result);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::Convert(
+    const Image* srcImages,
+    size_t nimages,
+    const TexMetadata& metadata,
+    DXGI_FORMAT format,
+    TEX_FILTER_FLAGS filter,
+    float threshold,
+    const ProgressCallback& progress,
+    ScratchImage& result) noexcept
 {
     if (!srcImages || !nimages || (metadata.format == format) || !IsValid(format))
         return E_INVALIDARG;
@@ -4982,6 +4996,8 @@ HRESULT DirectX::Convert(
         return E_POINTER;
     }
 
+    ProgressTracker tracker(progress, nimages);
+
     WICPixelFormatGUID pfGUID, targetGUID;
     const bool usewic = !metadata.IsPMAlpha() && UseWICConversion(filter, metadata.format, format, pfGUID, targetGUID);
 
@@ -5027,6 +5043,12 @@ HRESULT DirectX::Convert(
                 result.Release();
                 return hr;
             }
+
+            if (!tracker.Step())
+            {
+                result.Release();
+                return E_ABORT;
+            }
         }
         break;
 
@@ -5080,6 +5102,12 @@ HRESULT DirectX::Convert(
                         result.Release();
                         return hr;
                     }
+
+                    if (!tracker.Step())
+                    {
+                        result.Release();
+                        return E_ABORT;
+                    }
                 }
 
                 if (d > 1)
@@ -707,7 +707,8 @@ namespace
         _In_ size_t levels,
         _In_ const WICPixelFormatGUID& pfGUID,
         _In_ const ScratchImage& mipChain,
-        _In_ size_t item) noexcept
+        _In_ size_t item,
+        _Inout_ ProgressTracker& progress) noexcept
     {
         assert(levels > 1);
 
@@ -839,6 +840,9 @@ namespace
                         return hr;
                 }
             }
+
+            if (!progress.Step())
+                return E_ABORT;
         }
 
         return S_OK;
@@ -905,7 +909,7 @@ namespace
     }
 
     //--- 2D Point Filter ---
-    HRESULT Generate2DMipsPointFilter(size_t levels, const ScratchImage& mipChain, size_t item) noexcept
+    HRESULT Generate2DMipsPointFilter(size_t levels, const ScratchImage& mipChain, size_t item, ProgressTracker& progress) noexcept
     {
         if (!mipChain.GetImages())
             return E_INVALIDARG;
@@ -982,6 +986,9 @@ namespace
 
             if (width > 1)
                 width >>= 1;
+
+            if (!progress.Step())
+                return E_ABORT;
         }
 
         return S_OK;
@@ -989,7 +996,12 @@ namespace
 
 
     //--- 2D Box Filter ---
-    HRESULT Generate2DMipsBoxFilter(size_t levels, TEX_FILTER_FLAGS filter, const ScratchImage& mipChain, size_t item) noexcept
+    HRESULT Generate2DMipsBoxFilter(
+        size_t levels,
+        TEX_FILTER_FLAGS filter,
+        const ScratchImage& mipChain,
+        size_t item,
+        ProgressTracker& progress) noexcept
     {
         using namespace DirectX::Filters;
 
@@ -1078,6 +1090,9 @@ namespace
 
             if (width > 1)
                 width >>= 1;
+
+            if (!progress.Step())
+                return E_ABORT;
         }
 
         return S_OK;
@@ -1085,7 +1100,12 @@ namespace
 
 
     //--- 2D Linear Filter ---
-    HRESULT Generate2DMipsLinearFilter(size_t levels, TEX_FILTER_FLAGS filter, const ScratchImage& mipChain, size_t item) noexcept
+    HRESULT Generate2DMipsLinearFilter(
+        size_t levels,
+        TEX_FILTER_FLAGS filter,
+        const ScratchImage& mipChain,
+        size_t item,
+        ProgressTracker& progress) noexcept
     {
         using namespace DirectX::Filters;
 
@@ -1192,6 +1212,9 @@ namespace
 
             if (width > 1)
                 width >>= 1;
+
+            if (!progress.Step())
+                return E_ABORT;
         }
 
         return S_OK;
@@ -1202,7 +1225,12 @@ namespace
 #pragma clang diagnostic ignored "-Wextra-semi-stmt"
 #endif
 
-    HRESULT Generate2DMipsCubicFilter(size_t levels, TEX_FILTER_FLAGS filter, const ScratchImage& mipChain, size_t item) noexcept
+    HRESULT Generate2DMipsCubicFilter(
+        size_t levels,
+        TEX_FILTER_FLAGS filter,
+        const ScratchImage& mipChain,
+        size_t item,
+        ProgressTracker& progress) noexcept
     {
         using namespace DirectX::Filters;
 
@@ -1383,6 +1411,9 @@ namespace
 
             if (width > 1)
                 width >>= 1;
+
+            if (!progress.Step())
+                return E_ABORT;
         }
 
         return S_OK;
@@ -1390,7 +1421,12 @@ namespace
 
 
     //--- 2D Triangle Filter ---
-    HRESULT Generate2DMipsTriangleFilter(size_t levels, TEX_FILTER_FLAGS filter, const ScratchImage& mipChain, size_t item) noexcept
+    HRESULT Generate2DMipsTriangleFilter(
+        size_t levels,
+        TEX_FILTER_FLAGS filter,
+        const ScratchImage& mipChain,
+        size_t item,
+        ProgressTracker& progress) noexcept
     {
         using namespace DirectX::Filters;
 
@@ -1597,6 +1633,9 @@ namespace
 
             if (width > 1)
                 width >>= 1;
+
+            if (!progress.Step())
+                return E_ABORT;
         }
 
         return S_OK;
@@ -2814,6 +2853,18 @@ HRESULT DirectX::GenerateMipMaps(
     size_t levels,
     ScratchImage& mipChain,
     bool allow1D) noexcept
+{
+    return GenerateMipMaps(baseImage, filter, levels, nullptr, mipChain, allow1D);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::GenerateMipMaps(
+    const Image& baseImage,
+    TEX_FILTER_FLAGS filter,
+    size_t levels,
+    const ProgressCallback& progress,
+    ScratchImage& mipChain,
+    bool allow1D) noexcept
 {
     if (!IsValid(baseImage.format))
         return E_INVALIDARG;
@@ -2834,6 +2885,8 @@ HRESULT DirectX::GenerateMipMaps(
 
     HRESULT hr = E_UNEXPECTED;
 
+    ProgressTracker tracker(progress, levels - 1);
+
     static_assert(TEX_FILTER_POINT == 0x100000, "TEX_FILTER_ flag values don't match TEX_FILTER_MODE_MASK");
 
 #ifdef _WIN32
@@ -2878,7 +2931,15 @@ HRESULT DirectX::GenerateMipMaps(
                     if (FAILED(hr))
                         return hr;
 
-                    return GenerateMipMapsUsingWIC(baseImage, filter, levels, pfGUID, mipChain, 0);
+                    hr = GenerateMipMapsUsingWIC(baseImage, filter, levels, pfGUID, mipChain, 0, tracker);
+                    if (FAILED(hr))
+                    {
+                        // Includes E_ABORT from the progress callback
+                        mipChain.Release();
+                        return hr;
+                    }
+
+                    return S_OK;
                 }
                 else
                 {
@@ -2900,7 +2961,7 @@ HRESULT DirectX::GenerateMipMaps(
                     if (FAILED(hr))
                         return hr;
 
-                    hr = GenerateMipMapsUsingWIC(*timg, filter, levels, GUID_WICPixelFormat128bppRGBAFloat, tMipChain, 0);
+                    hr = GenerateMipMapsUsingWIC(*timg, filter, levels, GUID_WICPixelFormat128bppRGBAFloat, tMipChain, 0, tracker);
                     if (FAILED(hr))
                         return hr;
 
@@ -2948,7 +3009,7 @@ HRESULT DirectX::GenerateMipMaps(
             if (FAILED(hr))
                 return hr;
 
-            hr = Generate2DMipsBoxFilter(levels, filter, mipChain, 0);
+            hr = Generate2DMipsBoxFilter(levels, filter, mipChain, 0, tracker);
             if (FAILED(hr))
                 mipChain.Release();
             return hr;
@@ -2958,7 +3019,7 @@ HRESULT DirectX::GenerateMipMaps(
             if (FAILED(hr))
                 return hr;
 
-            hr = Generate2DMipsPointFilter(levels, mipChain, 0);
+            hr = Generate2DMipsPointFilter(levels, mipChain, 0, tracker);
             if (FAILED(hr))
                 mipChain.Release();
             return hr;
@@ -2968,7 +3029,7 @@ HRESULT DirectX::GenerateMipMaps(
             if (FAILED(hr))
                 return hr;
 
-            hr = Generate2DMipsLinearFilter(levels, filter, mipChain, 0);
+            hr = Generate2DMipsLinearFilter(levels, filter, mipChain, 0, tracker);
             if (FAILED(hr))
                 mipChain.Release();
             return hr;
@@ -2978,7 +3039,7 @@ HRESULT DirectX::GenerateMipMaps(
             if (FAILED(hr))
                 return hr;
 
-            hr = Generate2DMipsCubicFilter(levels, filter, mipChain, 0);
+            hr = Generate2DMipsCubicFilter(levels, filter, mipChain, 0, tracker);
             if (FAILED(hr))
                 mipChain.Release();
             return hr;
@@ -2988,7 +3049,7 @@ HRESULT DirectX::GenerateMipMaps(
             if (FAILED(hr))
                 return hr;
 
-            hr = Generate2DMipsTriangleFilter(levels, filter, mipChain, 0);
+            hr = Generate2DMipsTriangleFilter(levels, filter, mipChain, 0, tracker);
             if (FAILED(hr))
                 mipChain.Release();
             return hr;
@@ -3007,6 +3068,19 @@ HRESULT DirectX::GenerateMipMaps(
     TEX_FILTER_FLAGS filter,
     size_t levels,
     ScratchImage& mipChain)
+{
+    return GenerateMipMaps(srcImages, nimages, metadata, filter, levels, nullptr, mipChain);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::GenerateMipMaps(
+    const Image* srcImages,
+    size_t nimages,
+    const TexMetadata& metadata,
+    TEX_FILTER_FLAGS filter,
+    size_t levels,
+    const ProgressCallback& progress,
+    ScratchImage& mipChain)
 {
     if (!srcImages || !nimages || !IsValid(metadata.format))
         return E_INVALIDARG;
@@ -3049,6 +3123,8 @@ HRESULT DirectX::GenerateMipMaps(
     if (baseImages.empty())
         return hr;
 
+    ProgressTracker tracker(progress, metadata.arraySize * (levels - 1));
+
     static_assert(TEX_FILTER_POINT == 0x100000, "TEX_FILTER_ flag values don't match TEX_FILTER_MODE_MASK");
 
 #ifdef _WIN32
@@ -3095,7 +3171,7 @@ HRESULT DirectX::GenerateMipMaps(
 
                     for (size_t item = 0; item < metadata.arraySize; ++item)
                     {
-                        hr = GenerateMipMapsUsingWIC(baseImages[item], filter, levels, pfGUID, mipChain, item);
+                        hr = GenerateMipMapsUsingWIC(baseImages[item], filter, levels, pfGUID, mipChain, item, tracker);
                         if (FAILED(hr))
                         {
                             mipChain.Release();
@@ -3129,7 +3205,7 @@ HRESULT DirectX::GenerateMipMaps(
                         if (!timg)
                             return E_POINTER;
 
-                        hr = GenerateMipMapsUsingWIC(*timg, filter, levels, GUID_WICPixelFormat128bppRGBAFloat, tMipChain, item);
+                        hr = GenerateMipMapsUsingWIC(*timg, filter, levels, GUID_WICPixelFormat128bppRGBAFloat, tMipChain, item, tracker);
                         if (FAILED(hr))
                             return hr;
                     }
@@ -3165,9 +3241,12 @@ HRESULT DirectX::GenerateMipMaps(
 
             for (size_t item = 0; item < metadata.arraySize; ++item)
             {
-                hr = Generate2DMipsBoxFilter(levels, filter, mipChain, item);
+                hr = Generate2DMipsBoxFilter(levels, filter, mipChain, item, tracker);
                 if (FAILED(hr))
+                {
                     mipChain.Release();
+                    break;
+                }
             }
             return hr;
 
@@ -3178,9 +3257,12 @@ HRESULT DirectX::GenerateMipMaps(
 
             for (size_t item = 0; item < metadata.arraySize; ++item)
             {
-                hr = Generate2DMipsPointFilter(levels, mipChain, item);
+                hr = Generate2DMipsPointFilter(levels, mipChain, item, tracker);
                 if (FAILED(hr))
+                {
                     mipChain.Release();
+                    break;
+                }
             }
             return hr;
 
@@ -3191,9 +3273,12 @@ HRESULT DirectX::GenerateMipMaps(
 
             for (size_t item = 0; item < metadata.arraySize; ++item)
             {
-                hr = Generate2DMipsLinearFilter(levels, filter, mipChain, item);
+                hr = Generate2DMipsLinearFilter(levels, filter, mipChain, item, tracker);
                 if (FAILED(hr))
+                {
                     mipChain.Release();
+                    break;
+                }
             }
             return hr;
 
@@ -3204,9 +3289,12 @@ HRESULT DirectX::GenerateMipMaps(
 
             for (size_t item = 0; item < metadata.arraySize; ++item)
             {
-                hr = Generate2DMipsCubicFilter(levels, filter, mipChain, item);
+                hr = Generate2DMipsCubicFilter(levels, filter, mipChain, item, tracker);
                 if (FAILED(hr))
+                {
                     mipChain.Release();
+                    break;
+                }
             }
             return hr;
 
@@ -3217,9 +3305,12 @@ HRESULT DirectX::GenerateMipMaps(
 
             for (size_t item = 0; item < metadata.arraySize; ++item)
             {
-                hr = Generate2DMipsTriangleFilter(levels, filter, mipChain, item);
+                hr = Generate2DMipsTriangleFilter(levels, filter, mipChain, item, tracker);
                 if (FAILED(hr))
+                {
                     mipChain.Release();
+                    break;
+                }
             }
             return hr;
 
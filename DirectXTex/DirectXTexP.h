@@ -130,19 +130,23 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <ctime>
 #include <cstring>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <new>
+#include <thread>
 #include <tuple>
 
 #ifndef _WIN32
 #include <fstream>
 #include <filesystem>
-#include <thread>
 #endif
 
 #define _XM_NO_XMVECTOR_OVERLOADS_
@@ -214,6 +218,10 @@ using WICPixelFormatGUID = GUID;
 #define E_NOT_SUFFICIENT_BUFFER static_cast<HRESULT>(0x8007007AL)
 #endif
 
+#ifndef E_ABORT
+#define E_ABORT static_cast<HRESULT>(0x80004004L)
+#endif
+
 //-------------------------------------------------------------------------------------
 namespace DirectX
 {
@@ -421,6 +429,39 @@ namespace DirectX
             _Inout_updates_all_(count) XMVECTOR* pBuffer, _In_ size_t count,
             _In_ DXGI_FORMAT outFormat, _In_ DXGI_FORMAT inFormat, _In_ TEX_FILTER_FLAGS flags) noexcept;
 
+        //---------------------------------------------------------------------------------
+        // Parallel execution on the application executor or the built-in thread pool
+        void __cdecl ParallelFor(_In_ size_t count, _In_ const std::function<void __cdecl(size_t index)>& task) noexcept;
+
+        //---------------------------------------------------------------------------------
+        // Progress reporting and cancellation for a ProgressCallback; a no-op without one
+        class ProgressTracker
+        {
+        public:
+            ProgressTracker(const ProgressCallback& callback, size_t total) noexcept :
+                m_callback(callback), m_total(total), m_completed(0), m_cancelled(false) {}
+
+            ProgressTracker(const ProgressTracker&) = delete;
+            ProgressTracker& operator=(const ProgressTracker&) = delete;
+
+            // Returns false once the callback has asked to cancel
+            bool Step(size_t count = 1) noexcept
+            {
+                return !m_callback || Report(count);
+            }
+
+            bool IsCancelled() const noexcept { return m_cancelled.load(std::memory_order_relaxed); }
+
+        private:
+            bool __cdecl Report(size_t count) noexcept;
+
+            const ProgressCallback& m_callback;
+            size_t                  m_total;
+            size_t                  m_completed;
+            std::atomic<bool>       m_cancelled;
+            std::mutex              m_mutex;
+        };
+
         //---------------------------------------------------------------------------------
         // Misc helper functions
         bool __cdecl IsAlphaAllOpaqueBC(_In_ const Image& cImage) noexcept;
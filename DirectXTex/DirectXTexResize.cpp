@@ -948,6 +948,20 @@ HRESULT DirectX::Resize(
     size_t height,
     TEX_FILTER_FLAGS filter,
     ScratchImage& result) noexcept
+{
+    return Resize(srcImages, nimages, metadata, width, height, filter, nullptr, result);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::Resize(
+    const Image* srcImages,
+    size_t nimages,
+    const TexMetadata& metadata,
+    size_t width,
+    size_t height,
+    TEX_FILTER_FLAGS filter,
+    const ProgressCallback& progress,
+    ScratchImage& result) noexcept
 {
     if (!srcImages || !nimages || width == 0 || height == 0)
         return E_INVALIDARG;
@@ -963,6 +977,8 @@ HRESULT DirectX::Resize(
     if (FAILED(hr))
         return hr;
 
+    ProgressTracker tracker(progress, metadata.arraySize * metadata.depth);
+
 #ifdef _WIN32
     bool usewic = !metadata.IsPMAlpha() && UseWICFiltering(metadata.format, filter);
 
@@ -1045,6 +1061,12 @@ HRESULT DirectX::Resize(
                 result.Release();
                 return hr;
             }
+
+            if (!tracker.Step())
+            {
+                result.Release();
+                return E_ABORT;
+            }
         }
         break;
 
@@ -1106,6 +1128,12 @@ HRESULT DirectX::Resize(
                 result.Release();
                 return hr;
             }
+
+            if (!tracker.Step())
+            {
+                result.Release();
+                return E_ABORT;
+            }
         }
         break;
 
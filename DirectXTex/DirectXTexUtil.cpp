@@ -338,6 +338,369 @@ void DirectX::SetWICFactory(_In_opt_ IWICImagingFactory* pWIC) noexcept
 #endif // WIN32
 
 
+//=====================================================================================
+// Parallel execution
+//=====================================================================================
+
+namespace
+{
+    //-------------------------------------------------------------------------------------
+    // Work-stealing thread pool: each participant starts on its own contiguous share of
+    // the indices, and once that runs out takes the back half of the largest share left
+    //-------------------------------------------------------------------------------------
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t threads) noexcept(false) :
+            m_count(threads),
+            m_queues(new WorkQueue[threads]),
+            m_task(nullptr),
+            m_generation(0),
+            m_active(0),
+            m_stop(false)
+        {
+            assert(threads > 1);
+
+            try
+            {
+                m_threads.reserve(threads - 1);
+                for (size_t id = 1; id < threads; ++id)
+                {
+                    m_threads.emplace_back(&ThreadPool::WorkerMain, this, id);
+                }
+            }
+            catch (...)
+            {
+                Stop();
+                throw;
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        ~ThreadPool()
+        {
+            Stop();
+        }
+
+        size_t GetThreadCount() const noexcept { return m_count; }
+
+        // Runs task(0) ... task(count - 1) on the pool and the calling thread
+        void Run(size_t count, const std::function<void __cdecl(size_t)>& task) noexcept
+        {
+            std::unique_lock<std::mutex> job(m_jobMutex, std::try_to_lock);
+            if (!job.owns_lock())
+            {
+                // The pool is busy with another caller's job
+                RunSerial(count, task);
+                return;
+            }
+
+            for (size_t i = 0; i < m_count; ++i)
+            {
+                std::lock_guard<std::mutex> lock(m_queues[i].mutex);
+                m_queues[i].begin = size_t((uint64_t(count) * i) / m_count);
+                m_queues[i].end = size_t((uint64_t(count) * (i + 1)) / m_count);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_task = &task;
+                m_active = m_threads.size();
+                ++m_generation;
+            }
+            m_wake.notify_all();
+
+            s_inPool = true;
+            Work(0);
+            s_inPool = false;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_done.wait(lock, [this] { return m_active == 0; });
+            m_task = nullptr;
+        }
+
+        static void RunSerial(size_t count, const std::function<void __cdecl(size_t)>& task) noexcept
+        {
+            for (size_t index = 0; index < count; ++index)
+            {
+                task(index);
+            }
+        }
+
+        // True on pool threads and on a caller while it runs a job, where nested work runs serially
+        static thread_local bool s_inPool;
+
+    private:
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        size_t                              m_count;
+        std::unique_ptr<WorkQueue[]>        m_queues;
+        std::vector<std::thread>            m_threads;
+        std::mutex                          m_jobMutex;
+        std::mutex                          m_mutex;
+        std::condition_variable             m_wake;
+        std::condition_variable             m_done;
+        const std::function<void __cdecl(size_t)>* m_task;
+        uint64_t                            m_generation;
+        size_t                              m_active;
+        bool                                m_stop;
+
+        void Stop() noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+
+            for (auto& t : m_threads)
+            {
+                t.join();
+            }
+            m_threads.clear();
+        }
+
+        void WorkerMain(size_t id) noexcept
+        {
+            s_inPool = true;
+
+            uint64_t seen = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+                    if (m_stop)
+                        return;
+                    seen = m_generation;
+                }
+
+                Work(id);
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (--m_active == 0)
+                    m_done.notify_all();
+            }
+        }
+
+        void Work(size_t id) noexcept
+        {
+            size_t index;
+            while (Take(id, index))
+            {
+                (*m_task)(index);
+            }
+        }
+
+        bool Take(size_t id, size_t& index) noexcept
+        {
+            WorkQueue& own = m_queues[id];
+            {
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (own.begin < own.end)
+                {
+                    index = own.begin++;
+                    return true;
+                }
+            }
+
+            for (;;)
+            {
+                size_t victim = id;
+                size_t most = 0;
+                for (size_t i = 0; i < m_count; ++i)
+                {
+                    if (i == id)
+                        continue;
+
+                    std::lock_guard<std::mutex> lock(m_queues[i].mutex);
+                    const size_t left = m_queues[i].end - m_queues[i].begin;
+                    if (left > most)
+                    {
+                        most = left;
+                        victim = i;
+                    }
+                }
+
+                if (!most)
+                    return false;
+
+                size_t first, last;
+                {
+                    std::lock_guard<std::mutex> lock(m_queues[victim].mutex);
+                    const size_t left = m_queues[victim].end - m_queues[victim].begin;
+                    if (!left)
+                        continue;
+
+                    last = m_queues[victim].end;
+                    first = last - (left + 1) / 2;
+                    m_queues[victim].end = first;
+                }
+
+                // Keep the first stolen index and queue the rest as our own share
+                std::lock_guard<std::mutex> lock(own.mutex);
+                own.begin = first + 1;
+                own.end = last;
+                index = first;
+                return true;
+            }
+        }
+    };
+
+    thread_local bool ThreadPool::s_inPool = false;
+
+    std::mutex g_ParallelMutex;
+
+    // Never destroyed: joining the workers from a static destructor runs under the loader lock
+    // in a DLL and can deadlock, so a pool still alive at exit is left to process termination.
+    // ShutdownParallelThreads joins them explicitly.
+    std::shared_ptr<ThreadPool>& g_ThreadPool = *new std::shared_ptr<ThreadPool>();
+    size_t g_ParallelThreads = 0;
+    ParallelExecutor g_ParallelExecutor;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Sets the number of threads (including the caller) the built-in pool uses; 0 selects
+// the hardware concurrency. The pool is recreated on its next use.
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::SetParallelThreadCount(size_t threads) noexcept
+{
+    if (threads > 256)
+        return E_INVALIDARG;
+
+    std::shared_ptr<ThreadPool> old;
+    {
+        std::lock_guard<std::mutex> lock(g_ParallelMutex);
+        g_ParallelThreads = threads;
+        std::swap(old, g_ThreadPool);
+    }
+
+    // Jobs still running keep their pool alive until they finish
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Optional application executor used instead of the built-in pool
+//-------------------------------------------------------------------------------------
+void DirectX::SetParallelExecutor(ParallelExecutor executor) noexcept
+{
+    std::shared_ptr<ThreadPool> old;
+    {
+        std::lock_guard<std::mutex> lock(g_ParallelMutex);
+        std::swap(g_ParallelExecutor, executor);
+        if (g_ParallelExecutor)
+            std::swap(old, g_ThreadPool);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// Releases the built-in pool, joining its threads once no job still uses it. A later
+// parallel call creates a new pool.
+//-------------------------------------------------------------------------------------
+void DirectX::ShutdownParallelThreads() noexcept
+{
+    std::shared_ptr<ThreadPool> old;
+    {
+        std::lock_guard<std::mutex> lock(g_ParallelMutex);
+        std::swap(old, g_ThreadPool);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// Runs task(0) ... task(count - 1) concurrently on the application executor or the
+// built-in pool, falling back to the calling thread if neither is available
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::Internal::ParallelFor(size_t count, const std::function<void __cdecl(size_t)>& task) noexcept
+{
+    if (count < 2 || ThreadPool::s_inPool)
+    {
+        ThreadPool::RunSerial(count, task);
+        return;
+    }
+
+    ParallelExecutor executor;
+    std::shared_ptr<ThreadPool> pool;
+    try
+    {
+        std::lock_guard<std::mutex> lock(g_ParallelMutex);
+        if (g_ParallelExecutor)
+        {
+            executor = g_ParallelExecutor;
+        }
+        else
+        {
+            if (!g_ThreadPool)
+            {
+                const size_t threads = (g_ParallelThreads > 0) ? g_ParallelThreads : size_t(std::thread::hardware_concurrency());
+                if (threads > 1)
+                {
+                    g_ThreadPool = std::make_shared<ThreadPool>(threads);
+                }
+            }
+            pool = g_ThreadPool;
+        }
+    }
+    catch (...)
+    {
+        // Out of memory or threads, so do the work here
+    }
+
+    if (executor)
+    {
+        executor(count, task);
+    }
+    else if (pool)
+    {
+        pool->Run(count, task);
+    }
+    else
+    {
+        ThreadPool::RunSerial(count, task);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------
+// Counts completed work and gives the callback a chance to cancel
+//-------------------------------------------------------------------------------------
+bool DirectX::Internal::ProgressTracker::Report(size_t count) noexcept
+{
+    if (m_cancelled.load(std::memory_order_relaxed))
+        return false;
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_completed = std::min(m_completed + count, m_total);
+        if (!m_callback(m_completed, m_total))
+        {
+            m_cancelled = true;
+        }
+    }
+    catch (...)
+    {
+        // A throwing callback cancels the operation
+        m_cancelled = true;
+    }
+
+    return !m_cancelled.load(std::memory_order_relaxed);
+}
+
+
 //=====================================================================================
 // DXGI Format Utilities
 //=====================================================================================
@@ -53,6 +53,8 @@
 
 #include "DirectXPackedVector.h"
 
+#include "ResultCache.h"
+
 //Uncomment to add support for OpenEXR (.exr)
 //#define USE_OPENEXR
 
@@ -126,6 +128,10 @@ namespace
         OPT_PAPER_WHITE_NITS,
         OPT_BCNONMULT4FIX,
         OPT_SWIZZLE,
+        OPT_CACHE,
+        OPT_INCREMENTAL,
+        OPT_RDO,
+        OPT_RDO_MAX_MSE,
         OPT_MAX
     };
 
@@ -215,6 +221,10 @@ namespace
         { L"nits",          OPT_PAPER_WHITE_NITS },
         { L"fixbc4x4",      OPT_BCNONMULT4FIX },
         { L"swizzle",       OPT_SWIZZLE },
+        { L"cache",         OPT_CACHE },
+        { L"incremental",   OPT_INCREMENTAL },
+        { L"rdo",           OPT_RDO },
+        { L"rdomse",        OPT_RDO_MAX_MSE },
         { nullptr,          0 }
     };
 
@@ -941,17 +951,15 @@ namespace
             L"   -wicmulti           When writing images with WIC encode multiframe images\n"
             L"\n"
             L"   -nologo             suppress copyright message\n"
-            L"   -timing             Display elapsed processing time\n"
+            L"   -timing             Display elapsed processing time and BC6H/BC7 encoder statistics\n"
             L"\n"
-#ifdef _OPENMP
             L"   -singleproc         Do not use multi-threaded compression\n"
-#endif
             L"   -gpu <adapter>      Select GPU for DirectCompute-based codecs (0 is default)\n"
             L"   -nogpu              Do not use DirectCompute-based codecs\n"
             L"\n"
             L"   -bc <options>       Sets options for BC compression\n"
             L"                       options must be one or more of\n"
-            L"                          d, u, q, x\n"
+            L"                          d, u, q, x, m, f, r, 0-4 (BC7 level, fastest to default)\n"
             L"   -aw <weight>        BC7 GPU compressor weighting for alpha error metric\n"
             L"                       (defaults to 1.0)\n"
             L"\n"
@@ -962,7 +970,21 @@ namespace
             L"   -x2bias             Enable *2 - 1 conversion cases for unorm/pos-only-float\n"
             L"   -inverty            Invert Y (i.e. green) channel values\n"
             L"   -reconstructz       Rebuild Z (blue) channel assuming X/Y are normals\n"
-            L"   -swizzle <rgba>     Swizzle image channels using HLSL-style mask\n";
+            L"   -swizzle <rgba>     Swizzle image channels using HLSL-style mask\n"
+            L"\n"
+            L"   -cache <file>       Skip files whose source and options match a previous run\n"
+            L"                       and whose output is unchanged, using the index <file>\n"
+            L"                       (ignored with -incremental)\n"
+            L"   -incremental <dds>  Re-encode only the blocks whose source changed since <dds>\n"
+            L"                       was written with -incremental, copying the rest from it\n"
+            L"                       (one input file only; <dds> must have the same format and\n"
+            L"                       -bc, -srgb, -at and -rdo settings, or every block is encoded)\n"
+            L"                       (the source and settings are kept beside the output as\n"
+            L"                       <name>.src.dds and <name>.src.txt)\n"
+            L"\n"
+            L"   -rdo <lambda>       Rate-distortion BC encoding for smaller LZ-compressed files\n"
+            L"                       (larger lambda trades more quality for size, def: 1.0)\n"
+            L"   -rdomse <value>     Error each block may gain with -rdo, as MSE (def: 0.0002)\n";
 
         wprintf(L"%ls", s_usage);
 
@@ -1002,6 +1024,114 @@ namespace
         }
     }
 
+    // Source kept beside an incremental output, e.g. foo.src.dds for foo.dds
+    void GetIncrementalSourceName(const wchar_t* szDDS, wchar_t(&szSource)[1024])
+    {
+        wchar_t drive[_MAX_DRIVE] = {};
+        wchar_t dir[_MAX_DIR] = {};
+        wchar_t fname[_MAX_FNAME] = {};
+        _wsplitpath_s(szDDS, drive, _MAX_DRIVE, dir, _MAX_DIR, fname, _MAX_FNAME, nullptr, 0);
+
+        wcscat_s(fname, L".src");
+        _wmakepath_s(szSource, drive, dir, fname, L".dds");
+    }
+
+    // Hash of the encoder settings kept beside an incremental output, e.g. foo.src.txt for foo.dds
+    void GetIncrementalSettingsName(const wchar_t* szDDS, wchar_t(&szSettings)[1024])
+    {
+        wchar_t drive[_MAX_DRIVE] = {};
+        wchar_t dir[_MAX_DIR] = {};
+        wchar_t fname[_MAX_FNAME] = {};
+        _wsplitpath_s(szDDS, drive, _MAX_DRIVE, dir, _MAX_DIR, fname, _MAX_FNAME, nullptr, 0);
+
+        wcscat_s(fname, L".src");
+        _wmakepath_s(szSettings, drive, dir, fname, L".txt");
+    }
+
+    // Returns 0 when the settings are missing or unreadable
+    uint64_t ReadIncrementalSettings(const wchar_t* szDDS)
+    {
+        wchar_t szSettings[1024] = {};
+        GetIncrementalSettingsName(szDDS, szSettings);
+
+        std::wifstream inFile(szSettings);
+        uint64_t settings = 0;
+        if (!(inFile >> std::hex >> settings))
+            return 0;
+
+        return settings;
+    }
+
+    bool WriteIncrementalSettings(const wchar_t* szDDS, uint64_t settings)
+    {
+        wchar_t szSettings[1024] = {};
+        GetIncrementalSettingsName(szDDS, szSettings);
+
+        std::wofstream outFile(szSettings);
+        outFile << std::hex << settings << L'\n';
+        outFile.close();
+        return !outFile.fail();
+    }
+
+    void AddEncoderStatistics(BCEncoderStatistics& total, const BCEncoderStatistics& stats)
+    {
+        total.blocks += stats.blocks;
+        for (size_t mode = 0; mode < std::size(total.modes); ++mode)
+        {
+            total.modes[mode] += stats.modes[mode];
+            for (size_t partition = 0; partition < std::size(total.partitions[mode]); ++partition)
+            {
+                total.partitions[mode][partition] += stats.partitions[mode][partition];
+            }
+        }
+        total.solidBlocks += stats.solidBlocks;
+        total.opaqueBlocks += stats.opaqueBlocks;
+        total.roughMSECalls += stats.roughMSECalls;
+        total.refineCalls += stats.refineCalls;
+        total.roughTime += stats.roughTime;
+        total.refineTime += stats.refineTime;
+        total.totalTime += stats.totalTime;
+    }
+
+    // BC6H modes are printed 1-14 as in the format specification. The statistics only cover
+    // searched blocks, so the blocks reused from the cache or a previous image are shown beside them.
+    void PrintEncoderStatistics(const wchar_t* name, const BCEncoderStatistics& stats, size_t reused, size_t firstMode)
+    {
+        if (!stats.blocks && !reused)
+            return;
+
+        wprintf(L"\n %ls encoder: %zu blocks searched (%zu reused), %zu solid, %zu opaque\n",
+            name, stats.blocks, reused, stats.solidBlocks, stats.opaqueBlocks);
+
+        if (!stats.blocks)
+            return;
+
+        for (size_t mode = 0; mode < std::size(stats.modes); ++mode)
+        {
+            if (!stats.modes[mode])
+                continue;
+
+            size_t used = 0;
+            size_t common = 0;
+            for (size_t partition = 0; partition < std::size(stats.partitions[mode]); ++partition)
+            {
+                if (stats.partitions[mode][partition])
+                    ++used;
+                if (stats.partitions[mode][partition] > stats.partitions[mode][common])
+                    common = partition;
+            }
+
+            wprintf(L"   Mode %2zu - %zu blocks (%.1f%%), %zu partitions used, most often #%zu\n",
+                mode + firstMode, stats.modes[mode], 100.0 * double(stats.modes[mode]) / double(stats.blocks), used, common);
+        }
+
+        wprintf(L"   RoughMSE - %zu calls (%.1f per block), %.3f seconds\n",
+            stats.roughMSECalls, double(stats.roughMSECalls) / double(stats.blocks), double(stats.roughTime) * 1e-9);
+        wprintf(L"   Refine   - %zu calls (%.1f per block), %.3f seconds\n",
+            stats.refineCalls, double(stats.refineCalls) / double(stats.blocks), double(stats.refineTime) * 1e-9);
+        wprintf(L"   Total    - %.3f seconds of encoder time over all threads\n", double(stats.totalTime) * 1e-9);
+    }
+
     const wchar_t* GetErrorDesc(HRESULT hr)
     {
         static wchar_t desc[1024] = {};
@@ -1384,6 +1514,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     int adapter = -1;
     float alphaThreshold = TEX_THRESHOLD_DEFAULT;
     float alphaWeight = 1.f;
+    float rdoLambda = TEX_RDO_LAMBDA_DEFAULT;
+    float rdoMaxMSE = TEX_RDO_MAX_MSE_DEFAULT;
     CNMAP_FLAGS dwNormalMap = CNMAP_DEFAULT;
     float nmapAmplitude = 1.f;
     float wicQuality = -1.f;
@@ -1399,6 +1531,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     wchar_t szPrefix[MAX_PATH] = {};
     wchar_t szSuffix[MAX_PATH] = {};
     wchar_t szOutputDir[MAX_PATH] = {};
+    wchar_t szCacheFile[MAX_PATH] = {};
+    wchar_t szIncremental[MAX_PATH] = {};
 
     // Set locale for output since GetErrorDesc can get localized strings.
     std::locale::global(std::locale(""));
@@ -1465,6 +1599,10 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             case OPT_PAPER_WHITE_NITS:
             case OPT_PRESERVE_ALPHA_COVERAGE:
             case OPT_SWIZZLE:
+            case OPT_CACHE:
+            case OPT_INCREMENTAL:
+            case OPT_RDO:
+            case OPT_RDO_MAX_MSE:
                 // These support either "-arg:value" or "-arg value"
                 if (!*pValue)
                 {
@@ -1581,6 +1719,14 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 wcscpy_s(szOutputDir, MAX_PATH, pValue);
                 break;
 
+            case OPT_CACHE:
+                wcscpy_s(szCacheFile, MAX_PATH, pValue);
+                break;
+
+            case OPT_INCREMENTAL:
+                wcscpy_s(szIncremental, MAX_PATH, pValue);
+                break;
+
             case OPT_FILETYPE:
                 FileType = LookupByName(pValue, g_pSaveFileTypes);
                 if (!FileType)
@@ -1750,6 +1896,38 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }
                 break;
 
+            case OPT_RDO:
+                if (swscanf_s(pValue, L"%f", &rdoLambda) != 1)
+                {
+                    wprintf(L"Invalid value specified with -rdo (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                else if (rdoLambda < 0.f)
+                {
+                    wprintf(L"-rdo (%ls) parameter must be positive\n", pValue);
+                    wprintf(L"\n");
+                    return 1;
+                }
+                break;
+
+            case OPT_RDO_MAX_MSE:
+                if (swscanf_s(pValue, L"%f", &rdoMaxMSE) != 1)
+                {
+                    wprintf(L"Invalid value specified with -rdomse (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                else if (rdoMaxMSE < 0.f)
+                {
+                    wprintf(L"-rdomse (%ls) parameter must be positive\n", pValue);
+                    wprintf(L"\n");
+                    return 1;
+                }
+                break;
+
             case OPT_ALPHA_WEIGHT:
                 if (swscanf_s(pValue, L"%f", &alphaWeight) != 1)
                 {
@@ -1795,6 +1973,31 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                         found = true;
                     }
 
+                    if (wcschr(pValue, L'm'))
+                    {
+                        dwCompress |= TEX_COMPRESS_MULTIBLOCK;
+                        found = true;
+                    }
+
+                    if (wcschr(pValue, L'f'))
+                    {
+                        dwCompress |= TEX_COMPRESS_BC6H_FAST;
+                        found = true;
+                    }
+
+                    if (wcschr(pValue, L'r'))
+                    {
+                        dwCompress |= TEX_COMPRESS_MEMOIZE;
+                        found = true;
+                    }
+
+                    const wchar_t* level = wcspbrk(pValue, L"01234");
+                    if (level)
+                    {
+                        dwCompress |= static_cast<TEX_COMPRESS_FLAGS>(TEX_COMPRESS_BC7_LEVEL_0 * static_cast<uint32_t>(*level - L'0' + 1));
+                        found = true;
+                    }
+
                     if ((dwCompress & (TEX_COMPRESS_BC7_QUICK | TEX_COMPRESS_BC7_USE_3SUBSETS)) == (TEX_COMPRESS_BC7_QUICK | TEX_COMPRESS_BC7_USE_3SUBSETS))
                     {
                         wprintf(L"Can't use -bc x (max) and -bc q (quick) at same time\n\n");
@@ -1802,9 +2005,16 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                         return 1;
                     }
 
+                    if ((dwCompress & TEX_COMPRESS_BC7_QUICK) && (dwCompress & TEX_COMPRESS_BC7_LEVEL_MASK))
+                    {
+                        wprintf(L"Can't use a BC7 level (0-4) and -bc q (quick) at same time\n\n");
+                        PrintUsage();
+                        return 1;
+                    }
+
                     if (!found)
                     {
-                        wprintf(L"Invalid value specified for -bc (%ls), missing d, u, q, or x\n\n", pValue);
+                        wprintf(L"Invalid value specified for -bc (%ls), missing d, u, q, x, m, f, r, or a level 0-4\n\n", pValue);
                         return 1;
                     }
                 }
@@ -1955,6 +2165,13 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         return 0;
     }
 
+    // The previous output named by -incremental can only be the reference for one input
+    if (*szIncremental && conversion.size() > 1)
+    {
+        wprintf(L"-incremental can't be used with more than one input file\n");
+        return 1;
+    }
+
     if (~dwOptions & (uint64_t(1) << OPT_NOLOGO))
         PrintLogo();
 
@@ -1977,14 +2194,135 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     if (FileType != CODEC_DDS)
     {
         mipLevels = 1;
+
+        if (*szIncremental)
+        {
+            wprintf(L"-incremental requires DDS output\n");
+            return 1;
+        }
     }
 
+    // Encoder settings the previous output must have been written with for its blocks to be reused;
+    // the format and layout are checked against the file itself
+    uint64_t incrementalSettings = 0;
+    if (*szIncremental)
+    {
+        ContentHasher hasher;
+        hasher.UpdateValue(dwCompress);
+        hasher.UpdateValue(dwSRGB);
+        hasher.UpdateValue(alphaThreshold);
+        hasher.UpdateValue((dwOptions & (uint64_t(1) << OPT_RDO)) != 0);
+        hasher.UpdateValue(rdoLambda);
+        hasher.UpdateValue(rdoMaxMSE);
+        incrementalSettings = hasher.Finalize();
+    }
+
+    // Result cache
+    ResultCache cache;
+    bool useCache = false;
+    uint64_t optionsHash = 0;
+    if (*szCacheFile && *szIncremental)
+    {
+        // The output also depends on the previous output files, which the options hash can't cover
+        wprintf(L"WARNING: Ignoring cache %ls with -incremental\n", szCacheFile);
+    }
+    else if (*szCacheFile)
+    {
+        hr = cache.Open(szCacheFile);
+        if (FAILED(hr))
+        {
+            wprintf(L"WARNING: Ignoring cache %ls (%08X%ls)\n", szCacheFile, static_cast<unsigned int>(hr), GetErrorDesc(hr));
+        }
+        else
+        {
+            useCache = true;
+
+            // Everything that changes the output, except the source file itself
+            ContentHasher hasher;
+            hasher.UpdateValue(width);
+            hasher.UpdateValue(height);
+            hasher.UpdateValue(mipLevels);
+            hasher.UpdateValue(format);
+            hasher.UpdateValue(dwFilter);
+            hasher.UpdateValue(dwSRGB);
+            hasher.UpdateValue(dwConvert);
+            hasher.UpdateValue(dwCompress);
+            hasher.UpdateValue(dwFilterOpts);
+            hasher.UpdateValue(FileType);
+            hasher.UpdateValue(maxSize);
+            hasher.UpdateValue(alphaThreshold);
+            hasher.UpdateValue(alphaWeight);
+            hasher.UpdateValue(rdoLambda);
+            hasher.UpdateValue(rdoMaxMSE);
+            hasher.UpdateValue(dwNormalMap);
+            hasher.UpdateValue(nmapAmplitude);
+            hasher.UpdateValue(wicQuality);
+            hasher.UpdateValue(colorKey);
+            hasher.UpdateValue(dwRotateColor);
+            hasher.UpdateValue(paperWhiteNits);
+            hasher.UpdateValue(preserveAlphaCoverageRef);
+            hasher.UpdateValue(keepRecursiveDirs);
+            hasher.UpdateValue(swizzleElements);
+            hasher.UpdateValue(zeroElements);
+            hasher.UpdateValue(oneElements);
+            hasher.Update(szPrefix, wcslen(szPrefix) * sizeof(wchar_t));
+            hasher.Update(szSuffix, wcslen(szSuffix) * sizeof(wchar_t));
+            hasher.Update(szOutputDir, wcslen(szOutputDir) * sizeof(wchar_t));
+
+            constexpr uint64_t ignored = (uint64_t(1) << OPT_NOLOGO) | (uint64_t(1) << OPT_TIMING)
+                | (uint64_t(1) << OPT_OVERWRITE) | (uint64_t(1) << OPT_CACHE);
+            hasher.UpdateValue(dwOptions & ~ignored);
+
+            optionsHash = hasher.Finalize();
+        }
+    }
+
+    // Figure out dest filename
+    auto getDestName = [&](const SConversion& conv, wchar_t (&szDest)[1024])
+    {
+        wchar_t *pchSlash, *pchDot;
+
+        wcscpy_s(szDest, szOutputDir);
+
+        if (keepRecursiveDirs && *conv.szFolder)
+            wcscat_s(szDest, conv.szFolder);
+
+        if (*szPrefix)
+            wcscat_s(szDest, szPrefix);
+
+        pchSlash = wcsrchr(conv.szSrc, L'\\');
+        if (pchSlash)
+            wcscat_s(szDest, pchSlash + 1);
+        else
+            wcscat_s(szDest, conv.szSrc);
+
+        pchSlash = wcsrchr(szDest, '\\');
+        pchDot = wcsrchr(szDest, '.');
+
+        if (pchDot > pchSlash)
+            *pchDot = 0;
+
+        if (*szSuffix)
+            wcscat_s(szDest, szSuffix);
+
+        if (dwOptions & (uint64_t(1) << OPT_TOLOWER))
+        {
+            std::ignore = _wcslwr_s(szDest);
+        }
+    };
+
     LARGE_INTEGER qpcFreq = {};
     std::ignore = QueryPerformanceFrequency(&qpcFreq);
 
     LARGE_INTEGER qpcStart = {};
     std::ignore = QueryPerformanceCounter(&qpcStart);
 
+    // BC6H/BC7 encoder statistics reported by -timing
+    auto encoderBC6H = std::make_unique<BCEncoderStatistics>();
+    auto encoderBC7 = std::make_unique<BCEncoderStatistics>();
+    size_t reusedBC6H = 0;
+    size_t reusedBC7 = 0;
+
     // Convert images
     bool sizewarn = false;
     bool nonpow2warn = false;
@@ -2003,6 +2341,36 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         wprintf(L"reading %ls", pConv->szSrc);
         fflush(stdout);
 
+        CacheEntry cacheEntry = {};
+        bool cacheable = false;
+        if (useCache)
+        {
+            // The output name depends on the source path, so it is part of the key
+            ContentHasher hasher(optionsHash);
+            hasher.Update(pConv->szSrc, wcslen(pConv->szSrc) * sizeof(wchar_t));
+            hasher.Update(pConv->szFolder, wcslen(pConv->szFolder) * sizeof(wchar_t));
+            cacheEntry.optionsHash = hasher.Finalize();
+
+            if (SUCCEEDED(HashFileContents(pConv->szSrc, cacheEntry.contentHash, cacheEntry.sourceSize)))
+            {
+                cacheable = true;
+
+                wchar_t szDest[1024] = {};
+                getDestName(*pConv, szDest);
+
+                CacheEntry cached;
+                WIN32_FILE_ATTRIBUTE_DATA destData = {};
+                if (cache.Find(cacheEntry.contentHash, cacheEntry.optionsHash, cacheEntry.sourceSize, cached)
+                    && GetFileAttributesExW(szDest, GetFileExInfoStandard, &destData)
+                    && cached.value[0] == ((uint64_t(destData.nFileSizeHigh) << 32) | destData.nFileSizeLow)
+                    && cached.value[1] == ((uint64_t(destData.ftLastWriteTime.dwHighDateTime) << 32) | destData.ftLastWriteTime.dwLowDateTime))
+                {
+                    wprintf(L" unchanged, %ls is up to date\n", szDest);
+                    continue;
+                }
+            }
+        }
+
         wchar_t ext[_MAX_EXT] = {};
         wchar_t fname[_MAX_FNAME] = {};
         _wsplitpath_s(pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
@@ -2279,7 +2647,10 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 return 1;
             }
 
-            hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage);
+            const TEX_DECOMPRESS_FLAGS dflags = (dwOptions & (uint64_t(1) << OPT_FORCE_SINGLEPROC))
+                ? TEX_DECOMPRESS_DEFAULT : TEX_DECOMPRESS_PARALLEL;
+
+            hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, dflags, *timage);
             if (FAILED(hr))
             {
                 wprintf(L" FAILED [decompress] (%08X%ls)\n", static_cast<unsigned int>(hr), GetErrorDesc(hr));
@@ -3380,6 +3751,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Compress ----------------------------------------------------------------
+        std::unique_ptr<ScratchImage> incrementalSource;
         if (IsCompressed(tformat) && (FileType == CODEC_DDS))
         {
             if (cimage && (cimage->GetMetadata().format == tformat))
@@ -3454,25 +3826,110 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }
 
                 TEX_COMPRESS_FLAGS cflags = dwCompress;
-            #ifdef _OPENMP
                 if (!(dwOptions & (uint64_t(1) << OPT_FORCE_SINGLEPROC)))
                 {
                     cflags |= TEX_COMPRESS_PARALLEL;
                 }
-            #endif
+
+                if (dwOptions & (uint64_t(1) << OPT_RDO))
+                {
+                    cflags |= TEX_COMPRESS_RDO;
+                }
+
+                if (dwOptions & (uint64_t(1) << OPT_TIMING))
+                {
+                    cflags |= TEX_COMPRESS_ENCODER_STATS;
+                }
 
                 if ((img->width % 4) != 0 || (img->height % 4) != 0)
                 {
                     non4bc = true;
                 }
 
-                if (bc6hbc7 && pDevice)
+                // Incremental compression reuses CPU-encoded blocks and the rate-distortion pass is CPU-only,
+                // so neither uses the GPU codec
+                if (bc6hbc7 && pDevice && !*szIncremental && !(cflags & TEX_COMPRESS_RDO))
                 {
                     hr = Compress(pDevice.Get(), img, nimg, info, tformat, dwCompress | dwSRGB, alphaWeight, *timage);
                 }
                 else
                 {
-                    hr = Compress(img, nimg, info, tformat, cflags | dwSRGB, alphaThreshold, *timage);
+                    ScratchImage prevSource;
+                    ScratchImage prevOutput;
+                    bool incremental = false;
+                    if (*szIncremental && GetFileAttributesW(szIncremental) != INVALID_FILE_ATTRIBUTES)
+                    {
+                        wchar_t szPrevSource[1024] = {};
+                        GetIncrementalSourceName(szIncremental, szPrevSource);
+
+                        auto sameLayout = [&](const TexMetadata& mdata) noexcept
+                        {
+                            return mdata.width == info.width && mdata.height == info.height && mdata.depth == info.depth
+                                && mdata.arraySize == info.arraySize && mdata.mipLevels == info.mipLevels
+                                && mdata.miscFlags == info.miscFlags && mdata.dimension == info.dimension;
+                        };
+
+                        TexMetadata prevInfo = {};
+                        TexMetadata prevSourceInfo = {};
+                        incremental = (ReadIncrementalSettings(szIncremental) == incrementalSettings)
+                            && SUCCEEDED(LoadFromDDSFile(szIncremental, DDS_FLAGS_ALLOW_LARGE_FILES, &prevInfo, prevOutput))
+                            && SUCCEEDED(LoadFromDDSFile(szPrevSource, DDS_FLAGS_ALLOW_LARGE_FILES, &prevSourceInfo, prevSource))
+                            && prevInfo.format == tformat && sameLayout(prevInfo)
+                            && prevSourceInfo.format == info.format && sameLayout(prevSourceInfo);
+
+                        if (!incremental)
+                        {
+                            wprintf(L"\nWARNING: %ls doesn't match this output, compressing every block\n", szIncremental);
+                        }
+                    }
+
+                    CompressStatistics stats = {};
+                    CompressOptions options;
+                    options.rdo = { rdoLambda, rdoMaxMSE };
+                    options.stats = &stats;
+                    if (incremental)
+                    {
+                        options.prevSrcImages = prevSource.GetImages();
+                        options.prevCImages = prevOutput.GetImages();
+                    }
+
+                    hr = Compress(img, nimg, info, tformat, cflags | dwSRGB, alphaThreshold, options, *timage);
+
+                    if (SUCCEEDED(hr) && incremental)
+                    {
+                        wprintf(L" (%zu of %zu blocks unchanged)", stats.unchanged, stats.blocks);
+                    }
+
+                    if (SUCCEEDED(hr) && stats.memoLookups > 0)
+                    {
+                        wprintf(L" (reused %zu of %zu blocks)", stats.memoHits, stats.blocks);
+                    }
+
+                    if (SUCCEEDED(hr) && (cflags & TEX_COMPRESS_RDO))
+                    {
+                        wprintf(L" (rate-distortion changed %zu of %zu blocks)", stats.rdoBlocks, stats.blocks);
+                    }
+
+                    if (SUCCEEDED(hr) && (cflags & TEX_COMPRESS_ENCODER_STATS))
+                    {
+                        switch (tformat)
+                        {
+                        case DXGI_FORMAT_BC6H_UF16:
+                        case DXGI_FORMAT_BC6H_SF16:
+                            AddEncoderStatistics(*encoderBC6H, stats.encoder);
+                            reusedBC6H += stats.memoHits + stats.unchanged;
+                            break;
+
+                        case DXGI_FORMAT_BC7_UNORM:
+                        case DXGI_FORMAT_BC7_UNORM_SRGB:
+                            AddEncoderStatistics(*encoderBC7, stats.encoder);
+                            reusedBC7 += stats.memoHits + stats.unchanged;
+                            break;
+
+                        default:
+                            break;
+                        }
+                    }
                 }
                 if (FAILED(hr))
                 {
@@ -3493,6 +3950,12 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 assert(info.dimension == tinfo.dimension);
 
                 image.swap(timage);
+
+                if (*szIncremental)
+                {
+                    // Saved beside the output for the next incremental run to compare against
+                    incrementalSource.swap(timage);
+                }
             }
         }
         else
@@ -3536,17 +3999,17 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             wprintf(L"\n");
 
             // Figure out dest filename
-            wchar_t *pchSlash, *pchDot;
-
             wchar_t szDest[1024] = {};
-            wcscpy_s(szDest, szOutputDir);
+            getDestName(*pConv, szDest);
 
             if (keepRecursiveDirs && *pConv->szFolder)
             {
-                wcscat_s(szDest, pConv->szFolder);
+                wchar_t szDir[1024] = {};
+                wcscpy_s(szDir, szOutputDir);
+                wcscat_s(szDir, pConv->szFolder);
 
                 wchar_t szPath[MAX_PATH] = {};
-                if (!GetFullPathNameW(szDest, MAX_PATH, szPath, nullptr))
+                if (!GetFullPathNameW(szDir, MAX_PATH, szPath, nullptr))
                 {
                     wprintf(L" get full path FAILED (%08X%ls)\n",
                         static_cast<unsigned int>(HRESULT_FROM_WIN32(GetLastError())), GetErrorDesc(HRESULT_FROM_WIN32(GetLastError())));
@@ -3564,29 +4027,6 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }
             }
 
-            if (*szPrefix)
-                wcscat_s(szDest, szPrefix);
-
-            pchSlash = wcsrchr(pConv->szSrc, L'\\');
-            if (pchSlash)
-                wcscat_s(szDest, pchSlash + 1);
-            else
-                wcscat_s(szDest, pConv->szSrc);
-
-            pchSlash = wcsrchr(szDest, '\\');
-            pchDot = wcsrchr(szDest, '.');
-
-            if (pchDot > pchSlash)
-                *pchDot = 0;
-
-            if (*szSuffix)
-                wcscat_s(szDest, szSuffix);
-
-            if (dwOptions & (uint64_t(1) << OPT_TOLOWER))
-            {
-                std::ignore = _wcslwr_s(szDest);
-            }
-
             if (wcslen(szDest) > _MAX_PATH)
             {
                 wprintf(L"\nERROR: Output filename exceeds max-path, skipping!\n");
@@ -3623,6 +4063,18 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                     }
 
                     hr = SaveToDDSFile(img, nimg, info, ddsFlags, szDest);
+                    if (SUCCEEDED(hr) && incrementalSource)
+                    {
+                        wchar_t szSource[1024] = {};
+                        GetIncrementalSourceName(szDest, szSource);
+
+                        hr = SaveToDDSFile(incrementalSource->GetImages(), incrementalSource->GetImageCount(),
+                            incrementalSource->GetMetadata(), DDS_FLAGS_NONE, szSource);
+                        if (SUCCEEDED(hr) && !WriteIncrementalSettings(szDest, incrementalSettings))
+                        {
+                            hr = E_FAIL;
+                        }
+                    }
                     break;
                 }
 
@@ -3729,9 +4181,22 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 continue;
             }
             wprintf(L"\n");
+
+            WIN32_FILE_ATTRIBUTE_DATA destData = {};
+            if (cacheable && GetFileAttributesExW(szDest, GetFileExInfoStandard, &destData))
+            {
+                cacheEntry.value[0] = (uint64_t(destData.nFileSizeHigh) << 32) | destData.nFileSizeLow;
+                cacheEntry.value[1] = (uint64_t(destData.ftLastWriteTime.dwHighDateTime) << 32) | destData.ftLastWriteTime.dwLowDateTime;
+                cache.Insert(cacheEntry);
+            }
         }
     }
 
+    if (useCache)
+    {
+        cache.Close();
+    }
+
     if (sizewarn)
     {
         wprintf(L"\nWARNING: Target size exceeds maximum size for feature level (%u)\n", maxSize);
@@ -3753,6 +4218,9 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
 
         const LONGLONG delta = qpcEnd.QuadPart - qpcStart.QuadPart;
         wprintf(L"\n Processing time: %f seconds\n", double(delta) / double(qpcFreq.QuadPart));
+
+        PrintEncoderStatistics(L"BC6H", *encoderBC6H, reusedBC6H, 1);
+        PrintEncoderStatistics(L"BC7", *encoderBC7, reusedBC7, 0);
     }
 
     return retVal;
@@ -22,16 +22,25 @@
 #include <ShlObj.h>
 
 #include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <cassert>
+#include <condition_variable>
+#include <cstdarg>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cwchar>
 #include <fstream>
+#include <functional>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <list>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 #include <wrl\client.h>
 
@@ -47,6 +56,8 @@
 
 #include "DirectXPackedVector.h"
 
+#include "ResultCache.h"
+
 //Uncomment to add support for OpenEXR (.exr)
 //#define USE_OPENEXR
 
@@ -122,6 +133,13 @@ namespace
         OPT_PAPER_WHITE_NITS,
         OPT_BCNONMULT4FIX,
         OPT_SWIZZLE,
+        OPT_FULL_ENCODE,
+        OPT_FULL_PIPELINE,
+        OPT_JOBS,
+        OPT_SERVE,
+        OPT_STOP_AT_VERDICT,
+        OPT_CACHE,
+        OPT_SAMPLE,
         OPT_MAX
     };
 
@@ -135,8 +153,6 @@ namespace
         ROTATE_P3_TO_2020,
     };
 
-    static_assert(OPT_MAX <= 64, "dwOptions is a DWORD64 bitfield");
-
     struct SConversion
     {
         wchar_t szSrc[MAX_PATH];
@@ -208,6 +224,13 @@ namespace
         { L"nits",          OPT_PAPER_WHITE_NITS },
         { L"fixbc4x4",      OPT_BCNONMULT4FIX },
         { L"swizzle",       OPT_SWIZZLE },
+        { L"fullencode",    OPT_FULL_ENCODE },
+        { L"fullpipeline",  OPT_FULL_PIPELINE },
+        { L"j",             OPT_JOBS },
+        { L"serve",         OPT_SERVE },
+        { L"stopatverdict", OPT_STOP_AT_VERDICT },
+        { L"cache",         OPT_CACHE },
+        { L"sample",        OPT_SAMPLE },
         { nullptr,          0 }
     };
 
@@ -450,6 +473,72 @@ namespace
         { L"12.1", 16384 },
         { nullptr, 0 },
     };
+
+    //--------------------------------------------------------------------------------------
+    // When files are processed in parallel, console output is captured per thread so the
+    // results can be printed in input order
+    thread_local std::wstring* t_output = nullptr;
+
+    void OutputPrintf(_In_z_ _Printf_format_string_ const wchar_t* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+
+        if (t_output)
+        {
+            va_list argsCopy;
+            va_copy(argsCopy, args);
+            const int len = _vscwprintf(format, argsCopy);
+            va_end(argsCopy);
+
+            if (len > 0)
+            {
+                const size_t offset = t_output->size();
+                t_output->resize(offset + size_t(len) + 1);
+                vswprintf_s(&(*t_output)[offset], size_t(len) + 1, format, args);
+                t_output->resize(offset + size_t(len));
+            }
+        }
+        else
+        {
+            vwprintf(format, args);
+        }
+
+        va_end(args);
+    }
+
+    // Calls process once for every index below count, spread over short-lived threads
+    void RunConcurrently(size_t count, const std::function<void(size_t)>& process)
+    {
+        const size_t threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+        if (threads <= 1)
+        {
+            for (size_t index = 0; index < count; ++index)
+            {
+                process(index);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (size_t j = 0; j < threads; ++j)
+        {
+            workers.emplace_back([&]()
+                {
+                    for (size_t index = next++; index < count; index = next++)
+                    {
+                        process(index);
+                    }
+                });
+        }
+
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+    }
 }
 namespace texdiag
 {
@@ -604,7 +693,7 @@ namespace texdiag
         {
             if (static_cast<DXGI_FORMAT>(pFormat->dwValue) == Format)
             {
-                wprintf(L"%ls", pFormat->pName);
+                OutputPrintf(L"%ls", pFormat->pName);
                 return;
             }
         }
@@ -613,12 +702,12 @@ namespace texdiag
         {
             if (static_cast<DXGI_FORMAT>(pFormat->dwValue) == Format)
             {
-                wprintf(L"%ls", pFormat->pName);
+                OutputPrintf(L"%ls", pFormat->pName);
                 return;
             }
         }
 
-        wprintf(L"*UNKNOWN*");
+        OutputPrintf(L"*UNKNOWN*");
     }
 
 
@@ -793,138 +882,317 @@ namespace texdiag
         }
     };
 
-    HRESULT Analyze(const Image& image, _Out_ AnalyzeData& result)
+    // Partial statistics over a run of pixels. Partials of disjoint runs merge exactly
+    // (Chan et al.), so bands of rows are analyzed concurrently in a single decode pass.
+    struct AnalyzeAccumulator
     {
-        memset(&result, 0, sizeof(AnalyzeData));
+        size_t   count;
+        XMVECTOR mean;
+        XMVECTOR m2;        // Sum of squared differences from the mean
+        XMVECTOR minv;
+        XMVECTOR maxv;
+        XMVECTOR luminance;
+        size_t   specials[4];
+
+        AnalyzeAccumulator() noexcept :
+            count(0),
+            mean(g_XMZero),
+            m2(g_XMZero),
+            minv(g_XMFltMax),
+            maxv(XMVectorNegate(g_XMFltMax)),
+            luminance(g_XMZero),
+            specials{}
+        {
+        }
 
-        // First pass
-        XMVECTOR minv = g_XMFltMax;
-        XMVECTOR maxv = XMVectorNegate(g_XMFltMax);
-        XMVECTOR acc = g_XMZero;
-        XMVECTOR luminance = g_XMZero;
+        // Reads the decoded scanline twice while it is in cache, rather than decoding twice
+        void AddScanline(const XMVECTOR* pixels, size_t width) noexcept
+        {
+            static const XMVECTORF32 s_luminance = { { {  0.3f, 0.59f, 0.11f, 0.f } } };
 
-        size_t totalPixels = 0;
+            XMVECTOR sum = g_XMZero;
 
-        HRESULT hr = EvaluateImage(image, [&](const XMVECTOR* pixels, size_t width, size_t y)
+            for (size_t x = 0; x < width; ++x)
             {
-                static const XMVECTORF32 s_luminance = { { {  0.3f, 0.59f, 0.11f, 0.f } } };
+                const XMVECTOR v = pixels[x];
+                luminance = XMVectorMax(luminance, XMVector3Dot(v, s_luminance));
+                minv = XMVectorMin(minv, v);
+                maxv = XMVectorMax(maxv, v);
+                sum = XMVectorAdd(v, sum);
+
+                XMFLOAT4 f;
+                XMStoreFloat4(&f, v);
+                if (!isfinite(f.x))
+                {
+                    ++specials[0];
+                }
 
-                UNREFERENCED_PARAMETER(y);
+                if (!isfinite(f.y))
+                {
+                    ++specials[1];
+                }
 
-                for (size_t x = 0; x < width; ++x)
+                if (!isfinite(f.z))
                 {
-                    XMVECTOR v = *pixels++;
-                    luminance = XMVectorMax(luminance, XMVector3Dot(v, s_luminance));
-                    minv = XMVectorMin(minv, v);
-                    maxv = XMVectorMax(maxv, v);
-                    acc = XMVectorAdd(v, acc);
-                    ++totalPixels;
-
-                    XMFLOAT4 f;
-                    XMStoreFloat4(&f, v);
-                    if (!isfinite(f.x))
-                    {
-                        ++result.specials_x;
-                    }
+                    ++specials[2];
+                }
 
-                    if (!isfinite(f.y))
-                    {
-                        ++result.specials_y;
-                    }
+                if (!isfinite(f.w))
+                {
+                    ++specials[3];
+                }
+            }
 
-                    if (!isfinite(f.z))
-                    {
-                        ++result.specials_z;
-                    }
+            if (!width)
+                return;
 
-                    if (!isfinite(f.w))
-                    {
-                        ++result.specials_w;
-                    }
-                }
-            });
-        if (FAILED(hr))
-            return hr;
+            const XMVECTOR lineMean = XMVectorDivide(sum, XMVectorReplicate(float(width)));
+
+            XMVECTOR lineM2 = g_XMZero;
+            for (size_t x = 0; x < width; ++x)
+            {
+                const XMVECTOR diff = XMVectorSubtract(pixels[x], lineMean);
+                lineM2 = XMVectorMultiplyAdd(diff, diff, lineM2);
+            }
+
+            Merge(width, lineMean, lineM2);
+        }
 
-        if (!totalPixels)
-            return S_FALSE;
+        void Merge(const AnalyzeAccumulator& other) noexcept
+        {
+            luminance = XMVectorMax(luminance, other.luminance);
+            minv = XMVectorMin(minv, other.minv);
+            maxv = XMVectorMax(maxv, other.maxv);
 
-        result.luminance = XMVectorGetX(luminance);
-        XMStoreFloat4(&result.imageMin, minv);
-        XMStoreFloat4(&result.imageMax, maxv);
+            for (size_t j = 0; j < 4; ++j)
+            {
+                specials[j] += other.specials[j];
+            }
 
-        XMVECTOR pixelv = XMVectorReplicate(float(totalPixels));
-        XMVECTOR avgv = XMVectorDivide(acc, pixelv);
-        XMStoreFloat4(&result.imageAvg, avgv);
+            Merge(other.count, other.mean, other.m2);
+        }
 
-        // Second pass
-        acc = g_XMZero;
+    private:
+        void Merge(size_t n, FXMVECTOR otherMean, FXMVECTOR otherM2) noexcept
+        {
+            if (!n)
+                return;
 
-        hr = EvaluateImage(image, [&](const XMVECTOR* pixels, size_t width, size_t y)
+            if (!count)
             {
-                UNREFERENCED_PARAMETER(y);
+                count = n;
+                mean = otherMean;
+                m2 = otherM2;
+                return;
+            }
 
-                for (size_t x = 0; x < width; ++x)
-                {
-                    XMVECTOR v = *pixels++;
+            const size_t total = count + n;
+            const float weight = float(n) / float(total);
+
+            const XMVECTOR delta = XMVectorSubtract(otherMean, mean);
+            mean = XMVectorMultiplyAdd(delta, XMVectorReplicate(weight), mean);
+            m2 = XMVectorAdd(XMVectorAdd(m2, otherM2), XMVectorScale(XMVectorMultiply(delta, delta), float(count) * weight));
+            count = total;
+        }
+    };
+
+    // Analyzes all the images at once, splitting each into bands of rows that are decoded
+    // and accumulated concurrently. Returns S_FALSE if an image has no pixels.
+    HRESULT Analyze(_In_reads_(nimages) const Image* images, size_t nimages, _Out_writes_(nimages) AnalyzeData* results)
+    {
+        // A multiple of the BC block height, so each band decompresses on its own
+        constexpr size_t c_bandHeight = 64;
+
+        if (!images || !results)
+            return E_INVALIDARG;
+
+        struct Band
+        {
+            size_t image;
+            size_t y;
+        };
+
+        std::vector<Band> bands;
+        for (size_t index = 0; index < nimages; ++index)
+        {
+            memset(&results[index], 0, sizeof(AnalyzeData));
+
+            if (!images[index].pixels)
+                return E_POINTER;
+
+            for (size_t y = 0; y < images[index].height; y += c_bandHeight)
+            {
+                bands.push_back({ index, y });
+            }
+        }
 
-                    XMVECTOR diff = XMVectorSubtract(v, avgv);
-                    acc = XMVectorMultiplyAdd(diff, diff, acc);
+        std::vector<AnalyzeAccumulator> partials(bands.size());
+        std::atomic<HRESULT> status(S_OK);
+
+        RunConcurrently(bands.size(), [&](size_t index)
+            {
+                const Image& image = images[bands[index].image];
+                const size_t y = bands[index].y;
+                const size_t rowsPerPitch = IsCompressed(image.format) ? 4 : 1;
+
+                Image band = image;
+                band.height = std::min(c_bandHeight, image.height - y);
+                band.pixels = image.pixels + (y / rowsPerPitch) * image.rowPitch;
+                band.slicePitch = ((band.height + rowsPerPitch - 1) / rowsPerPitch) * image.rowPitch;
+
+                AnalyzeAccumulator& partial = partials[index];
+                const HRESULT hr = EvaluateImage(band, [&](const XMVECTOR* pixels, size_t width, size_t)
+                    {
+                        partial.AddScanline(pixels, width);
+                    });
+                if (FAILED(hr))
+                {
+                    status = hr;
                 }
             });
-        if (FAILED(hr))
-            return hr;
 
-        XMStoreFloat4(&result.imageVariance, acc);
+        if (FAILED(status))
+            return status;
 
-        XMVECTOR stddev = XMVectorSqrt(acc);
+        // Bands are merged in order so the results don't depend on thread timing
+        std::vector<AnalyzeAccumulator> totals(nimages);
+        for (size_t index = 0; index < bands.size(); ++index)
+        {
+            totals[bands[index].image].Merge(partials[index]);
+        }
 
-        XMStoreFloat4(&result.imageStdDev, stddev);
+        HRESULT hr = S_OK;
+        for (size_t index = 0; index < nimages; ++index)
+        {
+            const AnalyzeAccumulator& total = totals[index];
+            if (!total.count)
+            {
+                hr = S_FALSE;
+                continue;
+            }
 
-        return S_OK;
+            AnalyzeData& result = results[index];
+            result.luminance = XMVectorGetX(total.luminance);
+            XMStoreFloat4(&result.imageMin, total.minv);
+            XMStoreFloat4(&result.imageMax, total.maxv);
+            XMStoreFloat4(&result.imageAvg, total.mean);
+            XMStoreFloat4(&result.imageVariance, total.m2);
+            XMStoreFloat4(&result.imageStdDev, XMVectorSqrt(total.m2));
+            result.specials_x = total.specials[0];
+            result.specials_y = total.specials[1];
+            result.specials_z = total.specials[2];
+            result.specials_w = total.specials[3];
+        }
+
+        return hr;
+    }
+
+    HRESULT Analyze(const Image& image, _Out_ AnalyzeData& result)
+    {
+        return Analyze(&image, 1, &result);
     }
 
 
     //--------------------------------------------------------------------------------------
+    // 95% confidence interval (Wilson score) for the share of count out of n sampled blocks
+    void GetConfidenceInterval(size_t count, size_t n, double& lower, double& upper)
+    {
+        constexpr double z = 1.96;
+
+        const double p = double(count) / double(n);
+        const double z2n = z * z / double(n);
+        const double center = (p + z2n * 0.5) / (1.0 + z2n);
+        const double half = z * sqrt(p * (1.0 - p) / double(n) + z2n / (4.0 * double(n))) / (1.0 + z2n);
+
+        lower = std::max(0.0, center - half);
+        upper = std::min(1.0, center + half);
+    }
+
     struct AnalyzeBCData
     {
         size_t blocks;
         size_t blockHist[15];
+        size_t sampled;     // Blocks counted when only a sample was analyzed, otherwise 0
+
+        // Prints an exact count, or the estimate for the whole image from a sampled count
+        void PrintCount(const wchar_t* label, size_t count) const
+        {
+            if (!sampled)
+            {
+                OutputPrintf(L"%ls - %zu\n", label, count);
+                return;
+            }
 
-        void Print(DXGI_FORMAT fmt)
+            double lower, upper;
+            GetConfidenceInterval(count, sampled, lower, upper);
+
+            // The blocks seen in the sample are certain, and the rest can add at most the unseen ones
+            const size_t most = count + blocks - sampled;
+            const size_t low = std::min(std::max(count, size_t(lower * double(blocks))), most);
+            const size_t high = std::min(std::max(count, size_t(ceil(upper * double(blocks)))), most);
+
+            OutputPrintf(L"%ls - ~%zu (%zu to %zu)\n", label,
+                size_t(double(count) * double(blocks) / double(sampled) + 0.5), low, high);
+        }
+
+        void Print(DXGI_FORMAT fmt) const
         {
-            wprintf(L"\t        Compression - ");
+            OutputPrintf(L"\t        Compression - ");
             PrintFormat(fmt);
-            wprintf(L"\n\t       Total blocks - %zu\n", blocks);
+            OutputPrintf(L"\n\t       Total blocks - %zu\n", blocks);
+
+            switch (fmt)
+            {
+            case DXGI_FORMAT_BC1_UNORM:
+            case DXGI_FORMAT_BC1_UNORM_SRGB:
+            case DXGI_FORMAT_BC3_UNORM:
+            case DXGI_FORMAT_BC3_UNORM_SRGB:
+            case DXGI_FORMAT_BC4_UNORM:
+            case DXGI_FORMAT_BC4_SNORM:
+            case DXGI_FORMAT_BC5_UNORM:
+            case DXGI_FORMAT_BC5_SNORM:
+                if (sampled)
+                {
+                    OutputPrintf(L"\t     Sampled blocks - %zu (estimates with 95%% confidence)\n", sampled);
+                }
+                else if ((blockHist[0] + blockHist[1]) < blocks)
+                {
+                    OutputPrintf(L"\t    Examined blocks - %zu (stopped at verdict)\n", blockHist[0] + blockHist[1]);
+                }
+                break;
+
+            default:
+                break;
+            }
 
             switch (fmt)
             {
             case DXGI_FORMAT_BC1_UNORM:
             case DXGI_FORMAT_BC1_UNORM_SRGB:
-                wprintf(L"\t     4 color blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     3 color blocks - %zu\n", blockHist[1]);
+                PrintCount(L"\t     4 color blocks", blockHist[0]);
+                PrintCount(L"\t     3 color blocks", blockHist[1]);
                 break;
 
                 // BC2 only has a single 'type' of block
 
             case DXGI_FORMAT_BC3_UNORM:
             case DXGI_FORMAT_BC3_UNORM_SRGB:
-                wprintf(L"\t     8 alpha blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     6 alpha blocks - %zu\n", blockHist[1]);
+                PrintCount(L"\t     8 alpha blocks", blockHist[0]);
+                PrintCount(L"\t     6 alpha blocks", blockHist[1]);
                 break;
 
             case DXGI_FORMAT_BC4_UNORM:
             case DXGI_FORMAT_BC4_SNORM:
-                wprintf(L"\t     8 red blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     6 red blocks - %zu\n", blockHist[1]);
+                PrintCount(L"\t     8 red blocks", blockHist[0]);
+                PrintCount(L"\t     6 red blocks", blockHist[1]);
                 break;
 
             case DXGI_FORMAT_BC5_UNORM:
             case DXGI_FORMAT_BC5_SNORM:
-                wprintf(L"\t     8 red blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     6 red blocks - %zu\n", blockHist[1]);
-                wprintf(L"\t   8 green blocks - %zu\n", blockHist[2]);
-                wprintf(L"\t   6 green blocks - %zu\n", blockHist[3]);
+                PrintCount(L"\t     8 red blocks", blockHist[0]);
+                PrintCount(L"\t     6 red blocks", blockHist[1]);
+                PrintCount(L"\t   8 green blocks", blockHist[2]);
+                PrintCount(L"\t   6 green blocks", blockHist[3]);
                 break;
 
             case DXGI_FORMAT_BC6H_UF16:
@@ -932,10 +1200,10 @@ namespace texdiag
                 for (size_t j = 1; j <= 14; ++j)
                 {
                     if (blockHist[j] > 0)
-                        wprintf(L"\t     Mode %02zu blocks - %zu\n", j, blockHist[j]);
+                        OutputPrintf(L"\t     Mode %02zu blocks - %zu\n", j, blockHist[j]);
                 }
                 if (blockHist[0] > 0)
-                    wprintf(L"\tReserved mode blcks - %zu\n", blockHist[0]);
+                    OutputPrintf(L"\tReserved mode blcks - %zu\n", blockHist[0]);
                 break;
 
             case DXGI_FORMAT_BC7_UNORM:
@@ -943,10 +1211,10 @@ namespace texdiag
                 for (size_t j = 0; j <= 7; ++j)
                 {
                     if (blockHist[j] > 0)
-                        wprintf(L"\t     Mode %02zu blocks - %zu\n", j, blockHist[j]);
+                        OutputPrintf(L"\t     Mode %02zu blocks - %zu\n", j, blockHist[j]);
                 }
                 if (blockHist[8] > 0)
-                    wprintf(L"\tReserved mode blcks - %zu\n", blockHist[8]);
+                    OutputPrintf(L"\tReserved mode blcks - %zu\n", blockHist[8]);
                 break;
 
             default:
@@ -1002,317 +1270,396 @@ namespace texdiag
     };
 #pragma pack(pop)
 
-    HRESULT AnalyzeBC(const Image& image, _Out_ AnalyzeBCData& result)
+    // Counts the type of a single block
+    void CountBlock(DXGI_FORMAT format, const uint8_t* sptr, AnalyzeBCData& result)
     {
-        memset(&result, 0, sizeof(AnalyzeBCData));
-
-        size_t sbpp;
-        switch (image.format)
+        switch (format)
         {
         case DXGI_FORMAT_BC1_UNORM:
         case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC4_UNORM:
-        case DXGI_FORMAT_BC4_SNORM:
-            sbpp = 8;
-            break;
+        {
+            auto block = reinterpret_cast<const BC1Block*>(sptr);
+
+            if (block->rgb[0] <= block->rgb[1])
+            {
+                // Transparent block
+                ++result.blockHist[1];
+            }
+            else
+            {
+                // Opaque block
+                ++result.blockHist[0];
+            }
+        }
+        break;
+
+        // BC2 only has a single 'type' of block
 
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
         case DXGI_FORMAT_BC3_UNORM:
         case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC5_UNORM:
-        case DXGI_FORMAT_BC5_SNORM:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-        case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-            sbpp = 16;
-            break;
+        {
+            auto block = reinterpret_cast<const BC3Block*>(sptr);
 
-        default:
-            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            if (block->alpha[0] > block->alpha[1])
+            {
+                // 8 alpha block
+                ++result.blockHist[0];
+            }
+            else
+            {
+                // 6 alpha block
+                ++result.blockHist[1];
+            }
         }
+        break;
 
-        const uint8_t* pSrc = image.pixels;
-        const size_t rowPitch = image.rowPitch;
-
-        for (size_t h = 0; h < image.height; h += 4)
+        case DXGI_FORMAT_BC4_UNORM:
         {
-            const uint8_t* sptr = pSrc;
+            auto block = reinterpret_cast<const BC4UBlock*>(sptr);
 
-            for (size_t count = 0; count < rowPitch; count += sbpp)
+            if (block->red_0 > block->red_1)
             {
-                switch (image.format)
-                {
-                case DXGI_FORMAT_BC1_UNORM:
-                case DXGI_FORMAT_BC1_UNORM_SRGB:
-                {
-                    auto block = reinterpret_cast<const BC1Block*>(sptr);
+                // 8 red block
+                ++result.blockHist[0];
+            }
+            else
+            {
+                // 6 red block
+                ++result.blockHist[1];
+            }
+        }
+        break;
 
-                    if (block->rgb[0] <= block->rgb[1])
-                    {
-                        // Transparent block
-                        ++result.blockHist[1];
-                    }
-                    else
-                    {
-                        // Opaque block
-                        ++result.blockHist[0];
-                    }
-                }
-                break;
+        case DXGI_FORMAT_BC4_SNORM:
+        {
+            auto block = reinterpret_cast<const BC4SBlock*>(sptr);
 
-                // BC2 only has a single 'type' of block
+            if (block->red_0 > block->red_1)
+            {
+                // 8 red block
+                ++result.blockHist[0];
+            }
+            else
+            {
+                // 6 red block
+                ++result.blockHist[1];
+            }
+        }
+        break;
 
-                case DXGI_FORMAT_BC3_UNORM:
-                case DXGI_FORMAT_BC3_UNORM_SRGB:
-                {
-                    auto block = reinterpret_cast<const BC3Block*>(sptr);
+        case DXGI_FORMAT_BC5_UNORM:
+        {
+            auto block = reinterpret_cast<const BC5UBlock*>(sptr);
 
-                    if (block->alpha[0] > block->alpha[1])
-                    {
-                        // 8 alpha block
-                        ++result.blockHist[0];
-                    }
-                    else
-                    {
-                        // 6 alpha block
-                        ++result.blockHist[1];
-                    }
-                }
-                break;
+            if (block->u.red_0 > block->u.red_1)
+            {
+                // 8 red block
+                ++result.blockHist[0];
+            }
+            else
+            {
+                // 6 red block
+                ++result.blockHist[1];
+            }
 
-                case DXGI_FORMAT_BC4_UNORM:
-                {
-                    auto block = reinterpret_cast<const BC4UBlock*>(sptr);
+            if (block->v.red_0 > block->v.red_1)
+            {
+                // 8 green block
+                ++result.blockHist[2];
+            }
+            else
+            {
+                // 6 green block
+                ++result.blockHist[3];
+            }
+        }
+        break;
 
-                    if (block->red_0 > block->red_1)
-                    {
-                        // 8 red block
-                        ++result.blockHist[0];
-                    }
-                    else
-                    {
-                        // 6 red block
-                        ++result.blockHist[1];
-                    }
-                }
-                break;
+        case DXGI_FORMAT_BC5_SNORM:
+        {
+            auto block = reinterpret_cast<const BC5SBlock*>(sptr);
 
-                case DXGI_FORMAT_BC4_SNORM:
-                {
-                    auto block = reinterpret_cast<const BC4SBlock*>(sptr);
+            if (block->u.red_0 > block->u.red_1)
+            {
+                // 8 red block
+                ++result.blockHist[0];
+            }
+            else
+            {
+                // 6 red block
+                ++result.blockHist[1];
+            }
 
-                    if (block->red_0 > block->red_1)
-                    {
-                        // 8 red block
-                        ++result.blockHist[0];
-                    }
-                    else
-                    {
-                        // 6 red block
-                        ++result.blockHist[1];
-                    }
-                }
+            if (block->v.red_0 > block->v.red_1)
+            {
+                // 8 green block
+                ++result.blockHist[2];
+            }
+            else
+            {
+                // 6 green block
+                ++result.blockHist[3];
+            }
+        }
+        break;
+
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            switch (*sptr & 0x03)
+            {
+            case 0x00:
+                // Mode 1 (2 bits, 00)
+                ++result.blockHist[1];
                 break;
 
-                case DXGI_FORMAT_BC5_UNORM:
+            case 0x01:
+                // Mode 2 (2 bits, 01)
+                ++result.blockHist[2];
+                break;
+
+            default:
+                switch (*sptr & 0x1F)
                 {
-                    auto block = reinterpret_cast<const BC5UBlock*>(sptr);
+                case 0x02:
+                    // Mode 3 (5 bits, 00010)
+                    ++result.blockHist[3];
+                    break;
 
-                    if (block->u.red_0 > block->u.red_1)
-                    {
-                        // 8 red block
-                        ++result.blockHist[0];
-                    }
-                    else
-                    {
-                        // 6 red block
-                        ++result.blockHist[1];
-                    }
+                case 0x06:
+                    // Mode 4 (5 bits, 00110)
+                    ++result.blockHist[4];
+                    break;
 
-                    if (block->v.red_0 > block->v.red_1)
-                    {
-                        // 8 green block
-                        ++result.blockHist[2];
-                    }
-                    else
-                    {
-                        // 6 green block
-                        ++result.blockHist[3];
-                    }
-                }
-                break;
+                case 0x0A:
+                    // Mode 5 (5 bits, 01010)
+                    ++result.blockHist[5];
+                    break;
 
-                case DXGI_FORMAT_BC5_SNORM:
-                {
-                    auto block = reinterpret_cast<const BC5SBlock*>(sptr);
+                case 0x0E:
+                    // Mode 6 (5 bits, 01110)
+                    ++result.blockHist[6];
+                    break;
 
-                    if (block->u.red_0 > block->u.red_1)
-                    {
-                        // 8 red block
-                        ++result.blockHist[0];
-                    }
-                    else
-                    {
-                        // 6 red block
-                        ++result.blockHist[1];
-                    }
+                case 0x12:
+                    // Mode 7 (5 bits, 10010)
+                    ++result.blockHist[7];
+                    break;
 
-                    if (block->v.red_0 > block->v.red_1)
-                    {
-                        // 8 green block
-                        ++result.blockHist[2];
-                    }
-                    else
-                    {
-                        // 6 green block
-                        ++result.blockHist[3];
-                    }
+                case 0x16:
+                    // Mode 8 (5 bits, 10110)
+                    ++result.blockHist[8];
+                    break;
+
+                case 0x1A:
+                    // Mode 9 (5 bits, 11010)
+                    ++result.blockHist[9];
+                    break;
+
+                case 0x1E:
+                    // Mode 10 (5 bits, 11110)
+                    ++result.blockHist[10];
+                    break;
+
+                case 0x03:
+                    // Mode 11 (5 bits, 00011)
+                    ++result.blockHist[11];
+                    break;
+
+                case 0x07:
+                    // Mode 12 (5 bits, 00111)
+                    ++result.blockHist[12];
+                    break;
+
+                case 0x0B:
+                    // Mode 13 (5 bits, 01011)
+                    ++result.blockHist[13];
+                    break;
+
+                case 0x0F:
+                    // Mode 14 (5 bits, 01111)
+                    ++result.blockHist[14];
+                    break;
+
+                case 0x13: // Reserved mode (5 bits, 10011)
+                case 0x17: // Reserved mode (5 bits, 10111)
+                case 0x1B: // Reserved mode (5 bits, 11011)
+                case 0x1F: // Reserved mode (5 bits, 11111)
+                default:
+                    ++result.blockHist[0];
+                    break;
                 }
                 break;
+            }
+            break;
 
-                case DXGI_FORMAT_BC6H_UF16:
-                case DXGI_FORMAT_BC6H_SF16:
-                    switch (*sptr & 0x03)
-                    {
-                    case 0x00:
-                        // Mode 1 (2 bits, 00)
-                        ++result.blockHist[1];
-                        break;
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            if (*sptr & 0x01)
+            {
+                // Mode 0 (1)
+                ++result.blockHist[0];
+            }
+            else if (*sptr & 0x02)
+            {
+                // Mode 1 (01)
+                ++result.blockHist[1];
+            }
+            else if (*sptr & 0x04)
+            {
+                // Mode 2 (001)
+                ++result.blockHist[2];
+            }
+            else if (*sptr & 0x08)
+            {
+                // Mode 3 (0001)
+                ++result.blockHist[3];
+            }
+            else if (*sptr & 0x10)
+            {
+                // Mode 4 (00001)
+                ++result.blockHist[4];
+            }
+            else if (*sptr & 0x20)
+            {
+                // Mode 5 (000001)
+                ++result.blockHist[5];
+            }
+            else if (*sptr & 0x40)
+            {
+                // Mode 6 (0000001)
+                ++result.blockHist[6];
+            }
+            else if (*sptr & 0x80)
+            {
+                // Mode 7 (00000001)
+                ++result.blockHist[7];
+            }
+            else
+            {
+                // Reserved mode 8 (00000000)
+                ++result.blockHist[8];
+            }
+            break;
 
-                    case 0x01:
-                        // Mode 2 (2 bits, 01)
-                        ++result.blockHist[2];
-                        break;
+        default:
+            break;
+        }
+    }
 
-                    default:
-                        switch (*sptr & 0x1F)
-                        {
-                        case 0x02:
-                            // Mode 3 (5 bits, 00010)
-                            ++result.blockHist[3];
-                            break;
+    // Returns true once every block type the alpha verdict depends on has been seen. The
+    // verdict is only defined for formats with two interpolation modes per channel.
+    bool VerdictReached(DXGI_FORMAT format, const AnalyzeBCData& result)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            return result.blockHist[0] && result.blockHist[1];
 
-                        case 0x06:
-                            // Mode 4 (5 bits, 00110)
-                            ++result.blockHist[4];
-                            break;
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+            return result.blockHist[0] && result.blockHist[1] && result.blockHist[2] && result.blockHist[3];
 
-                        case 0x0A:
-                            // Mode 5 (5 bits, 01010)
-                            ++result.blockHist[5];
-                            break;
+        default:
+            return false;
+        }
+    }
 
-                        case 0x0E:
-                            // Mode 6 (5 bits, 01110)
-                            ++result.blockHist[6];
-                            break;
+    // With stopAtVerdict, blocks are visited spread over the image and the walk ends once
+    // VerdictReached is true. Blocks is still the total, so the counts may sum to less.
+    // A non-zero sampleBlocks only counts a stratified sample of at most that many blocks,
+    // and sets sampled to the number counted when that is less than the total.
+    HRESULT AnalyzeBC(const Image& image, _Out_ AnalyzeBCData& result, bool stopAtVerdict = false, size_t sampleBlocks = 0)
+    {
+        memset(&result, 0, sizeof(AnalyzeBCData));
 
-                        case 0x12:
-                            // Mode 7 (5 bits, 10010)
-                            ++result.blockHist[7];
-                            break;
+        size_t sbpp;
+        switch (image.format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            sbpp = 8;
+            break;
 
-                        case 0x16:
-                            // Mode 8 (5 bits, 10110)
-                            ++result.blockHist[8];
-                            break;
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            sbpp = 16;
+            break;
 
-                        case 0x1A:
-                            // Mode 9 (5 bits, 11010)
-                            ++result.blockHist[9];
-                            break;
+        default:
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
 
-                        case 0x1E:
-                            // Mode 10 (5 bits, 11110)
-                            ++result.blockHist[10];
-                            break;
+        const uint8_t* pSrc = image.pixels;
+        const size_t rowPitch = image.rowPitch;
 
-                        case 0x03:
-                            // Mode 11 (5 bits, 00011)
-                            ++result.blockHist[11];
-                            break;
+        switch (image.format)
+        {
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            // No verdict to stop at, and so none to settle from a sample
+            stopAtVerdict = false;
+            sampleBlocks = 0;
+            break;
 
-                        case 0x07:
-                            // Mode 12 (5 bits, 00111)
-                            ++result.blockHist[12];
-                            break;
+        default:
+            break;
+        }
 
-                        case 0x0B:
-                            // Mode 13 (5 bits, 01011)
-                            ++result.blockHist[13];
-                            break;
+        if (stopAtVerdict || sampleBlocks)
+        {
+            // Same blocks, in the same order, as ClassifyAlphaBlocks
+            BlockSampleOrder order;
+            ComputeBlockSampleOrder(image.width, image.height, sampleBlocks, stopAtVerdict, order);
 
-                        case 0x0F:
-                            // Mode 14 (5 bits, 01111)
-                            ++result.blockHist[14];
-                            break;
+            const size_t nbWidth = order.nbWidth;
+            const size_t nBlocks = nbWidth * order.nbHeight;
+            const size_t nCells = order.cellsX * order.cellsY;
 
-                        case 0x13: // Reserved mode (5 bits, 10011)
-                        case 0x17: // Reserved mode (5 bits, 10111)
-                        case 0x1B: // Reserved mode (5 bits, 11011)
-                        case 0x1F: // Reserved mode (5 bits, 11111)
-                        default:
-                            ++result.blockHist[0];
-                            break;
-                        }
-                        break;
-                    }
-                    break;
+            size_t counted = 0;
+            for (size_t nb = 0; nb < nCells; ++nb)
+            {
+                const size_t index = GetSampleBlockIndex(order, nb);
+                CountBlock(image.format, pSrc + (index / nbWidth) * rowPitch + (index % nbWidth) * sbpp, result);
+                ++counted;
 
-                case DXGI_FORMAT_BC7_UNORM:
-                case DXGI_FORMAT_BC7_UNORM_SRGB:
-                    if (*sptr & 0x01)
-                    {
-                        // Mode 0 (1)
-                        ++result.blockHist[0];
-                    }
-                    else if (*sptr & 0x02)
-                    {
-                        // Mode 1 (01)
-                        ++result.blockHist[1];
-                    }
-                    else if (*sptr & 0x04)
-                    {
-                        // Mode 2 (001)
-                        ++result.blockHist[2];
-                    }
-                    else if (*sptr & 0x08)
-                    {
-                        // Mode 3 (0001)
-                        ++result.blockHist[3];
-                    }
-                    else if (*sptr & 0x10)
-                    {
-                        // Mode 4 (00001)
-                        ++result.blockHist[4];
-                    }
-                    else if (*sptr & 0x20)
-                    {
-                        // Mode 5 (000001)
-                        ++result.blockHist[5];
-                    }
-                    else if (*sptr & 0x40)
-                    {
-                        // Mode 6 (0000001)
-                        ++result.blockHist[6];
-                    }
-                    else if (*sptr & 0x80)
-                    {
-                        // Mode 7 (00000001)
-                        ++result.blockHist[7];
-                    }
-                    else
-                    {
-                        // Reserved mode 8 (00000000)
-                        ++result.blockHist[8];
-                    }
+                if (stopAtVerdict && VerdictReached(image.format, result))
                     break;
+            }
 
-                default:
-                    break;
-                }
+            result.blocks = nBlocks;
+            if (nCells < nBlocks)
+            {
+                result.sampled = counted;
+            }
+            return S_OK;
+        }
+
+        for (size_t h = 0; h < image.height; h += 4)
+        {
+            const uint8_t* sptr = pSrc;
+
+            for (size_t count = 0; count < rowPitch; count += sbpp)
+            {
+                CountBlock(image.format, sptr, result);
 
                 sptr += sbpp;
                 ++result.blocks;
@@ -3169,6 +3516,218 @@ namespace
         return ((x != 0) && !(x & (x - 1)));
     }
 
+    size_t CountMips(size_t width, size_t height, size_t depth) noexcept
+    {
+        size_t mipLevels = 1;
+
+        while (width > 1 || height > 1 || depth > 1)
+        {
+            if (width > 1)
+                width >>= 1;
+
+            if (height > 1)
+                height >>= 1;
+
+            if (depth > 1)
+                depth >>= 1;
+
+            ++mipLevels;
+        }
+
+        return mipLevels;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Persistent worker threads for processing several files at once. Each Run call hands
+    // out files to idle workers one at a time, and each file's output is printed in input
+    // order once it and every file before it are done. A non-zero result stops handing out
+    // new files and is returned after the output up to that file is printed. Workers keep
+    // COM initialized between runs, so -serve requests don't pay for thread startup.
+    class WorkerPool
+    {
+    public:
+        explicit WorkerPool(unsigned int jobs) :
+            m_process(nullptr),
+            m_count(0),
+            m_next(0),
+            m_stop(false),
+            m_generation(0),
+            m_active(0),
+            m_shutdown(false)
+        {
+            m_threads.reserve(jobs);
+            for (unsigned int j = 0; j < jobs; ++j)
+            {
+                m_threads.emplace_back(&WorkerPool::Worker, this);
+            }
+        }
+
+        WorkerPool(WorkerPool&&) = delete;
+        WorkerPool& operator= (WorkerPool&&) = delete;
+
+        WorkerPool(WorkerPool const&) = delete;
+        WorkerPool& operator= (WorkerPool const&) = delete;
+
+        ~WorkerPool()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_shutdown = true;
+            }
+            m_wake.notify_all();
+
+            for (auto& t : m_threads)
+            {
+                t.join();
+            }
+        }
+
+        // If 'echo' is false, the captured output is discarded instead of printed
+        int Run(size_t count, const std::function<int(size_t)>& process, bool echo = true)
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                m_results.clear();
+                m_results.resize(count);
+                m_process = &process;
+                m_count = count;
+                m_next = 0;
+                m_stop = false;
+                m_active = static_cast<unsigned int>(m_threads.size());
+                ++m_generation;
+            }
+            m_wake.notify_all();
+
+            int status = 0;
+            for (size_t index = 0; (index < count) && !status; ++index)
+            {
+                std::wstring output;
+                {
+                    std::unique_lock<std::mutex> guard(m_lock);
+                    m_ready.wait(guard, [&]() { return m_results[index].done || !m_active; });
+
+                    if (!m_results[index].done)
+                    {
+                        // Processing stopped before this file was handed out
+                        break;
+                    }
+
+                    output.swap(m_results[index].output);
+                    status = m_results[index].status;
+                }
+
+                if (echo)
+                {
+                    wprintf(L"%ls", output.c_str());
+                    fflush(stdout);
+                }
+            }
+
+            // Wait for all workers to finish with this run
+            {
+                std::unique_lock<std::mutex> guard(m_lock);
+                m_stop = true;
+                m_ready.wait(guard, [&]() { return !m_active; });
+                m_process = nullptr;
+            }
+
+            return status;
+        }
+
+    private:
+        struct Result
+        {
+            std::wstring output;
+            int status;
+            bool done;
+        };
+
+        void Worker()
+        {
+            // WIC requires COM to be initialized on every thread
+            const HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+            unsigned int generation = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> guard(m_lock);
+                    m_wake.wait(guard, [&]() { return m_shutdown || (m_generation != generation); });
+
+                    if (m_shutdown)
+                        break;
+
+                    generation = m_generation;
+                }
+
+                while (!m_stop)
+                {
+                    const size_t index = m_next++;
+                    if (index >= m_count)
+                        break;
+
+                    std::wstring output;
+                    t_output = &output;
+
+                    int status = 1;
+                    if (SUCCEEDED(hrCOM))
+                    {
+                        status = (*m_process)(index);
+                    }
+                    else
+                    {
+                        OutputPrintf(L"Failed to initialize COM (%08X)\n", static_cast<unsigned int>(hrCOM));
+                    }
+
+                    t_output = nullptr;
+
+                    if (status)
+                        m_stop = true;
+
+                    {
+                        std::lock_guard<std::mutex> guard(m_lock);
+                        m_results[index].output.swap(output);
+                        m_results[index].status = status;
+                        m_results[index].done = true;
+                    }
+                    m_ready.notify_all();
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(m_lock);
+                    --m_active;
+                }
+                m_ready.notify_all();
+            }
+
+            if (SUCCEEDED(hrCOM))
+                CoUninitialize();
+        }
+
+        std::vector<std::thread>            m_threads;
+        std::vector<Result>                 m_results;
+        const std::function<int(size_t)>*   m_process;
+        size_t                              m_count;
+        std::atomic<size_t>                 m_next;
+        std::atomic<bool>                   m_stop;
+        unsigned int                        m_generation;
+        unsigned int                        m_active;
+        bool                                m_shutdown;
+        std::mutex                          m_lock;
+        std::condition_variable             m_wake;
+        std::condition_variable             m_ready;
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Result of reading only the file header. A settled file's alpha is known to be opaque,
+    // which the BC3 encoder always codes as 6 alpha blocks. Binary alpha formats such as BC1
+    // are not settled, since a fully transparent block encodes as an 8 alpha block.
+    struct HeaderTriage
+    {
+        TexMetadata info;
+        bool        settled;
+    };
+
 #ifdef _PREFAST_
 #pragma prefast(disable : 26018, "Only used with static internal arrays")
 #endif
@@ -3190,13 +3749,135 @@ namespace
     {
         while (pArray->pName)
         {
-            if (pValue == pArray->dwValue)
-                return pArray->pName;
+            if (pValue == pArray->dwValue)
+                return pArray->pName;
+
+            pArray++;
+        }
+
+        return L"";
+    }
+
+    // Formats a -serve result record: file, status, format, total blocks, and block counts.
+    // A sampled result has status "estimate", and the sampled blocks after the total; its
+    // counts are the ones seen in the sample.
+    std::wstring FormatRecord(const wchar_t* szFile, DXGI_FORMAT fmt, const texdiag::AnalyzeBCData& data)
+    {
+        size_t counts;
+        switch (fmt)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            counts = 2;
+            break;
+
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+            counts = 4;
+            break;
+
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            counts = 15;
+            break;
+
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            counts = 9;
+            break;
+
+        default:
+            counts = 0;
+            break;
+        }
+
+        auto fmtName = LookupByValue(fmt, g_pFormats);
+        if (!fmtName)
+            fmtName = LookupByValue(fmt, g_pReadOnlyFormats);
+
+        std::wstring record(szFile);
+        record += (data.sampled) ? L"\testimate\t" : L"\tok\t";
+        record += (fmtName) ? fmtName : L"*UNKNOWN*";
+        record += L"\t";
+        record += std::to_wstring(data.blocks);
+
+        if (data.sampled)
+        {
+            record += L"\t";
+            record += std::to_wstring(data.sampled);
+        }
+
+        for (size_t j = 0; j < counts; ++j)
+        {
+            record += L"\t";
+            record += std::to_wstring(data.blockHist[j]);
+        }
+
+        return record;
+    }
+
+    // Splits a -serve request line into arguments, honoring double quotes. Returns false if
+    // the line is blank.
+    bool SplitRequestLine(const wchar_t* line, std::vector<std::wstring>& args)
+    {
+        bool found = false;
+
+        for (const wchar_t* ptr = line; *ptr;)
+        {
+            while (iswspace(*ptr))
+                ++ptr;
+
+            if (!*ptr)
+                break;
+
+            std::wstring arg;
+            bool quoted = false;
+            for (; *ptr && (quoted || !iswspace(*ptr)); ++ptr)
+            {
+                if (*ptr == L'"')
+                {
+                    quoted = !quoted;
+                }
+                else
+                {
+                    arg += *ptr;
+                }
+            }
+
+            args.emplace_back(std::move(arg));
+            found = true;
+        }
+
+        return found;
+    }
+
+    // Reads a -serve request line of any length, without the line ending. Returns false at the
+    // end of the input.
+    bool ReadRequestLine(FILE* file, std::wstring& line)
+    {
+        line.clear();
+
+        wchar_t buffer[1024];
+        while (fgetws(buffer, static_cast<int>(std::size(buffer)), file))
+        {
+            line += buffer;
+            if (!line.empty() && line.back() == L'\n')
+                break;
+        }
 
-            pArray++;
+        if (line.empty())
+            return false;
+
+        while (!line.empty() && (line.back() == L'\n' || line.back() == L'\r'))
+        {
+            line.pop_back();
         }
 
-        return L"";
+        return true;
     }
 
     void SearchForFiles(const wchar_t* path, std::list<SConversion>& files, bool recursive, const wchar_t* folder)
@@ -3285,7 +3966,7 @@ namespace
         {
             if (static_cast<DXGI_FORMAT>(pFormat->dwValue) == Format)
             {
-                wprintf(L"%ls", pFormat->pName);
+                OutputPrintf(L"%ls", pFormat->pName);
                 return;
             }
         }
@@ -3294,71 +3975,71 @@ namespace
         {
             if (static_cast<DXGI_FORMAT>(pFormat->dwValue) == Format)
             {
-                wprintf(L"%ls", pFormat->pName);
+                OutputPrintf(L"%ls", pFormat->pName);
                 return;
             }
         }
 
-        wprintf(L"*UNKNOWN*");
+        OutputPrintf(L"*UNKNOWN*");
     }
 
     void PrintInfo(const TexMetadata& info)
     {
-        wprintf(L" (%zux%zu", info.width, info.height);
+        OutputPrintf(L" (%zux%zu", info.width, info.height);
 
         if (TEX_DIMENSION_TEXTURE3D == info.dimension)
-            wprintf(L"x%zu", info.depth);
+            OutputPrintf(L"x%zu", info.depth);
 
         if (info.mipLevels > 1)
-            wprintf(L",%zu", info.mipLevels);
+            OutputPrintf(L",%zu", info.mipLevels);
 
         if (info.arraySize > 1)
-            wprintf(L",%zu", info.arraySize);
+            OutputPrintf(L",%zu", info.arraySize);
 
-        wprintf(L" ");
+        OutputPrintf(L" ");
         PrintFormat(info.format);
 
         switch (info.dimension)
         {
         case TEX_DIMENSION_TEXTURE1D:
-            wprintf(L"%ls", (info.arraySize > 1) ? L" 1DArray" : L" 1D");
+            OutputPrintf(L"%ls", (info.arraySize > 1) ? L" 1DArray" : L" 1D");
             break;
 
         case TEX_DIMENSION_TEXTURE2D:
             if (info.IsCubemap())
             {
-                wprintf(L"%ls", (info.arraySize > 6) ? L" CubeArray" : L" Cube");
+                OutputPrintf(L"%ls", (info.arraySize > 6) ? L" CubeArray" : L" Cube");
             }
             else
             {
-                wprintf(L"%ls", (info.arraySize > 1) ? L" 2DArray" : L" 2D");
+                OutputPrintf(L"%ls", (info.arraySize > 1) ? L" 2DArray" : L" 2D");
             }
             break;
 
         case TEX_DIMENSION_TEXTURE3D:
-            wprintf(L" 3D");
+            OutputPrintf(L" 3D");
             break;
         }
 
         switch (info.GetAlphaMode())
         {
         case TEX_ALPHA_MODE_OPAQUE:
-            wprintf(L" \x0e0:Opaque");
+            OutputPrintf(L" \x0e0:Opaque");
             break;
         case TEX_ALPHA_MODE_PREMULTIPLIED:
-            wprintf(L" \x0e0:PM");
+            OutputPrintf(L" \x0e0:PM");
             break;
         case TEX_ALPHA_MODE_STRAIGHT:
-            wprintf(L" \x0e0:NonPM");
+            OutputPrintf(L" \x0e0:NonPM");
             break;
         case TEX_ALPHA_MODE_CUSTOM:
-            wprintf(L" \x0e0:Custom");
+            OutputPrintf(L" \x0e0:Custom");
             break;
         case TEX_ALPHA_MODE_UNKNOWN:
             break;
         }
 
-        wprintf(L")");
+        OutputPrintf(L")");
     }
 
     void PrintList(size_t cch, const SValue *pValue)
@@ -3500,15 +4181,19 @@ namespace
         wprintf(L"   -wicmulti           When writing images with WIC encode multiframe images\n");
         wprintf(L"\n   -nologo             suppress copyright message\n");
         wprintf(L"   -timing             Display elapsed processing time\n\n");
-#ifdef _OPENMP
         wprintf(L"   -singleproc         Do not use multi-threaded compression\n");
-#endif
+        wprintf(L"   -j <n>              Process <n> files at once, printing results in input order\n");
+        wprintf(L"                       (0 uses one thread per logical processor)\n");
+        wprintf(L"   -serve              Read requests from stdin, one \"<files> [options]\" per line,\n");
+        wprintf(L"                       and write one tab-separated result per file to stdout:\n");
+        wprintf(L"                       file, status, format, total blocks, block counts\n");
+        wprintf(L"                       (-j and -cache are fixed at startup)\n");
         wprintf(L"   -gpu <adapter>      Select GPU for DirectCompute-based codecs (0 is default)\n");
         wprintf(L"   -nogpu              Do not use DirectCompute-based codecs\n");
         wprintf(
             L"\n   -bc <options>       Sets options for BC compression\n"
             L"                       options must be one or more of\n"
-            L"                          d, u, q, x\n");
+            L"                          d, u, q, x, m, f, r, 0-4 (BC7 level, fastest to default)\n");
         wprintf(
             L"   -aw <weight>        BC7 GPU compressor weighting for alpha error metric\n"
             L"                       (defaults to 1.0)\n");
@@ -3520,6 +4205,18 @@ namespace
         wprintf(L"   -inverty            Invert Y (i.e. green) channel values\n");
         wprintf(L"   -reconstructz       Rebuild Z (blue) channel assuming X/Y are normals\n");
         wprintf(L"   -swizzle <rgba>     Swizzle image channels using HLSL-style mask\n");
+        wprintf(L"\n   -fullencode         Run the full BC3 encode before analysis instead of\n");
+        wprintf(L"                       classifying the alpha blocks directly\n");
+        wprintf(L"   -fullpipeline       Run every texconv stage (mips, alpha mode, all subresources)\n");
+        wprintf(L"                       even when the analysis only reads the top mip, and read\n");
+        wprintf(L"                       the pixels of files whose header settles the analysis\n");
+        wprintf(L"   -stopatverdict      Stop the analysis once both block types have been found\n");
+        wprintf(L"                       (BC1, BC3, BC4, BC5), visiting blocks spread over the image\n");
+        wprintf(L"   -cache <file>       Reuse analysis results for unchanged files and options,\n");
+        wprintf(L"                       keeping them in the index <file> (fixed at -serve startup)\n");
+        wprintf(L"   -sample <blocks>    Estimate the block counts (BC1, BC3, BC4, BC5) from a fixed\n");
+        wprintf(L"                       sample of blocks spread over the image, scanning every block\n");
+        wprintf(L"                       only when the sample misses a block type\n");
 
         wprintf(L"\n   <format>: ");
         PrintList(13, g_pFormats);
@@ -3694,768 +4391,1199 @@ namespace
         }
     }
 
-    const XMVECTORF32 c_MaxNitsFor2084 = { { { 10000.0f, 10000.0f, 10000.0f, 1.f } } };
+    const XMVECTORF32 c_MaxNitsFor2084 = { { { 10000.0f, 10000.0f, 10000.0f, 1.f } } };
+
+    const XMMATRIX c_from709to2020 =
+    {
+        0.6274040f, 0.0690970f, 0.0163916f, 0.f,
+        0.3292820f, 0.9195400f, 0.0880132f, 0.f,
+        0.0433136f, 0.0113612f, 0.8955950f, 0.f,
+        0.f,        0.f,        0.f,        1.f
+    };
+
+    const XMMATRIX c_from2020to709 =
+    {
+        1.6604910f,  -0.1245505f, -0.0181508f, 0.f,
+        -0.5876411f,  1.1328999f, -0.1005789f, 0.f,
+        -0.0728499f, -0.0083494f,  1.1187297f, 0.f,
+        0.f,          0.f,         0.f,        1.f
+    };
+
+    const XMMATRIX c_fromP3to2020 =
+    {
+        0.753845f, 0.0457456f, -0.00121055f, 0.f,
+        0.198593f, 0.941777f,   0.0176041f,  0.f,
+        0.047562f, 0.0124772f,  0.983607f,   0.f,
+        0.f,       0.f,         0.f,         1.f
+    };
+
+    inline float LinearToST2084(float normalizedLinearValue)
+    {
+        float ST2084 = pow((0.8359375f + 18.8515625f * pow(abs(normalizedLinearValue), 0.1593017578f)) / (1.0f + 18.6875f * pow(abs(normalizedLinearValue), 0.1593017578f)), 78.84375f);
+        return ST2084;  // Don't clamp between [0..1], so we can still perform operations on scene values higher than 10,000 nits
+    }
+
+    inline float ST2084ToLinear(float ST2084)
+    {
+        float normalizedLinear = pow(std::max(pow(abs(ST2084), 1.0f / 78.84375f) - 0.8359375f, 0.0f) / (18.8515625f - 18.6875f * pow(abs(ST2084), 1.0f / 78.84375f)), 1.0f / 0.1593017578f);
+        return normalizedLinear;
+    }
+
+    bool ParseSwizzleMask(_In_reads_(4) const wchar_t* mask, _Out_writes_(4) uint32_t* swizzleElements)
+    {
+        if (!mask || !swizzleElements)
+            return false;
+
+        if (!mask[0])
+            return false;
+
+        for (size_t j = 0; j < 4; ++j)
+        {
+            if (!mask[j])
+                break;
+
+            switch (mask[j])
+            {
+            case L'R':
+            case L'X':
+            case L'r':
+            case L'x':
+                for (size_t k = j; k < 4; ++k)
+                    swizzleElements[k] = 0;
+                break;
+
+            case L'G':
+            case L'Y':
+            case L'g':
+            case L'y':
+                for (size_t k = j; k < 4; ++k)
+                    swizzleElements[k] = 1;
+                break;
+
+            case L'B':
+            case L'Z':
+            case L'b':
+            case L'z':
+                for (size_t k = j; k < 4; ++k)
+                    swizzleElements[k] = 2;
+                break;
+
+            case L'A':
+            case L'W':
+            case L'a':
+            case L'w':
+                for (size_t k = j; k < 4; ++k)
+                    swizzleElements[k] = 3;
+                break;
+
+            default:
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+#ifdef _PREFAST_
+#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+#endif
+
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    // Parameters (set to their defaults by parseCommandLine)
+    size_t width;
+    size_t height;
+    size_t mipLevels;
+    DXGI_FORMAT format;
+    TEX_FILTER_FLAGS dwFilter;
+    TEX_FILTER_FLAGS dwSRGB;
+    TEX_FILTER_FLAGS dwConvert;
+    TEX_COMPRESS_FLAGS dwCompress;
+    TEX_FILTER_FLAGS dwFilterOpts;
+    DWORD FileType;
+    DWORD maxSize;
+    int adapter;
+    float alphaThreshold;
+    float alphaWeight;
+    CNMAP_FLAGS dwNormalMap;
+    float nmapAmplitude;
+    float wicQuality;
+    DWORD colorKey;
+    DWORD dwRotateColor;
+    float paperWhiteNits;
+    float preserveAlphaCoverageRef;
+    bool keepRecursiveDirs;
+    uint32_t swizzleElements[4];
+    unsigned int jobs;
+    size_t sampleBlocks;
+
+    wchar_t szPrefix[MAX_PATH];
+    wchar_t szSuffix[MAX_PATH];
+    wchar_t szOutputDir[MAX_PATH];
+    wchar_t szCacheFile[MAX_PATH];
+
+    std::bitset<OPT_MAX> dwOptions;
+    bool analysisOnly;
+    uint64_t optionsHash;
+
+    // Initialize COM (needed for WIC)
+    {
+        const HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        if (FAILED(hr))
+        {
+            wprintf(L"Failed to initialize COM (%08X)\n", static_cast<unsigned int>(hr));
+            return 1;
+        }
+    }
+
+    // Arguments past these come from a -serve request line
+    const int startupArgCount = argc;
+
+    // Process command line. With -serve this runs again for each request, using the startup
+    // arguments followed by the options from the request line.
+    auto parseCommandLine = [&](int argCount, wchar_t* args[], std::list<SConversion>& conversion, bool serveRequest) -> int
+    {
+        auto usage = [serveRequest]()
+        {
+            // Requests only report the error
+            if (!serveRequest)
+                PrintUsage();
+        };
+
+        // Defaults
+        width = 0;
+        height = 0;
+        mipLevels = 0;
+        format = DXGI_FORMAT_UNKNOWN;
+        dwFilter = TEX_FILTER_DEFAULT;
+        dwSRGB = TEX_FILTER_DEFAULT;
+        dwConvert = TEX_FILTER_DEFAULT;
+        dwCompress = TEX_COMPRESS_DEFAULT;
+        dwFilterOpts = TEX_FILTER_DEFAULT;
+        FileType = CODEC_DDS;
+        maxSize = 16384;
+        adapter = -1;
+        alphaThreshold = TEX_THRESHOLD_DEFAULT;
+        alphaWeight = 1.f;
+        dwNormalMap = CNMAP_DEFAULT;
+        nmapAmplitude = 1.f;
+        wicQuality = -1.f;
+        colorKey = 0;
+        dwRotateColor = 0;
+        paperWhiteNits = 200.f;
+        preserveAlphaCoverageRef = 0.0f;
+        keepRecursiveDirs = false;
+        swizzleElements[0] = 0;
+        swizzleElements[1] = 1;
+        swizzleElements[2] = 2;
+        swizzleElements[3] = 3;
+        jobs = 1;
+        sampleBlocks = 0;
+        *szPrefix = 0;
+        *szSuffix = 0;
+        *szOutputDir = 0;
+        *szCacheFile = 0;
+        dwOptions.reset();
+
+        for (int iArg = 1; iArg < argCount; iArg++)
+        {
+            PWSTR pArg = args[iArg];
+
+            if (('-' == pArg[0]) || ('/' == pArg[0]))
+            {
+                pArg++;
+
+                // Also accept the --option spelling
+                if ('-' == pArg[0])
+                    pArg++;
+
+                PWSTR pValue;
+
+                for (pValue = pArg; *pValue && (':' != *pValue); pValue++);
+
+                if (*pValue)
+                    *pValue++ = 0;
+
+                DWORD dwOption = LookupByName(pArg, g_pOptions);
+
+                // Request lines in -serve mode may override the startup options
+                if (!dwOption || (!serveRequest && dwOptions[dwOption]))
+                {
+                    usage();
+                    return 1;
+                }
+
+                dwOptions.set(dwOption);
+
+                // Handle options with additional value parameter
+                switch (dwOption)
+                {
+                case OPT_WIDTH:
+                case OPT_HEIGHT:
+                case OPT_MIPLEVELS:
+                case OPT_FORMAT:
+                case OPT_FILTER:
+                case OPT_PREFIX:
+                case OPT_SUFFIX:
+                case OPT_OUTPUTDIR:
+                case OPT_FILETYPE:
+                case OPT_GPU:
+                case OPT_FEATURE_LEVEL:
+                case OPT_ALPHA_THRESHOLD:
+                case OPT_ALPHA_WEIGHT:
+                case OPT_NORMAL_MAP:
+                case OPT_NORMAL_MAP_AMPLITUDE:
+                case OPT_WIC_QUALITY:
+                case OPT_BC_COMPRESS:
+                case OPT_COLORKEY:
+                case OPT_FILELIST:
+                case OPT_ROTATE_COLOR:
+                case OPT_PAPER_WHITE_NITS:
+                case OPT_PRESERVE_ALPHA_COVERAGE:
+                case OPT_SWIZZLE:
+                case OPT_JOBS:
+                case OPT_CACHE:
+                case OPT_SAMPLE:
+                    // These support either "-arg:value" or "-arg value"
+                    if (!*pValue)
+                    {
+                        if ((iArg + 1 >= argCount))
+                        {
+                            usage();
+                            return 1;
+                        }
+
+                        iArg++;
+                        pValue = args[iArg];
+                    }
+                    break;
+                }
+
+                switch (dwOption)
+                {
+                case OPT_WIDTH:
+                    if (swscanf_s(pValue, L"%zu", &width) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -w (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_HEIGHT:
+                    if (swscanf_s(pValue, L"%zu", &height) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -h (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_MIPLEVELS:
+                    if (swscanf_s(pValue, L"%zu", &mipLevels) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -m (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_FORMAT:
+                    format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormats));
+                    if (!format)
+                    {
+                        format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormatAliases));
+                        if (!format)
+                        {
+                            OutputPrintf(L"Invalid value specified with -f (%ls)\n", pValue);
+                            OutputPrintf(L"\n");
+                            usage();
+                            return 1;
+                        }
+                    }
+                    break;
+
+                case OPT_FILTER:
+                    dwFilter = static_cast<TEX_FILTER_FLAGS>(LookupByName(pValue, g_pFilters));
+                    if (!dwFilter)
+                    {
+                        OutputPrintf(L"Invalid value specified with -if (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_ROTATE_COLOR:
+                    dwRotateColor = LookupByName(pValue, g_pRotateColor);
+                    if (!dwRotateColor)
+                    {
+                        OutputPrintf(L"Invalid value specified with -rotatecolor (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_SRGBI:
+                    dwSRGB |= TEX_FILTER_SRGB_IN;
+                    break;
+
+                case OPT_SRGBO:
+                    dwSRGB |= TEX_FILTER_SRGB_OUT;
+                    break;
+
+                case OPT_SRGB:
+                    dwSRGB |= TEX_FILTER_SRGB;
+                    break;
+
+                case OPT_SEPALPHA:
+                    dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
+                    break;
+
+                case OPT_NO_WIC:
+                    dwFilterOpts |= TEX_FILTER_FORCE_NON_WIC;
+                    break;
+
+                case OPT_PREFIX:
+                    wcscpy_s(szPrefix, MAX_PATH, pValue);
+                    break;
+
+                case OPT_SUFFIX:
+                    wcscpy_s(szSuffix, MAX_PATH, pValue);
+                    break;
+
+                case OPT_OUTPUTDIR:
+                    wcscpy_s(szOutputDir, MAX_PATH, pValue);
+                    break;
+
+                case OPT_CACHE:
+                    wcscpy_s(szCacheFile, MAX_PATH, pValue);
+                    break;
+
+                case OPT_FILETYPE:
+                    FileType = LookupByName(pValue, g_pSaveFileTypes);
+                    if (!FileType)
+                    {
+                        OutputPrintf(L"Invalid value specified with -ft (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_PREMUL_ALPHA:
+                    if (dwOptions[OPT_DEMUL_ALPHA])
+                    {
+                        OutputPrintf(L"Can't use -pmalpha and -alpha at same time\n\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_DEMUL_ALPHA:
+                    if (dwOptions[OPT_PREMUL_ALPHA])
+                    {
+                        OutputPrintf(L"Can't use -pmalpha and -alpha at same time\n\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+
+                case OPT_TA_WRAP:
+                    if (dwFilterOpts & TEX_FILTER_MIRROR)
+                    {
+                        OutputPrintf(L"Can't use -wrap and -mirror at same time\n\n");
+                        usage();
+                        return 1;
+                    }
+                    dwFilterOpts |= TEX_FILTER_WRAP;
+                    break;
+
+                case OPT_TA_MIRROR:
+                    if (dwFilterOpts & TEX_FILTER_WRAP)
+                    {
+                        OutputPrintf(L"Can't use -wrap and -mirror at same time\n\n");
+                        usage();
+                        return 1;
+                    }
+                    dwFilterOpts |= TEX_FILTER_MIRROR;
+                    break;
+
+                case OPT_NORMAL_MAP:
+                {
+                    dwNormalMap = CNMAP_DEFAULT;
+
+                    if (wcschr(pValue, L'l'))
+                    {
+                        dwNormalMap |= CNMAP_CHANNEL_LUMINANCE;
+                    }
+                    else if (wcschr(pValue, L'r'))
+                    {
+                        dwNormalMap |= CNMAP_CHANNEL_RED;
+                    }
+                    else if (wcschr(pValue, L'g'))
+                    {
+                        dwNormalMap |= CNMAP_CHANNEL_GREEN;
+                    }
+                    else if (wcschr(pValue, L'b'))
+                    {
+                        dwNormalMap |= CNMAP_CHANNEL_BLUE;
+                    }
+                    else if (wcschr(pValue, L'a'))
+                    {
+                        dwNormalMap |= CNMAP_CHANNEL_ALPHA;
+                    }
+                    else
+                    {
+                        OutputPrintf(L"Invalid value specified for -nmap (%ls), missing l, r, g, b, or a\n\n", pValue);
+                        return 1;
+                    }
+
+                    if (wcschr(pValue, L'm'))
+                    {
+                        dwNormalMap |= CNMAP_MIRROR;
+                    }
+                    else
+                    {
+                        if (wcschr(pValue, L'u'))
+                        {
+                            dwNormalMap |= CNMAP_MIRROR_U;
+                        }
+                        if (wcschr(pValue, L'v'))
+                        {
+                            dwNormalMap |= CNMAP_MIRROR_V;
+                        }
+                    }
+
+                    if (wcschr(pValue, L'i'))
+                    {
+                        dwNormalMap |= CNMAP_INVERT_SIGN;
+                    }
 
-    const XMMATRIX c_from709to2020 =
-    {
-        0.6274040f, 0.0690970f, 0.0163916f, 0.f,
-        0.3292820f, 0.9195400f, 0.0880132f, 0.f,
-        0.0433136f, 0.0113612f, 0.8955950f, 0.f,
-        0.f,        0.f,        0.f,        1.f
-    };
+                    if (wcschr(pValue, L'o'))
+                    {
+                        dwNormalMap |= CNMAP_COMPUTE_OCCLUSION;
+                    }
+                }
+                break;
 
-    const XMMATRIX c_from2020to709 =
-    {
-        1.6604910f,  -0.1245505f, -0.0181508f, 0.f,
-        -0.5876411f,  1.1328999f, -0.1005789f, 0.f,
-        -0.0728499f, -0.0083494f,  1.1187297f, 0.f,
-        0.f,          0.f,         0.f,        1.f
-    };
+                case OPT_NORMAL_MAP_AMPLITUDE:
+                    if (!dwNormalMap)
+                    {
+                        OutputPrintf(L"-nmapamp requires -nmap\n\n");
+                        usage();
+                        return 1;
+                    }
+                    else if (swscanf_s(pValue, L"%f", &nmapAmplitude) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -nmapamp (%ls)\n\n", pValue);
+                        usage();
+                        return 1;
+                    }
+                    else if (nmapAmplitude < 0.f)
+                    {
+                        OutputPrintf(L"Normal map amplitude must be positive (%ls)\n\n", pValue);
+                        return 1;
+                    }
+                    break;
 
-    const XMMATRIX c_fromP3to2020 =
-    {
-        0.753845f, 0.0457456f, -0.00121055f, 0.f,
-        0.198593f, 0.941777f,   0.0176041f,  0.f,
-        0.047562f, 0.0124772f,  0.983607f,   0.f,
-        0.f,       0.f,         0.f,         1.f
-    };
+                case OPT_GPU:
+                    if (swscanf_s(pValue, L"%d", &adapter) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -gpu (%ls)\n\n", pValue);
+                        usage();
+                        return 1;
+                    }
+                    else if (adapter < 0)
+                    {
+                        OutputPrintf(L"Invalid adapter index (%ls)\n\n", pValue);
+                        usage();
+                        return 1;
+                    }
+                    break;
 
-    inline float LinearToST2084(float normalizedLinearValue)
-    {
-        float ST2084 = pow((0.8359375f + 18.8515625f * pow(abs(normalizedLinearValue), 0.1593017578f)) / (1.0f + 18.6875f * pow(abs(normalizedLinearValue), 0.1593017578f)), 78.84375f);
-        return ST2084;  // Don't clamp between [0..1], so we can still perform operations on scene values higher than 10,000 nits
-    }
+                case OPT_FEATURE_LEVEL:
+                    maxSize = LookupByName(pValue, g_pFeatureLevels);
+                    if (!maxSize)
+                    {
+                        OutputPrintf(L"Invalid value specified with -fl (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
 
-    inline float ST2084ToLinear(float ST2084)
-    {
-        float normalizedLinear = pow(std::max(pow(abs(ST2084), 1.0f / 78.84375f) - 0.8359375f, 0.0f) / (18.8515625f - 18.6875f * pow(abs(ST2084), 1.0f / 78.84375f)), 1.0f / 0.1593017578f);
-        return normalizedLinear;
-    }
+                case OPT_ALPHA_THRESHOLD:
+                    if (swscanf_s(pValue, L"%f", &alphaThreshold) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -at (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    else if (alphaThreshold < 0.f)
+                    {
+                        OutputPrintf(L"-at (%ls) parameter must be positive\n", pValue);
+                        OutputPrintf(L"\n");
+                        return 1;
+                    }
+                    break;
 
-    bool ParseSwizzleMask(_In_reads_(4) const wchar_t* mask, _Out_writes_(4) uint32_t* swizzleElements)
-    {
-        if (!mask || !swizzleElements)
-            return false;
+                case OPT_ALPHA_WEIGHT:
+                    if (swscanf_s(pValue, L"%f", &alphaWeight) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -aw (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    else if (alphaWeight < 0.f)
+                    {
+                        OutputPrintf(L"-aw (%ls) parameter must be positive\n", pValue);
+                        OutputPrintf(L"\n");
+                        return 1;
+                    }
+                    break;
 
-        if (!mask[0])
-            return false;
+                case OPT_BC_COMPRESS:
+                {
+                    dwCompress = TEX_COMPRESS_DEFAULT;
 
-        for (size_t j = 0; j < 4; ++j)
-        {
-            if (!mask[j])
-                break;
+                    bool found = false;
+                    if (wcschr(pValue, L'u'))
+                    {
+                        dwCompress |= TEX_COMPRESS_UNIFORM;
+                        found = true;
+                    }
 
-            switch (mask[j])
-            {
-            case L'R':
-            case L'X':
-            case L'r':
-            case L'x':
-                for (size_t k = j; k < 4; ++k)
-                    swizzleElements[k] = 0;
-                break;
+                    if (wcschr(pValue, L'd'))
+                    {
+                        dwCompress |= TEX_COMPRESS_DITHER;
+                        found = true;
+                    }
 
-            case L'G':
-            case L'Y':
-            case L'g':
-            case L'y':
-                for (size_t k = j; k < 4; ++k)
-                    swizzleElements[k] = 1;
-                break;
+                    if (wcschr(pValue, L'q'))
+                    {
+                        dwCompress |= TEX_COMPRESS_BC7_QUICK;
+                        found = true;
+                    }
 
-            case L'B':
-            case L'Z':
-            case L'b':
-            case L'z':
-                for (size_t k = j; k < 4; ++k)
-                    swizzleElements[k] = 2;
-                break;
+                    if (wcschr(pValue, L'x'))
+                    {
+                        dwCompress |= TEX_COMPRESS_BC7_USE_3SUBSETS;
+                        found = true;
+                    }
 
-            case L'A':
-            case L'W':
-            case L'a':
-            case L'w':
-                for (size_t k = j; k < 4; ++k)
-                    swizzleElements[k] = 3;
-                break;
+                    if (wcschr(pValue, L'm'))
+                    {
+                        dwCompress |= TEX_COMPRESS_MULTIBLOCK;
+                        found = true;
+                    }
 
-            default:
-                return false;
-            }
-        }
+                    if (wcschr(pValue, L'f'))
+                    {
+                        dwCompress |= TEX_COMPRESS_BC6H_FAST;
+                        found = true;
+                    }
 
-        return true;
-    }
-}
+                    if (wcschr(pValue, L'r'))
+                    {
+                        dwCompress |= TEX_COMPRESS_MEMOIZE;
+                        found = true;
+                    }
 
-//--------------------------------------------------------------------------------------
-// Entry-point
-//--------------------------------------------------------------------------------------
-#ifdef _PREFAST_
-#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
-#endif
+                    const wchar_t* level = wcspbrk(pValue, L"01234");
+                    if (level)
+                    {
+                        dwCompress |= static_cast<TEX_COMPRESS_FLAGS>(TEX_COMPRESS_BC7_LEVEL_0 * static_cast<uint32_t>(*level - L'0' + 1));
+                        found = true;
+                    }
 
-int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
-{
-    // Parameters and defaults
-    size_t width = 0;
-    size_t height = 0;
-    size_t mipLevels = 0;
-    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-    TEX_FILTER_FLAGS dwFilter = TEX_FILTER_DEFAULT;
-    TEX_FILTER_FLAGS dwSRGB = TEX_FILTER_DEFAULT;
-    TEX_FILTER_FLAGS dwConvert = TEX_FILTER_DEFAULT;
-    TEX_COMPRESS_FLAGS dwCompress = TEX_COMPRESS_DEFAULT;
-    TEX_FILTER_FLAGS dwFilterOpts = TEX_FILTER_DEFAULT;
-    DWORD FileType = CODEC_DDS;
-    DWORD maxSize = 16384;
-    int adapter = -1;
-    float alphaThreshold = TEX_THRESHOLD_DEFAULT;
-    float alphaWeight = 1.f;
-    CNMAP_FLAGS dwNormalMap = CNMAP_DEFAULT;
-    float nmapAmplitude = 1.f;
-    float wicQuality = -1.f;
-    DWORD colorKey = 0;
-    DWORD dwRotateColor = 0;
-    float paperWhiteNits = 200.f;
-    float preserveAlphaCoverageRef = 0.0f;
-    bool keepRecursiveDirs = false;
-    uint32_t swizzleElements[4] = { 0, 1, 2, 3 };
-
-    wchar_t szPrefix[MAX_PATH] = {};
-    wchar_t szSuffix[MAX_PATH] = {};
-    wchar_t szOutputDir[MAX_PATH] = {};
+                    if ((dwCompress & (TEX_COMPRESS_BC7_QUICK | TEX_COMPRESS_BC7_USE_3SUBSETS)) == (TEX_COMPRESS_BC7_QUICK | TEX_COMPRESS_BC7_USE_3SUBSETS))
+                    {
+                        OutputPrintf(L"Can't use -bc x (max) and -bc q (quick) at same time\n\n");
+                        usage();
+                        return 1;
+                    }
 
-    // Initialize COM (needed for WIC)
-    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-    if (FAILED(hr))
-    {
-        wprintf(L"Failed to initialize COM (%08X)\n", static_cast<unsigned int>(hr));
-        return 1;
-    }
+                    if ((dwCompress & TEX_COMPRESS_BC7_QUICK) && (dwCompress & TEX_COMPRESS_BC7_LEVEL_MASK))
+                    {
+                        OutputPrintf(L"Can't use a BC7 level (0-4) and -bc q (quick) at same time\n\n");
+                        usage();
+                        return 1;
+                    }
 
-    // Process command line
-    DWORD64 dwOptions = 0;
-    std::list<SConversion> conversion;
+                    if (!found)
+                    {
+                        OutputPrintf(L"Invalid value specified for -bc (%ls), missing d, u, q, x, m, f, r, or a level 0-4\n\n", pValue);
+                        return 1;
+                    }
+                }
+                break;
 
-    for (int iArg = 1; iArg < argc; iArg++)
-    {
-        PWSTR pArg = argv[iArg];
+                case OPT_WIC_QUALITY:
+                    if (swscanf_s(pValue, L"%f", &wicQuality) != 1
+                        || (wicQuality < 0.f)
+                        || (wicQuality > 1.f))
+                    {
+                        OutputPrintf(L"Invalid value specified with -wicq (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
 
-        if (('-' == pArg[0]) || ('/' == pArg[0]))
-        {
-            pArg++;
-            PWSTR pValue;
+                case OPT_COLORKEY:
+                    if (swscanf_s(pValue, L"%lx", &colorKey) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -c (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    colorKey &= 0xFFFFFF;
+                    break;
 
-            for (pValue = pArg; *pValue && (':' != *pValue); pValue++);
+                case OPT_X2_BIAS:
+                    dwConvert |= TEX_FILTER_FLOAT_X2BIAS;
+                    break;
 
-            if (*pValue)
-                *pValue++ = 0;
+                case OPT_USE_DX10:
+                    if (dwOptions[OPT_USE_DX9])
+                    {
+                        OutputPrintf(L"Can't use -dx9 and -dx10 at same time\n\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
 
-            DWORD dwOption = LookupByName(pArg, g_pOptions);
+                case OPT_USE_DX9:
+                    if (dwOptions[OPT_USE_DX10])
+                    {
+                        OutputPrintf(L"Can't use -dx9 and -dx10 at same time\n\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
 
-            if (!dwOption || (dwOptions & (DWORD64(1) << dwOption)))
-            {
-                PrintUsage();
-                return 1;
-            }
+                case OPT_RECURSIVE:
+                    if (*pValue)
+                    {
+                        // This option takes 'flatten' or 'keep' with ':' syntax
+                        if (!_wcsicmp(pValue, L"keep"))
+                        {
+                            keepRecursiveDirs = true;
+                        }
+                        else if (_wcsicmp(pValue, L"flatten") != 0)
+                        {
+                            OutputPrintf(L"For recursive use -r, -r:flatten, or -r:keep\n\n");
+                            usage();
+                            return 1;
+                        }
+                    }
+                    break;
 
-            dwOptions |= (DWORD64(1) << dwOption);
-
-            // Handle options with additional value parameter
-            switch (dwOption)
-            {
-            case OPT_WIDTH:
-            case OPT_HEIGHT:
-            case OPT_MIPLEVELS:
-            case OPT_FORMAT:
-            case OPT_FILTER:
-            case OPT_PREFIX:
-            case OPT_SUFFIX:
-            case OPT_OUTPUTDIR:
-            case OPT_FILETYPE:
-            case OPT_GPU:
-            case OPT_FEATURE_LEVEL:
-            case OPT_ALPHA_THRESHOLD:
-            case OPT_ALPHA_WEIGHT:
-            case OPT_NORMAL_MAP:
-            case OPT_NORMAL_MAP_AMPLITUDE:
-            case OPT_WIC_QUALITY:
-            case OPT_BC_COMPRESS:
-            case OPT_COLORKEY:
-            case OPT_FILELIST:
-            case OPT_ROTATE_COLOR:
-            case OPT_PAPER_WHITE_NITS:
-            case OPT_PRESERVE_ALPHA_COVERAGE:
-            case OPT_SWIZZLE:
-                // These support either "-arg:value" or "-arg value"
-                if (!*pValue)
+                case OPT_FILELIST:
                 {
-                    if ((iArg + 1 >= argc))
+                    std::wifstream inFile(pValue);
+                    if (!inFile)
                     {
-                        PrintUsage();
+                        OutputPrintf(L"Error opening -flist file %ls\n", pValue);
                         return 1;
                     }
+                    wchar_t fname[1024] = {};
+                    for (;;)
+                    {
+                        inFile >> fname;
+                        if (!inFile)
+                            break;
 
-                    iArg++;
-                    pValue = argv[iArg];
-                }
-                break;
-            }
+                        if (*fname == L'#')
+                        {
+                            // Comment
+                        }
+                        else if (*fname == L'-')
+                        {
+                            OutputPrintf(L"Command-line arguments not supported in -flist file\n");
+                            return 1;
+                        }
+                        else if (wcspbrk(fname, L"?*") != nullptr)
+                        {
+                            OutputPrintf(L"Wildcards not supported in -flist file\n");
+                            return 1;
+                        }
+                        else
+                        {
+                            SConversion conv = {};
+                            wcscpy_s(conv.szSrc, MAX_PATH, fname);
+                            conversion.push_back(conv);
+                        }
 
-            switch (dwOption)
-            {
-            case OPT_WIDTH:
-                if (swscanf_s(pValue, L"%zu", &width) != 1)
-                {
-                    wprintf(L"Invalid value specified with -w (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
+                        inFile.ignore(1000, '\n');
+                    }
+                    inFile.close();
                 }
                 break;
 
-            case OPT_HEIGHT:
-                if (swscanf_s(pValue, L"%zu", &height) != 1)
-                {
-                    wprintf(L"Invalid value specified with -h (%ls)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+                case OPT_PAPER_WHITE_NITS:
+                    if (swscanf_s(pValue, L"%f", &paperWhiteNits) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -nits (%ls)\n\n", pValue);
+                        usage();
+                        return 1;
+                    }
+                    else if (paperWhiteNits > 10000.f || paperWhiteNits <= 0.f)
+                    {
+                        OutputPrintf(L"-nits (%ls) parameter must be between 0 and 10000\n\n", pValue);
+                        return 1;
+                    }
+                    break;
 
-            case OPT_MIPLEVELS:
-                if (swscanf_s(pValue, L"%zu", &mipLevels) != 1)
-                {
-                    wprintf(L"Invalid value specified with -m (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+                case OPT_PRESERVE_ALPHA_COVERAGE:
+                    if (swscanf_s(pValue, L"%f", &preserveAlphaCoverageRef) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -keepcoverage (%ls)\n\n", pValue);
+                        usage();
+                        return 1;
+                    }
+                    else if (preserveAlphaCoverageRef < 0.0f || preserveAlphaCoverageRef > 1.0f)
+                    {
+                        OutputPrintf(L"-keepcoverage (%ls) parameter must be between 0.0 and 1.0\n\n", pValue);
+                        return 1;
+                    }
+                    break;
 
-            case OPT_FORMAT:
-                format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormats));
-                if (!format)
-                {
-                    format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormatAliases));
-                    if (!format)
+                case OPT_SWIZZLE:
+                    if (!*pValue || wcslen(pValue) > 4)
                     {
-                        wprintf(L"Invalid value specified with -f (%ls)\n", pValue);
-                        wprintf(L"\n");
-                        PrintUsage();
+                        OutputPrintf(L"Invalid value specified with -swizzle (%ls)\n\n", pValue);
+                        usage();
                         return 1;
                     }
-                }
-                break;
+                    else if (!ParseSwizzleMask(pValue, swizzleElements))
+                    {
+                        OutputPrintf(L"-swizzle requires a 1 to 4 character mask composed of these letters: r, g, b, a, x, y, w, z\n");
+                        return 1;
+                    }
+                    break;
 
-            case OPT_FILTER:
-                dwFilter = static_cast<TEX_FILTER_FLAGS>(LookupByName(pValue, g_pFilters));
-                if (!dwFilter)
-                {
-                    wprintf(L"Invalid value specified with -if (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+                case OPT_JOBS:
+                    // The worker threads are created once at -serve startup
+                    if (serveRequest && iArg >= startupArgCount)
+                    {
+                        OutputPrintf(L"-j can't be changed by a -serve request\n");
+                        return 1;
+                    }
+                    if (swscanf_s(pValue, L"%u", &jobs) != 1)
+                    {
+                        OutputPrintf(L"Invalid value specified with -j (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    if (!jobs)
+                    {
+                        jobs = std::max(1u, std::thread::hardware_concurrency());
+                    }
+                    break;
 
-            case OPT_ROTATE_COLOR:
-                dwRotateColor = LookupByName(pValue, g_pRotateColor);
-                if (!dwRotateColor)
+                case OPT_SAMPLE:
+                    if (swscanf_s(pValue, L"%zu", &sampleBlocks) != 1 || !sampleBlocks)
+                    {
+                        OutputPrintf(L"Invalid value specified with -sample (%ls)\n", pValue);
+                        OutputPrintf(L"\n");
+                        usage();
+                        return 1;
+                    }
+                    break;
+                }
+            }
+            else if (wcspbrk(pArg, L"?*") != nullptr)
+            {
+                size_t count = conversion.size();
+                SearchForFiles(pArg, conversion, dwOptions[OPT_RECURSIVE], nullptr);
+                if (conversion.size() <= count)
                 {
-                    wprintf(L"Invalid value specified with -rotatecolor (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
+                    OutputPrintf(L"No matching files found for %ls\n", pArg);
                     return 1;
                 }
-                break;
+            }
+            else
+            {
+                SConversion conv = {};
+                wcscpy_s(conv.szSrc, MAX_PATH, pArg);
 
-            case OPT_SRGBI:
-                dwSRGB |= TEX_FILTER_SRGB_IN;
-                break;
+                conversion.push_back(conv);
+            }
+        }
 
-            case OPT_SRGBO:
-                dwSRGB |= TEX_FILTER_SRGB_OUT;
-                break;
+        // Work out out filename prefix and suffix
+        if (szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
+            wcscat_s(szOutputDir, MAX_PATH, L"\\");
 
-            case OPT_SRGB:
-                dwSRGB |= TEX_FILTER_SRGB;
-                break;
+        auto fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
 
-            case OPT_SEPALPHA:
-                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
-                break;
+        if (fileTypeName)
+        {
+            wcscat_s(szSuffix, MAX_PATH, L".");
+            wcscat_s(szSuffix, MAX_PATH, fileTypeName);
+        }
+        else
+        {
+            wcscat_s(szSuffix, MAX_PATH, L".unknown");
+        }
 
-            case OPT_NO_WIC:
-                dwFilterOpts |= TEX_FILTER_FORCE_NON_WIC;
-                break;
+        if (FileType != CODEC_DDS)
+        {
+            mipLevels = 1;
+        }
 
-            case OPT_PREFIX:
-                wcscpy_s(szPrefix, MAX_PATH, pValue);
-                break;
+        // The analysis only reads the top mip of the first item, so by default skip the stages
+        // that can't change it (mip generation, other subresources, alpha mode)
+        analysisOnly = !dwOptions[OPT_FULL_PIPELINE];
 
-            case OPT_SUFFIX:
-                wcscpy_s(szSuffix, MAX_PATH, pValue);
-                break;
+        // Result cache key for everything that can change the analysis, except the source file
+        {
+            ContentHasher hasher;
+            hasher.UpdateValue(width);
+            hasher.UpdateValue(height);
+            hasher.UpdateValue(mipLevels);
+            hasher.UpdateValue(format);
+            hasher.UpdateValue(dwFilter);
+            hasher.UpdateValue(dwSRGB);
+            hasher.UpdateValue(dwConvert);
+            hasher.UpdateValue(dwCompress);
+            hasher.UpdateValue(dwFilterOpts);
+            hasher.UpdateValue(FileType);
+            hasher.UpdateValue(maxSize);
+            hasher.UpdateValue(alphaThreshold);
+            hasher.UpdateValue(alphaWeight);
+            hasher.UpdateValue(dwNormalMap);
+            hasher.UpdateValue(nmapAmplitude);
+            hasher.UpdateValue(colorKey);
+            hasher.UpdateValue(dwRotateColor);
+            hasher.UpdateValue(paperWhiteNits);
+            hasher.UpdateValue(preserveAlphaCoverageRef);
+            hasher.UpdateValue(swizzleElements);
+            hasher.UpdateValue(sampleBlocks);
+
+            auto hashedOptions = dwOptions;
+            hashedOptions.reset(OPT_NOLOGO).reset(OPT_TIMING).reset(OPT_OVERWRITE).reset(OPT_PREFIX)
+                .reset(OPT_SUFFIX).reset(OPT_OUTPUTDIR).reset(OPT_JOBS).reset(OPT_SERVE).reset(OPT_CACHE);
+
+            const std::string optionBits = hashedOptions.to_string();
+            hasher.Update(optionBits.data(), optionBits.size());
+
+            optionsHash = hasher.Finalize();
+        }
 
-            case OPT_OUTPUTDIR:
-                wcscpy_s(szOutputDir, MAX_PATH, pValue);
-                break;
+        return 0;
+    };
 
-            case OPT_FILETYPE:
-                FileType = LookupByName(pValue, g_pSaveFileTypes);
-                if (!FileType)
-                {
-                    wprintf(L"Invalid value specified with -ft (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    // Keep a copy of the startup arguments, since parsing modifies them
+    std::vector<std::wstring> startupArgs(argv, argv + argc);
 
-            case OPT_PREMUL_ALPHA:
-                if (dwOptions & (DWORD64(1) << OPT_DEMUL_ALPHA))
-                {
-                    wprintf(L"Can't use -pmalpha and -alpha at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    std::list<SConversion> conversion;
+    {
+        const int result = parseCommandLine(argc, argv, conversion, false);
+        if (result)
+            return result;
+    }
 
-            case OPT_DEMUL_ALPHA:
-                if (dwOptions & (DWORD64(1) << OPT_PREMUL_ALPHA))
-                {
-                    wprintf(L"Can't use -pmalpha and -alpha at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    const bool serve = dwOptions[OPT_SERVE];
+    if (serve && !conversion.empty())
+    {
+        wprintf(L"-serve reads input files from stdin\n");
+        return 1;
+    }
 
-            case OPT_TA_WRAP:
-                if (dwFilterOpts & TEX_FILTER_MIRROR)
-                {
-                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_WRAP;
-                break;
+    if (conversion.empty() && !serve)
+    {
+        PrintUsage();
+        return 0;
+    }
 
-            case OPT_TA_MIRROR:
-                if (dwFilterOpts & TEX_FILTER_WRAP)
-                {
-                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_MIRROR;
-                break;
+    // Only result records are written to stdout with -serve
+    if (!serve && !dwOptions[OPT_NOLOGO])
+        PrintLogo();
 
-            case OPT_NORMAL_MAP:
-            {
-                dwNormalMap = CNMAP_DEFAULT;
+    // Opened once, so -cache in a -serve request is ignored
+    ResultCache cache;
+    bool useCache = false;
+    if (*szCacheFile)
+    {
+        const HRESULT hr = cache.Open(szCacheFile);
+        if (FAILED(hr))
+        {
+            if (!serve)
+                wprintf(L"WARNING: Ignoring cache %ls (%08X)\n", szCacheFile, static_cast<unsigned int>(hr));
+        }
+        else
+        {
+            useCache = true;
+        }
+    }
 
-                if (wcschr(pValue, L'l'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_LUMINANCE;
-                }
-                else if (wcschr(pValue, L'r'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_RED;
-                }
-                else if (wcschr(pValue, L'g'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_GREEN;
-                }
-                else if (wcschr(pValue, L'b'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_BLUE;
-                }
-                else if (wcschr(pValue, L'a'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_ALPHA;
-                }
-                else
-                {
-                    wprintf(L"Invalid value specified for -nmap (%ls), missing l, r, g, b, or a\n\n", pValue);
-                    return 1;
-                }
+    LARGE_INTEGER qpcFreq;
+    if (!QueryPerformanceFrequency(&qpcFreq))
+    {
+        qpcFreq.QuadPart = 0;
+    }
 
-                if (wcschr(pValue, L'm'))
-                {
-                    dwNormalMap |= CNMAP_MIRROR;
-                }
-                else
-                {
-                    if (wcschr(pValue, L'u'))
-                    {
-                        dwNormalMap |= CNMAP_MIRROR_U;
-                    }
-                    if (wcschr(pValue, L'v'))
-                    {
-                        dwNormalMap |= CNMAP_MIRROR_V;
-                    }
-                }
+    LARGE_INTEGER qpcStart;
+    if (!QueryPerformanceCounter(&qpcStart))
+    {
+        qpcStart.QuadPart = 0;
+    }
 
-                if (wcschr(pValue, L'i'))
-                {
-                    dwNormalMap |= CNMAP_INVERT_SIGN;
-                }
+    // Convert images
+    std::atomic<bool> sizewarn(false);
+    std::atomic<bool> nonpow2warn(false);
+    std::atomic<bool> non4bc(false);
+    ComPtr<ID3D11Device> pDevice;
+    std::mutex deviceLock;
 
-                if (wcschr(pValue, L'o'))
-                {
-                    dwNormalMap |= CNMAP_COMPUTE_OCCLUSION;
-                }
-            }
-            break;
+    // Stages that can change the alpha values. With none of them requested, the BC3 alpha
+    // analysis can work from BC input blocks or from the file header alone.
+    auto alphaUnchangedFor = [&](const TexMetadata& mdata) -> bool
+    {
+        return !dwOptions[OPT_HFLIP] && !dwOptions[OPT_VFLIP]
+            && !dwOptions[OPT_FIT_POWEROF2] && !dwOptions[OPT_BCNONMULT4FIX]
+            && !dwOptions[OPT_TONEMAP] && !dwOptions[OPT_NORMAL_MAP] && !dwOptions[OPT_COLORKEY]
+            && !dwOptions[OPT_INVERT_Y] && !dwOptions[OPT_RECONSTRUCT_Z] && !dwOptions[OPT_PRESERVE_ALPHA_COVERAGE]
+            && !(width && width != mdata.width) && !(height && height != mdata.height)
+            && mdata.width <= maxSize && mdata.height <= maxSize
+            && swizzleElements[0] == 0 && swizzleElements[1] == 1 && swizzleElements[2] == 2 && swizzleElements[3] == 3
+            && !dwRotateColor;
+    };
 
-            case OPT_NORMAL_MAP_AMPLITUDE:
-                if (!dwNormalMap)
-                {
-                    wprintf(L"-nmapamp requires -nmap\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                else if (swscanf_s(pValue, L"%f", &nmapAmplitude) != 1)
-                {
-                    wprintf(L"Invalid value specified with -nmapamp (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                else if (nmapAmplitude < 0.f)
-                {
-                    wprintf(L"Normal map amplitude must be positive (%ls)\n\n", pValue);
-                    return 1;
-                }
-                break;
+    // Analyzes the blocks of a BC image, from a sample when that settles the verdict
+    auto analyzeBC = [&](const Image& img, texdiag::AnalyzeBCData& data) -> HRESULT
+    {
+        if (sampleBlocks)
+        {
+            const HRESULT hrSample = texdiag::AnalyzeBC(img, data, false, sampleBlocks);
+            if (FAILED(hrSample) || !data.sampled || texdiag::VerdictReached(img.format, data))
+                return hrSample;
 
-            case OPT_GPU:
-                if (swscanf_s(pValue, L"%d", &adapter) != 1)
-                {
-                    wprintf(L"Invalid value specified with -gpu (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                else if (adapter < 0)
-                {
-                    wprintf(L"Invalid adapter index (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+            // The sample missed a block type that could still be in the image
+        }
 
-            case OPT_FEATURE_LEVEL:
-                maxSize = LookupByName(pValue, g_pFeatureLevels);
-                if (!maxSize)
-                {
-                    wprintf(L"Invalid value specified with -fl (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        return texdiag::AnalyzeBC(img, data, dwOptions[OPT_STOP_AT_VERDICT]);
+    };
 
-            case OPT_ALPHA_THRESHOLD:
-                if (swscanf_s(pValue, L"%f", &alphaThreshold) != 1)
-                {
-                    wprintf(L"Invalid value specified with -at (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                else if (alphaThreshold < 0.f)
-                {
-                    wprintf(L"-at (%ls) parameter must be positive\n", pValue);
-                    wprintf(L"\n");
-                    return 1;
-                }
-                break;
+    // Header triage only applies to the BC3 alpha analysis of an explicit BC3 target
+    auto canTriage = [&]() -> bool
+    {
+        return analysisOnly && (format == DXGI_FORMAT_BC3_UNORM || format == DXGI_FORMAT_BC3_UNORM_SRGB)
+            && (FileType == CODEC_DDS) && !dwOptions[OPT_FULL_ENCODE];
+    };
 
-            case OPT_ALPHA_WEIGHT:
-                if (swscanf_s(pValue, L"%f", &alphaWeight) != 1)
-                {
-                    wprintf(L"Invalid value specified with -aw (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                else if (alphaWeight < 0.f)
-                {
-                    wprintf(L"-aw (%ls) parameter must be positive\n", pValue);
-                    wprintf(L"\n");
-                    return 1;
-                }
-                break;
+    // Reads only the header of a DDS, TGA, or HDR file and decides if it settles the analysis.
+    // Anything that fails here is left to the full load, which reports the error.
+    auto triageFile = [&](const wchar_t* szFile, HeaderTriage& result)
+    {
+        result.settled = false;
 
-            case OPT_BC_COMPRESS:
-            {
-                dwCompress = TEX_COMPRESS_DEFAULT;
+        wchar_t ext[_MAX_EXT] = {};
+        _wsplitpath_s(szFile, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
 
-                bool found = false;
-                if (wcschr(pValue, L'u'))
-                {
-                    dwCompress |= TEX_COMPRESS_UNIFORM;
-                    found = true;
-                }
+        TexMetadata& mdata = result.info;
+        bool opaque = false;
 
-                if (wcschr(pValue, L'd'))
-                {
-                    dwCompress |= TEX_COMPRESS_DITHER;
-                    found = true;
-                }
+        if (_wcsicmp(ext, L".dds") == 0)
+        {
+            DDS_FLAGS ddsFlags = DDS_FLAGS_ALLOW_LARGE_FILES;
+            if (dwOptions[OPT_DDS_DWORD_ALIGN])
+                ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
+            if (dwOptions[OPT_EXPAND_LUMINANCE])
+                ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
+            if (dwOptions[OPT_DDS_BAD_DXTN_TAILS])
+                ddsFlags |= DDS_FLAGS_BAD_DXTN_TAILS;
 
-                if (wcschr(pValue, L'q'))
-                {
-                    dwCompress |= TEX_COMPRESS_BC7_QUICK;
-                    found = true;
-                }
+            if (FAILED(GetMetadataFromDDSFile(szFile, ddsFlags, mdata)))
+                return;
 
-                if (wcschr(pValue, L'x'))
+            if (IsTypeless(mdata.format))
+            {
+                if (dwOptions[OPT_TYPELESS_UNORM])
                 {
-                    dwCompress |= TEX_COMPRESS_BC7_USE_3SUBSETS;
-                    found = true;
+                    mdata.format = MakeTypelessUNORM(mdata.format);
                 }
-
-                if ((dwCompress & (TEX_COMPRESS_BC7_QUICK | TEX_COMPRESS_BC7_USE_3SUBSETS)) == (TEX_COMPRESS_BC7_QUICK | TEX_COMPRESS_BC7_USE_3SUBSETS))
+                else if (dwOptions[OPT_TYPELESS_FLOAT])
                 {
-                    wprintf(L"Can't use -bc x (max) and -bc q (quick) at same time\n\n");
-                    PrintUsage();
-                    return 1;
+                    mdata.format = MakeTypelessFLOAT(mdata.format);
                 }
 
-                if (!found)
-                {
-                    wprintf(L"Invalid value specified for -bc (%ls), missing d, u, q, or x\n\n", pValue);
-                    return 1;
-                }
+                if (IsTypeless(mdata.format))
+                    return;
             }
-            break;
 
-            case OPT_WIC_QUALITY:
-                if (swscanf_s(pValue, L"%f", &wicQuality) != 1
-                    || (wicQuality < 0.f)
-                    || (wicQuality > 1.f))
-                {
-                    wprintf(L"Invalid value specified with -wicq (%ls)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+            // The DDS header states the alpha mode, or implies opaque for legacy formats without alpha
+            opaque = (mdata.GetAlphaMode() == TEX_ALPHA_MODE_OPAQUE);
+        }
+        else if (_wcsicmp(ext, L".tga") == 0)
+        {
+            // A TGA extension area can mark real alpha data as opaque, so only the pixel depth
+            // is trusted. With TGA_FLAGS_BGR, 24-bit images report a format without alpha.
+            if (FAILED(GetMetadataFromTGAFile(szFile, TGA_FLAGS_BGR, mdata)))
+                return;
 
-            case OPT_COLORKEY:
-                if (swscanf_s(pValue, L"%lx", &colorKey) != 1)
-                {
-                    printf("Invalid value specified with -c (%ls)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
-                }
-                colorKey &= 0xFFFFFF;
+            switch (mdata.format)
+            {
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+                mdata.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+                mdata.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
+                opaque = true;
                 break;
 
-            case OPT_X2_BIAS:
-                dwConvert |= TEX_FILTER_FLOAT_X2BIAS;
+            case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+                mdata.format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+                mdata.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
+                opaque = true;
                 break;
 
-            case OPT_USE_DX10:
-                if (dwOptions & (DWORD64(1) << OPT_USE_DX9))
-                {
-                    wprintf(L"Can't use -dx9 and -dx10 at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+                // Loaded as R8G8B8A8, with pixel-dependent alpha
+                return;
 
-            case OPT_USE_DX9:
-                if (dwOptions & (DWORD64(1) << OPT_USE_DX10))
-                {
-                    wprintf(L"Can't use -dx9 and -dx10 at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
+            default:
                 break;
+            }
+        }
+        else if (_wcsicmp(ext, L".hdr") == 0)
+        {
+            // Radiance RGBE has no alpha
+            if (FAILED(GetMetadataFromHDRFile(szFile, mdata)))
+                return;
 
-            case OPT_RECURSIVE:
-                if (*pValue)
-                {
-                    // This option takes 'flatten' or 'keep' with ':' syntax
-                    if (!_wcsicmp(pValue, L"keep"))
-                    {
-                        keepRecursiveDirs = true;
-                    }
-                    else if (_wcsicmp(pValue, L"flatten") != 0)
-                    {
-                        wprintf(L"For recursive use -r, -r:flatten, or -r:keep\n\n");
-                        PrintUsage();
-                        return 1;
-                    }
-                }
-                break;
+            opaque = true;
+        }
+        else
+        {
+            return;
+        }
 
-            case OPT_FILELIST:
-            {
-                std::wifstream inFile(pValue);
-                if (!inFile)
-                {
-                    wprintf(L"Error opening -flist file %ls\n", pValue);
-                    return 1;
-                }
-                wchar_t fname[1024] = {};
-                for (;;)
-                {
-                    inFile >> fname;
-                    if (!inFile)
-                        break;
+        result.settled = (opaque || !HasAlpha(mdata.format)) && alphaUnchangedFor(mdata);
+    };
 
-                    if (*fname == L'#')
-                    {
-                        // Comment
-                    }
-                    else if (*fname == L'-')
-                    {
-                        wprintf(L"Command-line arguments not supported in -flist file\n");
-                        return 1;
-                    }
-                    else if (wcspbrk(fname, L"?*") != nullptr)
-                    {
-                        wprintf(L"Wildcards not supported in -flist file\n");
-                        return 1;
-                    }
-                    else
-                    {
-                        SConversion conv = {};
-                        wcscpy_s(conv.szSrc, MAX_PATH, fname);
-                        conversion.push_back(conv);
-                    }
+    // Returns non-zero if processing must stop. If pTriage is not null and settled, the
+    // analysis is reported from it without loading the image. If record is not null, it
+    // receives the -serve result record for the file when the analysis succeeds.
+    auto processFile = [&](const SConversion* pConv, bool first, const HeaderTriage* pTriage, std::wstring* record) -> int
+    {
+        HRESULT hr = S_OK;
+        bool preserveAlphaCoverage = false;
+
+        if (!first)
+            OutputPrintf(L"\n");
+
+        // --- Load source image -------------------------------------------------------
+        OutputPrintf(L"reading %ls", pConv->szSrc);
+        fflush(stdout);
+
+        CacheEntry cacheEntry = {};
+        bool cacheable = false;
+
+        // Prints the analysis, and hands it to -serve and the cache
+        auto reportAnalysis = [&](DXGI_FORMAT fmt, const texdiag::AnalyzeBCData& data)
+        {
+            data.Print(fmt);
 
-                    inFile.ignore(1000, '\n');
-                }
-                inFile.close();
+            if (record)
+            {
+                *record = FormatRecord(pConv->szSrc, fmt, data);
             }
-            break;
-
-            case OPT_PAPER_WHITE_NITS:
-                if (swscanf_s(pValue, L"%f", &paperWhiteNits) != 1)
-                {
-                    wprintf(L"Invalid value specified with -nits (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                else if (paperWhiteNits > 10000.f || paperWhiteNits <= 0.f)
-                {
-                    wprintf(L"-nits (%ls) parameter must be between 0 and 10000\n\n", pValue);
-                    return 1;
-                }
-                break;
 
-            case OPT_PRESERVE_ALPHA_COVERAGE:
-                if (swscanf_s(pValue, L"%f", &preserveAlphaCoverageRef) != 1)
-                {
-                    wprintf(L"Invalid value specified with -keepcoverage (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                else if (preserveAlphaCoverageRef < 0.0f || preserveAlphaCoverageRef > 1.0f)
-                {
-                    wprintf(L"-keepcoverage (%ls) parameter must be between 0.0 and 1.0\n\n", pValue);
-                    return 1;
-                }
-                break;
+            if (cacheable)
+            {
+                static_assert(sizeof(CacheEntry::value) / sizeof(uint64_t) >= sizeof(texdiag::AnalyzeBCData::blockHist) / sizeof(size_t) + 2,
+                    "CacheEntry can't hold the analysis result");
 
-            case OPT_SWIZZLE:
-                if (!*pValue || wcslen(pValue) > 4)
-                {
-                    wprintf(L"Invalid value specified with -swizzle (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                else if (!ParseSwizzleMask(pValue, swizzleElements))
+                cacheEntry.value[0] = static_cast<uint64_t>(fmt) | (static_cast<uint64_t>(data.sampled) << 32);
+                cacheEntry.value[1] = data.blocks;
+                for (size_t j = 0; j < std::size(data.blockHist); ++j)
                 {
-                    wprintf(L"-swizzle requires a 1 to 4 character mask composed of these letters: r, g, b, a, x, y, w, z\n");
-                    return 1;
+                    cacheEntry.value[j + 2] = data.blockHist[j];
                 }
-                break;
+                cache.Insert(cacheEntry);
             }
-        }
-        else if (wcspbrk(pArg, L"?*") != nullptr)
+        };
+
+        // Prints the target and the analysis when the conversion itself is skipped
+        auto reportTarget = [&](TexMetadata& mdata, DXGI_FORMAT tfmt, const texdiag::AnalyzeBCData& data)
         {
-            size_t count = conversion.size();
-            SearchForFiles(pArg, conversion, (dwOptions & (DWORD64(1) << OPT_RECURSIVE)) != 0, nullptr);
-            if (conversion.size() <= count)
+            mdata.format = tfmt;
+            if (dwOptions[OPT_PREMUL_ALPHA] && !mdata.IsPMAlpha())
             {
-                wprintf(L"No matching files found for %ls\n", pArg);
-                return 1;
+                mdata.SetAlphaMode(TEX_ALPHA_MODE_PREMULTIPLIED);
             }
-        }
-        else
-        {
-            SConversion conv = {};
-            wcscpy_s(conv.szSrc, MAX_PATH, pArg);
 
-            conversion.push_back(conv);
-        }
-    }
+            PrintInfo(mdata);
+            OutputPrintf(L"\n");
 
-    if (conversion.empty())
-    {
-        PrintUsage();
-        return 0;
-    }
+            reportAnalysis(tfmt, data);
 
-    if (~dwOptions & (DWORD64(1) << OPT_NOLOGO))
-        PrintLogo();
+            OutputPrintf(L"\n");
+        };
 
-    // Work out out filename prefix and suffix
-    if (szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
-        wcscat_s(szOutputDir, MAX_PATH, L"\\");
+        if (pTriage && pTriage->settled)
+        {
+            TexMetadata mdata = pTriage->info;
 
-    auto fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
+            PrintInfo(mdata);
+            OutputPrintf(L" as");
 
-    if (fileTypeName)
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".");
-        wcscat_s(szSuffix, MAX_PATH, fileTypeName);
-    }
-    else
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".unknown");
-    }
+            if ((mdata.width % 4) != 0 || (mdata.height % 4) != 0)
+            {
+                non4bc = true;
+            }
 
-    if (FileType != CODEC_DDS)
-    {
-        mipLevels = 1;
-    }
+            // Every block of the top image is a 6 alpha block
+            texdiag::AnalyzeBCData data = {};
+            data.blocks = std::max<size_t>(1, (mdata.width + 3) / 4) * std::max<size_t>(1, (mdata.height + 3) / 4);
+            data.blockHist[1] = data.blocks;
 
-    LARGE_INTEGER qpcFreq;
-    if (!QueryPerformanceFrequency(&qpcFreq))
-    {
-        qpcFreq.QuadPart = 0;
-    }
+            reportTarget(mdata, format, data);
+            return 0;
+        }
 
-    LARGE_INTEGER qpcStart;
-    if (!QueryPerformanceCounter(&qpcStart))
-    {
-        qpcStart.QuadPart = 0;
-    }
+        if (useCache && SUCCEEDED(HashFileContents(pConv->szSrc, cacheEntry.contentHash, cacheEntry.sourceSize)))
+        {
+            cacheable = true;
+            cacheEntry.optionsHash = optionsHash;
 
-    // Convert images
-    bool sizewarn = false;
-    bool nonpow2warn = false;
-    bool non4bc = false;
-    bool preserveAlphaCoverage = false;
-    ComPtr<ID3D11Device> pDevice;
+            CacheEntry cached;
+            if (cache.Find(cacheEntry.contentHash, cacheEntry.optionsHash, cacheEntry.sourceSize, cached))
+            {
+                cacheable = false;
 
-    for (auto pConv = conversion.begin(); pConv != conversion.end(); ++pConv)
-    {
-        if (pConv != conversion.begin())
-            wprintf(L"\n");
+                // value[0] is the format with the sampled blocks in the high half, value[1] the
+                // total blocks, and then the block counts
+                const auto fmt = static_cast<DXGI_FORMAT>(cached.value[0] & 0xFFFFFFFF);
 
-        // --- Load source image -------------------------------------------------------
-        wprintf(L"reading %ls", pConv->szSrc);
-        fflush(stdout);
+                texdiag::AnalyzeBCData data = {};
+                data.sampled = static_cast<size_t>(cached.value[0] >> 32);
+                data.blocks = static_cast<size_t>(cached.value[1]);
+                for (size_t j = 0; j < std::size(data.blockHist); ++j)
+                {
+                    data.blockHist[j] = static_cast<size_t>(cached.value[j + 2]);
+                }
+
+                OutputPrintf(L" unchanged, using cached analysis\n");
+                reportAnalysis(fmt, data);
+                return 0;
+            }
+        }
 
         wchar_t ext[_MAX_EXT] = {};
         wchar_t fname[_MAX_FNAME] = {};
@@ -4464,44 +5592,47 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         TexMetadata info;
         std::unique_ptr<ScratchImage> image(new (std::nothrow) ScratchImage);
 
+        bool alphaClassified = false;
+        texdiag::AnalyzeBCData alphaData = {};
+
         if (!image)
         {
-            wprintf(L"\nERROR: Memory allocation failed\n");
+            OutputPrintf(L"\nERROR: Memory allocation failed\n");
             return 1;
         }
 
         if (_wcsicmp(ext, L".dds") == 0)
         {
             DDS_FLAGS ddsFlags = DDS_FLAGS_ALLOW_LARGE_FILES;
-            if (dwOptions & (DWORD64(1) << OPT_DDS_DWORD_ALIGN))
+            if (dwOptions[OPT_DDS_DWORD_ALIGN])
                 ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
-            if (dwOptions & (DWORD64(1) << OPT_EXPAND_LUMINANCE))
+            if (dwOptions[OPT_EXPAND_LUMINANCE])
                 ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
-            if (dwOptions & (DWORD64(1) << OPT_DDS_BAD_DXTN_TAILS))
+            if (dwOptions[OPT_DDS_BAD_DXTN_TAILS])
                 ddsFlags |= DDS_FLAGS_BAD_DXTN_TAILS;
 
             hr = LoadFromDDSFile(pConv->szSrc, ddsFlags, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
 
             if (IsTypeless(info.format))
             {
-                if (dwOptions & (DWORD64(1) << OPT_TYPELESS_UNORM))
+                if (dwOptions[OPT_TYPELESS_UNORM])
                 {
                     info.format = MakeTypelessUNORM(info.format);
                 }
-                else if (dwOptions & (DWORD64(1) << OPT_TYPELESS_FLOAT))
+                else if (dwOptions[OPT_TYPELESS_FLOAT])
                 {
                     info.format = MakeTypelessFLOAT(info.format);
                 }
 
                 if (IsTypeless(info.format))
                 {
-                    wprintf(L" FAILED due to Typeless format %d\n", info.format);
-                    continue;
+                    OutputPrintf(L" FAILED due to Typeless format %d\n", info.format);
+                    return 0;
                 }
 
                 image->OverrideFormat(info.format);
@@ -4512,8 +5643,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromBMPEx(pConv->szSrc, WIC_FLAGS_NONE | dwFilter, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
         }
         else if (_wcsicmp(ext, L".tga") == 0)
@@ -4521,8 +5652,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromTGAFile(pConv->szSrc, TGA_FLAGS_NONE, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
         }
         else if (_wcsicmp(ext, L".hdr") == 0)
@@ -4530,8 +5661,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromHDRFile(pConv->szSrc, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
         }
         else if (_wcsicmp(ext, L".ppm") == 0)
@@ -4539,8 +5670,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromPortablePixMap(pConv->szSrc, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
         }
         else if (_wcsicmp(ext, L".pfm") == 0)
@@ -4548,8 +5679,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromPortablePixMapHDR(pConv->szSrc, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
         }
 #ifdef USE_OPENEXR
@@ -4558,8 +5689,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromEXRFile(pConv->szSrc, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
         }
 #endif
@@ -4580,8 +5711,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromWICFile(pConv->szSrc, wicFlags, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
         }
 
@@ -4590,7 +5721,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         size_t tMips = (!mipLevels && info.mipLevels > 1) ? info.mipLevels : mipLevels;
 
         // Convert texture
-        wprintf(L" as");
+        OutputPrintf(L" as");
         fflush(stdout);
 
         // --- Planar ------------------------------------------------------------------
@@ -4603,15 +5734,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
             hr = ConvertToSinglePlane(img, nimg, info, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [converttosingleplane] (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED [converttosingleplane] (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -4631,6 +5762,90 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
 
         DXGI_FORMAT tformat = (format == DXGI_FORMAT_UNKNOWN) ? info.format : format;
 
+        // BC3 analysis only needs the alpha block types, which are classified without encoding.
+        // Only DDS output is ever compressed (see Compress below), so the shortcuts keyed on this
+        // must not fire for other output types either.
+        const bool classifyAlpha = (tformat == DXGI_FORMAT_BC3_UNORM || tformat == DXGI_FORMAT_BC3_UNORM_SRGB)
+            && (FileType == CODEC_DDS) && !dwOptions[OPT_FULL_ENCODE];
+
+        auto classifyAlphaBlocks = [&](const Image& img) -> HRESULT
+        {
+            TEX_COMPRESS_FLAGS cflags = dwCompress;
+            if (!dwOptions[OPT_FORCE_SINGLEPROC])
+            {
+                cflags |= TEX_COMPRESS_PARALLEL;
+            }
+
+            if ((img.width % 4) != 0 || (img.height % 4) != 0)
+            {
+                non4bc = true;
+            }
+
+            AlphaBlockCounts counts = {};
+            HRESULT hrClassify = E_FAIL;
+            size_t sampled = 0;
+            if (sampleBlocks)
+            {
+                // The whole sample is needed for the estimates
+                hrClassify = ClassifyAlphaBlocks(img, tformat, cflags | dwSRGB, TEX_CLASSIFY_DEFAULT, sampleBlocks, counts);
+                if (SUCCEEDED(hrClassify))
+                {
+                    sampled = counts.block8 + counts.block6;
+                }
+            }
+
+            // Unless the sample saw both block types, either could still be absent from the image
+            if (!sampled || sampled >= counts.blocks || !counts.block8 || !counts.block6)
+            {
+                sampled = 0;
+                hrClassify = ClassifyAlphaBlocks(img, tformat, cflags | dwSRGB,
+                    dwOptions[OPT_STOP_AT_VERDICT] ? TEX_CLASSIFY_STOP_AT_VERDICT : TEX_CLASSIFY_DEFAULT, 0, counts);
+            }
+
+            if (SUCCEEDED(hrClassify))
+            {
+                alphaData.blocks = counts.blocks;
+                alphaData.blockHist[0] = counts.block8;
+                alphaData.blockHist[1] = counts.block6;
+                alphaData.sampled = sampled;
+                alphaClassified = true;
+            }
+
+            return hrClassify;
+        };
+
+        const bool alphaUnchanged = alphaUnchangedFor(info);
+
+        if (IsCompressed(info.format) && classifyAlpha && analysisOnly && alphaUnchanged)
+        {
+            auto img = image->GetImage(0, 0, 0);
+            assert(img);
+
+            if (info.format == tformat
+                && !dwOptions[OPT_PREMUL_ALPHA] && !dwOptions[OPT_DEMUL_ALPHA])
+            {
+                // Compress would reuse the original blocks, so analyze them as they are
+                if ((img->width % 4) != 0 || (img->height % 4) != 0)
+                {
+                    non4bc = true;
+                }
+
+                hr = analyzeBC(*img, alphaData);
+            }
+            else
+            {
+                hr = classifyAlphaBlocks(*img);
+            }
+            if (FAILED(hr))
+            {
+                OutputPrintf(L" FAILED [compress] (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
+            }
+
+            reportTarget(info, tformat, alphaData);
+            return 0;
+        }
+
         // --- Decompress --------------------------------------------------------------
         std::unique_ptr<ScratchImage> cimage;
         if (IsCompressed(info.format))
@@ -4638,12 +5853,12 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             // Direct3D can only create BC resources with multiple-of-4 top levels
             if ((info.width % 4) != 0 || (info.height % 4) != 0)
             {
-                if (dwOptions & (DWORD64(1) << OPT_BCNONMULT4FIX))
+                if (dwOptions[OPT_BCNONMULT4FIX])
                 {
                     std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
                     if (!timage)
                     {
-                        wprintf(L"\nERROR: Memory allocation failed\n");
+                        OutputPrintf(L"\nERROR: Memory allocation failed\n");
                         return 1;
                     }
 
@@ -4661,7 +5876,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                     hr = timage->Initialize(mdata);
                     if (FAILED(hr))
                     {
-                        wprintf(L" FAILED [BC non-multiple-of-4 fixup] (%x)\n", static_cast<unsigned int>(hr));
+                        OutputPrintf(L" FAILED [BC non-multiple-of-4 fixup] (%x)\n", static_cast<unsigned int>(hr));
                         return 1;
                     }
 
@@ -4704,15 +5919,17 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
-            hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage);
+            const TEX_DECOMPRESS_FLAGS dflags = dwOptions[OPT_FORCE_SINGLEPROC] ? TEX_DECOMPRESS_DEFAULT : TEX_DECOMPRESS_PARALLEL;
+
+            hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, dflags, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [decompress] (%x)\n", static_cast<unsigned int>(hr));
-                continue;
+                OutputPrintf(L" FAILED [decompress] (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -4740,17 +5957,17 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Undo Premultiplied Alpha (if requested) ---------------------------------
-        if ((dwOptions & (DWORD64(1) << OPT_DEMUL_ALPHA))
+        if (dwOptions[OPT_DEMUL_ALPHA]
             && HasAlpha(info.format)
             && info.format != DXGI_FORMAT_A8_UNORM)
         {
             if (info.GetAlphaMode() == TEX_ALPHA_MODE_STRAIGHT)
             {
-                printf("\nWARNING: Image is already using straight alpha\n");
+                OutputPrintf(L"\nWARNING: Image is already using straight alpha\n");
             }
             else if (!info.IsPMAlpha())
             {
-                printf("\nWARNING: Image is not using premultipled alpha\n");
+                OutputPrintf(L"\nWARNING: Image is not using premultipled alpha\n");
             }
             else
             {
@@ -4761,15 +5978,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
                 if (!timage)
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
+                    OutputPrintf(L"\nERROR: Memory allocation failed\n");
                     return 1;
                 }
 
                 hr = PremultiplyAlpha(img, nimg, info, TEX_PMALPHA_REVERSE | dwSRGB, *timage);
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [demultiply alpha] (%x)\n", static_cast<unsigned int>(hr));
-                    continue;
+                    OutputPrintf(L" FAILED [demultiply alpha] (%x)\n", static_cast<unsigned int>(hr));
+                    return 0;
                 }
 
                 auto& tinfo = timage->GetMetadata();
@@ -4789,21 +6006,21 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Flip/Rotate -------------------------------------------------------------
-        if (dwOptions & ((DWORD64(1) << OPT_HFLIP) | (DWORD64(1) << OPT_VFLIP)))
+        if (dwOptions[OPT_HFLIP] || dwOptions[OPT_VFLIP])
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
             TEX_FR_FLAGS dwFlags = TEX_FR_ROTATE0;
 
-            if (dwOptions & (DWORD64(1) << OPT_HFLIP))
+            if (dwOptions[OPT_HFLIP])
                 dwFlags |= TEX_FR_FLIP_HORIZONTAL;
 
-            if (dwOptions & (DWORD64(1) << OPT_VFLIP))
+            if (dwOptions[OPT_VFLIP])
                 dwFlags |= TEX_FR_FLIP_VERTICAL;
 
             assert(dwFlags != 0);
@@ -4811,7 +6028,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = FlipRotate(image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFlags, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [fliprotate] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [fliprotate] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -4850,7 +6067,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 sizewarn = true;
         }
 
-        if (dwOptions & (DWORD64(1) << OPT_FIT_POWEROF2))
+        if (dwOptions[OPT_FIT_POWEROF2])
         {
             FitPowerOf2(info.width, info.height, twidth, theight, maxSize);
         }
@@ -4860,14 +6077,14 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
             hr = Resize(image->GetImages(), image->GetImageCount(), image->GetMetadata(), twidth, theight, dwFilter | dwFilterOpts, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [resize] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [resize] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -4894,7 +6111,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -4911,7 +6128,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [swizzle] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [swizzle] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -4940,7 +6157,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
                 if (!timage)
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
+                    OutputPrintf(L"\nERROR: Memory allocation failed\n");
                     return 1;
                 }
 
@@ -4948,7 +6165,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                     dwFilter | dwFilterOpts | dwSRGB | dwConvert, alphaThreshold, *timage);
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [convert] (%x)\n", static_cast<unsigned int>(hr));
+                    OutputPrintf(L" FAILED [convert] (%x)\n", static_cast<unsigned int>(hr));
                     return 1;
                 }
 
@@ -4974,7 +6191,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5142,7 +6359,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [rotate color apply] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [rotate color apply] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5164,12 +6381,12 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Tonemap (if requested) --------------------------------------------------
-        if (dwOptions & DWORD64(1) << OPT_TONEMAP)
+        if (dwOptions[OPT_TONEMAP])
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5193,7 +6410,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 });
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [tonemap maxlum] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [tonemap maxlum] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5222,7 +6439,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [tonemap apply] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [tonemap apply] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5244,12 +6461,12 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Convert -----------------------------------------------------------------
-        if (dwOptions & (DWORD64(1) << OPT_NORMAL_MAP))
+        if (dwOptions[OPT_NORMAL_MAP])
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5277,7 +6494,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = ComputeNormalMap(image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwNormalMap, nmapAmplitude, nmfmt, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [normalmap] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [normalmap] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5302,7 +6519,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5310,7 +6527,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 dwFilter | dwFilterOpts | dwSRGB | dwConvert, alphaThreshold, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [convert] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [convert] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5332,13 +6549,13 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- ColorKey/ChromaKey ------------------------------------------------------
-        if ((dwOptions & (DWORD64(1) << OPT_COLORKEY))
+        if (dwOptions[OPT_COLORKEY]
             && HasAlpha(info.format))
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5369,7 +6586,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [colorkey] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [colorkey] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5391,12 +6608,12 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Invert Y Channel --------------------------------------------------------
-        if (dwOptions & (DWORD64(1) << OPT_INVERT_Y))
+        if (dwOptions[OPT_INVERT_Y])
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5418,7 +6635,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [inverty] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [inverty] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5440,12 +6657,12 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Reconstruct Z Channel ---------------------------------------------------
-        if (dwOptions & (DWORD64(1) << OPT_RECONSTRUCT_Z))
+        if (dwOptions[OPT_RECONSTRUCT_Z])
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5467,7 +6684,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [reconstructz] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [reconstructz] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5489,7 +6706,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Determine whether preserve alpha coverage is required (if requested) ----
-        if (preserveAlphaCoverageRef > 0.0f && HasAlpha(info.format) && !image->IsAlphaAllOpaque())
+        // (for analysis this only matters when it forces dropping the original compressed data)
+        if (preserveAlphaCoverageRef > 0.0f && (!analysisOnly || cimage) && HasAlpha(info.format) && !image->IsAlphaAllOpaque())
         {
             preserveAlphaCoverage = true;
         }
@@ -5518,7 +6736,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5527,7 +6745,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = timage->Initialize(mdata);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [copy to single level] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [copy to single level] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5539,7 +6757,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                         *timage->GetImage(0, 0, d), TEX_FILTER_DEFAULT, 0, 0);
                     if (FAILED(hr))
                     {
-                        wprintf(L" FAILED [copy to single level] (%x)\n", static_cast<unsigned int>(hr));
+                        OutputPrintf(L" FAILED [copy to single level] (%x)\n", static_cast<unsigned int>(hr));
                         return 1;
                     }
                 }
@@ -5552,7 +6770,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                         *timage->GetImage(0, i, 0), TEX_FILTER_DEFAULT, 0, 0);
                     if (FAILED(hr))
                     {
-                        wprintf(L" FAILED [copy to single level] (%x)\n", static_cast<unsigned int>(hr));
+                        OutputPrintf(L" FAILED [copy to single level] (%x)\n", static_cast<unsigned int>(hr));
                         return 1;
                     }
                 }
@@ -5569,7 +6787,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 hr = timage->Initialize(mdata);
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [copy compressed to single level] (%x)\n", static_cast<unsigned int>(hr));
+                    OutputPrintf(L" FAILED [copy compressed to single level] (%x)\n", static_cast<unsigned int>(hr));
                     return 1;
                 }
 
@@ -5602,12 +6820,25 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }
         }
 
-        if ((!tMips || info.mipLevels != tMips) && (info.width > 1 || info.height > 1 || info.depth > 1))
+        if (analysisOnly)
+        {
+            // Mip generation copies the top level unchanged, so only track the resulting metadata
+            if ((!tMips || info.mipLevels != tMips) && (info.width > 1 || info.height > 1 || info.depth > 1))
+            {
+                const size_t maxMips = (info.dimension == TEX_DIMENSION_TEXTURE3D)
+                    ? CountMips(info.width, info.height, info.depth)
+                    : CountMips(info.width, info.height, 1);
+
+                info.mipLevels = (tMips) ? std::min(tMips, maxMips) : maxMips;
+                cimage.reset();
+            }
+        }
+        else if ((!tMips || info.mipLevels != tMips) && (info.width > 1 || info.height > 1 || info.depth > 1))
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
@@ -5621,7 +6852,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [mipmaps] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [mipmaps] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5641,19 +6872,19 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Preserve mipmap alpha coverage (if requested) ---------------------------
-        if (preserveAlphaCoverage && info.mipLevels != 1 && (info.dimension != TEX_DIMENSION_TEXTURE3D))
+        if (preserveAlphaCoverage && !analysisOnly && info.mipLevels != 1 && (info.dimension != TEX_DIMENSION_TEXTURE3D))
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
+                OutputPrintf(L"\nERROR: Memory allocation failed\n");
                 return 1;
             }
 
             hr = timage->Initialize(image->GetMetadata());
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [keepcoverage] (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED [keepcoverage] (%x)\n", static_cast<unsigned int>(hr));
                 return 1;
             }
 
@@ -5666,7 +6897,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 hr = ScaleMipMapsAlphaForCoverage(img, info.mipLevels, info, item, preserveAlphaCoverageRef, *timage);
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [keepcoverage] (%x)\n", static_cast<unsigned int>(hr));
+                    OutputPrintf(L" FAILED [keepcoverage] (%x)\n", static_cast<unsigned int>(hr));
                     return 1;
                 }
             }
@@ -5688,13 +6919,19 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Premultiplied alpha (if requested) --------------------------------------
-        if ((dwOptions & (DWORD64(1) << OPT_PREMUL_ALPHA))
+        if (dwOptions[OPT_PREMUL_ALPHA]
             && HasAlpha(info.format)
             && info.format != DXGI_FORMAT_A8_UNORM)
         {
             if (info.IsPMAlpha())
             {
-                printf("\nWARNING: Image is already using premultiplied alpha\n");
+                OutputPrintf(L"\nWARNING: Image is already using premultiplied alpha\n");
+            }
+            else if (analysisOnly && classifyAlpha)
+            {
+                // Premultiplying leaves alpha unchanged, so it can't affect the alpha block types
+                info.SetAlphaMode(TEX_ALPHA_MODE_PREMULTIPLIED);
+                cimage.reset();
             }
             else
             {
@@ -5705,27 +6942,44 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
                 if (!timage)
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
+                    OutputPrintf(L"\nERROR: Memory allocation failed\n");
                     return 1;
                 }
 
-                hr = PremultiplyAlpha(img, nimg, info, TEX_PMALPHA_DEFAULT | dwSRGB, *timage);
+                if (analysisOnly)
+                {
+                    hr = PremultiplyAlpha(*img, TEX_PMALPHA_DEFAULT | dwSRGB, *timage);
+                }
+                else
+                {
+                    hr = PremultiplyAlpha(img, nimg, info, TEX_PMALPHA_DEFAULT | dwSRGB, *timage);
+                }
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [premultiply alpha] (%x)\n", static_cast<unsigned int>(hr));
-                    continue;
+                    OutputPrintf(L" FAILED [premultiply alpha] (%x)\n", static_cast<unsigned int>(hr));
+                    return 0;
                 }
 
                 auto& tinfo = timage->GetMetadata();
-                info.miscFlags2 = tinfo.miscFlags2;
 
                 assert(info.width == tinfo.width);
                 assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.dimension == tinfo.dimension);
+
+                if (analysisOnly)
+                {
+                    // Only the top mip of the first item was premultiplied
+                    info.SetAlphaMode(TEX_ALPHA_MODE_PREMULTIPLIED);
+                }
+                else
+                {
+                    info.miscFlags2 = tinfo.miscFlags2;
+
+                    assert(info.depth == tinfo.depth);
+                    assert(info.arraySize == tinfo.arraySize);
+                    assert(info.mipLevels == tinfo.mipLevels);
+                    assert(info.miscFlags == tinfo.miscFlags);
+                    assert(info.dimension == tinfo.dimension);
+                }
 
                 image.swap(timage);
                 cimage.reset();
@@ -5756,6 +7010,23 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 assert(info.miscFlags == tinfo.miscFlags);
                 assert(info.dimension == tinfo.dimension);
             }
+            else if (classifyAlpha)
+            {
+                // Analysis only looks at the alpha block types, so skip encoding the color part
+                cimage.reset();
+
+                auto img = image->GetImage(0, 0, 0);
+                assert(img);
+
+                hr = classifyAlphaBlocks(*img);
+                if (FAILED(hr))
+                {
+                    OutputPrintf(L" FAILED [compress] (%x)\n", static_cast<unsigned int>(hr));
+                    return 0;
+                }
+
+                info.format = tformat;
+            }
             else
             {
                 cimage.reset();
@@ -5767,7 +7038,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
                 if (!timage)
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
+                    OutputPrintf(L"\nERROR: Memory allocation failed\n");
                     return 1;
                 }
 
@@ -5783,20 +7054,22 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                     bc6hbc7 = true;
 
                     {
+                        std::lock_guard<std::mutex> lock(deviceLock);
+
                         static bool s_tryonce = false;
 
                         if (!s_tryonce)
                         {
                             s_tryonce = true;
 
-                            if (!(dwOptions & (DWORD64(1) << OPT_NOGPU)))
+                            if (!dwOptions[OPT_NOGPU])
                             {
                                 if (!CreateDevice(adapter, pDevice.GetAddressOf()))
-                                    wprintf(L"\nWARNING: DirectCompute is not available, using BC6H / BC7 CPU codec\n");
+                                    OutputPrintf(L"\nWARNING: DirectCompute is not available, using BC6H / BC7 CPU codec\n");
                             }
                             else
                             {
-                                wprintf(L"\nWARNING: using BC6H / BC7 CPU codec\n");
+                                OutputPrintf(L"\nWARNING: using BC6H / BC7 CPU codec\n");
                             }
                         }
                     }
@@ -5807,20 +7080,32 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }
 
                 TEX_COMPRESS_FLAGS cflags = dwCompress;
-#ifdef _OPENMP
-                if (!(dwOptions & (DWORD64(1) << OPT_FORCE_SINGLEPROC)))
+                if (!dwOptions[OPT_FORCE_SINGLEPROC])
                 {
                     cflags |= TEX_COMPRESS_PARALLEL;
                 }
-#endif
 
                 if ((img->width % 4) != 0 || (img->height % 4) != 0)
                 {
                     non4bc = true;
                 }
 
-                if (bc6hbc7 && pDevice)
+                if (analysisOnly)
                 {
+                    // Only the top mip of the first item is analyzed
+                    if (bc6hbc7 && pDevice)
+                    {
+                        std::lock_guard<std::mutex> lock(deviceLock);
+                        hr = Compress(pDevice.Get(), *img, tformat, dwCompress | dwSRGB, alphaWeight, *timage);
+                    }
+                    else
+                    {
+                        hr = Compress(*img, tformat, cflags | dwSRGB, alphaThreshold, *timage);
+                    }
+                }
+                else if (bc6hbc7 && pDevice)
+                {
+                    std::lock_guard<std::mutex> lock(deviceLock);
                     hr = Compress(pDevice.Get(), img, nimg, info, tformat, dwCompress | dwSRGB, alphaWeight, *timage);
                 }
                 else
@@ -5829,8 +7114,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [compress] (%x)\n", static_cast<unsigned int>(hr));
-                    continue;
+                    OutputPrintf(L" FAILED [compress] (%x)\n", static_cast<unsigned int>(hr));
+                    return 0;
                 }
 
                 auto& tinfo = timage->GetMetadata();
@@ -5838,11 +7123,11 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 info.format = tinfo.format;
                 assert(info.width == tinfo.width);
                 assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.dimension == tinfo.dimension);
+                assert(analysisOnly || info.depth == tinfo.depth);
+                assert(analysisOnly || info.arraySize == tinfo.arraySize);
+                assert(analysisOnly || info.mipLevels == tinfo.mipLevels);
+                assert(analysisOnly || info.miscFlags == tinfo.miscFlags);
+                assert(analysisOnly || info.dimension == tinfo.dimension);
 
                 image.swap(timage);
             }
@@ -5853,7 +7138,11 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Set alpha mode ----------------------------------------------------------
-        if (HasAlpha(info.format)
+        if (analysisOnly)
+        {
+            // The alpha mode isn't part of the analysis, so skip the IsAlphaAllOpaque scan
+        }
+        else if (HasAlpha(info.format)
             && info.format != DXGI_FORMAT_A8_UNORM)
         {
             if (image->IsAlphaAllOpaque())
@@ -5864,7 +7153,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             {
                 // Aleady set TEX_ALPHA_MODE_PREMULTIPLIED
             }
-            else if (dwOptions & (DWORD64(1) << OPT_SEPALPHA))
+            else if (dwOptions[OPT_SEPALPHA])
             {
                 info.SetAlphaMode(TEX_ALPHA_MODE_CUSTOM);
             }
@@ -5885,50 +7174,201 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             size_t nimg = image->GetImageCount();
 
             PrintInfo(info);
-            wprintf(L"\n");
+            OutputPrintf(L"\n");
 
             // Figure out dest filename
 
             
                 DDS_FLAGS ddsFlags = DDS_FLAGS_NONE;
-                if (dwOptions & (DWORD64(1) << OPT_USE_DX10))
+                if (dwOptions[OPT_USE_DX10])
                 {
                     ddsFlags |= DDS_FLAGS_FORCE_DX10_EXT | DDS_FLAGS_FORCE_DX10_EXT_MISC2;
                 }
-                else if (dwOptions & (DWORD64(1) << OPT_USE_DX9))
+                else if (dwOptions[OPT_USE_DX9])
                 {
                     ddsFlags |= DDS_FLAGS_FORCE_DX9_LEGACY;
                 }
 
                 //perform analysis
                 //hr = SaveToDDSFile(img, nimg, info, ddsFlags, szDest);
-                texdiag::AnalyzeBCData data;
-                hr = texdiag::AnalyzeBC(*img, data);
+                texdiag::AnalyzeBCData data = alphaData;
+                if (!alphaClassified)
+                {
+                    hr = analyzeBC(*img, data);
+                }
                 if (FAILED(hr))
                 {
-//                    wprintf(L"ERROR: Failed analyzing BC image at slice %3zu, mip %3zu (%08X)\n", slice, mip, static_cast<unsigned int>(hr));
-                    wprintf(L"ERROR: Failed analyzing BC image at slice\n");
+//                    OutputPrintf(L"ERROR: Failed analyzing BC image at slice %3zu, mip %3zu (%08X)\n", slice, mip, static_cast<unsigned int>(hr));
+                    OutputPrintf(L"ERROR: Failed analyzing BC image at slice\n");
                     return 1;
                 }
 
-                data.Print(img->format);
+                reportAnalysis(info.format, data);
 
 
             
 
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                OutputPrintf(L" FAILED (%x)\n", static_cast<unsigned int>(hr));
+                return 0;
+            }
+            OutputPrintf(L"\n");
+        }
+
+        return 0;
+    };
+
+    // Worker threads are created once and reused by every -serve request
+    std::unique_ptr<WorkerPool> pool;
+    if (jobs > 1)
+    {
+        pool = std::make_unique<WorkerPool>(jobs);
+    }
+
+    // Processes the files in order; returns non-zero if processing must stop
+    auto processFiles = [&](const std::list<SConversion>& fileList, std::vector<std::wstring>* records) -> int
+    {
+        std::vector<const SConversion*> files;
+        files.reserve(fileList.size());
+        for (const auto& conv : fileList)
+        {
+            files.push_back(&conv);
+        }
+
+        if (records)
+        {
+            records->clear();
+            records->resize(files.size());
+        }
+
+        // Read the headers first, so files they settle never reach the pixel pipeline
+        std::vector<HeaderTriage> triage;
+        if (canTriage())
+        {
+            triage.resize(files.size());
+            RunConcurrently(files.size(), [&](size_t index)
+                {
+                    triageFile(files[index]->szSrc, triage[index]);
+                });
+        }
+
+        auto process = [&](size_t index) -> int
+        {
+            return processFile(files[index], index == 0,
+                (triage.empty()) ? nullptr : &triage[index],
+                (records) ? &(*records)[index] : nullptr);
+        };
+
+        if (pool && files.size() > 1)
+        {
+            // Console output is only wanted when not writing records
+            return pool->Run(files.size(), process, !records);
+        }
+
+        std::wstring discard;
+        for (size_t index = 0; index < files.size(); ++index)
+        {
+            if (records)
+            {
+                discard.clear();
+                t_output = &discard;
+            }
+
+            const int result = process(index);
+
+            t_output = nullptr;
+
+            if (result)
+                return result;
+        }
+
+        return 0;
+    };
+
+    if (serve)
+    {
+        // Each line is "<files> [options]", applied on top of the startup options
+        std::vector<std::wstring> records;
+        std::wstring line;
+        while (ReadRequestLine(stdin, line))
+        {
+            std::vector<std::wstring> requestArgs(startupArgs);
+            if (!SplitRequestLine(line.c_str(), requestArgs))
+            {
+                // Blank line
+                continue;
+            }
+
+            std::vector<wchar_t*> pArgs;
+            pArgs.reserve(requestArgs.size());
+            for (auto& arg : requestArgs)
+            {
+                pArgs.push_back(&arg[0]);
+            }
+
+            std::list<SConversion> requests;
+            std::wstring errors;
+            t_output = &errors;
+            const int result = parseCommandLine(static_cast<int>(pArgs.size()), pArgs.data(), requests, true);
+            t_output = nullptr;
+
+            if (result || requests.empty())
+            {
+                const size_t eol = errors.find_first_of(L"\r\n");
+                if (eol != std::wstring::npos)
+                    errors.resize(eol);
+
+                wprintf(L"%ls\terror\t%ls\n", line.c_str(), errors.empty() ? L"no input files" : errors.c_str());
+                fflush(stdout);
                 continue;
             }
-            wprintf(L"\n");
+
+            // A file that fails gets a failed record, and files after it in the request are not
+            // processed, but the server keeps reading requests
+            std::ignore = processFiles(requests, &records);
+
+            auto conv = requests.cbegin();
+            for (size_t index = 0; index < records.size(); ++index, ++conv)
+            {
+                if (records[index].empty())
+                {
+                    wprintf(L"%ls\tfailed\n", conv->szSrc);
+                }
+                else
+                {
+                    wprintf(L"%ls\n", records[index].c_str());
+                }
+            }
+            fflush(stdout);
+
+            if (useCache)
+            {
+                std::ignore = cache.Flush();
+            }
+        }
+
+        if (useCache)
+        {
+            cache.Close();
         }
+
+        return 0;
     }
 
+    {
+        const int result = processFiles(conversion, nullptr);
 
+        if (useCache)
+        {
+            cache.Close();
+        }
 
+        if (result)
+            return result;
+    }
 
-    if (dwOptions & (DWORD64(1) << OPT_TIMING))
+    if (dwOptions[OPT_TIMING])
     {
         LARGE_INTEGER qpcEnd;
         if (QueryPerformanceCounter(&qpcEnd))
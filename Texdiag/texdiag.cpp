@@ -21,6 +21,7 @@
 #pragma warning(pop)
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <cstdio>
@@ -29,6 +30,7 @@
 #include <cwchar>
 #include <cwctype>
 #include <fstream>
+#include <functional>
 #include <iterator>
 #include <list>
 #include <locale>
@@ -36,6 +38,7 @@
 #include <new>
 #include <set>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
@@ -88,6 +91,7 @@ enum OPTIONS : uint32_t
     OPT_DIFF_COLOR,
     OPT_THRESHOLD,
     OPT_FILELIST,
+    OPT_SAMPLE,
     OPT_MAX
 };
 
@@ -139,6 +143,7 @@ const SValue g_pOptions[] =
     { L"c",         OPT_DIFF_COLOR },
     { L"t",         OPT_THRESHOLD },
     { L"flist",     OPT_FILELIST },
+    { L"sample",    OPT_SAMPLE },
     { nullptr,      0 }
 };
 
@@ -686,6 +691,11 @@ namespace
             L"   -targetx <num>      dump pixels at location x (defaults to all)\n"
             L"   -targety <num>      dump pixels at location y (defaults to all)\n"
             L"\n"
+            L"                       (analyze only)\n"
+            L"   -sample <blocks>    estimate the BC1, BC3, BC4, and BC5 block counts from a\n"
+            L"                       fixed sample of blocks, counting every block only when\n"
+            L"                       the sample misses a block type\n"
+            L"\n"
             L"                       (dumpdds only)\n"
             L"   -ft <filetype>      output file type\n"
             L"\n"
@@ -825,6 +835,150 @@ namespace
         }
     }
 
+    // Reads only the file header. Returns S_FALSE if the metadata LoadImage reports could
+    // depend on the pixels, or for file types without a header-only reader.
+    HRESULT LoadMetadata(
+        const wchar_t *fileName,
+        uint32_t dwOptions,
+        TexMetadata& info)
+    {
+        if (!fileName)
+            return E_INVALIDARG;
+
+        wchar_t ext[_MAX_EXT] = {};
+        _wsplitpath_s(fileName, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+
+        if (_wcsicmp(ext, L".dds") == 0)
+        {
+            DDS_FLAGS ddsFlags = DDS_FLAGS_ALLOW_LARGE_FILES;
+            if (dwOptions & (1 << OPT_DDS_DWORD_ALIGN))
+                ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
+            if (dwOptions & (1 << OPT_EXPAND_LUMINANCE))
+                ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
+            if (dwOptions & (1 << OPT_DDS_BAD_DXTN_TAILS))
+                ddsFlags |= DDS_FLAGS_BAD_DXTN_TAILS;
+
+            HRESULT hr = GetMetadataFromDDSFile(fileName, ddsFlags, info);
+            if (FAILED(hr))
+                return hr;
+
+            if (IsTypeless(info.format))
+            {
+                if (dwOptions & (1 << OPT_TYPELESS_UNORM))
+                {
+                    info.format = MakeTypelessUNORM(info.format);
+                }
+                else if (dwOptions & (1 << OPT_TYPELESS_FLOAT))
+                {
+                    info.format = MakeTypelessFLOAT(info.format);
+                }
+
+                if (IsTypeless(info.format))
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+
+            // The alpha mode comes from the header, or is opaque for legacy formats without alpha
+            return S_OK;
+        }
+        else if (_wcsicmp(ext, L".tga") == 0)
+        {
+            // Loading a TGA with alpha scans it to decide the alpha mode. With TGA_FLAGS_BGR, the
+            // 24-bit images that have no alpha to scan report a format without alpha.
+            HRESULT hr = GetMetadataFromTGAFile(fileName, TGA_FLAGS_BGR, info);
+            if (FAILED(hr))
+                return hr;
+
+            switch (info.format)
+            {
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+                info.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+                info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
+                return S_OK;
+
+            case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+                info.format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+                info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
+                return S_OK;
+
+            default:
+                return HasAlpha(info.format) ? S_FALSE : S_OK;
+            }
+        }
+        else if (_wcsicmp(ext, L".hdr") == 0)
+        {
+            return GetMetadataFromHDRFile(fileName, info);
+        }
+
+        return S_FALSE;
+    }
+
+    // Image count and total pixel size of a ScratchImage initialized with this metadata
+    HRESULT GetImageArraySize(const TexMetadata& info, size_t& nImages, size_t& pixelSize)
+    {
+        nImages = pixelSize = 0;
+
+        size_t w = info.width;
+        size_t h = info.height;
+        size_t d = info.depth;
+
+        for (size_t level = 0; level < info.mipLevels; ++level)
+        {
+            size_t rowPitch, slicePitch;
+            HRESULT hr = ComputePitch(info.format, w, h, rowPitch, slicePitch, CP_FLAGS_NONE);
+            if (FAILED(hr))
+                return hr;
+
+            // Volume mips hold one image per slice, and array items one image per mip
+            const size_t count = (info.dimension == TEX_DIMENSION_TEXTURE3D) ? d : info.arraySize;
+            nImages += count;
+            pixelSize += slicePitch * count;
+
+            if (h > 1)
+                h >>= 1;
+
+            if (w > 1)
+                w >>= 1;
+
+            if (d > 1)
+                d >>= 1;
+        }
+
+        return S_OK;
+    }
+
+    // Calls process once for every index below count, spread over short-lived threads
+    void RunConcurrently(size_t count, const std::function<void(size_t)>& process)
+    {
+        const size_t threads = std::min<size_t>(count, std::max(1u, std::thread::hardware_concurrency()));
+        if (threads <= 1)
+        {
+            for (size_t index = 0; index < count; ++index)
+            {
+                process(index);
+            }
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (size_t j = 0; j < threads; ++j)
+        {
+            workers.emplace_back([&]()
+                {
+                    for (size_t index = next++; index < count; index = next++)
+                    {
+                        process(index);
+                    }
+                });
+        }
+
+        for (auto& t : workers)
+        {
+            t.join();
+        }
+    }
+
     HRESULT SaveImage(const Image* image, const wchar_t *fileName, uint32_t codec)
     {
         switch (codec)
@@ -879,102 +1033,275 @@ namespace
         }
     };
 
-    HRESULT Analyze(const Image& image, _Out_ AnalyzeData& result)
+    // Partial statistics over a run of pixels. Partials of disjoint runs merge exactly
+    // (Chan et al.), so bands of rows are analyzed concurrently in a single decode pass.
+    struct AnalyzeAccumulator
     {
-        memset(&result, 0, sizeof(AnalyzeData));
+        size_t   count;
+        XMVECTOR mean;
+        XMVECTOR m2;        // Sum of squared differences from the mean
+        XMVECTOR minv;
+        XMVECTOR maxv;
+        XMVECTOR luminance;
+        size_t   specials[4];
+
+        AnalyzeAccumulator() noexcept :
+            count(0),
+            mean(g_XMZero),
+            m2(g_XMZero),
+            minv(g_XMFltMax),
+            maxv(XMVectorNegate(g_XMFltMax)),
+            luminance(g_XMZero),
+            specials{}
+        {
+        }
 
-        // First pass
-        XMVECTOR minv = g_XMFltMax;
-        XMVECTOR maxv = XMVectorNegate(g_XMFltMax);
-        XMVECTOR acc = g_XMZero;
-        XMVECTOR luminance = g_XMZero;
+        // Reads the decoded scanline twice while it is in cache, rather than decoding twice
+        void AddScanline(const XMVECTOR* pixels, size_t width) noexcept
+        {
+            static const XMVECTORF32 s_luminance = { { {  0.3f, 0.59f, 0.11f, 0.f } } };
 
-        size_t totalPixels = 0;
+            XMVECTOR sum = g_XMZero;
 
-        HRESULT hr = EvaluateImage(image, [&](const XMVECTOR * pixels, size_t width, size_t y)
+            for (size_t x = 0; x < width; ++x)
             {
-                static const XMVECTORF32 s_luminance = { { {  0.3f, 0.59f, 0.11f, 0.f } } };
+                const XMVECTOR v = pixels[x];
+                luminance = XMVectorMax(luminance, XMVector3Dot(v, s_luminance));
+                minv = XMVectorMin(minv, v);
+                maxv = XMVectorMax(maxv, v);
+                sum = XMVectorAdd(v, sum);
+
+                XMFLOAT4 f;
+                XMStoreFloat4(&f, v);
+                if (!isfinite(f.x))
+                {
+                    ++specials[0];
+                }
 
-                UNREFERENCED_PARAMETER(y);
+                if (!isfinite(f.y))
+                {
+                    ++specials[1];
+                }
 
-                for (size_t x = 0; x < width; ++x)
+                if (!isfinite(f.z))
                 {
-                    const XMVECTOR v = *pixels++;
-                    luminance = XMVectorMax(luminance, XMVector3Dot(v, s_luminance));
-                    minv = XMVectorMin(minv, v);
-                    maxv = XMVectorMax(maxv, v);
-                    acc = XMVectorAdd(v, acc);
-                    ++totalPixels;
-
-                    XMFLOAT4 f;
-                    XMStoreFloat4(&f, v);
-                    if (!isfinite(f.x))
-                    {
-                        ++result.specials_x;
-                    }
+                    ++specials[2];
+                }
 
-                    if (!isfinite(f.y))
-                    {
-                        ++result.specials_y;
-                    }
+                if (!isfinite(f.w))
+                {
+                    ++specials[3];
+                }
+            }
 
-                    if (!isfinite(f.z))
-                    {
-                        ++result.specials_z;
-                    }
+            if (!width)
+                return;
 
-                    if (!isfinite(f.w))
-                    {
-                        ++result.specials_w;
-                    }
-                }
-            });
-        if (FAILED(hr))
-            return hr;
+            const XMVECTOR lineMean = XMVectorDivide(sum, XMVectorReplicate(float(width)));
+
+            XMVECTOR lineM2 = g_XMZero;
+            for (size_t x = 0; x < width; ++x)
+            {
+                const XMVECTOR diff = XMVectorSubtract(pixels[x], lineMean);
+                lineM2 = XMVectorMultiplyAdd(diff, diff, lineM2);
+            }
 
-        if (!totalPixels)
-            return S_FALSE;
+            Merge(width, lineMean, lineM2);
+        }
 
-        result.luminance = XMVectorGetX(luminance);
-        XMStoreFloat4(&result.imageMin, minv);
-        XMStoreFloat4(&result.imageMax, maxv);
+        void Merge(const AnalyzeAccumulator& other) noexcept
+        {
+            luminance = XMVectorMax(luminance, other.luminance);
+            minv = XMVectorMin(minv, other.minv);
+            maxv = XMVectorMax(maxv, other.maxv);
 
-        const XMVECTOR pixelv = XMVectorReplicate(float(totalPixels));
-        XMVECTOR avgv = XMVectorDivide(acc, pixelv);
-        XMStoreFloat4(&result.imageAvg, avgv);
+            for (size_t j = 0; j < 4; ++j)
+            {
+                specials[j] += other.specials[j];
+            }
 
-        // Second pass
-        acc = g_XMZero;
+            Merge(other.count, other.mean, other.m2);
+        }
 
-        hr = EvaluateImage(image, [&](const XMVECTOR * pixels, size_t width, size_t y)
+    private:
+        void Merge(size_t n, FXMVECTOR otherMean, FXMVECTOR otherM2) noexcept
+        {
+            if (!n)
+                return;
+
+            if (!count)
             {
-                UNREFERENCED_PARAMETER(y);
+                count = n;
+                mean = otherMean;
+                m2 = otherM2;
+                return;
+            }
 
-                for (size_t x = 0; x < width; ++x)
-                {
-                    const XMVECTOR v = *pixels++;
+            const size_t total = count + n;
+            const float weight = float(n) / float(total);
+
+            const XMVECTOR delta = XMVectorSubtract(otherMean, mean);
+            mean = XMVectorMultiplyAdd(delta, XMVectorReplicate(weight), mean);
+            m2 = XMVectorAdd(XMVectorAdd(m2, otherM2), XMVectorScale(XMVectorMultiply(delta, delta), float(count) * weight));
+            count = total;
+        }
+    };
+
+    // Analyzes all the images at once, splitting each into bands of rows that are decoded
+    // and accumulated concurrently. Returns S_FALSE if an image has no pixels.
+    HRESULT Analyze(_In_reads_(nimages) const Image* images, size_t nimages, _Out_writes_(nimages) AnalyzeData* results)
+    {
+        // A multiple of the BC block height, so each band decompresses on its own
+        constexpr size_t c_bandHeight = 64;
+
+        if (!images || !results)
+            return E_INVALIDARG;
+
+        struct Band
+        {
+            size_t image;
+            size_t y;
+        };
+
+        std::vector<Band> bands;
+        for (size_t index = 0; index < nimages; ++index)
+        {
+            memset(&results[index], 0, sizeof(AnalyzeData));
+
+            if (!images[index].pixels)
+                return E_POINTER;
 
-                    const XMVECTOR diff = XMVectorSubtract(v, avgv);
-                    acc = XMVectorMultiplyAdd(diff, diff, acc);
+            for (size_t y = 0; y < images[index].height; y += c_bandHeight)
+            {
+                bands.push_back({ index, y });
+            }
+        }
+
+        std::vector<AnalyzeAccumulator> partials(bands.size());
+        std::atomic<HRESULT> status(S_OK);
+
+        RunConcurrently(bands.size(), [&](size_t index)
+            {
+                const Image& image = images[bands[index].image];
+                const size_t y = bands[index].y;
+                const size_t rowsPerPitch = IsCompressed(image.format) ? 4 : 1;
+
+                Image band = image;
+                band.height = std::min(c_bandHeight, image.height - y);
+                band.pixels = image.pixels + (y / rowsPerPitch) * image.rowPitch;
+                band.slicePitch = ((band.height + rowsPerPitch - 1) / rowsPerPitch) * image.rowPitch;
+
+                AnalyzeAccumulator& partial = partials[index];
+                const HRESULT hr = EvaluateImage(band, [&](const XMVECTOR * pixels, size_t width, size_t)
+                    {
+                        partial.AddScanline(pixels, width);
+                    });
+                if (FAILED(hr))
+                {
+                    status = hr;
                 }
             });
-        if (FAILED(hr))
-            return hr;
 
-        XMStoreFloat4(&result.imageVariance, acc);
+        if (FAILED(status))
+            return status;
+
+        // Bands are merged in order so the results don't depend on thread timing
+        std::vector<AnalyzeAccumulator> totals(nimages);
+        for (size_t index = 0; index < bands.size(); ++index)
+        {
+            totals[bands[index].image].Merge(partials[index]);
+        }
+
+        HRESULT hr = S_OK;
+        for (size_t index = 0; index < nimages; ++index)
+        {
+            const AnalyzeAccumulator& total = totals[index];
+            if (!total.count)
+            {
+                hr = S_FALSE;
+                continue;
+            }
 
-        const XMVECTOR stddev = XMVectorSqrt(acc);
+            AnalyzeData& result = results[index];
+            result.luminance = XMVectorGetX(total.luminance);
+            XMStoreFloat4(&result.imageMin, total.minv);
+            XMStoreFloat4(&result.imageMax, total.maxv);
+            XMStoreFloat4(&result.imageAvg, total.mean);
+            XMStoreFloat4(&result.imageVariance, total.m2);
+            XMStoreFloat4(&result.imageStdDev, XMVectorSqrt(total.m2));
+            result.specials_x = total.specials[0];
+            result.specials_y = total.specials[1];
+            result.specials_z = total.specials[2];
+            result.specials_w = total.specials[3];
+        }
 
-        XMStoreFloat4(&result.imageStdDev, stddev);
+        return hr;
+    }
 
-        return S_OK;
+    HRESULT Analyze(const Image& image, _Out_ AnalyzeData& result)
+    {
+        return Analyze(&image, 1, &result);
     }
 
     //--------------------------------------------------------------------------------------
+    // 95% confidence interval (Wilson score) for the share of count out of n sampled blocks
+    void GetConfidenceInterval(size_t count, size_t n, double& lower, double& upper)
+    {
+        constexpr double z = 1.96;
+
+        const double p = double(count) / double(n);
+        const double z2n = z * z / double(n);
+        const double center = (p + z2n * 0.5) / (1.0 + z2n);
+        const double half = z * sqrt(p * (1.0 - p) / double(n) + z2n / (4.0 * double(n))) / (1.0 + z2n);
+
+        lower = std::max(0.0, center - half);
+        upper = std::min(1.0, center + half);
+    }
+
     struct AnalyzeBCData
     {
         size_t blocks;
         size_t blockHist[15];
+        size_t partitionHist[15][64];   // BC6H/BC7 blocks of each partition (shape) per mode, indexed like blockHist
+        size_t sampled;     // Blocks counted when only a sample was analyzed, otherwise 0
+
+        // Prints how many partitions of a BC6H/BC7 mode appear and the most frequent one
+        void PrintPartitions(size_t mode)
+        {
+            size_t used = 0;
+            size_t common = 0;
+            for (size_t j = 0; j < 64; ++j)
+            {
+                if (partitionHist[mode][j] > 0)
+                    ++used;
+                if (partitionHist[mode][j] > partitionHist[mode][common])
+                    common = j;
+            }
+
+            if (used > 0)
+                wprintf(L"\t         partitions - %zu used, most often #%zu (%zu blocks)\n", used, common, partitionHist[mode][common]);
+        }
+
+        // Prints an exact count, or the estimate for the whole image from a sampled count
+        void PrintCount(const wchar_t* label, size_t count)
+        {
+            if (!sampled)
+            {
+                wprintf(L"%ls - %zu\n", label, count);
+                return;
+            }
+
+            double lower, upper;
+            GetConfidenceInterval(count, sampled, lower, upper);
+
+            // The blocks seen in the sample are certain, and the rest can add at most the unseen ones
+            const size_t most = count + blocks - sampled;
+            const size_t low = std::min(std::max(count, size_t(lower * double(blocks))), most);
+            const size_t high = std::min(std::max(count, size_t(ceil(upper * double(blocks)))), most);
+
+            wprintf(L"%ls - ~%zu (%zu to %zu)\n", label,
+                size_t(double(count) * double(blocks) / double(sampled) + 0.5), low, high);
+        }
 
         void Print(DXGI_FORMAT fmt)
         {
@@ -982,34 +1309,39 @@ namespace
             PrintFormat(fmt);
             wprintf(L"\n\t       Total blocks - %zu\n", blocks);
 
+            if (sampled)
+            {
+                wprintf(L"\t     Sampled blocks - %zu (estimates with 95%% confidence)\n", sampled);
+            }
+
             switch (fmt)
             {
             case DXGI_FORMAT_BC1_UNORM:
             case DXGI_FORMAT_BC1_UNORM_SRGB:
-                wprintf(L"\t     4 color blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     3 color blocks - %zu\n", blockHist[1]);
+                PrintCount(L"\t     4 color blocks", blockHist[0]);
+                PrintCount(L"\t     3 color blocks", blockHist[1]);
                 break;
 
                 // BC2 only has a single 'type' of block
 
             case DXGI_FORMAT_BC3_UNORM:
             case DXGI_FORMAT_BC3_UNORM_SRGB:
-                wprintf(L"\t     8 alpha blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     6 alpha blocks - %zu\n", blockHist[1]);
+                PrintCount(L"\t     8 alpha blocks", blockHist[0]);
+                PrintCount(L"\t     6 alpha blocks", blockHist[1]);
                 break;
 
             case DXGI_FORMAT_BC4_UNORM:
             case DXGI_FORMAT_BC4_SNORM:
-                wprintf(L"\t     8 red blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     6 red blocks - %zu\n", blockHist[1]);
+                PrintCount(L"\t     8 red blocks", blockHist[0]);
+                PrintCount(L"\t     6 red blocks", blockHist[1]);
                 break;
 
             case DXGI_FORMAT_BC5_UNORM:
             case DXGI_FORMAT_BC5_SNORM:
-                wprintf(L"\t     8 red blocks - %zu\n", blockHist[0]);
-                wprintf(L"\t     6 red blocks - %zu\n", blockHist[1]);
-                wprintf(L"\t   8 green blocks - %zu\n", blockHist[2]);
-                wprintf(L"\t   6 green blocks - %zu\n", blockHist[3]);
+                PrintCount(L"\t     8 red blocks", blockHist[0]);
+                PrintCount(L"\t     6 red blocks", blockHist[1]);
+                PrintCount(L"\t   8 green blocks", blockHist[2]);
+                PrintCount(L"\t   6 green blocks", blockHist[3]);
                 break;
 
             case DXGI_FORMAT_BC6H_UF16:
@@ -1017,7 +1349,10 @@ namespace
                 for (size_t j = 1; j <= 14; ++j)
                 {
                     if (blockHist[j] > 0)
+                    {
                         wprintf(L"\t     Mode %02zu blocks - %zu\n", j, blockHist[j]);
+                        PrintPartitions(j);
+                    }
                 }
                 if (blockHist[0] > 0)
                     wprintf(L"\tReserved mode blcks - %zu\n", blockHist[0]);
@@ -1028,7 +1363,10 @@ namespace
                 for (size_t j = 0; j <= 7; ++j)
                 {
                     if (blockHist[j] > 0)
+                    {
                         wprintf(L"\t     Mode %02zu blocks - %zu\n", j, blockHist[j]);
+                        PrintPartitions(j);
+                    }
                 }
                 if (blockHist[8] > 0)
                     wprintf(L"\tReserved mode blcks - %zu\n", blockHist[8]);
@@ -1087,317 +1425,400 @@ namespace
     };
 #pragma pack(pop)
 
-    HRESULT AnalyzeBC(const Image& image, _Out_ AnalyzeBCData& result)
+    // Reads count bits starting at bit start of a 128-bit BC6H/BC7 block
+    size_t GetBlockBits(const uint8_t* sptr, size_t start, size_t count)
     {
-        memset(&result, 0, sizeof(AnalyzeBCData));
+        size_t value = 0;
+        for (size_t j = 0; j < count; ++j)
+        {
+            value |= size_t((sptr[(start + j) >> 3] >> ((start + j) & 7)) & 1) << j;
+        }
+        return value;
+    }
 
-        size_t sbpp;
-        switch (image.format)
+    // Counts the type of a single block
+    void CountBlock(DXGI_FORMAT format, const uint8_t* sptr, AnalyzeBCData& result)
+    {
+        switch (format)
         {
         case DXGI_FORMAT_BC1_UNORM:
         case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC4_UNORM:
-        case DXGI_FORMAT_BC4_SNORM:
-            sbpp = 8;
-            break;
+            {
+                auto block = reinterpret_cast<const BC1Block*>(sptr);
 
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-        case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC5_UNORM:
-        case DXGI_FORMAT_BC5_SNORM:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-        case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-            sbpp = 16;
+                if (block->rgb[0] <= block->rgb[1])
+                {
+                    // Transparent block
+                    ++result.blockHist[1];
+                }
+                else
+                {
+                    // Opaque block
+                    ++result.blockHist[0];
+                }
+            }
             break;
 
-        default:
-            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
-        }
-
-        const uint8_t *pSrc = image.pixels;
-        const size_t rowPitch = image.rowPitch;
-
-        for (size_t h = 0; h < image.height; h += 4)
-        {
-            const uint8_t *sptr = pSrc;
+            // BC2 only has a single 'type' of block
 
-            for (size_t count = 0; count < rowPitch; count += sbpp)
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
             {
-                switch (image.format)
-                {
-                case DXGI_FORMAT_BC1_UNORM:
-                case DXGI_FORMAT_BC1_UNORM_SRGB:
-                    {
-                        auto block = reinterpret_cast<const BC1Block*>(sptr);
-
-                        if (block->rgb[0] <= block->rgb[1])
-                        {
-                            // Transparent block
-                            ++result.blockHist[1];
-                        }
-                        else
-                        {
-                            // Opaque block
-                            ++result.blockHist[0];
-                        }
-                    }
-                    break;
-
-                    // BC2 only has a single 'type' of block
+                auto block = reinterpret_cast<const BC3Block*>(sptr);
 
-                case DXGI_FORMAT_BC3_UNORM:
-                case DXGI_FORMAT_BC3_UNORM_SRGB:
-                    {
-                        auto block = reinterpret_cast<const BC3Block*>(sptr);
-
-                        if (block->alpha[0] > block->alpha[1])
-                        {
-                            // 8 alpha block
-                            ++result.blockHist[0];
-                        }
-                        else
-                        {
-                            // 6 alpha block
-                            ++result.blockHist[1];
-                        }
-                    }
-                    break;
-
-                case DXGI_FORMAT_BC4_UNORM:
-                    {
-                        auto block = reinterpret_cast<const BC4UBlock*>(sptr);
-
-                        if (block->red_0 > block->red_1)
-                        {
-                            // 8 red block
-                            ++result.blockHist[0];
-                        }
-                        else
-                        {
-                            // 6 red block
-                            ++result.blockHist[1];
-                        }
-                    }
-                    break;
+                if (block->alpha[0] > block->alpha[1])
+                {
+                    // 8 alpha block
+                    ++result.blockHist[0];
+                }
+                else
+                {
+                    // 6 alpha block
+                    ++result.blockHist[1];
+                }
+            }
+            break;
 
-                case DXGI_FORMAT_BC4_SNORM:
-                    {
-                        auto block = reinterpret_cast<const BC4SBlock*>(sptr);
+        case DXGI_FORMAT_BC4_UNORM:
+            {
+                auto block = reinterpret_cast<const BC4UBlock*>(sptr);
 
-                        if (block->red_0 > block->red_1)
-                        {
-                            // 8 red block
-                            ++result.blockHist[0];
-                        }
-                        else
-                        {
-                            // 6 red block
-                            ++result.blockHist[1];
-                        }
-                    }
-                    break;
+                if (block->red_0 > block->red_1)
+                {
+                    // 8 red block
+                    ++result.blockHist[0];
+                }
+                else
+                {
+                    // 6 red block
+                    ++result.blockHist[1];
+                }
+            }
+            break;
 
-                case DXGI_FORMAT_BC5_UNORM:
-                    {
-                        auto block = reinterpret_cast<const BC5UBlock*>(sptr);
+        case DXGI_FORMAT_BC4_SNORM:
+            {
+                auto block = reinterpret_cast<const BC4SBlock*>(sptr);
 
-                        if (block->u.red_0 > block->u.red_1)
-                        {
-                            // 8 red block
-                            ++result.blockHist[0];
-                        }
-                        else
-                        {
-                            // 6 red block
-                            ++result.blockHist[1];
-                        }
+                if (block->red_0 > block->red_1)
+                {
+                    // 8 red block
+                    ++result.blockHist[0];
+                }
+                else
+                {
+                    // 6 red block
+                    ++result.blockHist[1];
+                }
+            }
+            break;
 
-                        if (block->v.red_0 > block->v.red_1)
-                        {
-                            // 8 green block
-                            ++result.blockHist[2];
-                        }
-                        else
-                        {
-                            // 6 green block
-                            ++result.blockHist[3];
-                        }
-                    }
-                    break;
+        case DXGI_FORMAT_BC5_UNORM:
+            {
+                auto block = reinterpret_cast<const BC5UBlock*>(sptr);
 
-                case DXGI_FORMAT_BC5_SNORM:
-                    {
-                        auto block = reinterpret_cast<const BC5SBlock*>(sptr);
+                if (block->u.red_0 > block->u.red_1)
+                {
+                    // 8 red block
+                    ++result.blockHist[0];
+                }
+                else
+                {
+                    // 6 red block
+                    ++result.blockHist[1];
+                }
 
-                        if (block->u.red_0 > block->u.red_1)
-                        {
-                            // 8 red block
-                            ++result.blockHist[0];
-                        }
-                        else
-                        {
-                            // 6 red block
-                            ++result.blockHist[1];
-                        }
+                if (block->v.red_0 > block->v.red_1)
+                {
+                    // 8 green block
+                    ++result.blockHist[2];
+                }
+                else
+                {
+                    // 6 green block
+                    ++result.blockHist[3];
+                }
+            }
+            break;
 
-                        if (block->v.red_0 > block->v.red_1)
-                        {
-                            // 8 green block
-                            ++result.blockHist[2];
-                        }
-                        else
-                        {
-                            // 6 green block
-                            ++result.blockHist[3];
-                        }
-                    }
-                    break;
+        case DXGI_FORMAT_BC5_SNORM:
+            {
+                auto block = reinterpret_cast<const BC5SBlock*>(sptr);
 
-                case DXGI_FORMAT_BC6H_UF16:
-                case DXGI_FORMAT_BC6H_SF16:
-                    switch (*sptr & 0x03)
-                    {
-                    case 0x00:
-                        // Mode 1 (2 bits, 00)
-                        ++result.blockHist[1];
-                        break;
+                if (block->u.red_0 > block->u.red_1)
+                {
+                    // 8 red block
+                    ++result.blockHist[0];
+                }
+                else
+                {
+                    // 6 red block
+                    ++result.blockHist[1];
+                }
 
-                    case 0x01:
-                        // Mode 2 (2 bits, 01)
-                        ++result.blockHist[2];
-                        break;
+                if (block->v.red_0 > block->v.red_1)
+                {
+                    // 8 green block
+                    ++result.blockHist[2];
+                }
+                else
+                {
+                    // 6 green block
+                    ++result.blockHist[3];
+                }
+            }
+            break;
 
-                    default:
-                        switch (*sptr & 0x1F)
-                        {
-                        case 0x02:
-                            // Mode 3 (5 bits, 00010)
-                            ++result.blockHist[3];
-                            break;
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            switch (*sptr & 0x03)
+            {
+            case 0x00:
+                // Mode 1 (2 bits, 00)
+                ++result.blockHist[1];
+                break;
 
-                        case 0x06:
-                            // Mode 4 (5 bits, 00110)
-                            ++result.blockHist[4];
-                            break;
+            case 0x01:
+                // Mode 2 (2 bits, 01)
+                ++result.blockHist[2];
+                break;
 
-                        case 0x0A:
-                            // Mode 5 (5 bits, 01010)
-                            ++result.blockHist[5];
-                            break;
+            default:
+                switch (*sptr & 0x1F)
+                {
+                case 0x02:
+                    // Mode 3 (5 bits, 00010)
+                    ++result.blockHist[3];
+                    break;
 
-                        case 0x0E:
-                            // Mode 6 (5 bits, 01110)
-                            ++result.blockHist[6];
-                            break;
+                case 0x06:
+                    // Mode 4 (5 bits, 00110)
+                    ++result.blockHist[4];
+                    break;
 
-                        case 0x12:
-                            // Mode 7 (5 bits, 10010)
-                            ++result.blockHist[7];
-                            break;
+                case 0x0A:
+                    // Mode 5 (5 bits, 01010)
+                    ++result.blockHist[5];
+                    break;
 
-                        case 0x16:
-                            // Mode 8 (5 bits, 10110)
-                            ++result.blockHist[8];
-                            break;
+                case 0x0E:
+                    // Mode 6 (5 bits, 01110)
+                    ++result.blockHist[6];
+                    break;
 
-                        case 0x1A:
-                            // Mode 9 (5 bits, 11010)
-                            ++result.blockHist[9];
-                            break;
+                case 0x12:
+                    // Mode 7 (5 bits, 10010)
+                    ++result.blockHist[7];
+                    break;
 
-                        case 0x1E:
-                            // Mode 10 (5 bits, 11110)
-                            ++result.blockHist[10];
-                            break;
+                case 0x16:
+                    // Mode 8 (5 bits, 10110)
+                    ++result.blockHist[8];
+                    break;
 
-                        case 0x03:
-                            // Mode 11 (5 bits, 00011)
-                            ++result.blockHist[11];
-                            break;
+                case 0x1A:
+                    // Mode 9 (5 bits, 11010)
+                    ++result.blockHist[9];
+                    break;
 
-                        case 0x07:
-                            // Mode 12 (5 bits, 00111)
-                            ++result.blockHist[12];
-                            break;
+                case 0x1E:
+                    // Mode 10 (5 bits, 11110)
+                    ++result.blockHist[10];
+                    break;
 
-                        case 0x0B:
-                            // Mode 13 (5 bits, 01011)
-                            ++result.blockHist[13];
-                            break;
+                case 0x03:
+                    // Mode 11 (5 bits, 00011)
+                    ++result.blockHist[11];
+                    break;
 
-                        case 0x0F:
-                            // Mode 14 (5 bits, 01111)
-                            ++result.blockHist[14];
-                            break;
+                case 0x07:
+                    // Mode 12 (5 bits, 00111)
+                    ++result.blockHist[12];
+                    break;
 
-                        case 0x13: // Reserved mode (5 bits, 10011)
-                        case 0x17: // Reserved mode (5 bits, 10111)
-                        case 0x1B: // Reserved mode (5 bits, 11011)
-                        case 0x1F: // Reserved mode (5 bits, 11111)
-                        default:
-                            ++result.blockHist[0];
-                            break;
-                        }
-                        break;
-                    }
+                case 0x0B:
+                    // Mode 13 (5 bits, 01011)
+                    ++result.blockHist[13];
                     break;
 
-                case DXGI_FORMAT_BC7_UNORM:
-                case DXGI_FORMAT_BC7_UNORM_SRGB:
-                    if (*sptr & 0x01)
-                    {
-                        // Mode 0 (1)
-                        ++result.blockHist[0];
-                    }
-                    else if (*sptr & 0x02)
-                    {
-                        // Mode 1 (01)
-                        ++result.blockHist[1];
-                    }
-                    else if (*sptr & 0x04)
-                    {
-                        // Mode 2 (001)
-                        ++result.blockHist[2];
-                    }
-                    else if (*sptr & 0x08)
-                    {
-                        // Mode 3 (0001)
-                        ++result.blockHist[3];
-                    }
-                    else if (*sptr & 0x10)
-                    {
-                        // Mode 4 (00001)
-                        ++result.blockHist[4];
-                    }
-                    else if (*sptr & 0x20)
-                    {
-                        // Mode 5 (000001)
-                        ++result.blockHist[5];
-                    }
-                    else if (*sptr & 0x40)
-                    {
-                        // Mode 6 (0000001)
-                        ++result.blockHist[6];
-                    }
-                    else if (*sptr & 0x80)
-                    {
-                        // Mode 7 (00000001)
-                        ++result.blockHist[7];
-                    }
-                    else
-                    {
-                        // Reserved mode 8 (00000000)
-                        ++result.blockHist[8];
-                    }
+                case 0x0F:
+                    // Mode 14 (5 bits, 01111)
+                    ++result.blockHist[14];
                     break;
 
+                case 0x13: // Reserved mode (5 bits, 10011)
+                case 0x17: // Reserved mode (5 bits, 10111)
+                case 0x1B: // Reserved mode (5 bits, 11011)
+                case 0x1F: // Reserved mode (5 bits, 11111)
                 default:
+                    ++result.blockHist[0];
                     break;
                 }
+                break;
+            }
+
+            if ((*sptr & 0x03) != 0x03)
+            {
+                // Modes 1-10 have two regions, with the shape in bits 77-81
+                const size_t mode = ((*sptr & 0x02) == 0) ? size_t(*sptr & 0x01) + 1 : size_t((*sptr & 0x1F) >> 2) + 3;
+                ++result.partitionHist[mode][GetBlockBits(sptr, 77, 5)];
+            }
+            break;
+
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            if (*sptr & 0x01)
+            {
+                // Mode 0 (1)
+                ++result.blockHist[0];
+            }
+            else if (*sptr & 0x02)
+            {
+                // Mode 1 (01)
+                ++result.blockHist[1];
+            }
+            else if (*sptr & 0x04)
+            {
+                // Mode 2 (001)
+                ++result.blockHist[2];
+            }
+            else if (*sptr & 0x08)
+            {
+                // Mode 3 (0001)
+                ++result.blockHist[3];
+            }
+            else if (*sptr & 0x10)
+            {
+                // Mode 4 (00001)
+                ++result.blockHist[4];
+            }
+            else if (*sptr & 0x20)
+            {
+                // Mode 5 (000001)
+                ++result.blockHist[5];
+            }
+            else if (*sptr & 0x40)
+            {
+                // Mode 6 (0000001)
+                ++result.blockHist[6];
+            }
+            else if (*sptr & 0x80)
+            {
+                // Mode 7 (00000001)
+                ++result.blockHist[7];
+            }
+            else
+            {
+                // Reserved mode 8 (00000000)
+                ++result.blockHist[8];
+            }
+
+            if (*sptr)
+            {
+                size_t mode = 0;
+                while (!(*sptr & (1u << mode)))
+                    ++mode;
+
+                // Modes 0-3 and 7 have subsets, with the partition after the mode bits
+                if (mode < 4 || mode == 7)
+                    ++result.partitionHist[mode][GetBlockBits(sptr, mode + 1, (mode == 0) ? 4 : 6)];
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // Returns true once every block type the verdict depends on has been seen. The verdict
+    // is only defined for formats with two interpolation modes per channel.
+    bool VerdictReached(DXGI_FORMAT format, const AnalyzeBCData& result)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            return result.blockHist[0] && result.blockHist[1];
+
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+            return result.blockHist[0] && result.blockHist[1] && result.blockHist[2] && result.blockHist[3];
+
+        default:
+            return false;
+        }
+    }
+
+    // A non-zero sampleBlocks only counts a stratified sample of at most that many blocks,
+    // and sets sampled to the number counted when that is less than the total
+    HRESULT AnalyzeBC(const Image& image, _Out_ AnalyzeBCData& result, size_t sampleBlocks = 0)
+    {
+        memset(&result, 0, sizeof(AnalyzeBCData));
+
+        size_t sbpp;
+        switch (image.format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            sbpp = 8;
+            break;
+
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_UNORM:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            sbpp = 16;
+            break;
+
+        default:
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        const uint8_t *pSrc = image.pixels;
+        const size_t rowPitch = image.rowPitch;
+
+        BlockSampleOrder order;
+        ComputeBlockSampleOrder(image.width, image.height, sampleBlocks, false, order);
+
+        const size_t nbWidth = order.nbWidth;
+
+        // A sample can only settle a verdict, so formats without one count every block
+        AnalyzeBCData allTypes = {};
+        std::fill_n(allTypes.blockHist, 4, size_t(1));
+
+        const size_t nCells = order.cellsX * order.cellsY;
+        if (nCells < nbWidth * order.nbHeight && VerdictReached(image.format, allTypes))
+        {
+            for (size_t cell = 0; cell < nCells; ++cell)
+            {
+                const size_t index = GetSampleBlockIndex(order, cell);
+                CountBlock(image.format, pSrc + (index / nbWidth) * rowPitch + (index % nbWidth) * sbpp, result);
+            }
+
+            result.blocks = nbWidth * order.nbHeight;
+            result.sampled = nCells;
+            return S_OK;
+        }
+
+        for (size_t h = 0; h < image.height; h += 4)
+        {
+            const uint8_t *sptr = pSrc;
+
+            for (size_t count = 0; count < rowPitch; count += sbpp)
+            {
+                CountBlock(image.format, sptr, result);
 
                 sptr += sbpp;
                 ++result.blocks;
@@ -3240,6 +3661,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     int pixely = -1;
     uint32_t diffColor = 0;
     float threshold = 0.25f;
+    size_t sampleBlocks = 0;
     DXGI_FORMAT diffFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
     uint32_t fileType = WIC_CODEC_BMP;
     wchar_t szOutputFile[MAX_PATH] = {};
@@ -3317,6 +3739,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             case OPT_DIFF_COLOR:
             case OPT_THRESHOLD:
             case OPT_FILELIST:
+            case OPT_SAMPLE:
                 if (!*pValue)
                 {
                     if ((iArg + 1 >= argc))
@@ -3449,6 +3872,16 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 }
                 break;
 
+            case OPT_SAMPLE:
+                if (swscanf_s(pValue, L"%zu", &sampleBlocks) != 1 || !sampleBlocks)
+                {
+                    wprintf(L"Invalid value specified with -sample (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
             case OPT_FILELIST:
                 {
                     std::wifstream inFile(pValue);
@@ -3757,7 +4190,33 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         break;
 
     default:
-        for (auto pConv = conversion.cbegin(); pConv != conversion.cend(); ++pConv)
+        // Info only needs the metadata, so read every header first and only load the files
+        // whose header doesn't settle it
+        struct HeaderInfo
+        {
+            TexMetadata info;
+            HRESULT hr;
+        };
+
+        std::vector<HeaderInfo> headers;
+        if (dwCommand == CMD_INFO)
+        {
+            std::vector<const SConversion*> files;
+            files.reserve(conversion.size());
+            for (const auto& conv : conversion)
+            {
+                files.push_back(&conv);
+            }
+
+            headers.resize(files.size());
+            RunConcurrently(files.size(), [&](size_t index)
+                {
+                    headers[index].hr = LoadMetadata(files[index]->szSrc, dwOptions, headers[index].info);
+                });
+        }
+
+        size_t fileIndex = 0;
+        for (auto pConv = conversion.cbegin(); pConv != conversion.cend(); ++pConv, ++fileIndex)
         {
             // Load source image
             if (pConv != conversion.begin())
@@ -3768,11 +4227,18 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
 
             TexMetadata info;
             std::unique_ptr<ScratchImage> image;
-            hr = LoadImage(pConv->szSrc, dwOptions, dwFilter, info, image);
-            if (FAILED(hr))
+            if (!headers.empty() && headers[fileIndex].hr == S_OK)
             {
-                wprintf(L" FAILED (%08X%ls)\n", static_cast<unsigned int>(hr), GetErrorDesc(hr));
-                return 1;
+                info = headers[fileIndex].info;
+            }
+            else
+            {
+                hr = LoadImage(pConv->szSrc, dwOptions, dwFilter, info, image);
+                if (FAILED(hr))
+                {
+                    wprintf(L" FAILED (%08X%ls)\n", static_cast<unsigned int>(hr), GetErrorDesc(hr));
+                    return 1;
+                }
             }
 
             wprintf(L"\n");
@@ -3831,9 +4297,26 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                     break;
                 }
 
-                wprintf(L"\n       images = %zu\n", image->GetImageCount());
+                size_t nimages = 0;
+                size_t pixelSize = 0;
+                if (image)
+                {
+                    nimages = image->GetImageCount();
+                    pixelSize = image->GetPixelsSize();
+                }
+                else
+                {
+                    hr = GetImageArraySize(info, nimages, pixelSize);
+                    if (FAILED(hr))
+                    {
+                        wprintf(L"\nERROR: Failed computing image size (%08X%ls)\n", static_cast<unsigned int>(hr), GetErrorDesc(hr));
+                        return 1;
+                    }
+                }
+
+                wprintf(L"\n       images = %zu\n", nimages);
 
-                auto const sizeInKb = static_cast<uint32_t>(image->GetPixelsSize() / 1024);
+                auto const sizeInKb = static_cast<uint32_t>(pixelSize / 1024);
 
                 wprintf(L"   pixel size = %u (KB)\n\n", sizeInKb);
             }
@@ -4076,6 +4559,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                     image.swap(timage);
                 }
 
+                // Every mip, item, and slice is analyzed in one concurrent sweep
+                std::vector<AnalyzeData> results(image->GetImageCount());
+                hr = Analyze(image->GetImages(), image->GetImageCount(), results.data());
+                if (FAILED(hr))
+                {
+                    wprintf(L"ERROR: Failed analyzing image (%08X%ls)\n", static_cast<unsigned int>(hr), GetErrorDesc(hr));
+                    return 1;
+                }
+
                 if (info.depth > 1)
                 {
                     wprintf(L"Results by mip (%3zu) and slice (%3zu)\n\n", info.mipLevels, info.depth);
@@ -4094,14 +4586,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                             }
                             else
                             {
-                                AnalyzeData data;
-                                hr = Analyze(*img, data);
-                                if (FAILED(hr))
-                                {
-                                    wprintf(L"ERROR: Failed analyzing image at slice %3zu, mip %3zu (%08X%ls)\n", slice, mip, static_cast<unsigned int>(hr), GetErrorDesc(hr));
-                                    return 1;
-                                }
-
+                                AnalyzeData& data = results[size_t(img - image->GetImages())];
                                 wprintf(L"Result slice %3zu, mip %3zu:\n", slice, mip);
                                 data.Print();
                             }
@@ -4109,7 +4594,13 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                             if (IsCompressed(info.format))
                             {
                                 AnalyzeBCData data;
-                                hr = AnalyzeBC(*img, data);
+                                hr = AnalyzeBC(*img, data, sampleBlocks);
+
+                                // A sample that missed a block type can't rule it out, so count every block
+                                if (SUCCEEDED(hr) && data.sampled && !VerdictReached(img->format, data))
+                                {
+                                    hr = AnalyzeBC(*img, data);
+                                }
                                 if (FAILED(hr))
                                 {
                                     wprintf(L"ERROR: Failed analyzing BC image at slice %3zu, mip %3zu (%08X%ls)\n", slice, mip, static_cast<unsigned int>(hr), GetErrorDesc(hr));
@@ -4142,14 +4633,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                             }
                             else
                             {
-                                AnalyzeData data;
-                                hr = Analyze(*img, data);
-                                if (FAILED(hr))
-                                {
-                                    wprintf(L"ERROR: Failed analyzing image at item %3zu, mip %3zu (%08X%ls)\n", item, mip, static_cast<unsigned int>(hr), GetErrorDesc(hr));
-                                    return 1;
-                                }
-
+                                AnalyzeData& data = results[size_t(img - image->GetImages())];
                                 if (image->GetImageCount() > 1)
                                 {
                                     wprintf(L"Result item %3zu, mip %3zu:\n", item, mip);
@@ -4160,7 +4644,13 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                             if (IsCompressed(info.format))
                             {
                                 AnalyzeBCData data;
-                                hr = AnalyzeBC(*img, data);
+                                hr = AnalyzeBC(*img, data, sampleBlocks);
+
+                                // A sample that missed a block type can't rule it out, so count every block
+                                if (SUCCEEDED(hr) && data.sampled && !VerdictReached(img->format, data))
+                                {
+                                    hr = AnalyzeBC(*img, data);
+                                }
                                 if (FAILED(hr))
                                 {
                                     wprintf(L"ERROR: Failed analyzing BC image at item %3zu, mip %3zu (%08X%ls)\n", item, mip, static_cast<unsigned int>(hr), GetErrorDesc(hr));